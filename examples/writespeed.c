@@ -0,0 +1,133 @@
+/*
+	Audio File Library
+
+	This program is free software; you can redistribute it and/or modify
+	it under the terms of the GNU General Public License as published by
+	the Free Software Foundation; either version 2 of the License, or
+	(at your option) any later version.
+
+	This program is distributed in the hope that it will be useful,
+	but WITHOUT ANY WARRANTY; without even the implied warranty of
+	MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+	GNU General Public License for more details.
+
+	You should have received a copy of the GNU General Public License along
+	with this program; if not, write to the Free Software Foundation, Inc.,
+	51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+*/
+
+/*
+	writespeed.c
+
+	Measure how fast a large WAVE file is written with a given write
+	policy.
+*/
+
+#ifdef HAVE_CONFIG_H
+#include <config.h>
+#endif
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/time.h>
+#include <unistd.h>
+#include <audiofile.h>
+
+#define CHANNEL_COUNT 2
+#define FRAMES_PER_WRITE 4096
+
+static void usage (const char *program)
+{
+	fprintf(stderr,
+		"usage: %s [-p] [-d] [-s] [-w] [-b bytes] [-m megabytes] filename\n"
+		"  -p  preallocate the sound data\n"
+		"  -d  write the sound data with direct I/O\n"
+		"  -s  wait for the file to reach storage when it is closed\n"
+		"  -w  write the buffer from a background thread\n"
+		"  -b  size of the I/O buffer (default 65536)\n"
+		"  -m  size of the sound data (default 1024)\n",
+		program);
+	exit(EXIT_FAILURE);
+}
+
+static double now (void)
+{
+	struct timeval tv;
+	gettimeofday(&tv, NULL);
+	return tv.tv_sec + tv.tv_usec / 1000000.0;
+}
+
+int main (int argc, char **argv)
+{
+	int policy = AF_WRITE_NORMAL;
+	int writeBehind = 0;
+	int bufferSize = 65536;
+	long megabytes = 1024;
+	int c;
+
+	while ((c = getopt(argc, argv, "pdswb:m:")) != -1)
+	{
+		switch (c)
+		{
+			case 'p': policy |= AF_WRITE_PREALLOCATE; break;
+			case 'd': policy |= AF_WRITE_DIRECT; break;
+			case 's': policy |= AF_WRITE_SYNC_ON_CLOSE; break;
+			case 'w': writeBehind = 1; break;
+			case 'b': bufferSize = atoi(optarg); break;
+			case 'm': megabytes = atol(optarg); break;
+			default: usage(argv[0]);
+		}
+	}
+	if (optind != argc - 1 || megabytes <= 0 || bufferSize < 0)
+		usage(argv[0]);
+
+	AFframecount frameCount = (AFframecount) megabytes * 1048576 /
+		(CHANNEL_COUNT * sizeof (short));
+
+	AFfilesetup setup = afNewFileSetup();
+	afInitFileFormat(setup, AF_FILE_WAVE);
+	afInitChannels(setup, AF_DEFAULT_TRACK, CHANNEL_COUNT);
+	afInitSampleFormat(setup, AF_DEFAULT_TRACK, AF_SAMPFMT_TWOSCOMP, 16);
+	afInitFrameCount(setup, AF_DEFAULT_TRACK, frameCount);
+	afInitBufferSize(setup, bufferSize);
+	afInitWriteBehind(setup, writeBehind);
+	afInitWritePolicy(setup, policy);
+
+	short *buffer = malloc(FRAMES_PER_WRITE * CHANNEL_COUNT * sizeof (short));
+	for (int i=0; i<FRAMES_PER_WRITE * CHANNEL_COUNT; i++)
+		buffer[i] = (i * 37) % 20011 - 10000;
+
+	double start = now();
+
+	AFfilehandle file = afOpenFile(argv[optind], "w", setup);
+	afFreeFileSetup(setup);
+	if (file == AF_NULL_FILEHANDLE)
+	{
+		fprintf(stderr, "could not open %s for writing\n", argv[optind]);
+		exit(EXIT_FAILURE);
+	}
+
+	AFframecount framesWritten = 0;
+	while (framesWritten < frameCount)
+	{
+		int n = FRAMES_PER_WRITE;
+		if (frameCount - framesWritten < n)
+			n = frameCount - framesWritten;
+		if (afWriteFrames(file, AF_DEFAULT_TRACK, buffer, n) != n)
+		{
+			fprintf(stderr, "could not write %s\n", argv[optind]);
+			exit(EXIT_FAILURE);
+		}
+		framesWritten += n;
+	}
+
+	afCloseFile(file);
+
+	double elapsed = now() - start;
+	printf("%ld MB in %.3f s: %.1f MB/s\n", megabytes, elapsed,
+		megabytes / elapsed);
+
+	free(buffer);
+	return 0;
+}
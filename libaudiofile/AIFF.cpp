@@ -81,6 +81,14 @@ static const _AFfilesetup aiffDefaultFileSetup =
 
 #define AIFC_VERSION_1 0xa2805140
 
+/*
+	AIFF has no way to leave the length of a chunk unspecified, so a
+	file written in streaming mode uses the largest possible chunk
+	lengths and frame count, which readers limit to the end of the
+	file.
+*/
+static const uint32_t kLengthUnspecified = 0xffffffff;
+
 struct _INST
 {
 	uint8_t		baseNote;
@@ -108,6 +116,8 @@ AIFFFile::AIFFFile()
 	m_MARK_offset = 0;
 	m_INST_offset = 0;
 	m_AESD_offset = 0;
+	m_PEAK_offset = 0;
+	m_PEAK_size = 0;
 	m_SSND_offset = 0;
 }
 
@@ -322,6 +332,8 @@ status AIFFFile::parseCOMM(const Tag &type, size_t size)
 
 	Track *track = getTrack();
 
+	m_COMM_offset = m_fh->tell() - 8;
+
 	uint16_t numChannels;
 	uint32_t numSampleFrames;
 	uint16_t sampleSize;
@@ -337,7 +349,10 @@ status AIFFFile::parseCOMM(const Tag &type, size_t size)
 	}
 
 	readU32(&numSampleFrames);
-	track->totalfframes = numSampleFrames;
+	if (numSampleFrames == kLengthUnspecified)
+		track->totalfframes = -1;
+	else
+		track->totalfframes = numSampleFrames;
 
 	readU16(&sampleSize);
 	track->f.sampleWidth = sampleSize;
@@ -424,7 +439,8 @@ status AIFFFile::parseCOMM(const Tag &type, size_t size)
 
 			initIMACompressionParams();
 
-			track->totalfframes *= 64;
+			if (track->totalfframes != -1)
+				track->totalfframes *= 64;
 		}
 		else
 		{
@@ -453,6 +469,8 @@ status AIFFFile::parseSSND(const Tag &type, size_t size)
 
 	Track *track = getTrack();
 
+	m_SSND_offset = m_fh->tell() - 8;
+
 	uint32_t offset, blockSize;
 	readU32(&offset);
 	readU32(&blockSize);
@@ -461,6 +479,12 @@ status AIFFFile::parseSSND(const Tag &type, size_t size)
 
 	track->fpos_first_frame = m_fh->tell() + offset;
 
+	if (size == kLengthUnspecified)
+	{
+		off_t length = m_fh->length();
+		track->data_size = length != -1 ? length - track->fpos_first_frame : -1;
+	}
+
 	return AF_SUCCEED;
 }
 
@@ -487,7 +511,8 @@ status AIFFFile::readInit(AFfilesetup setup)
 
 	/* Include the offset of the form type. */
 	size_t index = 4;
-	while (index < size)
+	bool dataExtendsToEnd = false;
+	while (index < size && !dataExtendsToEnd)
 	{
 		Tag chunkid;
 		uint32_t chunksize = 0;
@@ -506,26 +531,21 @@ status AIFFFile::readInit(AFfilesetup setup)
 			hasFVER = true;
 			parseFVER(chunkid, chunksize);
 		}
-		else if (chunkid == "INST")
-		{
-			parseINST(chunkid, chunksize);
-		}
-		else if (chunkid == "MARK")
-		{
-			parseMARK(chunkid, chunksize);
-		}
-		else if (chunkid == "AESD")
-		{
-			parseAESD(chunkid, chunksize);
-		}
-		else if (chunkid == "NAME" ||
+		else if (chunkid == "INST" ||
+			chunkid == "MARK" ||
+			chunkid == "AESD" ||
+			chunkid == "NAME" ||
 			chunkid == "AUTH" ||
 			chunkid == "(c) " ||
 			chunkid == "ANNO" ||
 			chunkid == "APPL" ||
 			chunkid == "MIDI")
 		{
-			parseMiscellaneous(chunkid, chunksize);
+			/*
+				Metadata is parsed when it is first asked for;
+				see parseDeferredChunk().
+			*/
+			deferChunk(chunkid, m_fh->tell(), chunksize);
 		}
 		/*
 			The sound data chunk is required if there are more than
@@ -540,11 +560,42 @@ status AIFFFile::readInit(AFfilesetup setup)
 			}
 			hasSSND = true;
 			result = parseSSND(chunkid, chunksize);
+			dataExtendsToEnd = chunksize == kLengthUnspecified;
+		}
+		else if (chunkid == "PEAK")
+		{
+			m_PEAK_offset = index + 8;
+			m_PEAK_size = chunksize;
+			parsePeakChunk(chunksize);
+		}
+		else if (chunkid == "FLLR")
+		{
+			// Space which metadata edited in place may take over.
+			m_chunkLayout.addFree(index + 8, 8 + chunksize + (chunksize % 2));
 		}
 
 		if (result == AF_FAIL)
 			return AF_FAIL;
 
+		if (m_headerOnly && hasCOMM && hasSSND)
+			break;
+
+		/*
+			A file which cannot seek is read in a single pass,
+			so nothing after the start of the data is parsed.
+		*/
+		if (!m_seekok && hasSSND)
+		{
+			if (!hasCOMM)
+			{
+				_af_error(AF_BAD_AIFF_COMM,
+					"COMM chunk must precede the SSND chunk "
+					"when reading from a non-seekable file");
+				return AF_FAIL;
+			}
+			break;
+		}
+
 		index += chunksize + 8;
 
 		/* all chunks must be aligned on an even number of bytes */
@@ -559,7 +610,21 @@ status AIFFFile::readInit(AFfilesetup setup)
 		_af_error(AF_BAD_AIFF_COMM, "bad AIFF COMM chunk");
 	}
 
-	if (isAIFFC() && !hasFVER)
+	// Peaks are ignored unless there is one for each channel.
+	Track *track = getTrack();
+	if (track->peaks.size() != static_cast<size_t>(track->f.channelCount))
+		track->peaks.clear();
+
+	// A PEAK chunk of another size cannot be rewritten in place.
+	if (m_PEAK_offset != 0 &&
+		m_PEAK_size != peakChunkSize(track->f.channelCount))
+		m_PEAK_offset = 0;
+
+	// A streamed file has as many frames as its sound data holds.
+	if (hasCOMM && hasSSND && getTrack()->totalfframes == -1)
+		getTrack()->computeTotalFileFrames();
+
+	if (isAIFFC() && !hasFVER && !m_headerOnly && m_seekok)
 	{
 		_af_error(AF_BAD_HEADER, "FVER chunk is required in AIFF-C");
 	}
@@ -568,32 +633,44 @@ status AIFFFile::readInit(AFfilesetup setup)
 	return AF_SUCCEED;
 }
 
-bool AIFFFile::recognizeAIFF(File *fh)
+status AIFFFile::parseDeferredChunk(const Tag &chunkid, AFfileoffset size)
 {
-	uint8_t buffer[8];
+	ChunkLayout::Extent extent = ChunkLayout::chunk(m_fh->tell() - 8, size);
 
-	fh->seek(0, File::SeekFromBeginning);
-
-	if (fh->read(buffer, 8) != 8 || memcmp(buffer, "FORM", 4) != 0)
-		return false;
-	if (fh->read(buffer, 4) != 4 || memcmp(buffer, "AIFF", 4) != 0)
-		return false;
-
-	return true;
+	if (chunkid == "INST")
+	{
+		m_INSTChunks.push_back(extent);
+		return parseINST(chunkid, size);
+	}
+	else if (chunkid == "MARK")
+	{
+		m_MARKChunks.push_back(extent);
+		return parseMARK(chunkid, size);
+	}
+	else if (chunkid == "AESD")
+	{
+		m_AESDChunks.push_back(extent);
+		return parseAESD(chunkid, size);
+	}
+	else
+	{
+		m_miscellaneousChunks.push_back(extent);
+		return parseMiscellaneous(chunkid, size);
+	}
 }
 
-bool AIFFFile::recognizeAIFFC(File *fh)
+bool AIFFFile::recognizeAIFF(const uint8_t *header, size_t length)
 {
-	uint8_t buffer[8];
-
-	fh->seek(0, File::SeekFromBeginning);
-
-	if (fh->read(buffer, 8) != 8 || memcmp(buffer, "FORM", 4) != 0)
-		return false;
-	if (fh->read(buffer, 4) != 4 || memcmp(buffer, "AIFC", 4) != 0)
-		return false;
+	return length >= 12 &&
+		memcmp(header, "FORM", 4) == 0 &&
+		memcmp(header + 8, "AIFF", 4) == 0;
+}
 
-	return true;
+bool AIFFFile::recognizeAIFFC(const uint8_t *header, size_t length)
+{
+	return length >= 12 &&
+		memcmp(header, "FORM", 4) == 0 &&
+		memcmp(header + 8, "AIFC", 4) == 0;
 }
 
 AFfilesetup AIFFFile::completeSetup(AFfilesetup setup)
@@ -764,7 +841,7 @@ status AIFFFile::writeInit(AFfilesetup setup)
 
 	initCompressionParams();
 
-	uint32_t fileSize = 0;
+	uint32_t fileSize = m_seekok ? 0 : kLengthUnspecified;
 	m_fh->write("FORM", 4);
 	writeU32(&fileSize);
 
@@ -781,6 +858,17 @@ status AIFFFile::writeInit(AFfilesetup setup)
 	writeINST();
 	writeAESD();
 	writeMiscellaneous();
+	// The peaks are known only after the audio data has been written.
+	if (getTrack()->computesPeaks && m_seekok)
+		writePEAK();
+
+	// Leave room for the metadata to grow if it is edited in place.
+	if (m_miscellaneousCount != 0 || getTrack()->markerCount != 0)
+	{
+		writeFreeChunk(ChunkLayout::kMetadataSlack);
+		reserveSpace(ChunkLayout::kMetadataSlack - 8);
+	}
+
 	writeSSND();
 
 	return AF_SUCCEED;
@@ -788,6 +876,10 @@ status AIFFFile::writeInit(AFfilesetup setup)
 
 status AIFFFile::update()
 {
+	// A streamed file's header is written only once.
+	if (!m_seekok)
+		return AF_SUCCEED;
+
 	/* Get the length of the file. */
 	uint32_t length = m_fh->length();
 	length -= 8;
@@ -796,19 +888,121 @@ status AIFFFile::update()
 	m_fh->seek(4, File::SeekFromBeginning);
 	writeU32(&length);
 
-	if (isAIFFC())
-		writeFVER();
+	// The frame count and the size of the sound data change with every update.
+	updateCOMM();
+	updateSSND();
 
-	writeCOMM();
-	writeMARK();
-	writeINST();
-	writeAESD();
-	writeMiscellaneous();
-	writeSSND();
+	if (m_PEAK_offset != 0 && writePEAK() == AF_FAIL)
+		return AF_FAIL;
+
+	if (m_metadataChanged)
+	{
+		writeMARK();
+		writeINST();
+		writeAESD();
+		writeMiscellaneous();
+	}
+
+	return AF_SUCCEED;
+}
+
+status AIFFFile::updateInit()
+{
+	// The offsets of the COMM and SSND chunks were found by readInit().
+
+	// Keep the peaks of a PEAK chunk up to date.
+	Track *track = getTrack();
+	if (m_PEAK_offset != 0 && !track->peaks.empty())
+		track->computesPeaks = true;
+	return AF_SUCCEED;
+}
+
+status AIFFFile::editInit()
+{
+	// The offset of the SSND chunk was found by readInit().
+	return AF_SUCCEED;
+}
+
+/*
+	Rewrite the chunks holding the metadata which has changed in a
+	file opened with "m".  A chunk stays where it is if it still
+	fits there and otherwise moves to free space or to the end of
+	the file, leaving a filler chunk in its place.
+*/
+status AIFFFile::updateMetadata()
+{
+	AFfileoffset originalLength = m_fh->length();
+	AFfileoffset length = originalLength;
+
+	if ((m_metadataChanged & kMarkerMetadata) && !m_MARKChunks.empty())
+	{
+		m_MARK_offset = m_chunkLayout.place(&m_MARKChunks, markSize(), &length);
+		writeMARK();
+	}
+
+	if ((m_metadataChanged & kInstrumentMetadata) && !m_INSTChunks.empty())
+	{
+		m_INST_offset = m_chunkLayout.place(&m_INSTChunks, 8 + 20, &length);
+		writeINST();
+	}
+
+	if ((m_metadataChanged & kAESMetadata) && !m_AESDChunks.empty())
+	{
+		m_AESD_offset = m_chunkLayout.place(&m_AESDChunks, 8 + 24, &length);
+		writeAESD();
+	}
+
+	if ((m_metadataChanged & kMiscellaneousMetadata) &&
+		!m_miscellaneousChunks.empty())
+	{
+		m_miscellaneousPosition = m_chunkLayout.place(&m_miscellaneousChunks,
+			miscellaneousSize(), &length);
+		writeMiscellaneous();
+	}
+
+	std::vector<ChunkLayout::Extent> freeChunks = m_chunkLayout.takeChanged();
+	for (size_t i=0; i<freeChunks.size(); i++)
+	{
+		m_fh->seek(freeChunks[i].offset, File::SeekFromBeginning);
+		writeFreeChunk(freeChunks[i].length);
+	}
+
+	if (length > originalLength)
+	{
+		// Chunks begin at even offsets.
+		if (originalLength % 2)
+		{
+			uint8_t zero = 0;
+			m_fh->seek(originalLength, File::SeekFromBeginning);
+			writeU8(&zero);
+		}
+
+		uint32_t formSize = length - 8;
+		m_fh->seek(4, File::SeekFromBeginning);
+		writeU32(&formSize);
+
+		// The sound data may have been written with an unspecified size.
+		if (updateSSND() == AF_FAIL)
+			return AF_FAIL;
+	}
 
 	return AF_SUCCEED;
 }
 
+/*
+	Write a filler chunk of the given total length, whose contents
+	are left as they are.
+*/
+status AIFFFile::writeFreeChunk(AFfileoffset length)
+{
+	assert(length >= ChunkLayout::kMinimumFreeLength);
+	Tag filler("FLLR");
+	uint32_t chunkSize = length - 8;
+	if (!writeTag(&filler) || !writeU32(&chunkSize))
+		return AF_FAIL;
+	return AF_SUCCEED;
+}
+
 status AIFFFile::writeCOMM()
 {
 	/*
@@ -897,9 +1091,7 @@ status AIFFFile::writeCOMM()
 	writeU16(&channelCount);
 
 	/* number of sample frames, 4 bytes */
-	uint32_t frameCount = track->totalfframes;
-	if (track->f.compressionType == AF_COMPRESSION_IMA)
-		frameCount = track->totalfframes / track->f.framesPerPacket;
+	uint32_t frameCount = frameCountForCOMM();
 	writeU32(&frameCount);
 
 	/* sample size, 2 bytes */
@@ -920,6 +1112,42 @@ status AIFFFile::writeCOMM()
 	return AF_SUCCEED;
 }
 
+uint32_t AIFFFile::frameCountForCOMM()
+{
+	if (!m_seekok)
+		return kLengthUnspecified;
+
+	Track *track = getTrack();
+	if (track->f.compressionType == AF_COMPRESSION_IMA)
+		return track->totalfframes / track->f.framesPerPacket;
+	return track->totalfframes;
+}
+
+// Rewrite the frame count, which follows the number of channels.
+status AIFFFile::updateCOMM()
+{
+	m_fh->seek(m_COMM_offset + 10, File::SeekFromBeginning);
+	uint32_t frameCount = frameCountForCOMM();
+	if (!writeU32(&frameCount))
+		return AF_FAIL;
+	return AF_SUCCEED;
+}
+
+/*
+	Rewrite the size of the SSND chunk, which includes the offset of
+	the sound data within it.
+*/
+status AIFFFile::updateSSND()
+{
+	Track *track = getTrack();
+	AFfileoffset dataOffset = track->fpos_first_frame - (m_SSND_offset + 16);
+	m_fh->seek(m_SSND_offset + 4, File::SeekFromBeginning);
+	uint32_t chunkSize = track->data_size + 8 + dataOffset;
+	if (!writeU32(&chunkSize))
+		return AF_FAIL;
+	return AF_SUCCEED;
+}
+
 /*
 	The AESD chunk contains information pertinent to audio recording
 	devices.
@@ -949,6 +1177,16 @@ status AIFFFile::writeAESD()
 	return AF_SUCCEED;
 }
 
+status AIFFFile::writePEAK()
+{
+	if (m_PEAK_offset == 0)
+		m_PEAK_offset = m_fh->tell();
+	else
+		m_fh->seek(m_PEAK_offset, File::SeekFromBeginning);
+
+	return writePeakChunk(Tag("FLLR"));
+}
+
 status AIFFFile::writeSSND()
 {
 	Track *track = getTrack();
@@ -960,7 +1198,7 @@ status AIFFFile::writeSSND()
 
 	m_fh->write("SSND", 4);
 
-	uint32_t chunkSize = track->data_size + 8;
+	uint32_t chunkSize = m_seekok ? track->data_size + 8 : kLengthUnspecified;
 	writeU32(&chunkSize);
 
 	uint32_t zero = 0;
@@ -977,6 +1215,11 @@ status AIFFFile::writeSSND()
 
 status AIFFFile::writeINST()
 {
+	if (m_INST_offset == 0)
+		m_INST_offset = m_fh->tell();
+	else
+		m_fh->seek(m_INST_offset, File::SeekFromBeginning);
+
 	uint32_t length = 20;
 
 	struct _INST instrumentdata;
@@ -1043,15 +1286,13 @@ status AIFFFile::writeMARK()
 	else
 		m_fh->seek(m_MARK_offset, File::SeekFromBeginning);
 
-	Tag markTag("MARK");
-	uint32_t length = 0;
+	uint16_t numMarkers = track->markerCount;
+	uint32_t length = markSize() - 8;
 
+	Tag markTag("MARK");
 	writeTag(&markTag);
 	writeU32(&length);
 
-	AFfileoffset chunkStartPosition = m_fh->tell();
-
-	uint16_t numMarkers = track->markerCount;
 	writeU16(&numMarkers);
 
 	for (unsigned i=0; i<numMarkers; i++)
@@ -1069,15 +1310,31 @@ status AIFFFile::writeMARK()
 		writePString(name);
 	}
 
-	AFfileoffset chunkEndPosition = m_fh->tell();
-	length = chunkEndPosition - chunkStartPosition;
+	return AF_SUCCEED;
+}
 
-	m_fh->seek(chunkStartPosition - 4, File::SeekFromBeginning);
+/*
+	Return the length of the MARK chunk, including its header.
+*/
+uint32_t AIFFFile::markSize()
+{
+	Track *track = getTrack();
 
-	writeU32(&length);
-	m_fh->seek(chunkEndPosition, File::SeekFromBeginning);
+	/*
+		Compute the length of the chunk in advance so that it need
+		not be patched afterwards.  Each marker has an identifier,
+		a position and a padded Pascal-style name.
+	*/
+	uint32_t length = 2;
+	for (int i=0; i<track->markerCount; i++)
+	{
+		size_t nameLength = strlen(track->markers[i].name);
+		length += 6;
+		if (nameLength <= 255)
+			length += (nameLength + 2) & ~1;
+	}
 
-	return AF_SUCCEED;
+	return 8 + length;
 }
 
 /*
@@ -1105,6 +1362,17 @@ status AIFFFile::writeFVER()
 	return AF_SUCCEED;
 }
 
+/*
+	Return the total length of the miscellaneous data chunks.
+*/
+uint32_t AIFFFile::miscellaneousSize()
+{
+	uint32_t length = 0;
+	for (int i=0; i<m_miscellaneousCount; i++)
+		length += 8 + m_miscellaneous[i].size + (m_miscellaneous[i].size % 2);
+	return length;
+}
+
 /*
 	WriteMiscellaneous writes all the miscellaneous data chunks in a
 	file handle structure to an AIFF or AIFF-C file.
@@ -1151,7 +1419,7 @@ status AIFFFile::writeMiscellaneous()
 		if (misc->buffer != NULL)
 			m_fh->write(misc->buffer, misc->size);
 		else
-			m_fh->seek(misc->size, File::SeekFromCurrent);
+			reserveSpace(misc->size);
 
 		if (misc->size % 2 != 0)
 			writeU8(&padByte);
@@ -28,9 +28,12 @@
 #ifndef AIFF_H
 #define AIFF_H
 
+#include "ChunkLayout.h"
 #include "Compiler.h"
 #include "FileHandle.h"
 
+#include <vector>
+
 #define _AF_AIFF_NUM_INSTPARAMS 9
 extern const InstParamInfo _af_aiff_inst_params[_AF_AIFF_NUM_INSTPARAMS];
 #define _AF_AIFFC_NUM_COMPTYPES 3
@@ -41,8 +44,8 @@ class AIFFFile : public _AFfilehandle
 public:
 	AIFFFile();
 
-	static bool recognizeAIFF(File *fh);
-	static bool recognizeAIFFC(File *fh);
+	static bool recognizeAIFF(const uint8_t *header, size_t length);
+	static bool recognizeAIFFC(const uint8_t *header, size_t length);
 
 	static AFfilesetup completeSetup(AFfilesetup);
 
@@ -50,11 +53,18 @@ public:
 
 	status readInit(AFfilesetup) OVERRIDE;
 	status writeInit(AFfilesetup) OVERRIDE;
+	status updateInit() OVERRIDE;
+	status editInit() OVERRIDE;
 
 	status update() OVERRIDE;
+	status updateMetadata() OVERRIDE;
+	bool supportsStreaming() OVERRIDE { return true; }
 
 	bool isInstrumentParameterValid(AUpvlist, int) OVERRIDE;
 
+protected:
+	status parseDeferredChunk(const Tag &, AFfileoffset) OVERRIDE;
+
 private:
 	AFfileoffset m_miscellaneousPosition;
 	AFfileoffset m_FVER_offset;
@@ -62,8 +72,17 @@ private:
 	AFfileoffset m_MARK_offset;
 	AFfileoffset m_INST_offset;
 	AFfileoffset m_AESD_offset;
+	AFfileoffset m_PEAK_offset;
+	uint32_t m_PEAK_size;
 	AFfileoffset m_SSND_offset;
 
+	// Free space and the chunks holding metadata, for editing in place.
+	ChunkLayout m_chunkLayout;
+	std::vector<ChunkLayout::Extent> m_MARKChunks;
+	std::vector<ChunkLayout::Extent> m_INSTChunks;
+	std::vector<ChunkLayout::Extent> m_AESDChunks;
+	std::vector<ChunkLayout::Extent> m_miscellaneousChunks;
+
 	status parseFVER(const Tag &type, size_t size);
 	status parseAESD(const Tag &type, size_t size);
 	status parseMiscellaneous(const Tag &type, size_t size);
@@ -74,11 +93,18 @@ private:
 
 	status writeCOMM();
 	status writeSSND();
+	uint32_t frameCountForCOMM();
+	status updateCOMM();
+	status updateSSND();
 	status writeMARK();
 	status writeINST();
 	status writeFVER();
 	status writeAESD();
+	status writePEAK();
 	status writeMiscellaneous();
+	status writeFreeChunk(AFfileoffset length);
+	uint32_t markSize();
+	uint32_t miscellaneousSize();
 
 	void initCompressionParams();
 	void initIMACompressionParams();
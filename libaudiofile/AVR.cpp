@@ -61,16 +61,9 @@ AVRFile::AVRFile()
 	setFormatByteOrder(AF_BYTEORDER_BIGENDIAN);
 }
 
-bool AVRFile::recognize(File *fh)
+bool AVRFile::recognize(const uint8_t *header, size_t length)
 {
-	uint32_t	magic;
-
-	fh->seek(0, File::SeekFromBeginning);
-
-	if (fh->read(&magic, 4) != 4 || memcmp(&magic, "2BIT", 4) != 0)
-		return false;
-
-	return true;
+	return length >= 4 && memcmp(header, "2BIT", 4) == 0;
 }
 
 status AVRFile::readInit(AFfilesetup setup)
@@ -36,7 +36,7 @@ class AVRFile : public _AFfilehandle
 public:
 	AVRFile();
 
-	static bool recognize(File *fh);
+	static bool recognize(const uint8_t *header, size_t length);
 	static AFfilesetup completeSetup(AFfilesetup);
 
 	status readInit(AFfilesetup) OVERRIDE;
@@ -0,0 +1,545 @@
+/*
+	Audio File Library
+
+	This library is free software; you can redistribute it and/or
+	modify it under the terms of the GNU Lesser General Public
+	License as published by the Free Software Foundation; either
+	version 2.1 of the License, or (at your option) any later version.
+
+	This library is distributed in the hope that it will be useful,
+	but WITHOUT ANY WARRANTY; without even the implied warranty of
+	MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+	Lesser General Public License for more details.
+
+	You should have received a copy of the GNU Lesser General Public
+	License along with this library; if not, write to the
+	Free Software Foundation, Inc., 51 Franklin Street, Fifth Floor,
+	Boston, MA  02110-1301  USA
+*/
+
+#include "config.h"
+#include "BufferedFile.h"
+
+#include <algorithm>
+#include <assert.h>
+#include <errno.h>
+#include <string.h>
+
+BufferedFile::BufferedFile(File *file, size_t bufferSize, bool writeBehind) :
+	File(file->accessMode()),
+	m_file(file),
+	m_buffer(NULL),
+	m_bufferSize(bufferSize),
+	m_bufferOffset(0),
+	m_readLength(0),
+	m_writeLength(0),
+	m_position(0),
+	m_filePosition(-1)
+#ifdef HAVE_PTHREAD_H
+	,
+	m_flushBuffer(NULL),
+	m_flushOffset(0),
+	m_flushLength(0),
+	m_flusherRunning(false),
+	m_flushPending(false),
+	m_stopFlusher(false)
+#endif
+{
+	assert(bufferSize > 0);
+	m_buffer = new uint8_t[m_bufferSize];
+	m_filePosition = m_file->tell();
+	m_seekable = m_filePosition != -1;
+	// Offsets in a non-seekable file count from where reading starts.
+	if (!m_seekable)
+		m_filePosition = 0;
+	m_position = m_filePosition;
+
+#ifdef HAVE_PTHREAD_H
+	if (writeBehind && accessMode() != ReadAccess)
+	{
+		pthread_mutex_init(&m_flushMutex, NULL);
+		pthread_cond_init(&m_flushCondition, NULL);
+		m_flushBuffer = new uint8_t[m_bufferSize];
+		m_flusherRunning =
+			pthread_create(&m_flusher, NULL, runFlusher, this) == 0;
+		if (!m_flusherRunning)
+		{
+			// Write synchronously instead.
+			pthread_cond_destroy(&m_flushCondition);
+			pthread_mutex_destroy(&m_flushMutex);
+			delete [] m_flushBuffer;
+			m_flushBuffer = NULL;
+		}
+	}
+#endif
+}
+
+BufferedFile::~BufferedFile()
+{
+	close();
+#ifdef HAVE_PTHREAD_H
+	stopFlusher();
+#endif
+	delete m_file;
+	delete [] m_buffer;
+}
+
+#ifdef HAVE_PTHREAD_H
+/*
+	The flusher thread writes each buffer handed to it by
+	flushBehind().  While a buffer is pending, only the flusher
+	thread uses the underlying file and m_filePosition.
+*/
+void *BufferedFile::runFlusher(void *arg)
+{
+	BufferedFile *file = static_cast<BufferedFile *>(arg);
+
+	pthread_mutex_lock(&file->m_flushMutex);
+	for (;;)
+	{
+		while (!file->m_flushPending && !file->m_stopFlusher)
+			pthread_cond_wait(&file->m_flushCondition, &file->m_flushMutex);
+		if (!file->m_flushPending)
+			break;
+		pthread_mutex_unlock(&file->m_flushMutex);
+
+		file->writeOut(file->m_flushBuffer, &file->m_flushOffset,
+			&file->m_flushLength);
+
+		pthread_mutex_lock(&file->m_flushMutex);
+		file->m_flushPending = false;
+		pthread_cond_broadcast(&file->m_flushCondition);
+	}
+	pthread_mutex_unlock(&file->m_flushMutex);
+
+	return NULL;
+}
+
+void BufferedFile::stopFlusher()
+{
+	if (!m_flusherRunning)
+		return;
+
+	pthread_mutex_lock(&m_flushMutex);
+	m_stopFlusher = true;
+	pthread_cond_broadcast(&m_flushCondition);
+	pthread_mutex_unlock(&m_flushMutex);
+	pthread_join(m_flusher, NULL);
+
+	pthread_cond_destroy(&m_flushCondition);
+	pthread_mutex_destroy(&m_flushMutex);
+	delete [] m_flushBuffer;
+	m_flushBuffer = NULL;
+	m_flusherRunning = false;
+}
+#endif
+
+/*
+	Hand the full write buffer to the flusher thread, once it has
+	finished with the previous one, or write it now if there is no
+	flusher thread.
+*/
+int BufferedFile::flushBehind()
+{
+#ifdef HAVE_PTHREAD_H
+	if (m_flusherRunning)
+	{
+		if (finishFlush() != 0)
+			return -1;
+
+		std::swap(m_buffer, m_flushBuffer);
+		m_flushOffset = m_bufferOffset;
+		m_flushLength = m_writeLength;
+		m_writeLength = 0;
+
+		pthread_mutex_lock(&m_flushMutex);
+		m_flushPending = true;
+		pthread_cond_broadcast(&m_flushCondition);
+		pthread_mutex_unlock(&m_flushMutex);
+		return 0;
+	}
+#endif
+
+	return flush();
+}
+
+/*
+	Wait for the flusher thread to finish writing, then write
+	whatever it could not, so that an error is reported with errno
+	set.  The underlying file may be used once this returns.
+*/
+int BufferedFile::finishFlush()
+{
+#ifdef HAVE_PTHREAD_H
+	if (!m_flusherRunning)
+		return 0;
+
+	pthread_mutex_lock(&m_flushMutex);
+	while (m_flushPending)
+		pthread_cond_wait(&m_flushCondition, &m_flushMutex);
+	pthread_mutex_unlock(&m_flushMutex);
+
+	if (m_flushLength > 0)
+		return writeOut(m_flushBuffer, &m_flushOffset, &m_flushLength);
+#endif
+
+	return 0;
+}
+
+int BufferedFile::close()
+{
+	int flushResult = flush();
+	int closeResult = m_file->close();
+	return flushResult != 0 ? flushResult : closeResult;
+}
+
+/*
+	Move the underlying file to position unless it is known to be
+	there already.
+*/
+bool BufferedFile::syncPosition(off_t position)
+{
+	if (m_filePosition == position)
+		return true;
+
+	if (!m_seekable)
+		return skipTo(position);
+
+	m_filePosition = m_file->seek(position, File::SeekFromBeginning);
+	if (m_filePosition != position)
+	{
+		m_filePosition = -1;
+		return false;
+	}
+	return true;
+}
+
+/*
+	Advance a non-seekable file to position by reading and discarding
+	data.  The buffer is used as scratch space.
+*/
+bool BufferedFile::skipTo(off_t position)
+{
+	if (position < m_filePosition || m_writeLength > 0)
+	{
+		errno = ESPIPE;
+		return false;
+	}
+
+	m_readLength = 0;
+	while (m_filePosition < position)
+	{
+		size_t n = m_bufferSize;
+		if (static_cast<off_t>(n) > position - m_filePosition)
+			n = position - m_filePosition;
+		ssize_t result = m_file->read(m_buffer, n);
+		if (result <= 0)
+			return false;
+		m_filePosition += result;
+	}
+	return true;
+}
+
+int BufferedFile::flush()
+{
+	if (finishFlush() != 0)
+		return -1;
+
+	return writeOut(m_buffer, &m_bufferOffset, &m_writeLength);
+}
+
+int BufferedFile::sync()
+{
+	if (flush() != 0)
+		return -1;
+
+	return m_file->sync();
+}
+
+/*
+	Write the *writeLength bytes of buffer to the underlying file at
+	*bufferOffset.
+*/
+int BufferedFile::writeOut(uint8_t *buffer, off_t *bufferOffset,
+	size_t *writeLength)
+{
+	if (*writeLength == 0)
+		return 0;
+
+	if (!syncPosition(*bufferOffset))
+		return -1;
+
+	size_t bytesWritten = 0;
+	while (bytesWritten < *writeLength)
+	{
+		ssize_t result = m_file->write(buffer + bytesWritten,
+			*writeLength - bytesWritten);
+		if (result <= 0)
+		{
+			// Keep whatever could not be written at the start of the buffer.
+			memmove(buffer, buffer + bytesWritten,
+				*writeLength - bytesWritten);
+			*bufferOffset += bytesWritten;
+			*writeLength -= bytesWritten;
+			m_filePosition = -1;
+			return -1;
+		}
+		bytesWritten += result;
+		if (m_filePosition != -1)
+			m_filePosition += result;
+	}
+
+	*writeLength = 0;
+	return 0;
+}
+
+/*
+	The number of bytes the write buffer may hold before it is
+	flushed.  Flushing at multiples of kWriteAlignment in the file
+	keeps all writes after the first aligned.
+*/
+size_t BufferedFile::writeCapacity() const
+{
+	off_t end = m_bufferOffset + static_cast<off_t>(m_bufferSize);
+	off_t alignedEnd = end - end % kWriteAlignment;
+	if (alignedEnd <= m_bufferOffset)
+		return m_bufferSize;
+	return alignedEnd - m_bufferOffset;
+}
+
+ssize_t BufferedFile::readThrough(void *data, size_t nbytes)
+{
+	if (!syncPosition(m_position))
+		return -1;
+	ssize_t result = m_file->read(data, nbytes);
+	if (result > 0 && m_filePosition != -1)
+		m_filePosition += result;
+	return result;
+}
+
+ssize_t BufferedFile::fill()
+{
+	/*
+		When reading continues where the buffered data ends, append
+		to it so that the data stays available for seeking back.
+	*/
+	bool append = m_readLength > 0 && m_readLength < m_bufferSize &&
+		m_position == m_bufferOffset + static_cast<off_t>(m_readLength);
+	if (!append)
+	{
+		m_bufferOffset = m_position;
+		m_readLength = 0;
+	}
+
+	ssize_t result = readThrough(m_buffer + m_readLength,
+		m_bufferSize - m_readLength);
+	if (result > 0)
+		m_readLength += result;
+	return result;
+}
+
+ssize_t BufferedFile::read(void *data, size_t nbytes)
+{
+	if (flush() != 0)
+		return -1;
+
+	uint8_t *out = static_cast<uint8_t *>(data);
+	size_t bytesRead = 0;
+	while (bytesRead < nbytes)
+	{
+		if (m_position >= m_bufferOffset &&
+			m_position < m_bufferOffset + static_cast<off_t>(m_readLength))
+		{
+			size_t offset = m_position - m_bufferOffset;
+			size_t n = m_readLength - offset;
+			if (n > nbytes - bytesRead)
+				n = nbytes - bytesRead;
+			memcpy(out + bytesRead, m_buffer + offset, n);
+			bytesRead += n;
+			m_position += n;
+			continue;
+		}
+
+		// Large reads bypass the buffer.
+		if (nbytes - bytesRead >= m_bufferSize)
+		{
+			m_readLength = 0;
+			ssize_t result = readThrough(out + bytesRead, nbytes - bytesRead);
+			if (result < 0)
+				return bytesRead > 0 ? static_cast<ssize_t>(bytesRead) : -1;
+			bytesRead += result;
+			m_position += result;
+			break;
+		}
+
+		ssize_t result = fill();
+		if (result < 0)
+			return bytesRead > 0 ? static_cast<ssize_t>(bytesRead) : -1;
+		if (result == 0)
+			break;
+	}
+
+	return bytesRead;
+}
+
+ssize_t BufferedFile::write(const void *data, size_t nbytes)
+{
+	// Buffered data read from the file may be about to become stale.
+	m_readLength = 0;
+
+	if (m_writeLength > 0 &&
+		m_position != m_bufferOffset + static_cast<off_t>(m_writeLength))
+	{
+		if (flush() != 0)
+			return -1;
+	}
+
+	const uint8_t *in = static_cast<const uint8_t *>(data);
+	size_t bytesWritten = 0;
+	while (bytesWritten < nbytes)
+	{
+		if (m_writeLength == 0)
+		{
+			m_bufferOffset = m_position;
+
+			// Large writes bypass the buffer.
+			if (nbytes - bytesWritten >= m_bufferSize)
+			{
+				if (finishFlush() != 0 || !syncPosition(m_position))
+					return bytesWritten > 0 ? static_cast<ssize_t>(bytesWritten) : -1;
+				ssize_t result = m_file->write(in + bytesWritten,
+					nbytes - bytesWritten);
+				if (result <= 0)
+				{
+					m_filePosition = -1;
+					return bytesWritten > 0 ? static_cast<ssize_t>(bytesWritten) : result;
+				}
+				if (m_filePosition != -1)
+					m_filePosition += result;
+				bytesWritten += result;
+				m_position += result;
+				continue;
+			}
+		}
+
+		// A failed flush may leave more than the capacity buffered.
+		size_t capacity = std::max(writeCapacity(), m_writeLength);
+		size_t n = capacity - m_writeLength;
+		if (n > nbytes - bytesWritten)
+			n = nbytes - bytesWritten;
+		memcpy(m_buffer + m_writeLength, in + bytesWritten, n);
+		m_writeLength += n;
+		bytesWritten += n;
+		m_position += n;
+
+		/*
+			The data just buffered is kept, but the caller must
+			learn that earlier data could not be written.
+		*/
+		if (m_writeLength == capacity && flushBehind() != 0)
+			return -1;
+	}
+
+	return bytesWritten;
+}
+
+/*
+	Data is copied by the underlying file, after any buffered data
+	which precedes it.
+*/
+ssize_t BufferedFile::copyFrom(File *source, off_t offset, size_t nbytes)
+{
+	if (flush() != 0 || !syncPosition(m_position))
+		return -1;
+
+	m_readLength = 0;
+	ssize_t result = m_file->copyFrom(source, offset, nbytes);
+	if (result > 0)
+	{
+		m_position += result;
+		if (m_filePosition != -1)
+			m_filePosition += result;
+	}
+	return result;
+}
+
+off_t BufferedFile::length()
+{
+	if (!m_seekable || finishFlush() != 0)
+		return -1;
+
+	off_t fileLength = m_file->length();
+	if (fileLength == -1)
+		return -1;
+	off_t bufferEnd = m_bufferOffset + m_writeLength;
+	return m_writeLength > 0 && bufferEnd > fileLength ? bufferEnd : fileLength;
+}
+
+off_t BufferedFile::seek(off_t offset, File::SeekOrigin origin)
+{
+	switch (origin)
+	{
+		case SeekFromBeginning:
+			break;
+		case SeekFromCurrent:
+			offset += m_position;
+			break;
+		case SeekFromEnd:
+		{
+			off_t fileLength = length();
+			if (fileLength == -1)
+				return -1;
+			offset += fileLength;
+			break;
+		}
+		default:
+			assert(false);
+			return -1;
+	}
+
+	if (offset < 0)
+	{
+		errno = EINVAL;
+		return -1;
+	}
+
+	// A non-seekable file can only go back within the buffer.
+	if (!m_seekable && finishFlush() != 0)
+		return -1;
+	if (!m_seekable && offset < m_filePosition &&
+		(m_readLength == 0 || offset < m_bufferOffset ||
+		offset > m_bufferOffset + static_cast<off_t>(m_readLength)))
+	{
+		errno = ESPIPE;
+		return -1;
+	}
+
+	m_position = offset;
+	return m_position;
+}
+
+off_t BufferedFile::tell()
+{
+	return m_position;
+}
+
+ssize_t BufferedFile::borrow(off_t offset, size_t nbytes, const void **data)
+{
+	// Only lend ranges which lie entirely inside the read buffer.
+	if (m_readLength == 0 ||
+		offset < m_bufferOffset ||
+		offset + static_cast<off_t>(nbytes) > m_bufferOffset + static_cast<off_t>(m_readLength))
+		return -1;
+
+	*data = m_buffer + (offset - m_bufferOffset);
+	return nbytes;
+}
+
+ssize_t BufferedFile::readAt(void *data, size_t nbytes, off_t offset)
+{
+	// Positional reads go straight to the underlying file so that they
+	// never touch the buffer, which belongs to the sequential reader.
+	if (finishFlush() != 0)
+		return -1;
+	return m_file->readAt(data, nbytes, offset);
+}
@@ -0,0 +1,137 @@
+/*
+	Audio File Library
+
+	This library is free software; you can redistribute it and/or
+	modify it under the terms of the GNU Lesser General Public
+	License as published by the Free Software Foundation; either
+	version 2.1 of the License, or (at your option) any later version.
+
+	This library is distributed in the hope that it will be useful,
+	but WITHOUT ANY WARRANTY; without even the implied warranty of
+	MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+	Lesser General Public License for more details.
+
+	You should have received a copy of the GNU Lesser General Public
+	License along with this library; if not, write to the
+	Free Software Foundation, Inc., 51 Franklin Street, Fifth Floor,
+	Boston, MA  02110-1301  USA
+*/
+
+#ifndef BUFFERED_FILE_H
+#define BUFFERED_FILE_H
+
+#include "Compiler.h"
+#include "File.h"
+
+#include <stddef.h>
+#include <stdint.h>
+#ifdef HAVE_PTHREAD_H
+#include <pthread.h>
+#endif
+
+/*
+	BufferedFile wraps another File and satisfies small reads from a
+	read-ahead buffer and coalesces small writes into a write-behind
+	buffer. Seeking is lazy: the position of the underlying file is
+	only changed when the buffer has to be refilled or flushed, so
+	seeks which land inside the buffer cost no system calls.
+
+	A file which cannot seek, such as a pipe, is read forward only:
+	seeking ahead reads and discards data, and seeking back is
+	possible as long as the target is still in the buffer.  This
+	lets a header be examined more than once before the audio data
+	is read.  canSeek() returns false for such a file.
+
+	Writes are flushed in pieces which end at multiples of
+	kWriteAlignment bytes in the file.  With writeBehind set, a full
+	buffer is handed to a background thread to be written while
+	the caller goes on filling a second buffer; any failure is
+	reported by the next call which has to wait for that thread.
+
+	BufferedFile takes ownership of the wrapped file.
+*/
+class BufferedFile : public File
+{
+public:
+	enum { kDefaultBufferSize = 65536 };
+	enum { kWriteAlignment = 4096 };
+
+	BufferedFile(File *file, size_t bufferSize, bool writeBehind = false);
+	virtual ~BufferedFile();
+
+	virtual int close() OVERRIDE;
+	virtual ssize_t read(void *data, size_t nbytes) OVERRIDE;
+	virtual ssize_t write(const void *data, size_t nbytes) OVERRIDE;
+	virtual off_t length() OVERRIDE;
+	virtual off_t seek(off_t offset, SeekOrigin origin) OVERRIDE;
+	virtual off_t tell() OVERRIDE;
+	virtual ssize_t borrow(off_t offset, size_t nbytes, const void **data) OVERRIDE;
+	virtual ssize_t readAt(void *data, size_t nbytes, off_t offset) OVERRIDE;
+	virtual bool canSeek() OVERRIDE { return m_seekable; }
+	virtual ssize_t copyFrom(File *source, off_t offset, size_t nbytes) OVERRIDE;
+	virtual int descriptor() OVERRIDE { return m_file->descriptor(); }
+
+	// Write any buffered data to the underlying file.
+	virtual int flush() OVERRIDE;
+
+	virtual int preallocate(off_t offset, off_t nbytes) OVERRIDE
+	{
+		return m_file->preallocate(offset, nbytes);
+	}
+
+	// Write any buffered data and wait for it to reach storage.
+	virtual int sync() OVERRIDE;
+
+	virtual int advise(off_t offset, off_t nbytes, Advice advice) OVERRIDE
+	{
+		return m_file->advise(offset, nbytes, advice);
+	}
+
+private:
+	File *m_file;
+	bool m_seekable;
+
+	uint8_t *m_buffer;
+	size_t m_bufferSize;
+	// File offset corresponding to the start of m_buffer.
+	off_t m_bufferOffset;
+	// Number of bytes in m_buffer which were read from the file.
+	size_t m_readLength;
+	// Number of bytes in m_buffer waiting to be written to the file.
+	size_t m_writeLength;
+
+	// Logical position seen by callers.
+	off_t m_position;
+	// Position of the underlying file, or -1 if unknown.
+	off_t m_filePosition;
+
+#ifdef HAVE_PTHREAD_H
+	// Buffer being written by the flusher thread, if it is running.
+	uint8_t *m_flushBuffer;
+	off_t m_flushOffset;
+	size_t m_flushLength;
+	bool m_flusherRunning;
+	bool m_flushPending;
+	bool m_stopFlusher;
+	pthread_t m_flusher;
+	pthread_mutex_t m_flushMutex;
+	pthread_cond_t m_flushCondition;
+
+	static void *runFlusher(void *);
+	void stopFlusher();
+#endif
+
+	bool syncPosition(off_t position);
+	bool skipTo(off_t position);
+	ssize_t readThrough(void *data, size_t nbytes);
+	ssize_t fill();
+	size_t writeCapacity() const;
+	int writeOut(uint8_t *buffer, off_t *bufferOffset, size_t *writeLength);
+	int flushBehind();
+	int finishFlush();
+
+	BufferedFile(const BufferedFile &);
+	BufferedFile &operator=(const BufferedFile &);
+};
+
+#endif
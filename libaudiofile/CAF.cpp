@@ -59,6 +59,15 @@ enum
 
 static const unsigned kALACDefaultFramesPerPacket = 4096;
 
+/*
+	Unless the expected frame count is given, space for the packet
+	table ahead of the audio data is reserved for this many seconds
+	of audio.  Each entry of the table takes at most 3 bytes for
+	packets smaller than 2 MB.
+*/
+static const int kPacketTableReserveSeconds = 600;
+static const int kPacketTableEntrySize = 3;
+
 static const _AFfilesetup cafDefaultFileSetup =
 {
 	_AF_VALID_FILESETUP,	// valid
@@ -76,7 +85,15 @@ static const _AFfilesetup cafDefaultFileSetup =
 
 CAFFile::CAFFile() :
 	m_dataOffset(-1),
-	m_cookieDataOffset(-1)
+	m_cookieDataOffset(-1),
+	m_editCount(0),
+	m_peakOffset(-1),
+	m_peakLength(0),
+	m_peakEditCount(0),
+	m_packetTableOffset(-1),
+	m_packetTableReserve(0),
+	m_packetTableEntries(0),
+	m_packetTableLength(0)
 {
 	setFormatByteOrder(AF_BYTEORDER_BIGENDIAN);
 }
@@ -85,14 +102,12 @@ CAFFile::~CAFFile()
 {
 }
 
-bool CAFFile::recognize(File *file)
+bool CAFFile::recognize(const uint8_t *header, size_t length)
 {
-	file->seek(0, File::SeekFromBeginning);
-	uint8_t buffer[8];
-	if (file->read(buffer, 8) != 8 || memcmp(buffer, "caff", 4) != 0)
+	if (length < 8 || memcmp(header, "caff", 4) != 0)
 		return false;
 	const uint8_t versionAndFlags[4] = { 0, 1, 0, 0 };
-	if (memcmp(buffer + 4, versionAndFlags, 4) != 0)
+	if (memcmp(header + 4, versionAndFlags, 4) != 0)
 		return false;
 	return true;
 }
@@ -107,7 +122,7 @@ status CAFFile::readInit(AFfilesetup setup)
 	off_t currentOffset = m_fh->tell();
 	off_t fileLength = m_fh->length();
 
-	while (currentOffset < fileLength)
+	while (!m_seekok || currentOffset < fileLength)
 	{
 		Tag chunkType;
 		int64_t chunkLength;
@@ -118,7 +133,11 @@ status CAFFile::readInit(AFfilesetup setup)
 		currentOffset += 12;
 
 		if (chunkType == "data" && chunkLength == -1)
-			chunkLength = fileLength - currentOffset;
+		{
+			// The data chunk extends to the end of the file.
+			if (fileLength != -1)
+				chunkLength = fileLength - currentOffset;
+		}
 		else if (chunkLength < 0)
 			_af_error(AF_BAD_HEADER,
 				"invalid chunk length %jd for chunk type %s\n",
@@ -133,13 +152,23 @@ status CAFFile::readInit(AFfilesetup setup)
 		{
 			if (parseData(chunkType, chunkLength) == AF_FAIL)
 				return AF_FAIL;
+			// A non-seekable file is read no further than the audio data.
+			if (!m_seekok)
+				break;
 		}
 		else if (chunkType == "pakt")
 		{
 			if (parsePacketTable(chunkType, chunkLength) == AF_FAIL)
 				return AF_FAIL;
 		}
-		else if (chunkType == "kuki")
+		else if (chunkType == "peak")
+		{
+			m_peakOffset = currentOffset - 12;
+			m_peakLength = chunkLength;
+			if (parsePeaks(chunkType, chunkLength) == AF_FAIL)
+				return AF_FAIL;
+		}
+		else if (chunkType == "kuki" && !m_headerOnly)
 		{
 			if (parseCookieData(chunkType, chunkLength) == AF_FAIL)
 				return AF_FAIL;
@@ -149,6 +178,28 @@ status CAFFile::readInit(AFfilesetup setup)
 			File::SeekFromBeginning);
 	}
 
+	Track *track = getTrack();
+
+	/*
+		Peaks are ignored unless there is one for each channel and
+		they describe the current audio data.
+	*/
+	if (track->peaks.size() != static_cast<size_t>(track->f.channelCount) ||
+		m_peakEditCount != m_editCount)
+		track->peaks.clear();
+
+	// A peak chunk of another size cannot be rewritten in place.
+	if (m_peakOffset != -1 &&
+		m_peakLength != peakChunkLength(track->f.channelCount))
+		m_peakOffset = -1;
+
+	if (!m_seekok && track->f.bytesPerPacket == 0 && !track->m_packetTable)
+	{
+		_af_error(AF_BAD_HEADER,
+			"packet table must precede the data chunk when reading from a non-seekable file");
+		return AF_FAIL;
+	}
+
 	return AF_SUCCEED;
 }
 
@@ -157,6 +208,14 @@ status CAFFile::writeInit(AFfilesetup setup)
 	if (initFromSetup(setup) == AF_FAIL)
 		return AF_FAIL;
 
+	// The packet table follows the sound data in a streamed file.
+	if (!m_seekok && getTrack()->f.compressionType == AF_COMPRESSION_ALAC)
+	{
+		_af_error(AF_BAD_CODEC_TYPE,
+			"ALAC-compressed CAF files cannot be written in streaming mode");
+		return AF_FAIL;
+	}
+
 	initCompressionParams();
 
 	Tag caff("caff");
@@ -168,6 +227,12 @@ status CAFFile::writeInit(AFfilesetup setup)
 		return AF_FAIL;
 	if (writeCookieData() == AF_FAIL)
 		return AF_FAIL;
+	// The peaks are known only after the audio data has been written.
+	if (getTrack()->computesPeaks && m_seekok && writePeaks() == AF_FAIL)
+		return AF_FAIL;
+	if (getTrack()->m_packetTable && m_seekok &&
+		reservePacketTable(setup) == AF_FAIL)
+		return AF_FAIL;
 	if (writeData(false) == AF_FAIL)
 		return AF_FAIL;
 
@@ -250,15 +315,36 @@ AFfilesetup CAFFile::completeSetup(AFfilesetup setup)
 
 status CAFFile::update()
 {
+	// The data chunk of a streamed file keeps its unspecified length.
+	if (!m_seekok)
+		return AF_SUCCEED;
+
 	if (writeCookieData() == AF_FAIL)
 		return AF_FAIL;
+	if (m_peakOffset != -1 && writePeaks() == AF_FAIL)
+		return AF_FAIL;
 	if (writeData(true) == AF_FAIL)
 		return AF_FAIL;
+	if (m_packetTableOffset != -1)
+		return updatePacketTable();
 	if (writePacketTable() == AF_FAIL)
 		return AF_FAIL;
 	return AF_SUCCEED;
 }
 
+status CAFFile::updateInit()
+{
+	// The data chunk's header and edit count precede the audio data.
+	m_dataOffset = getTrack()->fpos_first_frame - 16;
+	m_editCount++;
+
+	// Keep the peaks of a peak chunk up to date.
+	Track *track = getTrack();
+	if (m_peakOffset != -1 && !track->peaks.empty())
+		track->computesPeaks = true;
+	return AF_SUCCEED;
+}
+
 status CAFFile::parseDescription(const Tag &, int64_t)
 {
 	double sampleRate;
@@ -374,15 +460,12 @@ status CAFFile::parseDescription(const Tag &, int64_t)
 
 status CAFFile::parseData(const Tag &tag, int64_t length)
 {
-	uint32_t editCount;
-	if (!readU32(&editCount))
+	if (!readU32(&m_editCount))
 		return AF_FAIL;
 
 	Track *track = getTrack();
-	if (length == -1)
-		track->data_size = m_fh->length() - m_fh->tell();
-	else
-		track->data_size = length - 4;
+	// The length of the audio data is unknown when reading from a pipe.
+	track->data_size = length == -1 ? -1 : length - 4;
 	track->fpos_first_frame = m_fh->tell();
 
 	track->computeTotalFileFrames();
@@ -518,6 +601,27 @@ status CAFFile::parseCookieData(const Tag &tag, int64_t length)
 	return AF_SUCCEED;
 }
 
+status CAFFile::parsePeaks(const Tag &, int64_t length)
+{
+	// A malformed chunk is ignored.
+	if (length < 4 || (length - 4) % 12 != 0 || !readU32(&m_peakEditCount))
+		return AF_SUCCEED;
+
+	std::vector<Peak> peaks((length - 4) / 12);
+	for (size_t i=0; i<peaks.size(); i++)
+	{
+		float value;
+		int64_t position;
+		if (!readFloat(&value) || !readS64(&position))
+			return AF_SUCCEED;
+		peaks[i].value = value;
+		peaks[i].position = position;
+	}
+
+	getTrack()->peaks.swap(peaks);
+	return AF_SUCCEED;
+}
+
 status CAFFile::writeDescription()
 {
 	Track *track = getTrack();
@@ -596,13 +700,12 @@ status CAFFile::writeData(bool update)
 
 	Tag data("data");
 	int64_t dataLength = -1;
-	uint32_t editCount = 0;
 	if (update)
 		dataLength = track->data_size + 4;
 
 	if (!writeTag(&data) ||
 		!writeS64(&dataLength) ||
-		!writeU32(&editCount))
+		!writeU32(&m_editCount))
 		return AF_FAIL;
 	if (track->fpos_first_frame == 0)
 		track->fpos_first_frame = m_fh->tell();
@@ -653,6 +756,106 @@ status CAFFile::writePacketTable()
 	return AF_SUCCEED;
 }
 
+/*
+	Place the packet table ahead of the data chunk, followed by a
+	free chunk which holds the space into which the table grows.
+	Each update then writes only the entries added since the last
+	one instead of the whole table.
+*/
+status CAFFile::reservePacketTable(AFfilesetup setup)
+{
+	Track *track = getTrack();
+	TrackSetup *trackSetup = setup->getTrack();
+
+	AFframecount frameCount = trackSetup->frameCountSet ?
+		trackSetup->frameCount :
+		static_cast<AFframecount>(track->f.sampleRate * kPacketTableReserveSeconds);
+	AFframecount packetCount = (frameCount + track->f.framesPerPacket - 1) /
+		track->f.framesPerPacket;
+	if (packetCount == 0)
+		return AF_SUCCEED;
+
+	m_packetTableOffset = m_fh->tell();
+	m_packetTableReserve = packetCount * kPacketTableEntrySize;
+
+	if (updatePacketTable() == AF_FAIL)
+		return AF_FAIL;
+
+	// The rest of the free chunk is filled in as the file grows.
+	if (m_fh->seek(m_packetTableOffset + 36 + m_packetTableReserve + 12,
+		File::SeekFromBeginning) == -1)
+		return AF_FAIL;
+	return AF_SUCCEED;
+}
+
+status CAFFile::updatePacketTable()
+{
+	Track *track = getTrack();
+	SharedPtr<PacketTable> packetTable = track->m_packetTable;
+
+	size_t numPackets = packetTable->numPackets();
+	std::vector<uint8_t> entries;
+	size_t lastEntrySize = 0;
+	for (size_t i=m_packetTableEntries; i<numPackets; i++)
+	{
+		uint8_t entry[5];
+		encodeBERInteger(packetTable->bytesPerPacket(i), entry, &lastEntrySize);
+		entries.insert(entries.end(), entry, entry + lastEntrySize);
+	}
+
+	AFfileoffset tableLength = m_packetTableLength + entries.size();
+	if (tableLength > m_packetTableReserve)
+	{
+		/*
+			The table has outgrown the space reserved for it.
+			Turn that space into a free chunk and write the
+			table after the audio data from now on.
+		*/
+		Tag free("free");
+		int64_t freeLength = 24 + m_packetTableReserve + 12;
+		m_fh->seek(m_packetTableOffset, File::SeekFromBeginning);
+		if (!writeTag(&free) || !writeS64(&freeLength))
+			return AF_FAIL;
+		m_packetTableOffset = -1;
+		return writePacketTable();
+	}
+
+	m_fh->seek(m_packetTableOffset + 36 + m_packetTableLength,
+		File::SeekFromBeginning);
+	if (m_fh->write(entries.data(), entries.size()) !=
+		static_cast<ssize_t>(entries.size()))
+		return AF_FAIL;
+
+	Tag free("free");
+	int64_t freeLength = m_packetTableReserve - tableLength;
+	if (!writeTag(&free) || !writeS64(&freeLength))
+		return AF_FAIL;
+
+	Tag pakt("pakt");
+	int64_t packetTableLength = 24 + tableLength;
+	int64_t numPacketsInTable = numPackets;
+	int64_t numValidFrames = packetTable->numValidFrames();
+	int32_t primingFrames = packetTable->primingFrames();
+	int32_t remainderFrames = packetTable->remainderFrames();
+
+	m_fh->seek(m_packetTableOffset, File::SeekFromBeginning);
+	if (!writeTag(&pakt) ||
+		!writeS64(&packetTableLength) ||
+		!writeS64(&numPacketsInTable) ||
+		!writeS64(&numValidFrames) ||
+		!writeS32(&primingFrames) ||
+		!writeS32(&remainderFrames))
+		return AF_FAIL;
+
+	if (numPackets > 0)
+	{
+		m_packetTableEntries = numPackets - 1;
+		m_packetTableLength = tableLength - lastEntrySize;
+	}
+
+	return AF_SUCCEED;
+}
+
 status CAFFile::writeCookieData()
 {
 	if (!m_codecData)
@@ -675,6 +878,41 @@ status CAFFile::writeCookieData()
 	return AF_SUCCEED;
 }
 
+/*
+	Write the peak chunk, or a free chunk of the same size if the
+	peaks of the track are not known.
+*/
+status CAFFile::writePeaks()
+{
+	Track *track = getTrack();
+
+	if (m_peakOffset == -1)
+		m_peakOffset = m_fh->tell();
+	else
+		m_fh->seek(m_peakOffset, File::SeekFromBeginning);
+
+	Tag peak("peak");
+	Tag free("free");
+	int64_t chunkLength = peakChunkLength(track->f.channelCount);
+	if (!writeTag(track->peaks.empty() ? &free : &peak) ||
+		!writeS64(&chunkLength))
+		return AF_FAIL;
+	if (track->peaks.empty())
+		return reserveSpace(chunkLength) ? AF_SUCCEED : AF_FAIL;
+
+	if (!writeU32(&m_editCount))
+		return AF_FAIL;
+	for (size_t i=0; i<track->peaks.size(); i++)
+	{
+		float value = track->peaks[i].value;
+		int64_t position = track->peaks[i].position;
+		if (!writeFloat(&value) || !writeS64(&position))
+			return AF_FAIL;
+	}
+
+	return AF_SUCCEED;
+}
+
 void CAFFile::initCompressionParams()
 {
 	Track *track = getTrack();
@@ -35,7 +35,7 @@ class Buffer;
 class CAFFile : public _AFfilehandle
 {
 public:
-	static bool recognize(File *);
+	static bool recognize(const uint8_t *header, size_t length);
 	static AFfilesetup completeSetup(AFfilesetup);
 
 	CAFFile();
@@ -43,22 +43,57 @@ public:
 
 	status readInit(AFfilesetup) OVERRIDE;
 	status writeInit(AFfilesetup) OVERRIDE;
+	status updateInit() OVERRIDE;
 	status update() OVERRIDE;
+	bool supportsStreaming() OVERRIDE { return true; }
 
 private:
 	AFfileoffset m_dataOffset;
 	AFfileoffset m_cookieDataOffset;
 	SharedPtr<Buffer> m_codecData;
+	// Incremented each time the audio data of an existing file is changed.
+	uint32_t m_editCount;
+	/*
+		Start of the peak chunk, or -1 if there is none, the length
+		of the chunk read from the file, and the edit count of the
+		audio data which its peaks describe.
+	*/
+	AFfileoffset m_peakOffset;
+	int64_t m_peakLength;
+	uint32_t m_peakEditCount;
+
+	/*
+		Start of the packet table when it precedes the data chunk,
+		or -1 if it follows the audio data.
+	*/
+	AFfileoffset m_packetTableOffset;
+	// Space reserved for the entries of the packet table.
+	AFfileoffset m_packetTableReserve;
+	/*
+		Number and encoded length of the packet table entries which
+		are in the file and final.  The last entry written by an
+		update may describe a partial packet, so it is not final.
+	*/
+	size_t m_packetTableEntries;
+	AFfileoffset m_packetTableLength;
 
 	status parseDescription(const Tag &, int64_t);
 	status parseData(const Tag &, int64_t);
 	status parsePacketTable(const Tag &, int64_t);
 	status parseCookieData(const Tag &, int64_t);
+	status parsePeaks(const Tag &, int64_t);
 
 	status writeDescription();
 	status writeData(bool update);
 	status writePacketTable();
+	status reservePacketTable(AFfilesetup);
+	status updatePacketTable();
 	status writeCookieData();
+	status writePeaks();
+	static int64_t peakChunkLength(int channelCount)
+	{
+		return 4 + 12 * channelCount;
+	}
 
 	void initCompressionParams();
 	void initIMACompressionParams();
@@ -0,0 +1,129 @@
+/*
+	Audio File Library
+
+	This library is free software; you can redistribute it and/or
+	modify it under the terms of the GNU Lesser General Public
+	License as published by the Free Software Foundation; either
+	version 2.1 of the License, or (at your option) any later version.
+
+	This library is distributed in the hope that it will be useful,
+	but WITHOUT ANY WARRANTY; without even the implied warranty of
+	MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+	Lesser General Public License for more details.
+
+	You should have received a copy of the GNU Lesser General Public
+	License along with this library; if not, write to the
+	Free Software Foundation, Inc., 51 Franklin Street, Fifth Floor,
+	Boston, MA  02110-1301  USA
+*/
+
+#include "config.h"
+#include "ChunkLayout.h"
+
+#include <algorithm>
+#include <assert.h>
+
+ChunkLayout::ChunkLayout()
+{
+}
+
+void ChunkLayout::addFree(AFfileoffset offset, AFfileoffset length)
+{
+	Extent extent = { offset, length, false };
+	insert(extent);
+}
+
+void ChunkLayout::insert(const Extent &extent)
+{
+	std::vector<Extent>::iterator i = m_free.begin();
+	while (i != m_free.end() && i->offset < extent.offset)
+		++i;
+	i = m_free.insert(i, extent);
+
+	// Merge with the following extent, then with the preceding one.
+	std::vector<Extent>::iterator next = i + 1;
+	if (next != m_free.end() && i->offset + i->length >= next->offset)
+	{
+		AFfileoffset end = std::max(i->offset + i->length,
+			next->offset + next->length);
+		i->length = end - i->offset;
+		i->changed = true;
+		m_free.erase(next);
+	}
+	if (i != m_free.begin())
+	{
+		std::vector<Extent>::iterator previous = i - 1;
+		if (previous->offset + previous->length >= i->offset)
+		{
+			AFfileoffset end = std::max(i->offset + i->length,
+				previous->offset + previous->length);
+			previous->length = end - previous->offset;
+			previous->changed = true;
+			m_free.erase(i);
+		}
+	}
+}
+
+AFfileoffset ChunkLayout::place(std::vector<Extent> *chunks,
+	AFfileoffset length, AFfileoffset *fileLength)
+{
+	assert(length % 2 == 0);
+
+	for (size_t i=0; i<chunks->size(); i++)
+	{
+		Extent extent = (*chunks)[i];
+		extent.changed = true;
+		insert(extent);
+	}
+
+	AFfileoffset offset = findSpace(length, fileLength);
+	Extent extent = { offset, length, false };
+	chunks->assign(1, extent);
+	return offset;
+}
+
+AFfileoffset ChunkLayout::findSpace(AFfileoffset length,
+	AFfileoffset *fileLength)
+{
+	for (std::vector<Extent>::iterator i = m_free.begin(); i != m_free.end(); ++i)
+	{
+		bool endsFile = i->offset + i->length >= *fileLength;
+		AFfileoffset remainder = i->length - length;
+		if (remainder != 0 && remainder < kMinimumFreeLength &&
+			!(endsFile && remainder < 0))
+			continue;
+
+		AFfileoffset offset = i->offset;
+		if (remainder > 0)
+		{
+			i->offset += length;
+			i->length = remainder;
+			i->changed = true;
+		}
+		else
+		{
+			m_free.erase(i);
+			if (offset + length > *fileLength)
+				*fileLength = offset + length;
+		}
+		return offset;
+	}
+
+	AFfileoffset offset = *fileLength + (*fileLength % 2);
+	*fileLength = offset + length;
+	return offset;
+}
+
+std::vector<ChunkLayout::Extent> ChunkLayout::takeChanged()
+{
+	std::vector<Extent> changed;
+	for (size_t i=0; i<m_free.size(); i++)
+	{
+		if (m_free[i].changed)
+		{
+			changed.push_back(m_free[i]);
+			m_free[i].changed = false;
+		}
+	}
+	return changed;
+}
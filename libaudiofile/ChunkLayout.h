@@ -0,0 +1,98 @@
+/*
+	Audio File Library
+
+	This library is free software; you can redistribute it and/or
+	modify it under the terms of the GNU Lesser General Public
+	License as published by the Free Software Foundation; either
+	version 2.1 of the License, or (at your option) any later version.
+
+	This library is distributed in the hope that it will be useful,
+	but WITHOUT ANY WARRANTY; without even the implied warranty of
+	MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+	Lesser General Public License for more details.
+
+	You should have received a copy of the GNU Lesser General Public
+	License along with this library; if not, write to the
+	Free Software Foundation, Inc., 51 Franklin Street, Fifth Floor,
+	Boston, MA  02110-1301  USA
+*/
+
+#ifndef CHUNK_LAYOUT_H
+#define CHUNK_LAYOUT_H
+
+#include "afinternal.h"
+
+#include <vector>
+
+/*
+	ChunkLayout keeps track of the free space in an existing RIFF or
+	IFF file: chunks which readers skip, such as JUNK chunks, and
+	chunks which are about to be rewritten.  It chooses where a
+	rewritten chunk is placed so that no other chunk has to move.
+
+	Chunks have 8-byte headers and begin at even offsets, so free
+	space is only usable if it is filled exactly or leaves room for
+	the header of a free chunk covering the remainder.
+*/
+class ChunkLayout
+{
+public:
+	struct Extent
+	{
+		AFfileoffset offset;
+		AFfileoffset length;	// including header and pad byte
+		// Set if no free chunk header describes this extent yet.
+		bool changed;
+	};
+
+	enum
+	{
+		kMinimumFreeLength = 8,
+		/*
+			The length of the free chunk which writers leave
+			after metadata so that it can grow when it is
+			edited in place.
+		*/
+		kMetadataSlack = 256
+	};
+
+	// Return the extent of a chunk at offset whose data has size bytes.
+	static Extent chunk(AFfileoffset offset, AFfileoffset size)
+	{
+		Extent extent = { offset, 8 + size + (size % 2), false };
+		return extent;
+	}
+
+	ChunkLayout();
+
+	// Record a chunk which is already free.
+	void addFree(AFfileoffset offset, AFfileoffset length);
+
+	/*
+		Free the chunks at the extents in *chunks and choose an
+		offset at which to write length bytes replacing them; the
+		extent of those bytes then replaces *chunks.  The bytes go
+		into the first free space which they fit, including free
+		space which ends the file, or else at the end of the file.
+		fileLength is updated if the file grows.
+	*/
+	AFfileoffset place(std::vector<Extent> *chunks, AFfileoffset length,
+		AFfileoffset *fileLength);
+
+	/*
+		Return the free extents which need a new free chunk header
+		and mark them as described.
+	*/
+	std::vector<Extent> takeChanged();
+
+	const std::vector<Extent> &freeExtents() const { return m_free; }
+
+private:
+	// Sorted by offset; adjoining extents are merged.
+	std::vector<Extent> m_free;
+
+	void insert(const Extent &extent);
+	AFfileoffset findSpace(AFfileoffset length, AFfileoffset *fileLength);
+};
+
+#endif
@@ -49,13 +49,9 @@ const _AFfilesetup flacDefaultFileSetup =
 	NULL	// miscellaneous
 };
 
-bool FLACFile::recognize(File *file)
+bool FLACFile::recognize(const uint8_t *header, size_t length)
 {
-	file->seek(0, File::SeekFromBeginning);
-	uint8_t buffer[4];
-	if (file->read(buffer, 4) != 4 || memcmp(buffer, "fLaC", 4) != 0)
-		return false;
-	return true;
+	return length >= 4 && memcmp(header, "fLaC", 4) == 0;
 }
 
 FLACFile::FLACFile()
@@ -168,7 +164,8 @@ status FLACFile::readInit(AFfilesetup)
 	if (track)
 	{
 		track->fpos_first_frame = static_cast<off_t>(position);
-		track->data_size = m_fh->length() - track->fpos_first_frame;
+		off_t length = m_fh->length();
+		track->data_size = length >= 0 ? length - track->fpos_first_frame : -1;
 	}
 
 	FLAC__stream_decoder_delete(decoder);
@@ -256,7 +253,8 @@ FLAC__StreamDecoderLengthStatus FLACFile::lengthCallback(const FLAC__StreamDecod
 FLAC__bool FLACFile::eofCallback(const FLAC__StreamDecoder *, void *clientData)
 {
 	FLACFile *flac = static_cast<FLACFile *>(clientData);
-	return flac->m_fh->tell() == flac->m_fh->length();
+	off_t length = flac->m_fh->length();
+	return length >= 0 && flac->m_fh->tell() == length;
 }
 
 FLAC__StreamDecoderWriteStatus FLACFile::writeCallback(const FLAC__StreamDecoder *, const FLAC__Frame *frame, const FLAC__int32 * const buffer[], void *clientData)
@@ -36,7 +36,7 @@ extern const int _af_flac_compression_types[_AF_FLAC_NUM_COMPTYPES];
 class FLACFile : public _AFfilehandle
 {
 public:
-	static bool recognize(File *);
+	static bool recognize(const uint8_t *header, size_t length);
 	static AFfilesetup completeSetup(AFfilesetup);
 
 	FLACFile();
@@ -32,19 +32,30 @@
 
 #include "Compiler.h"
 #include "af_vfs.h"
+#include "audiofile.h"
 
+#include <algorithm>
 #include <assert.h>
+#include <errno.h>
 #include <fcntl.h>
+#include <stdint.h>
 #include <stdlib.h>
+#include <string.h>
 #include <sys/stat.h>
 #include <sys/types.h>
 #include <unistd.h>
 #include <stdio.h>
+#ifdef HAVE_SYS_MMAN_H
+#include <sys/mman.h>
+#endif
+#ifdef HAVE_SYS_SENDFILE_H
+#include <sys/sendfile.h>
+#endif
 
 class FilePOSIX : public File
 {
 public:
-	FilePOSIX(int fd, AccessMode mode) : File(mode), m_fd(fd) { }
+	FilePOSIX(int fd, AccessMode mode, int writePolicy);
 	virtual ~FilePOSIX() { close(); }
 
 	virtual int close() OVERRIDE;
@@ -53,9 +64,38 @@ public:
 	virtual off_t length() OVERRIDE;
 	virtual off_t seek(off_t offset, SeekOrigin origin) OVERRIDE;
 	virtual off_t tell() OVERRIDE;
+	virtual ssize_t readAt(void *data, size_t nbytes, off_t offset) OVERRIDE;
+	virtual ssize_t copyFrom(File *source, off_t offset, size_t nbytes) OVERRIDE;
+	virtual int descriptor() OVERRIDE { return m_fd; }
+	virtual int preallocate(off_t offset, off_t nbytes) OVERRIDE;
+	virtual int sync() OVERRIDE;
+	virtual int advise(off_t offset, off_t nbytes, Advice advice) OVERRIDE;
 
 private:
+	/*
+		Data written with direct I/O must start and end at
+		multiples of kDirectAlignment bytes, both in the file and
+		in memory; data not aligned in memory is copied through a
+		staging buffer of kStagingSize bytes.
+	*/
+	enum { kDirectAlignment = 4096 };
+	enum { kStagingSize = 1 << 20 };
+
 	int m_fd;
+	// Current offset, or -1 if the file is not seekable.
+	off_t m_offset;
+	// Use pread()/pwrite() at m_offset rather than moving the descriptor.
+	bool m_positional;
+	// Writes always go to the end of the file.
+	bool m_append;
+	// Write aligned data with direct I/O, bypassing the page cache.
+	bool m_direct;
+	// Whether the descriptor currently has O_DIRECT set.
+	bool m_directActive;
+	void *m_staging;
+
+	bool setDirect(bool enable);
+	size_t writeDirect(const uint8_t *data, size_t nbytes);
 };
 
 class FileVF : public File
@@ -75,26 +115,133 @@ private:
 	AFvirtualfile *m_vf;
 };
 
-File *File::open(const char *path, File::AccessMode mode)
+class FileView : public File
+{
+public:
+	FileView(File *file) : File(ReadAccess), m_file(file), m_offset(0) { }
+
+	virtual int close() OVERRIDE { return 0; }
+	virtual ssize_t read(void *data, size_t nbytes) OVERRIDE;
+	virtual ssize_t write(const void *data, size_t nbytes) OVERRIDE;
+	virtual off_t length() OVERRIDE { return m_file->length(); }
+	virtual off_t seek(off_t offset, SeekOrigin origin) OVERRIDE;
+	virtual off_t tell() OVERRIDE { return m_offset; }
+	virtual ssize_t borrow(off_t offset, size_t nbytes, const void **data) OVERRIDE
+	{
+		// A buffered file lends the buffer of its own reader.
+		if (!m_file->canLend())
+			return -1;
+		return m_file->borrow(offset, nbytes, data);
+	}
+	virtual bool canLend() OVERRIDE { return m_file->canLend(); }
+	virtual ssize_t readAt(void *data, size_t nbytes, off_t offset) OVERRIDE
+	{
+		return m_file->readAt(data, nbytes, offset);
+	}
+	virtual int descriptor() OVERRIDE { return m_file->descriptor(); }
+
+private:
+	File *m_file;
+	off_t m_offset;
+};
+
+/*
+	FileMemory reads a span of memory which it does not own or, if it
+	was created for writing, a buffer which it owns and enlarges as
+	data is written.
+*/
+class FileMemory : public File
+{
+public:
+	// Read length bytes at data, which must outlive the file.
+	FileMemory(const void *data, off_t length) :
+		File(ReadAccess),
+		m_data(static_cast<const uint8_t *>(data)),
+		m_length(length),
+		m_offset(0),
+		m_buffer(NULL),
+		m_capacity(0)
+	{
+	}
+	// Start with an empty buffer.
+	FileMemory(AccessMode mode) :
+		File(mode),
+		m_data(NULL),
+		m_length(0),
+		m_offset(0),
+		m_buffer(NULL),
+		m_capacity(0)
+	{
+	}
+	virtual ~FileMemory() { close(); }
+
+	virtual int close() OVERRIDE;
+	virtual ssize_t read(void *data, size_t nbytes) OVERRIDE;
+	virtual ssize_t write(const void *data, size_t nbytes) OVERRIDE;
+	virtual off_t length() OVERRIDE;
+	virtual off_t seek(off_t offset, SeekOrigin origin) OVERRIDE;
+	virtual off_t tell() OVERRIDE;
+	virtual ssize_t borrow(off_t offset, size_t nbytes, const void **data) OVERRIDE;
+	virtual bool canLend() OVERRIDE { return m_buffer == NULL; }
+	virtual ssize_t readAt(void *data, size_t nbytes, off_t offset) OVERRIDE;
+	virtual void *releaseContents(size_t *size) OVERRIDE;
+
+	// Make room for capacity bytes in the buffer.
+	bool reserve(size_t capacity);
+
+protected:
+	const uint8_t *m_data;
+	off_t m_length;
+	off_t m_offset;
+
+private:
+	// The buffer of a file created for writing, otherwise NULL.
+	uint8_t *m_buffer;
+	size_t m_capacity;
+};
+
+#ifdef HAVE_MMAP
+class FileMMap : public FileMemory
+{
+public:
+	FileMMap(int fd, void *data, off_t length) :
+		FileMemory(data, length),
+		m_fd(fd)
+	{
+	}
+	virtual ~FileMMap() { close(); }
+
+	virtual int close() OVERRIDE;
+	virtual int descriptor() OVERRIDE { return m_fd; }
+	virtual int advise(off_t offset, off_t nbytes, Advice advice) OVERRIDE;
+
+private:
+	int m_fd;
+};
+#endif
+
+File *File::open(const char *path, File::AccessMode mode, int writePolicy)
 {
 	int flags = 0;
 	if (mode == ReadAccess)
 		flags = O_RDONLY;
 	else if (mode == WriteAccess)
 		flags = O_CREAT | O_WRONLY | O_TRUNC;
+	else if (mode == ReadWriteAccess)
+		flags = O_RDWR;
 #if defined(WIN32) || defined(__CYGWIN__)
 	flags |= O_BINARY;
 #endif
 	int fd = ::open(path, flags, 0666);
 	if (fd == -1)
 		return NULL;
-	File *file = new FilePOSIX(fd, mode);
+	File *file = new FilePOSIX(fd, mode, writePolicy);
 	return file;
 }
 
-File *File::create(int fd, File::AccessMode mode)
+File *File::create(int fd, File::AccessMode mode, int writePolicy)
 {
-	return new FilePOSIX(fd, mode);
+	return new FilePOSIX(fd, mode, writePolicy);
 }
 
 File *File::create(AFvirtualfile *vf, File::AccessMode mode)
@@ -102,17 +249,180 @@ File *File::create(AFvirtualfile *vf, File::AccessMode mode)
 	return new FileVF(vf, mode);
 }
 
+File *File::map(int fd, int hints)
+{
+#ifdef HAVE_MMAP
+	struct stat st;
+	if (fstat(fd, &st) == -1 || !S_ISREG(st.st_mode) || st.st_size <= 0)
+		return NULL;
+
+	void *data = ::mmap(NULL, st.st_size, PROT_READ, MAP_SHARED, fd, 0);
+	if (data == MAP_FAILED)
+		return NULL;
+
+#ifdef HAVE_MADVISE
+	if (hints & AF_MMAP_SEQUENTIAL)
+		::madvise(data, st.st_size, MADV_SEQUENTIAL);
+	if (hints & AF_MMAP_RANDOM)
+		::madvise(data, st.st_size, MADV_RANDOM);
+	if (hints & AF_MMAP_WILLNEED)
+		::madvise(data, st.st_size, MADV_WILLNEED);
+#ifdef MADV_HUGEPAGE
+	if (hints & AF_MMAP_HUGEPAGES)
+		::madvise(data, st.st_size, MADV_HUGEPAGE);
+#endif
+#endif
+
+	return new FileMMap(fd, data, st.st_size);
+#else
+	return NULL;
+#endif
+}
+
+File *File::createMemory(const void *data, size_t size, AccessMode mode)
+{
+	if (mode == ReadAccess)
+		return new FileMemory(data, size);
+
+	FileMemory *file = new FileMemory(mode);
+	if (!file->reserve(std::max<size_t>(size, 65536)) ||
+		(size > 0 && file->write(data, size) != static_cast<ssize_t>(size)) ||
+		file->seek(0, SeekFromBeginning) != 0)
+	{
+		delete file;
+		return NULL;
+	}
+	return file;
+}
+
+File *File::createView(File *file)
+{
+	return new FileView(file);
+}
+
 File::~File()
 {
 }
 
+ssize_t File::borrow(off_t offset, size_t nbytes, const void **data)
+{
+	return -1;
+}
+
+ssize_t File::readAt(void *data, size_t nbytes, off_t offset)
+{
+	errno = ENOSYS;
+	return -1;
+}
+
+bool File::canLend()
+{
+	return false;
+}
+
 bool File::canSeek()
 {
 	return seek(0, File::SeekFromCurrent) != -1;
 }
 
+int File::flush()
+{
+	return 0;
+}
+
+int File::preallocate(off_t offset, off_t nbytes)
+{
+	errno = ENOSYS;
+	return -1;
+}
+
+int File::sync()
+{
+	return flush();
+}
+
+int File::advise(off_t offset, off_t nbytes, Advice advice)
+{
+	return 0;
+}
+
+void *File::releaseContents(size_t *size)
+{
+	return NULL;
+}
+
+ssize_t File::copyFrom(File *source, off_t offset, size_t nbytes)
+{
+	if (nbytes == 0)
+		return 0;
+	if (source->seek(offset, SeekFromBeginning) != offset)
+		return -1;
+
+	const size_t kBufferSize = 65536;
+	uint8_t *buffer = static_cast<uint8_t *>(malloc(std::min(nbytes, kBufferSize)));
+	if (!buffer)
+		return -1;
+
+	size_t bytesCopied = 0;
+	while (bytesCopied < nbytes)
+	{
+		size_t n = std::min(nbytes - bytesCopied, kBufferSize);
+		ssize_t bytesRead = source->read(buffer, n);
+		if (bytesRead <= 0)
+			break;
+		ssize_t bytesWritten = write(buffer, bytesRead);
+		if (bytesWritten > 0)
+			bytesCopied += bytesWritten;
+		if (bytesWritten != bytesRead)
+			break;
+	}
+
+	free(buffer);
+	return bytesCopied > 0 ? static_cast<ssize_t>(bytesCopied) : -1;
+}
+
+int File::descriptor()
+{
+	return -1;
+}
+
+FilePOSIX::FilePOSIX(int fd, AccessMode mode, int writePolicy) :
+	File(mode),
+	m_fd(fd),
+	m_offset(::lseek(fd, 0, SEEK_CUR)),
+	m_positional(false),
+	m_append(false),
+	m_direct(false),
+	m_directActive(false),
+	m_staging(NULL)
+{
+	if (m_offset == -1)
+		return;
+
+	int flags = ::fcntl(fd, F_GETFL);
+	m_append = flags != -1 && (flags & O_APPEND);
+#ifdef O_DIRECT
+	m_directActive = flags != -1 && (flags & O_DIRECT);
+#endif
+
+#if defined(HAVE_PREAD) && defined(HAVE_PWRITE)
+	struct stat st;
+	if (!m_append && ::fstat(fd, &st) == 0 && S_ISREG(st.st_mode))
+		m_positional = true;
+#endif
+
+	// Direct I/O needs the explicit offsets of pwrite().
+#if defined(O_DIRECT) && defined(HAVE_POSIX_MEMALIGN)
+	m_direct = (writePolicy & AF_WRITE_DIRECT) && mode != ReadAccess &&
+		m_positional;
+#endif
+}
+
 int FilePOSIX::close()
 {
+	free(m_staging);
+	m_staging = NULL;
+
 	if (m_fd == -1)
 		return 0;
 
@@ -123,42 +433,373 @@ int FilePOSIX::close()
 
 ssize_t FilePOSIX::read(void *data, size_t nbytes)
 {
-	return ::read(m_fd, data, nbytes);
+	setDirect(false);
+
+	ssize_t result;
+#if defined(HAVE_PREAD)
+	if (m_positional)
+		result = ::pread(m_fd, data, nbytes, m_offset);
+	else
+#endif
+		result = ::read(m_fd, data, nbytes);
+	if (result > 0 && m_offset != -1)
+		m_offset += result;
+	return result;
 }
 
+/*
+	With direct I/O, the aligned part of data written at an aligned
+	offset bypasses the page cache and only the tail which follows
+	it is written through the page cache.
+*/
 ssize_t FilePOSIX::write(const void *data, size_t nbytes)
 {
-	return ::write(m_fd, data, nbytes);
+	size_t directBytes = 0;
+	if (m_direct && m_offset % kDirectAlignment == 0 &&
+		nbytes >= kDirectAlignment)
+	{
+		directBytes = writeDirect(static_cast<const uint8_t *>(data), nbytes);
+		m_offset += directBytes;
+		if (directBytes == nbytes)
+			return nbytes;
+		data = static_cast<const uint8_t *>(data) + directBytes;
+		nbytes -= directBytes;
+	}
+
+	if (!setDirect(false))
+		return directBytes > 0 ? static_cast<ssize_t>(directBytes) : -1;
+
+	ssize_t result;
+#if defined(HAVE_PWRITE)
+	if (m_positional)
+		result = ::pwrite(m_fd, data, nbytes, m_offset);
+	else
+#endif
+		result = ::write(m_fd, data, nbytes);
+	if (result < 0)
+		return directBytes > 0 ? static_cast<ssize_t>(directBytes) : -1;
+	if (result > 0 && m_offset != -1)
+	{
+		if (m_append)
+			m_offset = ::lseek(m_fd, 0, SEEK_CUR);
+		else
+			m_offset += result;
+	}
+	return directBytes + result;
+}
+
+/*
+	Write the longest multiple of kDirectAlignment bytes of data at
+	m_offset with O_DIRECT set, and return the number of bytes
+	written. Direct I/O is given up for good if the file system
+	refuses it.
+*/
+size_t FilePOSIX::writeDirect(const uint8_t *data, size_t nbytes)
+{
+#if defined(O_DIRECT) && defined(HAVE_POSIX_MEMALIGN)
+	if (!m_staging &&
+		::posix_memalign(&m_staging, kDirectAlignment, kStagingSize) != 0)
+	{
+		m_staging = NULL;
+		m_direct = false;
+		return 0;
+	}
+
+	if (!setDirect(true))
+	{
+		m_direct = false;
+		return 0;
+	}
+
+	size_t alignedBytes = nbytes - nbytes % kDirectAlignment;
+	size_t bytesWritten = 0;
+	while (bytesWritten < alignedBytes)
+	{
+		const void *source = data + bytesWritten;
+		size_t n = alignedBytes - bytesWritten;
+		if (reinterpret_cast<uintptr_t>(source) % kDirectAlignment != 0)
+		{
+			n = std::min<size_t>(n, kStagingSize);
+			memcpy(m_staging, source, n);
+			source = m_staging;
+		}
+
+		ssize_t result = ::pwrite(m_fd, source, n, m_offset + bytesWritten);
+		if (result <= 0)
+		{
+			if (result == -1 && errno == EINVAL && bytesWritten == 0)
+				m_direct = false;
+			break;
+		}
+		bytesWritten += result;
+		if (result % kDirectAlignment != 0)
+			break;
+	}
+	return bytesWritten;
+#else
+	return 0;
+#endif
+}
+
+/*
+	Set or clear O_DIRECT on the descriptor. Returns false if it
+	cannot be changed.
+*/
+bool FilePOSIX::setDirect(bool enable)
+{
+	if (enable == m_directActive)
+		return true;
+
+#ifdef O_DIRECT
+	int flags = ::fcntl(m_fd, F_GETFL);
+	if (flags == -1)
+		return false;
+	flags = enable ? flags | O_DIRECT : flags & ~O_DIRECT;
+	if (::fcntl(m_fd, F_SETFL, flags) == -1)
+		return false;
+	m_directActive = enable;
+	return true;
+#else
+	return false;
+#endif
+}
+
+int FilePOSIX::preallocate(off_t offset, off_t nbytes)
+{
+#if defined(HAVE_FALLOCATE) && defined(FALLOC_FL_KEEP_SIZE)
+	return ::fallocate(m_fd, FALLOC_FL_KEEP_SIZE, offset, nbytes);
+#else
+	errno = ENOSYS;
+	return -1;
+#endif
+}
+
+int FilePOSIX::advise(off_t offset, off_t nbytes, Advice advice)
+{
+#ifdef HAVE_POSIX_FADVISE
+	if (m_offset == -1)
+		return 0;
+
+	int fadvice;
+	switch (advice)
+	{
+		case AdviseNormal: fadvice = POSIX_FADV_NORMAL; break;
+		case AdviseSequential: fadvice = POSIX_FADV_SEQUENTIAL; break;
+		case AdviseRandom: fadvice = POSIX_FADV_RANDOM; break;
+		case AdviseWillNeed: fadvice = POSIX_FADV_WILLNEED; break;
+		case AdviseDontNeed: fadvice = POSIX_FADV_DONTNEED; break;
+		default: assert(false); return -1;
+	}
+
+	int result = ::posix_fadvise(m_fd, offset, nbytes, fadvice);
+	if (result != 0)
+	{
+		errno = result;
+		return -1;
+	}
+#endif
+	return 0;
+}
+
+int FilePOSIX::sync()
+{
+#ifdef HAVE_FDATASYNC
+	return ::fdatasync(m_fd);
+#else
+	return ::fsync(m_fd);
+#endif
+}
+
+/*
+	Have the kernel copy the data between the descriptors, which
+	copy_file_range() may do by sharing the data between the files.
+	Whatever the kernel cannot copy is copied through a buffer.
+*/
+ssize_t FilePOSIX::copyFrom(File *source, off_t offset, size_t nbytes)
+{
+	int sourceFD = source->descriptor();
+	if (sourceFD == -1 || m_offset == -1 || m_append || !setDirect(false))
+		return File::copyFrom(source, offset, nbytes);
+
+	size_t bytesCopied = 0;
+#ifdef HAVE_COPY_FILE_RANGE
+	while (bytesCopied < nbytes)
+	{
+		loff_t in = offset + bytesCopied;
+		loff_t out = m_offset;
+		ssize_t result = ::copy_file_range(sourceFD, &in, m_fd, &out,
+			nbytes - bytesCopied, 0);
+		if (result <= 0)
+			break;
+		bytesCopied += result;
+		m_offset += result;
+	}
+#endif
+#if defined(HAVE_SENDFILE) && defined(HAVE_SYS_SENDFILE_H)
+	if (bytesCopied < nbytes && ::lseek(m_fd, m_offset, SEEK_SET) == m_offset)
+	{
+		while (bytesCopied < nbytes)
+		{
+			off_t in = offset + bytesCopied;
+			ssize_t result = ::sendfile(m_fd, sourceFD, &in,
+				nbytes - bytesCopied);
+			if (result <= 0)
+				break;
+			bytesCopied += result;
+			m_offset += result;
+		}
+	}
+#endif
+
+	// A descriptor which is read and written directly follows m_offset.
+	if (!m_positional && ::lseek(m_fd, m_offset, SEEK_SET) != m_offset)
+		return bytesCopied > 0 ? static_cast<ssize_t>(bytesCopied) : -1;
+
+	if (bytesCopied < nbytes)
+	{
+		ssize_t result = File::copyFrom(source, offset + bytesCopied,
+			nbytes - bytesCopied);
+		if (result > 0)
+			bytesCopied += result;
+		else if (bytesCopied == 0)
+			return -1;
+	}
+
+	return bytesCopied;
 }
 
 off_t FilePOSIX::length()
 {
-	off_t current = tell();
-	if (current == -1)
+	if (m_offset == -1)
 		return -1;
-	off_t length = seek(0, SeekFromEnd);
+
+	struct stat st;
+	if (::fstat(m_fd, &st) == 0 && S_ISREG(st.st_mode))
+		return st.st_size;
+
+	off_t length = ::lseek(m_fd, 0, SEEK_END);
 	if (length == -1)
 		return -1;
-	seek(current, SeekFromBeginning);
+	::lseek(m_fd, m_offset, SEEK_SET);
 	return length;
 }
 
 off_t FilePOSIX::seek(off_t offset, File::SeekOrigin origin)
 {
-	int whence;
+	if (m_offset == -1)
+	{
+		int whence;
+		switch (origin)
+		{
+			case SeekFromBeginning: whence = SEEK_SET; break;
+			case SeekFromCurrent: whence = SEEK_CUR; break;
+			case SeekFromEnd: whence = SEEK_END; break;
+			default: assert(false); return -1;
+		}
+		return ::lseek(m_fd, offset, whence);
+	}
+
 	switch (origin)
 	{
-		case SeekFromBeginning: whence = SEEK_SET; break;
-		case SeekFromCurrent: whence = SEEK_CUR; break;
-		case SeekFromEnd: whence = SEEK_END; break;
-		default: assert(false); return -1;
+		case SeekFromBeginning:
+			break;
+		case SeekFromCurrent:
+			offset += m_offset;
+			break;
+		case SeekFromEnd:
+			if (!m_positional)
+			{
+				off_t result = ::lseek(m_fd, offset, SEEK_END);
+				if (result != -1)
+					m_offset = result;
+				return result;
+			}
+			else
+			{
+				off_t fileLength = length();
+				if (fileLength == -1)
+					return -1;
+				offset += fileLength;
+			}
+			break;
+		default:
+			assert(false);
+			return -1;
+	}
+
+	if (offset < 0)
+	{
+		errno = EINVAL;
+		return -1;
+	}
+
+	// Seeking to the current offset needs no system call.
+	if (offset == m_offset || m_positional)
+	{
+		m_offset = offset;
+		return m_offset;
 	}
-	return ::lseek(m_fd, offset, whence);
+
+	off_t result = ::lseek(m_fd, offset, SEEK_SET);
+	if (result != -1)
+		m_offset = result;
+	return result;
 }
 
 off_t FilePOSIX::tell()
 {
-	return seek(0, File::SeekFromCurrent);
+	if (m_offset == -1)
+		return ::lseek(m_fd, 0, SEEK_CUR);
+	return m_offset;
+}
+
+ssize_t FilePOSIX::readAt(void *data, size_t nbytes, off_t offset)
+{
+#ifdef HAVE_PREAD
+	if (m_offset != -1 && setDirect(false))
+		return ::pread(m_fd, data, nbytes, offset);
+#endif
+	errno = ENOSYS;
+	return -1;
+}
+
+ssize_t FileView::read(void *data, size_t nbytes)
+{
+	ssize_t result = m_file->readAt(data, nbytes, m_offset);
+	if (result > 0)
+		m_offset += result;
+	return result;
+}
+
+ssize_t FileView::write(const void *data, size_t nbytes)
+{
+	errno = EBADF;
+	return -1;
+}
+
+off_t FileView::seek(off_t offset, File::SeekOrigin origin)
+{
+	switch (origin)
+	{
+		case SeekFromBeginning: break;
+		case SeekFromCurrent: offset += m_offset; break;
+		case SeekFromEnd:
+		{
+			off_t fileLength = length();
+			if (fileLength == -1)
+				return -1;
+			offset += fileLength;
+			break;
+		}
+		default: assert(false); return -1;
+	}
+	if (offset < 0)
+	{
+		errno = EINVAL;
+		return -1;
+	}
+	m_offset = offset;
+	return m_offset;
 }
 
 int FileVF::close()
@@ -195,3 +836,178 @@ off_t FileVF::tell()
 {
 	return m_vf->tell(m_vf);
 }
+
+int FileMemory::close()
+{
+	free(m_buffer);
+	m_buffer = NULL;
+	m_capacity = 0;
+	return 0;
+}
+
+ssize_t FileMemory::read(void *data, size_t nbytes)
+{
+	const void *source;
+	ssize_t n = borrow(m_offset, nbytes, &source);
+	if (n > 0)
+	{
+		memcpy(data, source, n);
+		m_offset += n;
+	}
+	return n;
+}
+
+ssize_t FileMemory::readAt(void *data, size_t nbytes, off_t offset)
+{
+	const void *source;
+	ssize_t n = borrow(offset, nbytes, &source);
+	if (n > 0)
+		memcpy(data, source, n);
+	return n;
+}
+
+/*
+	Writing past the end of the data fills the gap with zeros, as
+	for a file on disk.
+*/
+ssize_t FileMemory::write(const void *data, size_t nbytes)
+{
+	if (accessMode() == ReadAccess)
+	{
+		errno = EBADF;
+		return -1;
+	}
+
+	size_t end = m_offset + nbytes;
+	if (end > m_capacity &&
+		!reserve(std::max(end, std::max<size_t>(2 * m_capacity, 65536))))
+	{
+		errno = ENOMEM;
+		return -1;
+	}
+
+	if (m_offset > m_length)
+		memset(m_buffer + m_length, 0, m_offset - m_length);
+	memcpy(m_buffer + m_offset, data, nbytes);
+	m_offset = end;
+	m_length = std::max<off_t>(m_length, end);
+	return nbytes;
+}
+
+bool FileMemory::reserve(size_t capacity)
+{
+	if (capacity <= m_capacity)
+		return true;
+
+	uint8_t *buffer = static_cast<uint8_t *>(realloc(m_buffer, capacity));
+	if (!buffer)
+		return false;
+	m_buffer = buffer;
+	m_data = buffer;
+	m_capacity = capacity;
+	return true;
+}
+
+void *FileMemory::releaseContents(size_t *size)
+{
+	if (!m_buffer)
+		return NULL;
+
+	void *contents = m_buffer;
+	*size = m_length;
+	m_buffer = NULL;
+	m_capacity = 0;
+	m_data = NULL;
+	m_length = 0;
+	m_offset = 0;
+	return contents;
+}
+
+off_t FileMemory::length()
+{
+	return m_length;
+}
+
+off_t FileMemory::seek(off_t offset, File::SeekOrigin origin)
+{
+	switch (origin)
+	{
+		case SeekFromBeginning: break;
+		case SeekFromCurrent: offset += m_offset; break;
+		case SeekFromEnd: offset += m_length; break;
+		default: assert(false); return -1;
+	}
+	if (offset < 0)
+	{
+		errno = EINVAL;
+		return -1;
+	}
+	m_offset = offset;
+	return m_offset;
+}
+
+off_t FileMemory::tell()
+{
+	return m_offset;
+}
+
+ssize_t FileMemory::borrow(off_t offset, size_t nbytes, const void **data)
+{
+	if (offset < 0)
+		return -1;
+	if (offset >= m_length)
+		return 0;
+	if (static_cast<off_t>(nbytes) > m_length - offset)
+		nbytes = m_length - offset;
+	*data = m_data + offset;
+	return nbytes;
+}
+
+#ifdef HAVE_MMAP
+int FileMMap::close()
+{
+	if (m_fd == -1)
+		return 0;
+
+	::munmap(const_cast<uint8_t *>(m_data), m_length);
+	m_data = NULL;
+
+	int result = ::close(m_fd);
+	m_fd = -1;
+	return result;
+}
+
+/*
+	MADV_DONTNEED would only remove pages from this mapping and
+	leave them in the page cache, so data which will not be read
+	again is left alone.
+*/
+int FileMMap::advise(off_t offset, off_t nbytes, Advice advice)
+{
+#ifdef HAVE_MADVISE
+	int madvice;
+	switch (advice)
+	{
+		case AdviseNormal: madvice = MADV_NORMAL; break;
+		case AdviseSequential: madvice = MADV_SEQUENTIAL; break;
+		case AdviseRandom: madvice = MADV_RANDOM; break;
+		case AdviseWillNeed: madvice = MADV_WILLNEED; break;
+		case AdviseDontNeed: return 0;
+		default: assert(false); return -1;
+	}
+
+	if (offset < 0 || offset >= m_length)
+		return 0;
+	if (nbytes == 0 || nbytes > m_length - offset)
+		nbytes = m_length - offset;
+
+	// madvise() takes a range which starts on a page.
+	off_t pageSize = ::sysconf(_SC_PAGESIZE);
+	off_t start = offset - offset % pageSize;
+	return ::madvise(const_cast<uint8_t *>(m_data) + start,
+		nbytes + (offset - start), madvice);
+#else
+	return 0;
+#endif
+}
+#endif
@@ -41,7 +41,9 @@ public:
 	enum AccessMode
 	{
 		ReadAccess,
-		WriteAccess
+		WriteAccess,
+		// An existing file which is both read and written.
+		ReadWriteAccess
 	};
 
 	enum SeekOrigin
@@ -51,10 +53,50 @@ public:
 		SeekFromEnd
 	};
 
-	static File *open(const char *path, AccessMode mode);
-	static File *create(int fd, AccessMode mode);
+	enum Advice
+	{
+		AdviseNormal,
+		AdviseSequential,
+		AdviseRandom,
+		// Data which will be read soon.
+		AdviseWillNeed,
+		// Data which will not be read again.
+		AdviseDontNeed
+	};
+
+	/*
+		writePolicy is a combination of AF_WRITE_* flags; only
+		AF_WRITE_DIRECT affects the file itself.
+	*/
+	static File *open(const char *path, AccessMode mode,
+		int writePolicy = 0);
+	static File *create(int fd, AccessMode mode, int writePolicy = 0);
 	static File *create(AFvirtualfile *vf, AccessMode mode);
 
+	/*
+		Map the regular file referred to by fd read-only into memory.
+		hints is a combination of AF_MMAP_* flags. Returns NULL
+		(leaving fd open) if the file cannot be mapped.
+	*/
+	static File *map(int fd, int hints);
+
+	/*
+		Create a file held in memory. A file created for reading
+		reads size bytes at data in place, and data must outlive
+		it. Otherwise the file holds a copy of the size bytes at
+		data in a buffer which grows as data is written. Returns
+		NULL if memory cannot be allocated.
+	*/
+	static File *createMemory(const void *data, size_t size, AccessMode mode);
+
+	/*
+		Create a read-only view of file with its own position. Reads
+		through the view use file's readAt(), so views of the same
+		file may be used from different threads. The view does not
+		take ownership of file.
+	*/
+	static File *createView(File *file);
+
 	virtual ~File();
 	virtual int close() = 0;
 	virtual ssize_t read(void *data, size_t nbytes) = 0;
@@ -63,7 +105,75 @@ public:
 	virtual off_t seek(off_t offset, SeekOrigin origin) = 0;
 	virtual off_t tell() = 0;
 
-	bool canSeek();
+	/*
+		Provide direct access to up to nbytes bytes at offset without
+		copying and without changing the current position. Returns the
+		number of bytes available at *data, or -1 if this file cannot
+		lend its contents.
+	*/
+	virtual ssize_t borrow(off_t offset, size_t nbytes, const void **data);
+
+	/*
+		Return true if data lent by borrow() never changes while the
+		file is open, so that it may be used from several threads.
+	*/
+	virtual bool canLend();
+
+	/*
+		Read up to nbytes bytes at offset without using or changing
+		the current position. This may be called from several threads
+		at once. Returns -1 if this file does not support positional
+		reads.
+	*/
+	virtual ssize_t readAt(void *data, size_t nbytes, off_t offset);
+
+	virtual bool canSeek();
+
+	/*
+		Copy up to nbytes bytes at offset in source to the current
+		position of this file and advance the position past them.
+		The position of source may change. Files which can have the
+		operating system copy the data do so without passing it
+		through this process. Returns the number of bytes copied, or
+		-1 if an error occurred before any were copied.
+	*/
+	virtual ssize_t copyFrom(File *source, off_t offset, size_t nbytes);
+
+	// Return the descriptor of the open file, or -1 if there is none.
+	virtual int descriptor();
+
+	/*
+		Pass any data which this file holds back to the operating
+		system. Returns 0 on success.
+	*/
+	virtual int flush();
+
+	/*
+		Reserve storage for nbytes bytes at offset without changing
+		the length of the file. Returns 0 on success, or -1 if the
+		storage cannot be reserved.
+	*/
+	virtual int preallocate(off_t offset, off_t nbytes);
+
+	/*
+		Wait until everything written to this file, including the
+		data it holds, has reached storage. Returns 0 on success.
+	*/
+	virtual int sync();
+
+	/*
+		Advise the operating system how nbytes bytes at offset, or
+		the rest of the file if nbytes is 0, will be read. Returns
+		0 on success; files which cannot use the advice ignore it.
+	*/
+	virtual int advise(off_t offset, off_t nbytes, Advice advice);
+
+	/*
+		Hand the contents of a file which holds them in a buffer of
+		its own to the caller, who must free() them, and leave the
+		file empty. Returns NULL for other files.
+	*/
+	virtual void *releaseContents(size_t *size);
 
 	AccessMode accessMode() const { return m_accessMode; }
 
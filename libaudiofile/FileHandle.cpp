@@ -26,7 +26,10 @@
 #include "audiofile.h"
 #include "byteorder.h"
 #include <stdlib.h>
+#include <string.h>
 #include <assert.h>
+#include <algorithm>
+#include <time.h>
 
 #include "AIFF.h"
 #include "AVR.h"
@@ -42,12 +45,15 @@
 #include "WAVE.h"
 
 #include "File.h"
+#include "HeaderFile.h"
 #include "Instrument.h"
+#include "SeekIndex.h"
 #include "Setup.h"
 #include "Tag.h"
 #include "Track.h"
 #include "units.h"
 #include "util.h"
+#include "modules/ModuleState.h"
 
 static void freeInstParams (AFPVu *values, int fileFormat)
 {
@@ -103,7 +109,15 @@ _AFfilehandle::_AFfilehandle()
 {
 	m_valid = _AF_VALID_FILEHANDLE;
 	m_access = 0;
+	m_inPlace = false;
+	m_readWrite = false;
+	m_editMetadata = false;
 	m_seekok = false;
+	m_headerOnly = false;
+	m_writePolicy = AF_WRITE_NORMAL;
+	m_accessHint = AF_ACCESS_NORMAL;
+	m_prefetchFrames = 0;
+	m_metadataChanged = kAllMetadata;
 	m_fh = NULL;
 	m_fileName = NULL;
 	m_fileFormat = AF_FILE_UNKNOWN;
@@ -114,6 +128,7 @@ _AFfilehandle::_AFfilehandle()
 	m_miscellaneousCount = 0;
 	m_miscellaneous = NULL;
 	m_formatByteOrder = 0;
+	m_seekIndexPath = NULL;
 }
 
 _AFfilehandle::~_AFfilehandle()
@@ -121,6 +136,7 @@ _AFfilehandle::~_AFfilehandle()
 	m_valid = 0;
 
 	free(m_fileName);
+	free(m_seekIndexPath);
 
 	delete [] m_tracks;
 	m_tracks = NULL;
@@ -153,6 +169,143 @@ _AFfilehandle::~_AFfilehandle()
 	m_miscellaneousCount = 0;
 }
 
+/*
+	A seek index file holds an 8-byte magic, a uint32 version, the
+	identity of the audio file and a uint32 track count, followed by
+	the uint32 track ID and seek index of each track.
+*/
+static const char kSeekIndexMagic[8] = { 'A', 'F', 'S', 'E', 'E', 'K', 'I', 'X' };
+static const uint32_t kSeekIndexVersion = 1;
+
+void _AFfilehandle::initSeekIndexes(const char *path, AFframecount interval)
+{
+	for (int i=0; i<m_trackCount; i++)
+		m_tracks[i].seekIndex = new SeekIndex(interval);
+
+	if (!path)
+		return;
+
+	m_seekIndexPath = _af_strdup(path);
+	m_seekIndexIdentity = FileIdentity::of(m_fh);
+
+	// A seek index file which cannot be used is replaced when saved.
+	SidecarReader reader;
+	char magic[sizeof (kSeekIndexMagic)];
+	uint32_t version, trackCount;
+	FileIdentity identity;
+	if (reader.load(path) == AF_FAIL ||
+		!reader.readBytes(magic, sizeof (magic)) ||
+		memcmp(magic, kSeekIndexMagic, sizeof (magic)) != 0 ||
+		!reader.readU32(&version) || version != kSeekIndexVersion ||
+		!reader.readIdentity(&identity) ||
+		!(identity == m_seekIndexIdentity) ||
+		!reader.readU32(&trackCount))
+		return;
+
+	for (uint32_t i=0; i<trackCount; i++)
+	{
+		uint32_t trackID;
+		if (!reader.readU32(&trackID))
+			return;
+		SharedPtr<SeekIndex> seekIndex = SeekIndex::read(reader);
+		if (!seekIndex)
+			return;
+
+		for (int t=0; t<m_trackCount; t++)
+		{
+			if (m_tracks[t].id == static_cast<int>(trackID))
+				m_tracks[t].seekIndex = seekIndex;
+		}
+	}
+}
+
+void _AFfilehandle::saveSeekIndexes()
+{
+	if (!m_seekIndexPath)
+		return;
+
+	bool modified = false;
+	for (int i=0; i<m_trackCount; i++)
+		modified = modified || m_tracks[i].seekIndex->isModified();
+	if (!modified)
+		return;
+
+	SidecarWriter writer;
+	writer.writeBytes(kSeekIndexMagic, sizeof (kSeekIndexMagic));
+	writer.writeU32(kSeekIndexVersion);
+	writer.writeIdentity(m_seekIndexIdentity);
+	writer.writeU32(m_trackCount);
+	for (int i=0; i<m_trackCount; i++)
+	{
+		writer.writeU32(m_tracks[i].id);
+		m_tracks[i].seekIndex->write(writer);
+	}
+
+	// Failing to save the seek indexes does not prevent closing the file.
+	writer.save(m_seekIndexPath);
+}
+
+/*
+	Sound data read sequentially is dropped from the page cache in
+	pieces of at least kAdviseGranularity bytes, so that reading a
+	few frames at a time does not cost a system call each time.
+*/
+static const AFfileoffset kAdviseGranularity = 1 << 20;
+
+void _AFfilehandle::setAccessHint(int hint, AFframecount prefetchFrames)
+{
+	m_accessHint = hint;
+	m_prefetchFrames = prefetchFrames;
+
+	File::Advice advice = File::AdviseNormal;
+	if (hint == AF_ACCESS_SEQUENTIAL)
+		advice = File::AdviseSequential;
+	else if (hint == AF_ACCESS_RANDOM)
+		advice = File::AdviseRandom;
+	m_fh->advise(0, 0, advice);
+
+	for (int i=0; i<m_trackCount; i++)
+		adviseAccess(&m_tracks[i], true);
+}
+
+void _AFfilehandle::adviseAccess(Track *track, bool repositioned)
+{
+	AFfileoffset position = track->fpos_next_frame;
+
+	if (repositioned)
+	{
+		track->fpos_dropped = position;
+		track->fpos_prefetched = position;
+	}
+
+	if (m_accessHint == AF_ACCESS_SEQUENTIAL &&
+		position - track->fpos_dropped >= kAdviseGranularity)
+	{
+		m_fh->advise(track->fpos_dropped, position - track->fpos_dropped,
+			File::AdviseDontNeed);
+		track->fpos_dropped = position;
+	}
+
+	if (m_prefetchFrames <= 0 || track->totalfframes <= 0 ||
+		track->data_size <= 0)
+		return;
+
+	// Compressed data is assumed to take the same space for each frame.
+	AFfileoffset window = static_cast<AFfileoffset>(
+		static_cast<double>(track->data_size) / track->totalfframes *
+		m_prefetchFrames);
+	AFfileoffset start = std::max(position, track->fpos_prefetched);
+	AFfileoffset end = std::min(position + window,
+		track->fpos_first_frame + track->data_size);
+
+	// Prefetch more once half of the window has been read.
+	if (end > start && (repositioned || end - start >= window / 2))
+	{
+		m_fh->advise(start, end - start, File::AdviseWillNeed);
+		track->fpos_prefetched = end;
+	}
+}
+
 Track *_AFfilehandle::allocateTrack()
 {
 	assert(!m_trackCount);
@@ -176,7 +329,7 @@ Track *_AFfilehandle::getTrack(int trackID)
 
 bool _AFfilehandle::checkCanRead()
 {
-	if (m_access != _AF_READ_ACCESS)
+	if (m_access != _AF_READ_ACCESS && !m_readWrite)
 	{
 		_af_error(AF_BAD_NOREADACC, "file not opened for read access");
 		return false;
@@ -187,7 +340,7 @@ bool _AFfilehandle::checkCanRead()
 
 bool _AFfilehandle::checkCanWrite()
 {
-	if (m_access != _AF_WRITE_ACCESS)
+	if (m_access != _AF_WRITE_ACCESS && !m_readWrite)
 	{
 		_af_error(AF_BAD_NOWRITEACC, "file not opened for write access");
 		return false;
@@ -196,8 +349,95 @@ bool _AFfilehandle::checkCanWrite()
 	return true;
 }
 
+bool _AFfilehandle::checkCanWriteMetadata()
+{
+	// A file opened with "m" has its metadata but not its frames written.
+	if (m_editMetadata)
+		return true;
+
+	if (!checkCanWrite())
+		return false;
+
+	// The chunks holding metadata were not laid out by writeInit().
+	if (m_inPlace)
+	{
+		_af_error(AF_BAD_NOT_IMPLEMENTED,
+			"metadata cannot be changed in a file opened for "
+			"appending or updating");
+		return false;
+	}
+
+	return true;
+}
+
+status _AFfilehandle::updateInit()
+{
+	_af_error(AF_BAD_NOT_IMPLEMENTED,
+		"%s files cannot be opened for appending or updating",
+		_af_units[m_fileFormat].name);
+	return AF_FAIL;
+}
+
+status _AFfilehandle::editInit()
+{
+	_af_error(AF_BAD_NOT_IMPLEMENTED,
+		"metadata of %s files cannot be edited in place",
+		_af_units[m_fileFormat].name);
+	return AF_FAIL;
+}
+
+status _AFfilehandle::switchAccess(int access)
+{
+	if (m_access == access)
+		return AF_SUCCEED;
+
+	assert(m_readWrite);
+	m_access = access;
+
+	for (int i=0; i<m_trackCount; i++)
+	{
+		Track *track = &m_tracks[i];
+		track->ms = new ModuleState();
+		if (track->ms->init(this, track) == AF_FAIL)
+			return AF_FAIL;
+	}
+
+	return AF_SUCCEED;
+}
+
+status _AFfilehandle::commitWriteInit(AFfilesetup setup)
+{
+	File *file = m_fh;
+	HeaderFile header(file);
+	m_fh = &header;
+	return commitHeader(&header, file, writeInit(setup));
+}
+
+status _AFfilehandle::commitUpdate()
+{
+	File *file = m_fh;
+	HeaderFile header(file);
+	m_fh = &header;
+	return commitHeader(&header, file,
+		m_editMetadata ? updateMetadata() : update());
+}
+
+status _AFfilehandle::commitHeader(HeaderFile *header, File *file,
+	status result)
+{
+	m_fh = file;
+	if (header->commit() != 0 && result == AF_SUCCEED)
+	{
+		_af_error(AF_BAD_WRITE, "could not write file header");
+		return AF_FAIL;
+	}
+	return result;
+}
+
 Instrument *_AFfilehandle::getInstrument(int instrumentID)
 {
+	loadMetadata();
+
 	for (int i = 0; i < m_instrumentCount; i++)
 		if (m_instruments[i].id == instrumentID)
 			return &m_instruments[i];
@@ -208,6 +448,8 @@ Instrument *_AFfilehandle::getInstrument(int instrumentID)
 
 Miscellaneous *_AFfilehandle::getMiscellaneous(int miscellaneousID)
 {
+	loadMetadata();
+
 	for (int i=0; i<m_miscellaneousCount; i++)
 	{
 		if (m_miscellaneous[i].id == miscellaneousID)
@@ -219,6 +461,50 @@ Miscellaneous *_AFfilehandle::getMiscellaneous(int miscellaneousID)
 	return NULL;
 }
 
+void _AFfilehandle::deferChunk(const Tag &id, AFfileoffset offset,
+	AFfileoffset size)
+{
+	// A file which cannot seek will not be able to come back later.
+	if (!m_seekok)
+	{
+		parseDeferredChunk(id, size);
+		return;
+	}
+
+	DeferredChunk chunk;
+	chunk.id = id;
+	chunk.offset = offset;
+	chunk.size = size;
+	m_deferredChunks.push_back(chunk);
+}
+
+void _AFfilehandle::parseDeferredChunks()
+{
+	std::vector<DeferredChunk> chunks;
+	chunks.swap(m_deferredChunks);
+
+	/*
+		The file module reads sample data from the current position,
+		so restore it after parsing.
+	*/
+	AFfileoffset position = m_fh->tell();
+
+	for (size_t i=0; i<chunks.size(); i++)
+	{
+		if (m_fh->seek(chunks[i].offset, File::SeekFromBeginning) !=
+			chunks[i].offset)
+		{
+			_af_error(AF_BAD_LSEEK, "unable to seek to %s chunk",
+				chunks[i].id.name().c_str());
+			break;
+		}
+
+		parseDeferredChunk(chunks[i].id, chunks[i].size);
+	}
+
+	m_fh->seek(position, File::SeekFromBeginning);
+}
+
 status _AFfilehandle::initFromSetup(AFfilesetup setup)
 {
 	if (copyTracksFromSetup(setup) == AF_FAIL)
@@ -254,6 +540,12 @@ status _AFfilehandle::copyTracksFromSetup(AFfilesetup setup)
 			return AF_FAIL;
 
 		track->hasAESData = trackSetup->aesDataSet;
+
+		if (trackSetup->peaksSet)
+		{
+			track->computesPeaks = true;
+			track->peaks.assign(track->f.channelCount, Peak());
+		}
 	}
 
 	return AF_SUCCEED;
@@ -486,3 +778,74 @@ bool _AFfilehandle::writeTag(const Tag *t)
 	uint32_t v = t->value();
 	return m_fh->write(&v, sizeof (v)) == sizeof (v);
 }
+
+bool _AFfilehandle::reserveSpace(size_t nbytes)
+{
+	if (m_seekok)
+		return m_fh->seek(nbytes, File::SeekFromCurrent) != -1;
+
+	static const uint8_t zeros[256] = { 0 };
+	while (nbytes > 0)
+	{
+		size_t n = std::min(nbytes, sizeof (zeros));
+		if (m_fh->write(zeros, n) != static_cast<ssize_t>(n))
+			return false;
+		nbytes -= n;
+	}
+	return true;
+}
+
+status _AFfilehandle::parsePeakChunk(uint32_t size)
+{
+	Track *track = getTrack();
+
+	// A malformed chunk is ignored.
+	uint32_t version, timeStamp;
+	if (size < 8 || (size - 8) % 8 != 0 ||
+		!readU32(&version) || !readU32(&timeStamp))
+		return AF_SUCCEED;
+
+	std::vector<Peak> peaks((size - 8) / 8);
+	for (size_t i=0; i<peaks.size(); i++)
+	{
+		float value;
+		uint32_t position;
+		if (!readFloat(&value) || !readU32(&position))
+			return AF_SUCCEED;
+		peaks[i].value = value;
+		peaks[i].position = position;
+	}
+
+	track->peaks.swap(peaks);
+	return AF_SUCCEED;
+}
+
+status _AFfilehandle::writePeakChunk(const Tag &filler)
+{
+	Track *track = getTrack();
+
+	Tag peak("PEAK");
+	uint32_t chunkSize = peakChunkSize(track->f.channelCount);
+	if (!writeTag(track->peaks.empty() ? &filler : &peak) ||
+		!writeU32(&chunkSize))
+		return AF_FAIL;
+	if (track->peaks.empty())
+		return reserveSpace(chunkSize) ? AF_SUCCEED : AF_FAIL;
+
+	uint32_t version = 1;
+	uint32_t timeStamp = time(NULL);
+	if (!writeU32(&version) || !writeU32(&timeStamp))
+		return AF_FAIL;
+
+	for (size_t i=0; i<track->peaks.size(); i++)
+	{
+		float value = track->peaks[i].value;
+		// The frame is stored in 32 bits.
+		uint32_t position = std::min<AFframecount>(track->peaks[i].position,
+			0xffffffff);
+		if (!writeFloat(&value) || !writeU32(&position))
+			return AF_FAIL;
+	}
+
+	return AF_SUCCEED;
+}
@@ -21,11 +21,14 @@
 #ifndef FILEHANDLE_H
 #define FILEHANDLE_H
 
+#include "Sidecar.h"
+#include "Tag.h"
 #include "afinternal.h"
 #include <stdint.h>
+#include <vector>
 
 class File;
-class Tag;
+class HeaderFile;
 struct Instrument;
 struct Miscellaneous;
 struct Track;
@@ -37,8 +40,65 @@ struct _AFfilehandle
 	int m_valid;	// _AF_VALID_FILEHANDLE
 	int m_access;	// _AF_READ_ACCESS or _AF_WRITE_ACCESS
 
+	/*
+		Set for an existing file opened with "a" or "r+", whose
+		header was read by readInit() and is updated in place.
+	*/
+	bool m_inPlace;
+
+	/*
+		Set for a file opened with "r+", which may be both read
+		and written.  m_access is then the direction in which the
+		module states of its tracks currently work.
+	*/
+	bool m_readWrite;
+
+	/*
+		Set for a file opened with "m", whose frames are read and
+		whose metadata is rewritten in place by updateMetadata().
+	*/
+	bool m_editMetadata;
+
 	bool m_seekok;
 
+	/*
+		Set when only the essential header fields are wanted;
+		readInit() may then stop as soon as the audio data has
+		been located.
+	*/
+	bool m_headerOnly;
+
+	/*
+		The AF_WRITE_* flags of the setup with which the file was
+		opened, which decide when afSyncFile() and afCloseFile()
+		wait for the data written to reach storage.
+	*/
+	int m_writePolicy;
+
+	// The AF_ACCESS_* hint given with afSetAccessHint().
+	int m_accessHint;
+	// Number of frames to prefetch ahead of the position of each track.
+	AFframecount m_prefetchFrames;
+
+	// Kinds of metadata, combined in m_metadataChanged.
+	enum
+	{
+		kMarkerMetadata = 1 << 0,
+		kInstrumentMetadata = 1 << 1,
+		kMiscellaneousMetadata = 1 << 2,
+		kAESMetadata = 1 << 3,
+		kAllMetadata = kMarkerMetadata | kInstrumentMetadata |
+			kMiscellaneousMetadata | kAESMetadata
+	};
+
+	/*
+		The kinds of metadata which update() must write: all of
+		them until update() has first been called, and afterward
+		those which have changed, so that update() rewrites the
+		chunks holding metadata only when necessary.
+	*/
+	int m_metadataChanged;
+
 	File *m_fh;
 
 	char *m_fileName;
@@ -57,10 +117,30 @@ struct _AFfilehandle
 private:
 	int m_formatByteOrder;
 
+	/*
+		The file in which the seek indexes of the tracks are saved
+		when the file is closed, or NULL, and the identity of the
+		audio file from which they were recorded.
+	*/
+	char *m_seekIndexPath;
+	FileIdentity m_seekIndexIdentity;
+
+	struct DeferredChunk
+	{
+		Tag id;
+		AFfileoffset offset;	// start of the chunk's data
+		AFfileoffset size;
+	};
+	std::vector<DeferredChunk> m_deferredChunks;
+
+	void parseDeferredChunks();
+
 	status copyTracksFromSetup(AFfilesetup setup);
 	status copyInstrumentsFromSetup(AFfilesetup setup);
 	status copyMiscellaneousFromSetup(AFfilesetup setup);
 
+	status commitHeader(HeaderFile *header, File *file, status result);
+
 public:
 	virtual ~_AFfilehandle();
 
@@ -68,10 +148,77 @@ public:
 	virtual status readInit(AFfilesetup) = 0;
 	virtual status writeInit(AFfilesetup) = 0;
 	virtual status update() = 0;
+	/*
+		Prepare a file whose header has been read by readInit() so
+		that update() can patch that header after frames have been
+		written to it.
+	*/
+	virtual status updateInit();
+	/*
+		Prepare a file whose header and metadata have been read so
+		that updateMetadata() can rewrite the chunks holding the
+		metadata which changes, without moving the sound data.
+	*/
+	virtual status editInit();
+	virtual status updateMetadata() { return AF_SUCCEED; }
 	virtual bool isInstrumentParameterValid(AUpvlist, int) { return false; }
+	/*
+		Return true if the format can be written without seeking
+		back to update its header; see afInitStreaming().
+	*/
+	virtual bool supportsStreaming() { return false; }
 
 	bool checkCanRead();
 	bool checkCanWrite();
+	bool checkCanWriteMetadata();
+
+	/*
+		Rebuild the module states of a file opened with "r+" to work
+		in the direction given by access.  The position of each track
+		is kept.
+	*/
+	status switchAccess(int access);
+
+	/*
+		Call writeInit() or update(), or updateMetadata() for a file
+		opened with "m", with their writes gathered in memory, so
+		that each contiguous region of the header reaches the file
+		in a single write.
+	*/
+	status commitWriteInit(AFfilesetup setup);
+	status commitUpdate();
+
+	/*
+		Parse the metadata chunks which readInit() deferred.  This
+		must be called before markers, instruments, miscellaneous
+		data or AES channel data are accessed.
+	*/
+	void loadMetadata()
+	{
+		if (!m_deferredChunks.empty())
+			parseDeferredChunks();
+	}
+
+	/*
+		Give each track a seek index with restart points about
+		interval frames apart, loading those saved in the file at
+		path if it was made from this file.
+	*/
+	void initSeekIndexes(const char *path, AFframecount interval);
+	// Save the seek indexes if restart points have been added.
+	void saveSeekIndexes();
+
+	/*
+		Advise the operating system of the access hint and
+		prefetch window set with afSetAccessHint().
+	*/
+	void setAccessHint(int hint, AFframecount prefetchFrames);
+	/*
+		Drop or prefetch sound data around the position of track
+		according to the access hint, after track has been read or,
+		if repositioned is set, has been moved.
+	*/
+	void adviseAccess(Track *track, bool repositioned);
 
 	Track *allocateTrack();
 	Track *getTrack(int trackID = AF_DEFAULT_TRACK);
@@ -83,6 +230,14 @@ protected:
 
 	status initFromSetup(AFfilesetup setup);
 
+	/*
+		Record a metadata chunk whose data starts at offset so that
+		it is parsed by parseDeferredChunk() on first use instead of
+		when the file is opened.
+	*/
+	void deferChunk(const Tag &id, AFfileoffset offset, AFfileoffset size);
+	virtual status parseDeferredChunk(const Tag &, AFfileoffset) { return AF_SUCCEED; }
+
 	void setFormatByteOrder(int byteOrder) { m_formatByteOrder = byteOrder; }
 
 	bool readU8(uint8_t *);
@@ -109,6 +264,27 @@ protected:
 
 	bool readTag(Tag *t);
 	bool writeTag(const Tag *t);
+
+	/*
+		Leave space for nbytes of data which will be written later.
+		A file which cannot seek is filled with zeros instead.
+	*/
+	bool reserveSpace(size_t nbytes);
+
+	/*
+		Read or write the PEAK chunk of a WAVE or AIFF file, which
+		holds a version, a time stamp, and the peak value and frame
+		of each channel.  If the peaks of the track are not known,
+		writePeakChunk() writes a chunk of the same size with the
+		filler chunk ID instead.  A PEAK chunk read from a file is
+		rewritten only if it has the size peakChunkSize() gives.
+	*/
+	static uint32_t peakChunkSize(int channelCount)
+	{
+		return 8 + 8 * channelCount;
+	}
+	status parsePeakChunk(uint32_t size);
+	status writePeakChunk(const Tag &filler);
 };
 
 #endif
@@ -0,0 +1,189 @@
+/*
+	Audio File Library
+
+	This library is free software; you can redistribute it and/or
+	modify it under the terms of the GNU Lesser General Public
+	License as published by the Free Software Foundation; either
+	version 2.1 of the License, or (at your option) any later version.
+
+	This library is distributed in the hope that it will be useful,
+	but WITHOUT ANY WARRANTY; without even the implied warranty of
+	MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+	Lesser General Public License for more details.
+
+	You should have received a copy of the GNU Lesser General Public
+	License along with this library; if not, write to the
+	Free Software Foundation, Inc., 51 Franklin Street, Fifth Floor,
+	Boston, MA  02110-1301  USA
+*/
+
+
+#include "config.h"
+#include "HeaderFile.h"
+
+#include <assert.h>
+#include <errno.h>
+#include <string.h>
+
+HeaderFile::HeaderFile(File *file) :
+	File(file->accessMode()),
+	m_file(file),
+	m_seekable(file->canSeek()),
+	m_position(file->tell())
+{
+	// Offsets in a non-seekable file count from where writing starts.
+	if (m_position == -1)
+		m_position = 0;
+}
+
+HeaderFile::~HeaderFile()
+{
+}
+
+int HeaderFile::close()
+{
+	return commit();
+}
+
+int HeaderFile::flush()
+{
+	if (commit() != 0)
+		return -1;
+	return m_file->flush();
+}
+
+int HeaderFile::commit()
+{
+	for (RegionMap::iterator i = m_regions.begin(); i != m_regions.end(); )
+	{
+		off_t offset = i->first;
+		const std::vector<uint8_t> &data = i->second;
+		if (m_seekable && m_file->tell() != offset &&
+			m_file->seek(offset, File::SeekFromBeginning) != offset)
+			return -1;
+		if (m_file->write(&data[0], data.size()) !=
+			static_cast<ssize_t>(data.size()))
+			return -1;
+		m_regions.erase(i++);
+	}
+
+	if (m_seekable && m_file->tell() != m_position &&
+		m_file->seek(m_position, File::SeekFromBeginning) != m_position)
+		return -1;
+	return 0;
+}
+
+ssize_t HeaderFile::read(void *data, size_t nbytes)
+{
+	if (commit() != 0)
+		return -1;
+	ssize_t result = m_file->read(data, nbytes);
+	if (result > 0)
+		m_position += result;
+	return result;
+}
+
+ssize_t HeaderFile::write(const void *data, size_t nbytes)
+{
+	if (nbytes == 0)
+		return 0;
+
+	const uint8_t *in = static_cast<const uint8_t *>(data);
+	off_t start = m_position;
+	off_t end = m_position + nbytes;
+	m_position = end;
+
+	// Find the first region which overlaps or adjoins the write.
+	RegionMap::iterator first = m_regions.upper_bound(start);
+	if (first != m_regions.begin())
+	{
+		RegionMap::iterator previous = first;
+		--previous;
+		if (previous->first + static_cast<off_t>(previous->second.size()) >= start)
+			first = previous;
+	}
+
+	// Extending the end of a region is by far the most common case.
+	RegionMap::iterator next = first;
+	if (first != m_regions.end() && first->first <= start)
+		++next;
+	if (first != m_regions.end() && first->first <= start &&
+		first->first + static_cast<off_t>(first->second.size()) == start &&
+		(next == m_regions.end() || next->first > end))
+	{
+		first->second.insert(first->second.end(), in, in + nbytes);
+		return nbytes;
+	}
+
+	// Merge every region which the write overlaps or adjoins.
+	off_t mergedStart = start;
+	off_t mergedEnd = end;
+	RegionMap::iterator last = first;
+	while (last != m_regions.end() && last->first <= end)
+	{
+		if (last->first < mergedStart)
+			mergedStart = last->first;
+		off_t regionEnd = last->first + static_cast<off_t>(last->second.size());
+		if (regionEnd > mergedEnd)
+			mergedEnd = regionEnd;
+		++last;
+	}
+
+	std::vector<uint8_t> merged(mergedEnd - mergedStart);
+	for (RegionMap::iterator i = first; i != last; ++i)
+		memcpy(&merged[i->first - mergedStart], &i->second[0],
+			i->second.size());
+	memcpy(&merged[start - mergedStart], in, nbytes);
+
+	m_regions.erase(first, last);
+	m_regions[mergedStart].swap(merged);
+	return nbytes;
+}
+
+off_t HeaderFile::length()
+{
+	off_t fileLength = m_file->length();
+	if (fileLength == -1 || m_regions.empty())
+		return fileLength;
+	RegionMap::reverse_iterator lastRegion = m_regions.rbegin();
+	off_t regionEnd = lastRegion->first +
+		static_cast<off_t>(lastRegion->second.size());
+	return regionEnd > fileLength ? regionEnd : fileLength;
+}
+
+off_t HeaderFile::seek(off_t offset, File::SeekOrigin origin)
+{
+	switch (origin)
+	{
+		case SeekFromBeginning:
+			break;
+		case SeekFromCurrent:
+			offset += m_position;
+			break;
+		case SeekFromEnd:
+		{
+			off_t fileLength = length();
+			if (fileLength == -1)
+				return -1;
+			offset += fileLength;
+			break;
+		}
+		default:
+			assert(false);
+			return -1;
+	}
+
+	if (offset < 0 || (!m_seekable && offset != m_position))
+	{
+		errno = !m_seekable ? ESPIPE : EINVAL;
+		return -1;
+	}
+
+	m_position = offset;
+	return m_position;
+}
+
+off_t HeaderFile::tell()
+{
+	return m_position;
+}
@@ -0,0 +1,76 @@
+/*
+	Audio File Library
+
+	This library is free software; you can redistribute it and/or
+	modify it under the terms of the GNU Lesser General Public
+	License as published by the Free Software Foundation; either
+	version 2.1 of the License, or (at your option) any later version.
+
+	This library is distributed in the hope that it will be useful,
+	but WITHOUT ANY WARRANTY; without even the implied warranty of
+	MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+	Lesser General Public License for more details.
+
+	You should have received a copy of the GNU Lesser General Public
+	License along with this library; if not, write to the
+	Free Software Foundation, Inc., 51 Franklin Street, Fifth Floor,
+	Boston, MA  02110-1301  USA
+*/
+
+
+#ifndef HEADER_FILE_H
+#define HEADER_FILE_H
+
+#include "Compiler.h"
+#include "File.h"
+
+#include <map>
+#include <stdint.h>
+#include <vector>
+
+/*
+	HeaderFile gathers the writes made to another file while a header
+	is being written.  Writes are kept in memory and merged with any
+	writes which they overlap or adjoin, so that commit() writes each
+	contiguous region of the header with a single call to the
+	underlying file, however many fields the header is built from.
+
+	Reading first commits any gathered writes.  HeaderFile does not
+	take ownership of the wrapped file.
+*/
+class HeaderFile : public File
+{
+public:
+	HeaderFile(File *file);
+	virtual ~HeaderFile();
+
+	virtual int close() OVERRIDE;
+	virtual ssize_t read(void *data, size_t nbytes) OVERRIDE;
+	virtual ssize_t write(const void *data, size_t nbytes) OVERRIDE;
+	virtual off_t length() OVERRIDE;
+	virtual off_t seek(off_t offset, SeekOrigin origin) OVERRIDE;
+	virtual off_t tell() OVERRIDE;
+	virtual bool canSeek() OVERRIDE { return m_seekable; }
+	virtual int flush() OVERRIDE;
+
+	/*
+		Write the gathered regions to the underlying file in order of
+		offset and leave it positioned where this file is.  Returns 0
+		on success.
+	*/
+	int commit();
+
+private:
+	File *m_file;
+	bool m_seekable;
+	off_t m_position;
+
+	// Gathered data keyed by offset; regions neither overlap nor adjoin.
+	typedef std::map<off_t, std::vector<uint8_t> > RegionMap;
+	RegionMap m_regions;
+
+	HeaderFile(const HeaderFile &);
+	HeaderFile &operator=(const HeaderFile &);
+};
+
+#endif
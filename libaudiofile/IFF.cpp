@@ -58,18 +58,11 @@ static const _AFfilesetup iffDefaultFileSetup =
 	NULL			/* miscellaneous */
 };
 
-bool IFFFile::recognize(File *fh)
+bool IFFFile::recognize(const uint8_t *header, size_t length)
 {
-	uint8_t buffer[8];
-
-	fh->seek(0, File::SeekFromBeginning);
-
-	if (fh->read(buffer, 8) != 8 || memcmp(buffer, "FORM", 4) != 0)
-		return false;
-	if (fh->read(buffer, 4) != 4 || memcmp(buffer, "8SVX", 4) != 0)
-		return false;
-
-	return true;
+	return length >= 12 &&
+		memcmp(header, "FORM", 4) == 0 &&
+		memcmp(header + 8, "8SVX", 4) == 0;
 }
 
 IFFFile::IFFFile()
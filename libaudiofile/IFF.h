@@ -34,7 +34,7 @@
 class IFFFile : public _AFfilehandle
 {
 public:
-	static bool recognize(File *fh);
+	static bool recognize(const uint8_t *header, size_t length);
 	static AFfilesetup completeSetup(AFfilesetup);
 
 	IFFFile();
@@ -97,24 +97,20 @@ const int _af_ircam_compression_types[_AF_IRCAM_NUM_COMPTYPES] =
 	AF_COMPRESSION_G711_ALAW
 };
 
-bool IRCAMFile::recognize(File *fh)
+bool IRCAMFile::recognize(const uint8_t *header, size_t length)
 {
-	uint8_t buffer[4];
-
-	fh->seek(0, File::SeekFromBeginning);
-
-	if (fh->read(buffer, 4) != 4)
+	if (length < 4)
 		return false;
 
 	/* Check to see if the file's magic number matches. */
-	if (!memcmp(buffer, ircam_vax_le_magic, 4) ||
-		!memcmp(buffer, ircam_vax_be_magic, 4) ||
-		!memcmp(buffer, ircam_sun_be_magic, 4) ||
-		!memcmp(buffer, ircam_sun_le_magic, 4) ||
-		!memcmp(buffer, ircam_mips_le_magic, 4) ||
-		!memcmp(buffer, ircam_mips_be_magic, 4) ||
-		!memcmp(buffer, ircam_next_be_magic, 4) ||
-		!memcmp(buffer, ircam_next_le_magic, 4))
+	if (!memcmp(header, ircam_vax_le_magic, 4) ||
+		!memcmp(header, ircam_vax_be_magic, 4) ||
+		!memcmp(header, ircam_sun_be_magic, 4) ||
+		!memcmp(header, ircam_sun_le_magic, 4) ||
+		!memcmp(header, ircam_mips_le_magic, 4) ||
+		!memcmp(header, ircam_mips_be_magic, 4) ||
+		!memcmp(header, ircam_next_be_magic, 4) ||
+		!memcmp(header, ircam_next_le_magic, 4))
 	{
 		return true;
 	}
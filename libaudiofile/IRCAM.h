@@ -38,12 +38,13 @@ extern const int _af_ircam_compression_types[_AF_IRCAM_NUM_COMPTYPES];
 class IRCAMFile : public _AFfilehandle
 {
 public:
-	static bool recognize(File *fh);
+	static bool recognize(const uint8_t *header, size_t length);
 	static AFfilesetup completeSetup(AFfilesetup);
 
 	status readInit(AFfilesetup) OVERRIDE;
 	status writeInit(AFfilesetup) OVERRIDE;
 	status update() OVERRIDE;
+	bool supportsStreaming() OVERRIDE { return true; }
 };
 
 #endif
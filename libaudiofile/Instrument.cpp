@@ -101,6 +101,8 @@ int afGetInstIDs (AFfilehandle file, int *instids)
 	if (!_af_filehandle_ok(file))
 		return -1;
 
+	file->loadMetadata();
+
 	if (instids)
 		for (int i=0; i < file->m_instrumentCount; i++)
 			instids[i] = file->m_instruments[i].id;
@@ -117,13 +119,15 @@ void _af_instparam_set (AFfilehandle file, int instid, AUpvlist pvlist, int npv)
 	if (!_af_filehandle_ok(file))
 		return;
 
-	if (!file->checkCanWrite())
+	if (!file->checkCanWriteMetadata())
 		return;
 
 	Instrument *instrument = file->getInstrument(instid);
 	if (!instrument)
 		return;
 
+	file->m_metadataChanged |= _AFfilehandle::kInstrumentMetadata;
+
 	if (AUpvgetmaxitems(pvlist) < npv)
 	npv = AUpvgetmaxitems(pvlist);
 
@@ -81,13 +81,17 @@ static Loop *getLoop (AFfilehandle handle, int instid, int loopid,
 	if (!_af_filehandle_ok(handle))
 		return NULL;
 
-	if (mustWrite && !handle->checkCanWrite())
+	if (mustWrite && !handle->checkCanWriteMetadata())
 		return NULL;
 
 	Instrument *instrument = handle->getInstrument(instid);
 	if (!instrument)
 		return NULL;
 
+	// The caller is about to change the loop.
+	if (mustWrite)
+		handle->m_metadataChanged |= _AFfilehandle::kInstrumentMetadata;
+
 	return instrument->getLoop(loopid);
 }
 
@@ -157,6 +157,8 @@ char *afGetMarkName (AFfilehandle file, int trackid, int markid)
 	if (!_af_filehandle_ok(file))
 		return NULL;
 
+	file->loadMetadata();
+
 	Track *track = file->getTrack(trackid);
 	if (!track)
 		return NULL;
@@ -173,6 +175,8 @@ char *afGetMarkComment (AFfilehandle file, int trackid, int markid)
 	if (!_af_filehandle_ok(file))
 		return NULL;
 
+	file->loadMetadata();
+
 	Track *track = file->getTrack(trackid);
 	if (!track)
 		return NULL;
@@ -190,9 +194,11 @@ void afSetMarkPosition (AFfilehandle file, int trackid, int markid,
 	if (!_af_filehandle_ok(file))
 		return;
 
-	if (!file->checkCanWrite())
+	if (!file->checkCanWriteMetadata())
 		return;
 
+	file->loadMetadata();
+
 	Track *track = file->getTrack(trackid);
 	if (!track)
 		return;
@@ -209,6 +215,7 @@ void afSetMarkPosition (AFfilehandle file, int trackid, int markid,
 	}
 
 	marker->position = position;
+	file->m_metadataChanged |= _AFfilehandle::kMarkerMetadata;
 }
 
 int afGetMarkIDs (AFfilehandle file, int trackid, int markids[])
@@ -216,6 +223,8 @@ int afGetMarkIDs (AFfilehandle file, int trackid, int markids[])
 	if (!_af_filehandle_ok(file))
 		return -1;
 
+	file->loadMetadata();
+
 	Track *track = file->getTrack(trackid);
 	if (!track)
 		return -1;
@@ -236,6 +245,8 @@ AFframecount afGetMarkPosition (AFfilehandle file, int trackid, int markid)
 	if (!_af_filehandle_ok(file))
 		return 0L;
 
+	file->loadMetadata();
+
 	Track *track = file->getTrack(trackid);
 	if (!track)
 		return 0L;
@@ -76,6 +76,8 @@ int afGetMiscIDs (AFfilehandle file, int *ids)
 	if (!_af_filehandle_ok(file))
 		return -1;
 
+	file->loadMetadata();
+
 	if (ids != NULL)
 	{
 		for (int i=0; i<file->m_miscellaneousCount; i++)
@@ -134,7 +136,7 @@ int afWriteMisc (AFfilehandle file, int miscellaneousid, const void *buf, int by
 	if (!_af_filehandle_ok(file))
 		return -1;
 
-	if (!file->checkCanWrite())
+	if (!file->checkCanWriteMetadata())
 		return -1;
 
 	Miscellaneous *miscellaneous = file->getMiscellaneous(miscellaneousid);
@@ -160,6 +162,7 @@ int afWriteMisc (AFfilehandle file, int miscellaneousid, const void *buf, int by
 	memcpy((char *) miscellaneous->buffer + miscellaneous->position,
 		buf, localsize);
 	miscellaneous->position += localsize;
+	file->m_metadataChanged |= _AFfilehandle::kMiscellaneousMetadata;
 	return localsize;
 }
 
@@ -59,20 +59,11 @@ static const _AFfilesetup nistDefaultFileSetup =
 	NULL			/* miscellaneous */
 };
 
-bool NISTFile::recognize(File *fh)
+bool NISTFile::recognize(const uint8_t *header, size_t length)
 {
-	uint8_t buffer[16];
-
-	fh->seek(0, File::SeekFromBeginning);
-
-	if (fh->read(buffer, 16) != 16)
-		return false;
-
 	/* Check to see if the file's magic number matches. */
-	if (memcmp(buffer, "NIST_1A\n   1024\n", 16) == 0)
-		return true;
-
-	return false;
+	return length >= 16 &&
+		memcmp(header, "NIST_1A\n   1024\n", 16) == 0;
 }
 
 AFfilesetup NISTFile::completeSetup(AFfilesetup setup)
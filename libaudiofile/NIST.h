@@ -33,7 +33,7 @@
 class NISTFile : public _AFfilehandle
 {
 public:
-	static bool recognize(File *fh);
+	static bool recognize(const uint8_t *header, size_t length);
 	static AFfilesetup completeSetup(AFfilesetup setup);
 
 	status readInit(AFfilesetup) OVERRIDE;
@@ -137,11 +137,23 @@ status NeXTFile::readInit(AFfilesetup setup)
 
 	track->fpos_first_frame = offset;
 
-	off_t lengthAvailable = m_fh->length() - offset;
-	if (length == _AU_LENGTH_UNSPECIFIED || static_cast<off_t>(length) > lengthAvailable)
-		length = lengthAvailable;
+	off_t fileLength = m_fh->length();
+	if (fileLength == -1)
+	{
+		// The length of a pipe is not known in advance.
+		if (length == _AU_LENGTH_UNSPECIFIED)
+			track->data_size = -1;
+		else
+			track->data_size = length;
+	}
+	else
+	{
+		off_t lengthAvailable = fileLength - offset;
+		if (length == _AU_LENGTH_UNSPECIFIED || static_cast<off_t>(length) > lengthAvailable)
+			length = lengthAvailable;
 
-	track->data_size = length;
+		track->data_size = length;
+	}
 
 	switch (encoding)
 	{
@@ -202,16 +214,9 @@ status NeXTFile::readInit(AFfilesetup setup)
 	return AF_SUCCEED;
 }
 
-bool NeXTFile::recognize(File *fh)
+bool NeXTFile::recognize(const uint8_t *header, size_t length)
 {
-	uint8_t buffer[4];
-
-	fh->seek(0, File::SeekFromBeginning);
-
-	if (fh->read(buffer, 4) != 4 || memcmp(buffer, ".snd", 4) != 0)
-		return false;
-
-	return true;
+	return length >= 4 && memcmp(header, ".snd", 4) == 0;
 }
 
 AFfilesetup NeXTFile::completeSetup(AFfilesetup setup)
@@ -295,6 +300,10 @@ static uint32_t nextencodingtype (AudioFormat *format);
 
 status NeXTFile::update()
 {
+	// A streamed file's header is written only once.
+	if (!m_seekok)
+		return AF_SUCCEED;
+
 	writeHeader();
 	return AF_SUCCEED;
 }
@@ -307,7 +316,7 @@ status NeXTFile::writeHeader()
 		_af_error(AF_BAD_LSEEK, "bad seek");
 
 	uint32_t offset = track->fpos_first_frame;
-	uint32_t length = track->data_size;
+	uint32_t length = m_seekok ? track->data_size : _AU_LENGTH_UNSPECIFIED;
 	uint32_t encoding = nextencodingtype(&track->f);
 	uint32_t sampleRate = track->f.sampleRate;
 	uint32_t channelCount = track->f.channelCount;
@@ -319,6 +328,10 @@ status NeXTFile::writeHeader()
 	writeU32(&sampleRate);
 	writeU32(&channelCount);
 
+	// The information field must be at least four bytes long.
+	uint32_t info = 0;
+	writeU32(&info);
+
 	return AF_SUCCEED;
 }
 
@@ -357,10 +370,10 @@ status NeXTFile::writeInit(AFfilesetup setup)
 	if (initFromSetup(setup) == AF_FAIL)
 		return AF_FAIL;
 
-	writeHeader();
-
 	Track *track = getTrack();
 	track->fpos_first_frame = 28;
 
+	writeHeader();
+
 	return AF_SUCCEED;
 }
@@ -39,12 +39,13 @@ class NeXTFile : public _AFfilehandle
 public:
 	NeXTFile();
 
-	static bool recognize(File *fh);
+	static bool recognize(const uint8_t *header, size_t length);
 	static AFfilesetup completeSetup(AFfilesetup);
 
 	status readInit(AFfilesetup) OVERRIDE;
 	status writeInit(AFfilesetup) OVERRIDE;
 	status update() OVERRIDE;
+	bool supportsStreaming() OVERRIDE { return true; }
 
 private:
 	status writeHeader();
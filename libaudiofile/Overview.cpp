@@ -0,0 +1,515 @@
+/*
+	Audio File Library
+
+	This library is free software; you can redistribute it and/or
+	modify it under the terms of the GNU Lesser General Public
+	License as published by the Free Software Foundation; either
+	version 2.1 of the License, or (at your option) any later version.
+
+	This library is distributed in the hope that it will be useful,
+	but WITHOUT ANY WARRANTY; without even the implied warranty of
+	MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+	Lesser General Public License for more details.
+
+	You should have received a copy of the GNU Lesser General Public
+	License along with this library; if not, write to the
+	Free Software Foundation, Inc., 51 Franklin Street, Fifth Floor,
+	Boston, MA  02110-1301  USA
+*/
+
+/*
+	Overview.cpp
+
+	This file contains routines for building overviews of the audio
+	data of a track, from which waveforms can be drawn at any zoom
+	level without reading the audio data again, and for saving them
+	to cache files.
+*/
+
+#include "config.h"
+#include "Overview.h"
+
+#include "FileHandle.h"
+#include "Track.h"
+#include "afinternal.h"
+#include "audiofile.h"
+#include "byteorder.h"
+#include "modules/ModuleState.h"
+#include "util.h"
+
+#include <algorithm>
+#include <math.h>
+#include <string.h>
+
+static const char kCacheMagic[8] = { 'A', 'F', 'O', 'V', 'R', 'V', 'W', '\n' };
+static const uint32_t kCacheVersion = 1;
+
+// The number of frames read at a time while building an overview.
+static const int kReadFrames = 65536;
+
+// The number of samples whose statistics are gathered side by side.
+static const int kLaneCount = 64;
+
+/*
+	Gather the extremes and the sum of squares of each sample
+	position within rows of laneCount samples, a whole number of
+	frames long, scanning the interleaved samples in order.  Each
+	lane is updated independently, so the compiler can vectorize
+	the loop over a row.
+*/
+static void scanLanes (const float *samples, int sampleCount, int laneCount,
+	float *minima, float *maxima, float *sums)
+{
+	int i = 0;
+	for (; i + laneCount <= sampleCount; i += laneCount)
+	{
+		const float *row = samples + i;
+		for (int j=0; j<laneCount; j++)
+		{
+			float sample = row[j];
+			minima[j] = std::min(minima[j], sample);
+			maxima[j] = std::max(maxima[j], sample);
+			sums[j] += sample * sample;
+		}
+	}
+	// The remaining samples are a whole number of frames.
+	for (int j=0; i + j < sampleCount; j++)
+	{
+		float sample = samples[i + j];
+		minima[j] = std::min(minima[j], sample);
+		maxima[j] = std::max(maxima[j], sample);
+		sums[j] += sample * sample;
+	}
+}
+
+bool _AFoverview::Key::operator==(const Key &other) const
+{
+	return file == other.file && channelCount == other.channelCount;
+}
+
+_AFoverview::_AFoverview(const Key &key) :
+	m_key(key),
+	m_frameCount(0)
+{
+}
+
+_AFoverview::Key _AFoverview::makeKey(AFfilehandle file, Track *track)
+{
+	Key key;
+	key.file = FileIdentity::of(file->m_fh);
+	key.channelCount = track->v.channelCount;
+	return key;
+}
+
+AFframecount _AFoverview::bucketFrames(size_t level) const
+{
+	AFframecount frames = kBaseBucketFrames;
+	for (size_t i=0; i<level; i++)
+		frames *= kBucketFactor;
+	return frames;
+}
+
+size_t _AFoverview::bucketCount(size_t level) const
+{
+	return m_levels[level].size() / channelCount();
+}
+
+_AFoverview::Bucket _AFoverview::combine(size_t level, size_t first,
+	size_t last, int channel) const
+{
+	const Level &buckets = m_levels[level];
+	AFframecount frames = bucketFrames(level);
+	int channels = channelCount();
+
+	float minimum = HUGE_VALF, maximum = -HUGE_VALF;
+	double sum = 0;
+	AFframecount totalFrames = 0;
+	for (size_t i=first; i<last; i++)
+	{
+		const Bucket &bucket = buckets[i * channels + channel];
+		AFframecount n = std::min<AFframecount>(frames, m_frameCount - i * frames);
+		minimum = std::min(minimum, bucket.min);
+		maximum = std::max(maximum, bucket.max);
+		sum += static_cast<double>(bucket.rms) * bucket.rms * n;
+		totalFrames += n;
+	}
+
+	Bucket result;
+	result.min = minimum;
+	result.max = maximum;
+	result.rms = totalFrames ? sqrt(sum / totalFrames) : 0;
+	return result;
+}
+
+void _AFoverview::addLevels()
+{
+	int channels = channelCount();
+	while (bucketCount(m_levels.size() - 1) > 1)
+	{
+		size_t below = m_levels.size() - 1;
+		size_t belowCount = bucketCount(below);
+		size_t count = (belowCount + kBucketFactor - 1) / kBucketFactor;
+
+		Level level(count * channels);
+		for (size_t i=0; i<count; i++)
+		{
+			size_t first = i * kBucketFactor;
+			size_t last = std::min(first + kBucketFactor, belowCount);
+			for (int c=0; c<channels; c++)
+				level[i * channels + c] = combine(below, first, last, c);
+		}
+		m_levels.push_back(level);
+	}
+}
+
+_AFoverview *_AFoverview::build(AFfilehandle file, Track *track,
+	const Key &key)
+{
+	AudioFormat savedFormat = track->v;
+	AFframecount savedFrame = track->nextvframe;
+
+	_af_set_sample_format(&track->v, AF_SAMPFMT_FLOAT, 32);
+	track->v.byteOrder = _AF_BYTEORDER_NATIVE;
+	track->nextvframe = 0;
+	track->ms->setDirty();
+
+	_AFoverview *overview = new _AFoverview(key);
+	overview->m_levels.push_back(Level());
+	Level &base = overview->m_levels[0];
+
+	int channels = key.channelCount;
+	std::vector<float> buffer(kReadFrames * channels);
+	std::vector<float> minima(channels, HUGE_VALF);
+	std::vector<float> maxima(channels, -HUGE_VALF);
+	std::vector<double> sums(channels, 0);
+	int bucketFrames = 0;
+
+	/*
+		A lane's sum of squares covers at most one bucket, so it is
+		kept in single precision and widened once per bucket.
+	*/
+	int laneCount = std::max(kLaneCount / channels, 1) * channels;
+	std::vector<float> laneMinima(laneCount), laneMaxima(laneCount),
+		laneSums(laneCount);
+
+	bool ok = true;
+	while (true)
+	{
+		int framesRead = afReadFrames(file, track->id, &buffer[0], kReadFrames);
+		if (framesRead < 0)
+			ok = false;
+		if (framesRead <= 0)
+			break;
+
+		int frame = 0;
+		while (frame < framesRead)
+		{
+			int count = std::min(framesRead - frame,
+				kBaseBucketFrames - bucketFrames);
+
+			std::fill(laneMinima.begin(), laneMinima.end(), HUGE_VALF);
+			std::fill(laneMaxima.begin(), laneMaxima.end(), -HUGE_VALF);
+			std::fill(laneSums.begin(), laneSums.end(), 0.0f);
+			scanLanes(&buffer[frame * channels], count * channels, laneCount,
+				&laneMinima[0], &laneMaxima[0], &laneSums[0]);
+
+			for (int j=0; j<laneCount; j++)
+			{
+				int c = j % channels;
+				minima[c] = std::min(minima[c], laneMinima[j]);
+				maxima[c] = std::max(maxima[c], laneMaxima[j]);
+				sums[c] += laneSums[j];
+			}
+
+			frame += count;
+			bucketFrames += count;
+			if (bucketFrames == kBaseBucketFrames)
+			{
+				for (int c=0; c<channels; c++)
+				{
+					Bucket bucket;
+					bucket.min = minima[c];
+					bucket.max = maxima[c];
+					bucket.rms = sqrt(sums[c] / bucketFrames);
+					base.push_back(bucket);
+					minima[c] = HUGE_VALF;
+					maxima[c] = -HUGE_VALF;
+					sums[c] = 0;
+				}
+				overview->m_frameCount += bucketFrames;
+				bucketFrames = 0;
+			}
+		}
+	}
+
+	// Close the last bucket, which may hold fewer frames.
+	if (ok && bucketFrames > 0)
+	{
+		for (int c=0; c<channels; c++)
+		{
+			Bucket bucket;
+			bucket.min = minima[c];
+			bucket.max = maxima[c];
+			bucket.rms = sqrt(sums[c] / bucketFrames);
+			base.push_back(bucket);
+		}
+		overview->m_frameCount += bucketFrames;
+	}
+
+	track->v = savedFormat;
+	track->nextvframe = savedFrame;
+	track->ms->setDirty();
+
+	if (!ok)
+	{
+		delete overview;
+		return NULL;
+	}
+
+	overview->addLevels();
+	return overview;
+}
+
+void _AFoverview::read(AFframecount start, AFframecount end,
+	int bucketCount, float *minima, float *maxima, float *rms) const
+{
+	int channels = channelCount();
+
+	end = std::min(end, m_frameCount);
+	AFframecount length = std::max<AFframecount>(end - start, 0);
+	AFframecount quotient = length / bucketCount;
+	AFframecount remainder = length % bucketCount;
+
+	// Use the coarsest level whose buckets fit in each output bucket.
+	size_t level = 0;
+	while (level + 1 < m_levels.size() && bucketFrames(level + 1) <= quotient)
+		level++;
+	AFframecount frames = bucketFrames(level);
+
+	for (int i=0; i<bucketCount; i++)
+	{
+		AFframecount first = start + quotient * i + remainder * i / bucketCount;
+		AFframecount last = start + quotient * (i + 1) +
+			remainder * (i + 1) / bucketCount;
+		if (last == first)
+			last = first + 1;
+
+		for (int c=0; c<channels; c++)
+		{
+			Bucket bucket = { 0, 0, 0 };
+			if (first < m_frameCount)
+				bucket = combine(level, first / frames,
+					(last - 1) / frames + 1, c);
+
+			if (minima)
+				minima[i * channels + c] = bucket.min;
+			if (maxima)
+				maxima[i * channels + c] = bucket.max;
+			if (rms)
+				rms[i * channels + c] = bucket.rms;
+		}
+	}
+}
+
+/*
+	Cache files store all values in little-endian byte order:
+
+	magic		8 bytes
+	version		uint32
+	channel count	uint32
+	file size	uint64
+	modification time	int64
+	content hash	uint64
+	frame count	int64
+	base bucket frames	uint32
+	bucket factor	uint32
+	level count	uint32
+	for each level:
+		bucket count	uint64
+		for each bucket and channel: min, max, rms	float
+*/
+
+status _AFoverview::save(const char *path) const
+{
+	SidecarWriter writer;
+	writer.writeBytes(kCacheMagic, sizeof (kCacheMagic));
+	writer.writeU32(kCacheVersion);
+	writer.writeU32(m_key.channelCount);
+	writer.writeIdentity(m_key.file);
+	writer.writeU64(m_frameCount);
+	writer.writeU32(kBaseBucketFrames);
+	writer.writeU32(kBucketFactor);
+	writer.writeU32(m_levels.size());
+	for (size_t i=0; i<m_levels.size(); i++)
+	{
+		writer.writeU64(bucketCount(i));
+		for (size_t j=0; j<m_levels[i].size(); j++)
+		{
+			writer.writeFloat(m_levels[i][j].min);
+			writer.writeFloat(m_levels[i][j].max);
+			writer.writeFloat(m_levels[i][j].rms);
+		}
+	}
+
+	return writer.save(path);
+}
+
+_AFoverview *_AFoverview::load(const char *path, const Key &key)
+{
+	SidecarReader reader;
+	char magic[sizeof (kCacheMagic)];
+	uint32_t version, channelCount, baseBucketFrames, bucketFactor, levelCount;
+	Key savedKey;
+	uint64_t frameCount;
+	if (reader.load(path) == AF_FAIL ||
+		!reader.readBytes(magic, sizeof (magic)) ||
+		memcmp(magic, kCacheMagic, sizeof (magic)) != 0 ||
+		!reader.readU32(&version) || version != kCacheVersion ||
+		!reader.readU32(&channelCount) ||
+		!reader.readIdentity(&savedKey.file) ||
+		!reader.readU64(&frameCount) ||
+		!reader.readU32(&baseBucketFrames) ||
+		!reader.readU32(&bucketFactor) ||
+		!reader.readU32(&levelCount))
+		return NULL;
+
+	savedKey.channelCount = channelCount;
+	if (!(savedKey == key) || channelCount == 0 ||
+		baseBucketFrames != kBaseBucketFrames ||
+		bucketFactor != kBucketFactor ||
+		static_cast<int64_t>(frameCount) < 0 ||
+		levelCount == 0 || levelCount > 16)
+		return NULL;
+
+	_AFoverview *overview = new _AFoverview(key);
+	overview->m_frameCount = frameCount;
+
+	// Each level must have as many buckets as the frame count implies.
+	uint64_t expectedCount = (frameCount + kBaseBucketFrames - 1) /
+		kBaseBucketFrames;
+	for (uint32_t i=0; i<levelCount; i++)
+	{
+		uint64_t count;
+		if (!reader.readU64(&count) || count != expectedCount ||
+			count > reader.remaining() / (3 * sizeof (float) * channelCount))
+		{
+			delete overview;
+			return NULL;
+		}
+
+		overview->m_levels.push_back(Level(count * channelCount));
+		Level &level = overview->m_levels.back();
+		for (size_t j=0; j<level.size(); j++)
+		{
+			reader.readFloat(&level[j].min);
+			reader.readFloat(&level[j].max);
+			reader.readFloat(&level[j].rms);
+		}
+
+		expectedCount = (expectedCount + kBucketFactor - 1) / kBucketFactor;
+	}
+
+	if (reader.remaining() != 0 || overview->bucketCount(levelCount - 1) > 1)
+	{
+		delete overview;
+		return NULL;
+	}
+
+	return overview;
+}
+
+AFoverview afNewOverview (AFfilehandle file, int trackid,
+	const char *cachePath)
+{
+	if (!_af_filehandle_ok(file))
+		return NULL;
+
+	if (!file->checkCanRead())
+		return NULL;
+
+	Track *track = file->getTrack(trackid);
+	if (!track)
+		return NULL;
+
+	if (!file->m_seekok)
+	{
+		_af_error(AF_BAD_LSEEK,
+			"cannot build an overview of a file which cannot seek");
+		return NULL;
+	}
+
+	_AFoverview::Key key = _AFoverview::makeKey(file, track);
+
+	if (cachePath)
+	{
+		_AFoverview *overview = _AFoverview::load(cachePath, key);
+		if (overview)
+			return overview;
+	}
+
+	_AFoverview *overview = _AFoverview::build(file, track, key);
+	if (!overview)
+		return NULL;
+
+	// Failing to save the overview does not prevent its use.
+	if (cachePath)
+		overview->save(cachePath);
+
+	return overview;
+}
+
+void afFreeOverview (AFoverview overview)
+{
+	delete overview;
+}
+
+static bool overviewOk (AFoverview overview)
+{
+	if (!overview)
+	{
+		_af_error(AF_BAD_FILEHANDLE, "null overview");
+		return false;
+	}
+	return true;
+}
+
+int afGetOverviewChannels (AFoverview overview)
+{
+	if (!overviewOk(overview))
+		return -1;
+
+	return overview->channelCount();
+}
+
+AFframecount afGetOverviewFrameCount (AFoverview overview)
+{
+	if (!overviewOk(overview))
+		return -1;
+
+	return overview->frameCount();
+}
+
+int afReadOverview (AFoverview overview, AFframecount start,
+	AFframecount end, int bucketCount, float *minima, float *maxima,
+	float *rms)
+{
+	if (!overviewOk(overview))
+		return -1;
+
+	if (start < 0 || end < start)
+	{
+		_af_error(AF_BAD_FRAME, "invalid frame range [%jd, %jd)",
+			static_cast<intmax_t>(start), static_cast<intmax_t>(end));
+		return -1;
+	}
+
+	if (bucketCount <= 0)
+	{
+		_af_error(AF_BAD_FRAMECNT, "invalid bucket count %d", bucketCount);
+		return -1;
+	}
+
+	overview->read(start, end, bucketCount, minima, maxima, rms);
+
+	return bucketCount;
+}
@@ -0,0 +1,104 @@
+/*
+	Audio File Library
+
+	This library is free software; you can redistribute it and/or
+	modify it under the terms of the GNU Lesser General Public
+	License as published by the Free Software Foundation; either
+	version 2.1 of the License, or (at your option) any later version.
+
+	This library is distributed in the hope that it will be useful,
+	but WITHOUT ANY WARRANTY; without even the implied warranty of
+	MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+	Lesser General Public License for more details.
+
+	You should have received a copy of the GNU Lesser General Public
+	License along with this library; if not, write to the
+	Free Software Foundation, Inc., 51 Franklin Street, Fifth Floor,
+	Boston, MA  02110-1301  USA
+*/
+
+#ifndef OVERVIEW_H
+#define OVERVIEW_H
+
+#include "Sidecar.h"
+#include "afinternal.h"
+#include "audiofile.h"
+
+#include <stdint.h>
+#include <vector>
+
+struct Track;
+
+/*
+	The minimum, maximum and RMS value of the samples of each channel
+	of a track in buckets of kBaseBucketFrames frames, and in the
+	successively larger buckets of further levels, each of which
+	combines kBucketFactor buckets of the level below.  The top level
+	has a single bucket.
+*/
+struct _AFoverview
+{
+public:
+	static const int kBaseBucketFrames = 256;
+	static const int kBucketFactor = 16;
+
+	/*
+		What the overview was built from.  An overview saved to a
+		file is used only if the audio file still matches it.
+	*/
+	struct Key
+	{
+		FileIdentity file;
+		uint32_t channelCount;
+
+		bool operator==(const Key &) const;
+	};
+
+	/*
+		Read the track from its first frame in floating-point form
+		and build its overview.  The virtual sample format and the
+		position of the track are restored afterward.
+	*/
+	static _AFoverview *build(AFfilehandle file, Track *track,
+		const Key &key);
+	// Load an overview saved to path if it matches key.
+	static _AFoverview *load(const char *path, const Key &key);
+	static Key makeKey(AFfilehandle file, Track *track);
+
+	// Save the overview to path, replacing any file there.
+	status save(const char *path) const;
+
+	int channelCount() const { return m_key.channelCount; }
+	AFframecount frameCount() const { return m_frameCount; }
+
+	/*
+		Combine the buckets which overlap each of bucketCount equal
+		parts of the frames [start, end).
+	*/
+	void read(AFframecount start, AFframecount end, int bucketCount,
+		float *minima, float *maxima, float *rms) const;
+
+private:
+	struct Bucket
+	{
+		float min, max, rms;
+	};
+
+	// The buckets of a level, one for each channel of each bucket.
+	typedef std::vector<Bucket> Level;
+
+	Key m_key;
+	AFframecount m_frameCount;
+	std::vector<Level> m_levels;
+
+	_AFoverview(const Key &key);
+
+	AFframecount bucketFrames(size_t level) const;
+	size_t bucketCount(size_t level) const;
+	// Combine buckets [first, last) of a level for one channel.
+	Bucket combine(size_t level, size_t first, size_t last,
+		int channel) const;
+	void addLevels();
+};
+
+#endif
@@ -60,6 +60,12 @@ void PacketTable::append(size_t bytesPerPacket)
 	m_bytesPerPacket.push_back(bytesPerPacket);
 }
 
+void PacketTable::truncate(size_t numPackets)
+{
+	if (numPackets < m_bytesPerPacket.size())
+		m_bytesPerPacket.resize(numPackets);
+}
+
 AFfileoffset PacketTable::startOfPacket(size_t packet) const
 {
 	AFfileoffset offset = 0;
@@ -0,0 +1,69 @@
+/*
+	Audio File Library
+
+	This library is free software; you can redistribute it and/or
+	modify it under the terms of the GNU Lesser General Public
+	License as published by the Free Software Foundation; either
+	version 2.1 of the License, or (at your option) any later version.
+
+	This library is distributed in the hope that it will be useful,
+	but WITHOUT ANY WARRANTY; without even the implied warranty of
+	MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+	Lesser General Public License for more details.
+
+	You should have received a copy of the GNU Lesser General Public
+	License along with this library; if not, write to the
+	Free Software Foundation, Inc., 51 Franklin Street, Fifth Floor,
+	Boston, MA  02110-1301  USA
+*/
+
+/*
+	Peak.cpp
+
+	This file contains routines for dealing with the peak amplitude
+	of each channel, which files can store so that it need not be
+	found by reading all of their audio data.
+*/
+
+#include "config.h"
+#include "Peak.h"
+
+#include "FileHandle.h"
+#include "Setup.h"
+#include "Track.h"
+#include "afinternal.h"
+#include "audiofile.h"
+#include "util.h"
+
+void afInitPeaks (AFfilesetup setup, int trackid, int enable)
+{
+	if (!_af_filesetup_ok(setup))
+		return;
+
+	TrackSetup *track = setup->getTrack(trackid);
+	if (!track)
+		return;
+
+	track->peaksSet = enable != 0;
+}
+
+int afGetPeaks (AFfilehandle file, int trackid, double *peaks,
+	AFframecount *positions)
+{
+	if (!_af_filehandle_ok(file))
+		return -1;
+
+	Track *track = file->getTrack(trackid);
+	if (!track)
+		return -1;
+
+	for (size_t i=0; i<track->peaks.size(); i++)
+	{
+		if (peaks)
+			peaks[i] = track->peaks[i].value;
+		if (positions)
+			positions[i] = track->peaks[i].position;
+	}
+
+	return track->peaks.size();
+}
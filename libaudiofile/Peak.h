@@ -0,0 +1,37 @@
+/*
+	Audio File Library
+
+	This library is free software; you can redistribute it and/or
+	modify it under the terms of the GNU Lesser General Public
+	License as published by the Free Software Foundation; either
+	version 2.1 of the License, or (at your option) any later version.
+
+	This library is distributed in the hope that it will be useful,
+	but WITHOUT ANY WARRANTY; without even the implied warranty of
+	MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+	Lesser General Public License for more details.
+
+	You should have received a copy of the GNU Lesser General Public
+	License along with this library; if not, write to the
+	Free Software Foundation, Inc., 51 Franklin Street, Fifth Floor,
+	Boston, MA  02110-1301  USA
+*/
+
+#ifndef PEAK_H
+#define PEAK_H
+
+#include "audiofile.h"
+
+/*
+	The largest absolute sample value of a channel, relative to full
+	scale, and the first frame in which it occurs.
+*/
+struct Peak
+{
+	double value;
+	AFframecount position;
+
+	Peak() : value(0), position(0) { }
+};
+
+#endif
@@ -54,7 +54,7 @@ const int _af_raw_compression_types[_AF_RAW_NUM_COMPTYPES] =
 	AF_COMPRESSION_G711_ALAW
 };
 
-bool RawFile::recognize(File *fh)
+bool RawFile::recognize(const uint8_t *header, size_t length)
 {
 	return false;
 }
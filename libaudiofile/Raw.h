@@ -34,12 +34,13 @@ extern const int _af_raw_compression_types[_AF_RAW_NUM_COMPTYPES];
 class RawFile : public _AFfilehandle
 {
 public:
-	static bool recognize(File *fh);
+	static bool recognize(const uint8_t *header, size_t length);
 	static AFfilesetup completeSetup(AFfilesetup);
 
 	status readInit(AFfilesetup setup) OVERRIDE;
 	status writeInit(AFfilesetup setup) OVERRIDE;
 	status update() OVERRIDE;
+	bool supportsStreaming() OVERRIDE { return true; }
 };
 
 #endif
@@ -0,0 +1,155 @@
+/*
+	Audio File Library
+
+	This library is free software; you can redistribute it and/or
+	modify it under the terms of the GNU Lesser General Public
+	License as published by the Free Software Foundation; either
+	version 2.1 of the License, or (at your option) any later version.
+
+	This library is distributed in the hope that it will be useful,
+	but WITHOUT ANY WARRANTY; without even the implied warranty of
+	MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+	Lesser General Public License for more details.
+
+	You should have received a copy of the GNU Lesser General Public
+	License along with this library; if not, write to the
+	Free Software Foundation, Inc., 51 Franklin Street, Fifth Floor,
+	Boston, MA  02110-1301  USA
+*/
+
+#include "config.h"
+#include "ReaderPool.h"
+
+#include "File.h"
+#include "FileHandle.h"
+#include "PacketTable.h"
+#include "SeekIndex.h"
+#include "modules/ModuleState.h"
+
+#include <math.h>
+
+TrackReader::TrackReader() :
+	m_fh(NULL),
+	m_generation(0)
+{
+}
+
+TrackReader::~TrackReader()
+{
+	/*
+		The compression parameters, channel matrix and markers
+		belong to the file handle's track.
+	*/
+	m_track.f.compressionParams = NULL;
+	m_track.v.compressionParams = NULL;
+	m_track.channelMatrix = NULL;
+	m_track.markerCount = 0;
+	m_track.markers = NULL;
+	m_track.readerPool = NULL;
+
+	m_track.ms = NULL;
+	delete m_fh;
+}
+
+TrackReader *TrackReader::create(AFfilehandle file, const Track *track)
+{
+	TrackReader *reader = new TrackReader();
+	reader->m_generation = track->ms->generation();
+	reader->m_fh = File::createView(file->m_fh);
+
+	reader->m_track = *track;
+	reader->m_track.readerPool = NULL;
+	// Readers may run on other threads, so they do not record restart points.
+	reader->m_track.seekIndex = NULL;
+	reader->m_track.ms = new ModuleState();
+
+	Track *t = &reader->m_track;
+	if (t->ms->init(file, t, reader->m_fh) == AF_FAIL ||
+		t->ms->setup(file, t) == AF_FAIL)
+	{
+		delete reader;
+		return NULL;
+	}
+
+	return reader;
+}
+
+status TrackReader::seek(AFfilehandle file, AFframecount vframe)
+{
+	// Position the module chain as ModuleState::setup() does.
+	Track *t = &m_track;
+	AFframecount fframepos = llrint(vframe * t->f.sampleRate / t->v.sampleRate);
+	t->nextfframe = fframepos;
+	t->nextvframe = llrint(fframepos * t->v.sampleRate / t->f.sampleRate);
+	return t->ms->reset(file, t);
+}
+
+ReaderPool::ReaderPool() :
+	m_generation(0)
+{
+#ifdef HAVE_PTHREAD_H
+	pthread_mutex_init(&m_mutex, NULL);
+#endif
+}
+
+ReaderPool::~ReaderPool()
+{
+	for (size_t i=0; i<m_idle.size(); i++)
+		delete m_idle[i];
+#ifdef HAVE_PTHREAD_H
+	pthread_mutex_destroy(&m_mutex);
+#endif
+}
+
+void ReaderPool::lock()
+{
+#ifdef HAVE_PTHREAD_H
+	pthread_mutex_lock(&m_mutex);
+#endif
+}
+
+void ReaderPool::unlock()
+{
+#ifdef HAVE_PTHREAD_H
+	pthread_mutex_unlock(&m_mutex);
+#endif
+}
+
+TrackReader *ReaderPool::acquire(AFfilehandle file, const Track *track)
+{
+	TrackReader *reader = NULL;
+	std::vector<TrackReader *> stale;
+
+	lock();
+	if (m_generation != track->ms->generation())
+	{
+		stale.swap(m_idle);
+		m_generation = track->ms->generation();
+	}
+	if (!m_idle.empty())
+	{
+		reader = m_idle.back();
+		m_idle.pop_back();
+	}
+	unlock();
+
+	for (size_t i=0; i<stale.size(); i++)
+		delete stale[i];
+
+	if (!reader)
+		reader = TrackReader::create(file, track);
+	return reader;
+}
+
+void ReaderPool::release(TrackReader *reader)
+{
+	lock();
+	if (reader->generation() == m_generation)
+	{
+		m_idle.push_back(reader);
+		reader = NULL;
+	}
+	unlock();
+
+	delete reader;
+}
@@ -0,0 +1,93 @@
+/*
+	Audio File Library
+
+	This library is free software; you can redistribute it and/or
+	modify it under the terms of the GNU Lesser General Public
+	License as published by the Free Software Foundation; either
+	version 2.1 of the License, or (at your option) any later version.
+
+	This library is distributed in the hope that it will be useful,
+	but WITHOUT ANY WARRANTY; without even the implied warranty of
+	MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+	Lesser General Public License for more details.
+
+	You should have received a copy of the GNU Lesser General Public
+	License along with this library; if not, write to the
+	Free Software Foundation, Inc., 51 Franklin Street, Fifth Floor,
+	Boston, MA  02110-1301  USA
+*/
+
+#ifndef READER_POOL_H
+#define READER_POOL_H
+
+#include "Track.h"
+#include "afinternal.h"
+
+#include <vector>
+
+#ifdef HAVE_PTHREAD_H
+#include <pthread.h>
+#endif
+
+class File;
+
+/*
+	A TrackReader decodes frames from a track independently of the
+	file handle's own position. It has its own copy of the track's
+	state, its own module chain and its own view of the file, and
+	shares the parsed header and packet table with the file handle.
+*/
+class TrackReader
+{
+public:
+	static TrackReader *create(AFfilehandle file, const Track *track);
+	~TrackReader();
+
+	Track *track() { return &m_track; }
+	File *file() { return m_fh; }
+	unsigned generation() const { return m_generation; }
+
+	// Position the reader at the given virtual frame.
+	status seek(AFfilehandle file, AFframecount vframe);
+
+private:
+	Track m_track;
+	File *m_fh;
+	unsigned m_generation;
+
+	TrackReader();
+	TrackReader(const TrackReader &);
+	TrackReader &operator=(const TrackReader &);
+};
+
+/*
+	ReaderPool keeps idle TrackReaders for a track so that concurrent
+	positional reads need not rebuild a module chain for every call.
+	Readers are discarded when the track's virtual format changes.
+*/
+class ReaderPool
+{
+public:
+	ReaderPool();
+	~ReaderPool();
+
+	// Return an idle reader for track, creating one if necessary.
+	TrackReader *acquire(AFfilehandle file, const Track *track);
+	// Return a reader obtained from acquire() to the pool.
+	void release(TrackReader *reader);
+
+private:
+	std::vector<TrackReader *> m_idle;
+	unsigned m_generation;
+#ifdef HAVE_PTHREAD_H
+	pthread_mutex_t m_mutex;
+#endif
+
+	void lock();
+	void unlock();
+
+	ReaderPool(const ReaderPool &);
+	ReaderPool &operator=(const ReaderPool &);
+};
+
+#endif
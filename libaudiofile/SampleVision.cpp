@@ -74,13 +74,11 @@ SampleVisionFile::~SampleVisionFile()
 {
 }
 
-bool SampleVisionFile::recognize(File *fh)
+bool SampleVisionFile::recognize(const uint8_t *header, size_t length)
 {
-	fh->seek(0, File::SeekFromBeginning);
-	char magic[kSMPMagicLength];
-	if (fh->read(magic, kSMPMagicLength) != (ssize_t) kSMPMagicLength)
-		return false;
-	return !strncmp(magic, kSMPMagic, kSMPMagicLength);
+	return length >= kSMPMagicLength &&
+		!strncmp(reinterpret_cast<const char *>(header), kSMPMagic,
+			kSMPMagicLength);
 }
 
 AFfilesetup SampleVisionFile::completeSetup(AFfilesetup setup)
@@ -30,7 +30,7 @@ public:
 	SampleVisionFile();
 	virtual ~SampleVisionFile();
 
-	static bool recognize(File *fh);
+	static bool recognize(const uint8_t *header, size_t length);
 
 	static AFfilesetup completeSetup(AFfilesetup);
 
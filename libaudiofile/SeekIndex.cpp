@@ -0,0 +1,111 @@
+/*
+	Audio File Library
+
+	This library is free software; you can redistribute it and/or
+	modify it under the terms of the GNU Lesser General Public
+	License as published by the Free Software Foundation; either
+	version 2.1 of the License, or (at your option) any later version.
+
+	This library is distributed in the hope that it will be useful,
+	but WITHOUT ANY WARRANTY; without even the implied warranty of
+	MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+	Lesser General Public License for more details.
+
+	You should have received a copy of the GNU Lesser General Public
+	License along with this library; if not, write to the
+	Free Software Foundation, Inc., 51 Franklin Street, Fifth Floor,
+	Boston, MA  02110-1301  USA
+*/
+
+#include "config.h"
+#include "SeekIndex.h"
+
+#include "Sidecar.h"
+
+#include <algorithm>
+
+static bool compareFrames(const SeekIndex::Entry &entry, AFframecount frame)
+{
+	return entry.frame < frame;
+}
+
+SeekIndex::SeekIndex(AFframecount interval) :
+	m_interval(interval > 0 ? interval : kDefaultInterval),
+	m_modified(false)
+{
+}
+
+void SeekIndex::add(AFframecount frame, AFfileoffset offset, int64_t packet)
+{
+	std::vector<Entry>::iterator next = std::lower_bound(m_entries.begin(),
+		m_entries.end(), frame, compareFrames);
+	if (next != m_entries.end() && next->frame - frame < m_interval)
+		return;
+	if (next != m_entries.begin() && frame - (next - 1)->frame < m_interval)
+		return;
+
+	Entry entry;
+	entry.frame = frame;
+	entry.offset = offset;
+	entry.packet = packet;
+	m_entries.insert(next, entry);
+	m_modified = true;
+}
+
+const SeekIndex::Entry *SeekIndex::find(AFframecount frame) const
+{
+	std::vector<Entry>::const_iterator next = std::lower_bound(m_entries.begin(),
+		m_entries.end(), frame + 1, compareFrames);
+	if (next == m_entries.begin())
+		return NULL;
+	return &*(next - 1);
+}
+
+/*
+	A seek index is stored as its interval and its number of entries,
+	each uint64, followed by the frame, offset and packet of each
+	entry, each int64.
+*/
+void SeekIndex::write(SidecarWriter &writer) const
+{
+	writer.writeU64(m_interval);
+	writer.writeU64(m_entries.size());
+	for (size_t i=0; i<m_entries.size(); i++)
+	{
+		writer.writeU64(m_entries[i].frame);
+		writer.writeU64(m_entries[i].offset);
+		writer.writeU64(m_entries[i].packet);
+	}
+}
+
+SeekIndex *SeekIndex::read(SidecarReader &reader)
+{
+	uint64_t interval, count;
+	if (!reader.readU64(&interval) || !reader.readU64(&count) ||
+		static_cast<int64_t>(interval) <= 0 ||
+		count > reader.remaining() / (3 * sizeof (uint64_t)))
+		return NULL;
+
+	SeekIndex *index = new SeekIndex(interval);
+	index->m_entries.resize(count);
+	for (size_t i=0; i<count; i++)
+	{
+		uint64_t frame, offset, packet;
+		reader.readU64(&frame);
+		reader.readU64(&offset);
+		reader.readU64(&packet);
+
+		Entry &entry = index->m_entries[i];
+		entry.frame = frame;
+		entry.offset = offset;
+		entry.packet = packet;
+		if (entry.frame < 0 || entry.offset < 0 || entry.packet < 0 ||
+			(i > 0 && entry.frame <= index->m_entries[i-1].frame))
+		{
+			delete index;
+			return NULL;
+		}
+	}
+
+	return index;
+}
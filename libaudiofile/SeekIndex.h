@@ -0,0 +1,76 @@
+/*
+	Audio File Library
+
+	This library is free software; you can redistribute it and/or
+	modify it under the terms of the GNU Lesser General Public
+	License as published by the Free Software Foundation; either
+	version 2.1 of the License, or (at your option) any later version.
+
+	This library is distributed in the hope that it will be useful,
+	but WITHOUT ANY WARRANTY; without even the implied warranty of
+	MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+	Lesser General Public License for more details.
+
+	You should have received a copy of the GNU Lesser General Public
+	License along with this library; if not, write to the
+	Free Software Foundation, Inc., 51 Franklin Street, Fifth Floor,
+	Boston, MA  02110-1301  USA
+*/
+
+#ifndef SEEK_INDEX_H
+#define SEEK_INDEX_H
+
+#include "Shared.h"
+#include "afinternal.h"
+
+#include <audiofile.h>
+#include <stdint.h>
+#include <vector>
+
+class SidecarReader;
+class SidecarWriter;
+
+/*
+	A SeekIndex records points in the encoded audio data of a track
+	from which decoding can restart, about one for every interval
+	frames, so that compression modules whose files have no index of
+	their own can seek without bisecting or scanning the file.  The
+	points are recorded by the compression modules as frames are
+	decoded in order.
+*/
+class SeekIndex : public Shared<SeekIndex>
+{
+public:
+	static const AFframecount kDefaultInterval = 32768;
+
+	struct Entry
+	{
+		AFframecount frame;	// first frame decoded from this point
+		AFfileoffset offset;	// byte offset of the encoded data
+		int64_t packet;	// packet beginning at offset, if counted
+	};
+
+	SeekIndex(AFframecount interval);
+
+	AFframecount interval() const { return m_interval; }
+	size_t size() const { return m_entries.size(); }
+
+	// Record a restart point unless another lies within the interval.
+	void add(AFframecount frame, AFfileoffset offset, int64_t packet);
+
+	// Return the last restart point at or before frame, or NULL.
+	const Entry *find(AFframecount frame) const;
+
+	// Whether points have been added since the index was created or read.
+	bool isModified() const { return m_modified; }
+
+	void write(SidecarWriter &writer) const;
+	static SeekIndex *read(SidecarReader &reader);
+
+private:
+	AFframecount m_interval;
+	std::vector<Entry> m_entries;
+	bool m_modified;
+};
+
+#endif
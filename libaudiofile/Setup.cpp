@@ -28,6 +28,7 @@
 #include <stdlib.h>
 #include <string.h>
 
+#include "BufferedFile.h"
 #include "FileHandle.h"
 #include "Instrument.h"
 #include "Marker.h"
@@ -55,7 +56,17 @@ static const _AFfilesetup _af_default_file_setup =
 	1,		/* instrumentCount */
 	NULL,		/* instruments */
 	0,		/* miscellaneousCount */
-	NULL		/* miscellaneous */
+	NULL,		/* miscellaneous */
+	false,		/* fileFormatSet */
+	false,		/* memoryMap */
+	AF_MMAP_NORMAL,	/* memoryMapHints */
+	BufferedFile::kDefaultBufferSize,	/* bufferSize */
+	false,		/* writeBehind */
+	AF_WRITE_NORMAL,	/* writePolicy */
+	false,		/* streaming */
+	false,		/* seekIndex */
+	NULL,		/* seekIndexPath */
+	0		/* seekIndexInterval */
 };
 
 static const InstrumentSetup _af_default_instrumentsetup =
@@ -89,6 +100,7 @@ static const TrackSetup _af_default_tracksetup =
 	false,		/* markersSet */
 	false,		/* dataOffsetSet */
 	false,		/* frameCountSet */
+	false,		/* peaksSet */
 
 	4,		/* markerCount */
 	NULL,		/* markers */
@@ -278,6 +290,8 @@ void afFreeFileSetup (AFfilesetup setup)
 		setup->miscellaneousCount = 0;
 	}
 
+	free(setup->seekIndexPath);
+
 	memset(setup, 0, sizeof (_AFfilesetup));
 	free(setup);
 }
@@ -303,6 +317,110 @@ void afInitFileFormat (AFfilesetup setup, int filefmt)
 	}
 
 	setup->fileFormat = filefmt;
+	setup->fileFormatSet = true;
+}
+
+void afInitMemoryMap (AFfilesetup setup, int enable, int hints)
+{
+	if (!_af_filesetup_ok(setup))
+		return;
+
+	setup->memoryMap = enable != 0;
+	setup->memoryMapHints = hints;
+}
+
+void afInitBufferSize (AFfilesetup setup, int bufferSize)
+{
+	if (!_af_filesetup_ok(setup))
+		return;
+
+	if (bufferSize < 0)
+	{
+		_af_error(AF_BAD_FILESETUP, "invalid buffer size %d", bufferSize);
+		return;
+	}
+
+	setup->bufferSize = bufferSize;
+}
+
+void afInitWriteBehind (AFfilesetup setup, int enable)
+{
+	if (!_af_filesetup_ok(setup))
+		return;
+
+	setup->writeBehind = enable != 0;
+}
+
+void afInitWritePolicy (AFfilesetup setup, int policy)
+{
+	if (!_af_filesetup_ok(setup))
+		return;
+
+	const int allPolicies = AF_WRITE_PREALLOCATE | AF_WRITE_DIRECT |
+		AF_WRITE_SYNC_ON_CLOSE | AF_WRITE_SYNC_ALWAYS;
+	if (policy & ~allPolicies)
+	{
+		_af_error(AF_BAD_FILESETUP, "invalid write policy %d", policy);
+		return;
+	}
+
+	setup->writePolicy = policy;
+}
+
+void afInitStreaming (AFfilesetup setup, int enable)
+{
+	if (!_af_filesetup_ok(setup))
+		return;
+
+	setup->streaming = enable != 0;
+}
+
+void afInitSeekIndex (AFfilesetup setup, int enable, const char *path,
+	AFframecount interval)
+{
+	if (!_af_filesetup_ok(setup))
+		return;
+
+	if (interval < 0)
+	{
+		_af_error(AF_BAD_FILESETUP, "invalid seek index interval %jd",
+			static_cast<intmax_t>(interval));
+		return;
+	}
+
+	char *pathCopy = NULL;
+	if (path && !(pathCopy = _af_strdup(path)))
+		return;
+
+	free(setup->seekIndexPath);
+	setup->seekIndex = enable != 0;
+	setup->seekIndexPath = pathCopy;
+	setup->seekIndexInterval = interval;
+}
+
+/*
+	Return true if the setup says anything about the audio data itself,
+	as opposed to only how the file should be accessed.
+*/
+bool _af_setup_describes_format (const _AFfilesetup *setup)
+{
+	if (setup->fileFormatSet || setup->trackSet ||
+		setup->instrumentSet || setup->miscellaneousSet)
+		return true;
+
+	for (int i=0; i<setup->trackCount; i++)
+	{
+		const TrackSetup &track = setup->tracks[i];
+		if (track.rateSet || track.sampleFormatSet ||
+			track.sampleWidthSet || track.byteOrderSet ||
+			track.channelCountSet || track.compressionSet ||
+			track.aesDataSet || track.markersSet ||
+			track.dataOffsetSet || track.frameCountSet ||
+			track.peaksSet)
+			return true;
+	}
+
+	return false;
 }
 
 void afInitChannels (AFfilesetup setup, int trackid, int channels)
@@ -452,6 +570,10 @@ AFfilesetup _af_filesetup_copy (const _AFfilesetup *setup,
 	newsetup->tracks = NULL;
 	newsetup->instruments = NULL;
 	newsetup->miscellaneous = NULL;
+	newsetup->seekIndexPath = NULL;
+	if (defaultSetup->seekIndexPath &&
+		!(newsetup->seekIndexPath = _af_strdup(defaultSetup->seekIndexPath)))
+		goto fail;
 
 	/* Copy tracks. */
 	trackCount = setup->trackSet ? setup->trackCount :
@@ -512,6 +634,7 @@ AFfilesetup _af_filesetup_copy (const _AFfilesetup *setup,
 	return newsetup;
 
 	fail:
+		free(newsetup->seekIndexPath);
 		if (newsetup->miscellaneous)
 			free(newsetup->miscellaneous);
 		if (newsetup->instruments)
@@ -44,6 +44,21 @@ struct _AFfilesetup
 	int miscellaneousCount;
 	MiscellaneousSetup *miscellaneous;
 
+	bool fileFormatSet;
+
+	bool memoryMap;
+	int memoryMapHints;
+
+	int bufferSize;
+	bool writeBehind;
+	int writePolicy;
+
+	bool streaming;
+
+	bool seekIndex;
+	char *seekIndexPath;
+	AFframecount seekIndexInterval;
+
 	TrackSetup *getTrack(int trackID = AF_DEFAULT_TRACK);
 	InstrumentSetup *getInstrument(int instrumentID);
 	MiscellaneousSetup *getMiscellaneous(int miscellaneousID);
@@ -58,4 +73,6 @@ AFfilesetup _af_filesetup_copy (const _AFfilesetup *setup,
 
 InstrumentSetup *_af_instsetup_new (int count);
 
+bool _af_setup_describes_format (const _AFfilesetup *setup);
+
 #endif
@@ -37,8 +37,21 @@ public:
 	Shared() : m_refCount(0)
 	{
 	}
+	/*
+		Reference counts are updated atomically so that objects such
+		as packet tables can be shared by readers on different threads.
+	*/
+#if defined(__GNUC__)
+	void retain() { __sync_add_and_fetch(&m_refCount, 1); }
+	void release()
+	{
+		if (__sync_sub_and_fetch(&m_refCount, 1) == 0)
+			delete static_cast<T *>(this);
+	}
+#else
 	void retain() { m_refCount++; }
 	void release() { if (--m_refCount == 0) delete static_cast<T *>(this); }
+#endif
 
 protected:
 	~Shared()
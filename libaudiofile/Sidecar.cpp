@@ -0,0 +1,237 @@
+/*
+	Audio File Library
+
+	This library is free software; you can redistribute it and/or
+	modify it under the terms of the GNU Lesser General Public
+	License as published by the Free Software Foundation; either
+	version 2.1 of the License, or (at your option) any later version.
+
+	This library is distributed in the hope that it will be useful,
+	but WITHOUT ANY WARRANTY; without even the implied warranty of
+	MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+	Lesser General Public License for more details.
+
+	You should have received a copy of the GNU Lesser General Public
+	License along with this library; if not, write to the
+	Free Software Foundation, Inc., 51 Franklin Street, Fifth Floor,
+	Boston, MA  02110-1301  USA
+*/
+
+/*
+	Sidecar.cpp
+
+	This file contains routines for reading and writing sidecar files,
+	which cache information derived from an audio file, such as its
+	overview or seek index, alongside it.
+*/
+
+#include "config.h"
+#include "Sidecar.h"
+
+#include "File.h"
+#include "byteorder.h"
+
+#include <algorithm>
+#include <stdio.h>
+#include <string.h>
+#include <string>
+#include <sys/stat.h>
+
+// The number of bytes at each end of a file which are hashed.
+static const off_t kHashBytes = 65536;
+
+static const uint64_t kFNVOffsetBasis = 0xcbf29ce484222325ULL;
+static const uint64_t kFNVPrime = 0x100000001b3ULL;
+
+static bool hashRegion(File *fh, off_t offset, off_t length, uint64_t *hash)
+{
+	uint8_t buffer[4096];
+	while (length > 0)
+	{
+		size_t n = std::min<off_t>(length, sizeof (buffer));
+		ssize_t result = fh->readAt(buffer, n, offset);
+		if (result < 0)
+		{
+			// Fall back to reading at the current position.
+			off_t position = fh->tell();
+			if (position < 0 || fh->seek(offset, File::SeekFromBeginning) != offset)
+				return false;
+			result = fh->read(buffer, n);
+			if (fh->seek(position, File::SeekFromBeginning) != position)
+				return false;
+		}
+		if (result <= 0)
+			return false;
+
+		for (ssize_t i=0; i<result; i++)
+			*hash = (*hash ^ buffer[i]) * kFNVPrime;
+		offset += result;
+		length -= result;
+	}
+	return true;
+}
+
+FileIdentity FileIdentity::of(File *fh)
+{
+	FileIdentity identity;
+	off_t length = fh->length();
+	identity.size = std::max<off_t>(length, 0);
+	identity.modificationTime = 0;
+
+	struct stat st;
+	int fd = fh->descriptor();
+	if (fd != -1 && fstat(fd, &st) == 0)
+		identity.modificationTime = st.st_mtime;
+
+	/*
+		Hash the beginning and the end of the file, which hold its
+		header and any chunks appended after the audio data, so that
+		a file rewritten within the resolution of its modification
+		time is not taken for the file from which a sidecar file was
+		made.  Hashing all of the file would cost as much as most of
+		what sidecar files save.
+	*/
+	uint64_t hash = kFNVOffsetBasis;
+	off_t headLength = std::min(std::max<off_t>(length, 0), kHashBytes);
+	off_t tailOffset = std::max(headLength, length - kHashBytes);
+	if (!hashRegion(fh, 0, headLength, &hash) ||
+		!hashRegion(fh, tailOffset, length - tailOffset, &hash))
+		hash = 0;
+	identity.contentHash = hash;
+
+	return identity;
+}
+
+bool FileIdentity::operator==(const FileIdentity &other) const
+{
+	return size == other.size &&
+		modificationTime == other.modificationTime &&
+		contentHash == other.contentHash;
+}
+
+void SidecarWriter::writeBytes(const void *data, size_t size)
+{
+	const uint8_t *bytes = static_cast<const uint8_t *>(data);
+	m_data.insert(m_data.end(), bytes, bytes + size);
+}
+
+void SidecarWriter::writeU32(uint32_t value)
+{
+	value = hostToLittle(value);
+	writeBytes(&value, sizeof (value));
+}
+
+void SidecarWriter::writeU64(uint64_t value)
+{
+	value = hostToLittle(value);
+	writeBytes(&value, sizeof (value));
+}
+
+void SidecarWriter::writeFloat(float value)
+{
+	uint32_t bits;
+	memcpy(&bits, &value, sizeof (bits));
+	writeU32(bits);
+}
+
+void SidecarWriter::writeIdentity(const FileIdentity &identity)
+{
+	writeU64(identity.size);
+	writeU64(identity.modificationTime);
+	writeU64(identity.contentHash);
+}
+
+status SidecarWriter::save(const char *path) const
+{
+	std::string temporaryPath = std::string(path) + ".tmp";
+	File *fh = File::open(temporaryPath.c_str(), File::WriteAccess);
+	if (!fh)
+		return AF_FAIL;
+
+	bool ok = m_data.empty() || fh->write(&m_data[0], m_data.size()) ==
+		static_cast<ssize_t>(m_data.size());
+	ok = fh->close() == 0 && ok;
+	delete fh;
+
+	if (!ok || rename(temporaryPath.c_str(), path) != 0)
+	{
+		remove(temporaryPath.c_str());
+		return AF_FAIL;
+	}
+
+	return AF_SUCCEED;
+}
+
+SidecarReader::SidecarReader() :
+	m_offset(0)
+{
+}
+
+status SidecarReader::load(const char *path)
+{
+	m_data.clear();
+	m_offset = 0;
+
+	File *fh = File::open(path, File::ReadAccess);
+	if (!fh)
+		return AF_FAIL;
+
+	off_t length = fh->length();
+	bool ok = length >= 0;
+	if (length > 0)
+	{
+		m_data.resize(length);
+		ok = fh->read(&m_data[0], length) == length;
+	}
+	fh->close();
+	delete fh;
+
+	if (!ok)
+		m_data.clear();
+	return ok ? AF_SUCCEED : AF_FAIL;
+}
+
+bool SidecarReader::readBytes(void *data, size_t size)
+{
+	if (size > remaining())
+		return false;
+	memcpy(data, &m_data[m_offset], size);
+	m_offset += size;
+	return true;
+}
+
+bool SidecarReader::readU32(uint32_t *value)
+{
+	if (!readBytes(value, sizeof (*value)))
+		return false;
+	*value = littleToHost(*value);
+	return true;
+}
+
+bool SidecarReader::readU64(uint64_t *value)
+{
+	if (!readBytes(value, sizeof (*value)))
+		return false;
+	*value = littleToHost(*value);
+	return true;
+}
+
+bool SidecarReader::readFloat(float *value)
+{
+	uint32_t bits;
+	if (!readU32(&bits))
+		return false;
+	memcpy(value, &bits, sizeof (bits));
+	return true;
+}
+
+bool SidecarReader::readIdentity(FileIdentity *identity)
+{
+	uint64_t modificationTime;
+	if (!readU64(&identity->size) ||
+		!readU64(&modificationTime) ||
+		!readU64(&identity->contentHash))
+		return false;
+	identity->modificationTime = modificationTime;
+	return true;
+}
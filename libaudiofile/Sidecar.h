@@ -0,0 +1,94 @@
+/*
+	Audio File Library
+
+	This library is free software; you can redistribute it and/or
+	modify it under the terms of the GNU Lesser General Public
+	License as published by the Free Software Foundation; either
+	version 2.1 of the License, or (at your option) any later version.
+
+	This library is distributed in the hope that it will be useful,
+	but WITHOUT ANY WARRANTY; without even the implied warranty of
+	MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+	Lesser General Public License for more details.
+
+	You should have received a copy of the GNU Lesser General Public
+	License along with this library; if not, write to the
+	Free Software Foundation, Inc., 51 Franklin Street, Fifth Floor,
+	Boston, MA  02110-1301  USA
+*/
+
+#ifndef SIDECAR_H
+#define SIDECAR_H
+
+#include "afinternal.h"
+
+#include <stdint.h>
+#include <sys/types.h>
+#include <vector>
+
+class File;
+
+/*
+	What a sidecar file was made from.  A sidecar file is used only
+	if the audio file still has the same identity.
+*/
+struct FileIdentity
+{
+	uint64_t size;
+	int64_t modificationTime;
+	uint64_t contentHash;
+
+	static FileIdentity of(File *file);
+
+	bool operator==(const FileIdentity &) const;
+};
+
+/*
+	SidecarWriter assembles a sidecar file in memory, with all values
+	in little-endian byte order, and saves it in one piece.
+*/
+class SidecarWriter
+{
+public:
+	void writeBytes(const void *data, size_t size);
+	void writeU32(uint32_t value);
+	void writeU64(uint64_t value);
+	void writeFloat(float value);
+	void writeIdentity(const FileIdentity &identity);
+
+	/*
+		Save to path, replacing any file there, through a temporary
+		file so that a reader never sees a partially written file.
+	*/
+	status save(const char *path) const;
+
+private:
+	std::vector<uint8_t> m_data;
+};
+
+/*
+	SidecarReader reads the values written by SidecarWriter.  Each
+	read fails once the end of the file has been reached.
+*/
+class SidecarReader
+{
+public:
+	SidecarReader();
+
+	// Read the whole file at path.
+	status load(const char *path);
+
+	bool readBytes(void *data, size_t size);
+	bool readU32(uint32_t *value);
+	bool readU64(uint64_t *value);
+	bool readFloat(float *value);
+	bool readIdentity(FileIdentity *identity);
+
+	size_t remaining() const { return m_data.size() - m_offset; }
+
+private:
+	std::vector<uint8_t> m_data;
+	size_t m_offset;
+};
+
+#endif
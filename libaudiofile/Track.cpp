@@ -38,6 +38,8 @@
 #include "util.h"
 #include "Marker.h"
 #include "PacketTable.h"
+#include "ReaderPool.h"
+#include "SeekIndex.h"
 #include "modules/Module.h"
 #include "modules/ModuleState.h"
 
@@ -74,6 +76,8 @@ Track::Track()
 	hasAESData = false;
 	memset(aesData, 0, 24);
 
+	computesPeaks = false;
+
 	totalfframes = 0;
 	nextfframe = 0;
 	frames2ignore = 0;
@@ -83,6 +87,10 @@ Track::Track()
 	totalvframes = 0;
 	nextvframe = 0;
 	data_size = 0;
+	fpos_dropped = 0;
+	fpos_prefetched = 0;
+
+	readerPool = NULL;
 }
 
 Track::~Track()
@@ -99,6 +107,9 @@ Track::~Track()
 		v.compressionParams = NULL;
 	}
 
+	delete readerPool;
+	readerPool = NULL;
+
 	free(channelMatrix);
 	channelMatrix = NULL;
 
@@ -172,6 +183,15 @@ status Track::copyMarkers(TrackSetup *setup)
 
 void Track::computeTotalFileFrames()
 {
-	if (f.bytesPerPacket && f.framesPerPacket)
+	// The amount of sound data in a non-seekable file may be unknown.
+	if (data_size == -1)
+		totalfframes = -1;
+	else if (f.bytesPerPacket && f.framesPerPacket)
 		totalfframes = (data_size / f.bytesPerPacket) * f.framesPerPacket;
 }
+
+void Track::discardPeaks()
+{
+	peaks.clear();
+	computesPeaks = false;
+}
@@ -26,11 +26,16 @@
 #define TRACK_H
 
 #include "AudioFormat.h"
+#include "Peak.h"
 #include "Shared.h"
 #include "afinternal.h"
 
+#include <vector>
+
 class ModuleState;
 class PacketTable;
+class ReaderPool;
+class SeekIndex;
 struct Marker;
 struct MarkerSetup;
 
@@ -42,7 +47,7 @@ struct TrackSetup
 
 	bool rateSet, sampleFormatSet, sampleWidthSet, byteOrderSet,
 		channelCountSet, compressionSet, aesDataSet, markersSet,
-		dataOffsetSet, frameCountSet;
+		dataOffsetSet, frameCountSet, peaksSet;
 
 	int markerCount;
 	MarkerSetup *markers;
@@ -62,6 +67,12 @@ struct Track
 
 	SharedPtr<PacketTable> m_packetTable;
 
+	/*
+		Restart points recorded while the track is decoded, or
+		NULL if the file was not opened with a seek index.
+	*/
+	SharedPtr<SeekIndex> seekIndex;
+
 	double *channelMatrix;
 
 	int markerCount;
@@ -70,6 +81,15 @@ struct Track
 	bool hasAESData;	/* Is AES nonaudio data present? */
 	unsigned char aesData[24];	/* AES nonaudio data */
 
+	/*
+		Peak of each channel of the file format, or empty if the
+		peaks are not known.  While frames are written, computesPeaks
+		is set and the peaks are updated with each frame written.
+		Rewriting frames before the end of the track discards them.
+	*/
+	std::vector<Peak> peaks;
+	bool computesPeaks;
+
 	AFframecount totalfframes;		/* frameCount */
 	AFframecount nextfframe;		/* currentFrame */
 	AFframecount frames2ignore;
@@ -80,8 +100,18 @@ struct Track
 	AFframecount nextvframe;
 	AFfileoffset data_size;		/* trackBytes */
 
+	/*
+		End of the sound data dropped from the page cache behind
+		the position of the track, and end of the data prefetched
+		ahead of it; see afSetAccessHint().
+	*/
+	AFfileoffset fpos_dropped, fpos_prefetched;
+
 	SharedPtr<ModuleState> ms;
 
+	/* readers for afReadFramesAt(), NULL if not supported */
+	ReaderPool *readerPool;
+
 	double taper, dynamic_range;
 	bool ratecvt_filter_params_set;
 
@@ -93,6 +123,8 @@ struct Track
 	status copyMarkers(TrackSetup *setup);
 
 	void computeTotalFileFrames();
+	// Forget the peaks, which no longer describe the audio data.
+	void discardPeaks();
 };
 
 #endif
@@ -0,0 +1,332 @@
+/*
+	Audio File Library
+
+	This library is free software; you can redistribute it and/or
+	modify it under the terms of the GNU Lesser General Public
+	License as published by the Free Software Foundation; either
+	version 2.1 of the License, or (at your option) any later version.
+
+	This library is distributed in the hope that it will be useful,
+	but WITHOUT ANY WARRANTY; without even the implied warranty of
+	MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+	Lesser General Public License for more details.
+
+	You should have received a copy of the GNU Lesser General Public
+	License along with this library; if not, write to the
+	Free Software Foundation, Inc., 51 Franklin Street, Fifth Floor,
+	Boston, MA  02110-1301  USA
+*/
+
+#include "config.h"
+
+#include <gtest/gtest.h>
+#include <algorithm>
+#include <errno.h>
+#include <fcntl.h>
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <vector>
+
+#include "BufferedFile.h"
+
+static int createTemporaryFile()
+{
+	char path[] = "/tmp/UT_BufferedFile-XXXXXX";
+	int fd = ::mkstemp(path);
+	if (fd != -1)
+		::unlink(path);
+	return fd;
+}
+
+/*
+	Apply a pseudo-random mix of reads, writes and seeks to a buffered
+	file and to an in-memory model, checking that they agree.
+*/
+static void testRandomAccess(size_t bufferSize, bool writeBehind = false)
+{
+	int fd = createTemporaryFile();
+	ASSERT_NE(-1, fd);
+
+	BufferedFile *file = new BufferedFile(File::create(fd, File::WriteAccess),
+		bufferSize, writeBehind);
+	std::vector<uint8_t> model;
+	off_t position = 0;
+
+	srand(1);
+	for (int i=0; i<2000; i++)
+	{
+		int operation = rand() % 3;
+		size_t size = rand() % (3 * bufferSize + 2);
+		if (operation == 0)
+		{
+			std::vector<uint8_t> data(size);
+			for (size_t j=0; j<size; j++)
+				data[j] = rand();
+			ASSERT_EQ(static_cast<ssize_t>(size),
+				file->write(size ? &data[0] : NULL, size));
+			if (position + size > model.size())
+				model.resize(position + size);
+			if (size)
+				memcpy(&model[position], &data[0], size);
+			position += size;
+		}
+		else if (operation == 1)
+		{
+			std::vector<uint8_t> data(size + 1);
+			ssize_t expected = 0;
+			if (position < static_cast<off_t>(model.size()))
+				expected = std::min<off_t>(size, model.size() - position);
+			ASSERT_EQ(expected, file->read(&data[0], size));
+			if (expected)
+				EXPECT_EQ(0, memcmp(&model[position], &data[0], expected));
+			position += expected;
+		}
+		else
+		{
+			off_t offset = model.empty() ? 0 : rand() % model.size();
+			ASSERT_EQ(offset, file->seek(offset, File::SeekFromBeginning));
+			position = offset;
+		}
+		ASSERT_EQ(position, file->tell());
+		ASSERT_EQ(static_cast<off_t>(model.size()), file->length());
+	}
+
+	ASSERT_EQ(0, file->flush());
+
+	// The underlying file must match the model once flushed.
+	std::vector<uint8_t> contents(model.size());
+	ASSERT_EQ(static_cast<ssize_t>(model.size()),
+		::pread(fd, contents.empty() ? NULL : &contents[0], contents.size(), 0));
+	EXPECT_TRUE(contents == model);
+
+	delete file;
+}
+
+TEST(BufferedFile, RandomAccess)
+{
+	testRandomAccess(1);
+	testRandomAccess(7);
+	testRandomAccess(64);
+	testRandomAccess(4096);
+}
+
+TEST(BufferedFile, RandomAccess_WriteBehind)
+{
+	testRandomAccess(1, true);
+	testRandomAccess(7, true);
+	testRandomAccess(64, true);
+	testRandomAccess(4096, true);
+}
+
+/*
+	RecordingFile keeps its contents in memory and records the offset
+	and size of each write.  Writes fail once failAfter bytes have
+	been written.
+*/
+class RecordingFile : public File
+{
+public:
+	struct Write
+	{
+		off_t offset;
+		size_t size;
+	};
+
+	RecordingFile(std::vector<uint8_t> *data, std::vector<Write> *writes,
+		size_t failAfter) :
+		File(WriteAccess),
+		m_data(data),
+		m_writes(writes),
+		m_position(0),
+		m_bytesWritten(0),
+		m_failAfter(failAfter)
+	{
+	}
+
+	virtual int close() { return 0; }
+	virtual ssize_t read(void *, size_t) { return -1; }
+	virtual ssize_t write(const void *data, size_t nbytes)
+	{
+		if (m_bytesWritten + nbytes > m_failAfter)
+		{
+			errno = ENOSPC;
+			return -1;
+		}
+		Write w = { m_position, nbytes };
+		m_writes->push_back(w);
+		if (m_position + nbytes > m_data->size())
+			m_data->resize(m_position + nbytes);
+		memcpy(&(*m_data)[m_position], data, nbytes);
+		m_position += nbytes;
+		m_bytesWritten += nbytes;
+		return nbytes;
+	}
+	virtual off_t length() { return m_data->size(); }
+	virtual off_t seek(off_t offset, SeekOrigin origin)
+	{
+		EXPECT_EQ(SeekFromBeginning, origin);
+		m_position = offset;
+		return offset;
+	}
+	virtual off_t tell() { return m_position; }
+
+private:
+	std::vector<uint8_t> *m_data;
+	std::vector<Write> *m_writes;
+	off_t m_position;
+	size_t m_bytesWritten;
+	size_t m_failAfter;
+};
+
+static void testAlignedWrites(bool writeBehind)
+{
+	const size_t kBufferSize = 3 * BufferedFile::kWriteAlignment;
+	std::vector<uint8_t> data;
+	std::vector<RecordingFile::Write> writes;
+	BufferedFile *file = new BufferedFile(
+		new RecordingFile(&data, &writes, 1000000), kBufferSize, writeBehind);
+
+	std::vector<uint8_t> model;
+	uint8_t header[44];
+	for (size_t i=0; i<sizeof (header); i++)
+		header[i] = i;
+	ASSERT_EQ(44, file->write(header, sizeof (header)));
+	model.insert(model.end(), header, header + sizeof (header));
+	for (int i=0; i<200; i++)
+	{
+		uint8_t block[300];
+		for (size_t j=0; j<sizeof (block); j++)
+			block[j] = i + j;
+		ASSERT_EQ(300, file->write(block, sizeof (block)));
+		model.insert(model.end(), block, block + sizeof (block));
+	}
+	ASSERT_EQ(0, file->flush());
+	EXPECT_TRUE(data == model);
+
+	// Every write but the last ends at a multiple of kWriteAlignment.
+	ASSERT_GT(writes.size(), 2u);
+	for (size_t i=0; i<writes.size() - 1; i++)
+	{
+		EXPECT_EQ(0, (writes[i].offset + writes[i].size) %
+			BufferedFile::kWriteAlignment);
+		EXPECT_LE(writes[i].size, kBufferSize);
+	}
+	EXPECT_EQ(model.size(), writes.back().offset + writes.back().size);
+
+	delete file;
+}
+
+TEST(BufferedFile, AlignedWrites)
+{
+	testAlignedWrites(false);
+}
+
+TEST(BufferedFile, AlignedWrites_WriteBehind)
+{
+	testAlignedWrites(true);
+}
+
+/*
+	A buffer which the flusher thread fails to write is reported by a
+	later write or flush.
+*/
+TEST(BufferedFile, WriteBehindError)
+{
+	const size_t kBufferSize = BufferedFile::kWriteAlignment;
+	std::vector<uint8_t> data;
+	std::vector<RecordingFile::Write> writes;
+	BufferedFile *file = new BufferedFile(
+		new RecordingFile(&data, &writes, 2 * kBufferSize), kBufferSize, true);
+
+	std::vector<uint8_t> block(kBufferSize / 2);
+	ssize_t result = block.size();
+	int i;
+	int error = 0;
+	for (i=0; i<20 && result == static_cast<ssize_t>(block.size()); i++)
+	{
+		result = file->write(&block[0], block.size());
+		error = errno;
+	}
+	EXPECT_EQ(-1, result);
+	EXPECT_LT(i, 20);
+	EXPECT_EQ(ENOSPC, error);
+	EXPECT_EQ(-1, file->flush());
+
+	delete file;
+}
+
+TEST(BufferedFile, SeekWithinBuffer)
+{
+	int fd = createTemporaryFile();
+	ASSERT_NE(-1, fd);
+
+	uint8_t data[256];
+	for (int i=0; i<256; i++)
+		data[i] = i;
+	ASSERT_EQ(256, ::write(fd, data, 256));
+	ASSERT_EQ(0, ::lseek(fd, 0, SEEK_SET));
+
+	BufferedFile file(File::create(fd, File::ReadAccess), 64);
+	uint8_t value;
+	ASSERT_EQ(1, file.read(&value, 1));
+	EXPECT_EQ(0, value);
+
+	// Move the descriptor behind the buffer's back: seeks and reads
+	// which stay within the buffer must not touch it.
+	ASSERT_EQ(200, ::lseek(fd, 200, SEEK_SET));
+	ASSERT_EQ(40, file.seek(40, File::SeekFromBeginning));
+	ASSERT_EQ(1, file.read(&value, 1));
+	EXPECT_EQ(40, value);
+	ASSERT_EQ(10, file.seek(10, File::SeekFromBeginning));
+	ASSERT_EQ(1, file.read(&value, 1));
+	EXPECT_EQ(10, value);
+	const void *borrowed;
+	ASSERT_EQ(16, file.borrow(32, 16, &borrowed));
+	EXPECT_EQ(0, memcmp(borrowed, data + 32, 16));
+	EXPECT_EQ(-1, file.borrow(60, 16, &borrowed));
+	EXPECT_EQ(200, ::lseek(fd, 0, SEEK_CUR));
+}
+
+TEST(BufferedFile, ForwardOnly)
+{
+	int fds[2];
+	ASSERT_EQ(0, ::pipe(fds));
+
+	uint8_t data[256];
+	for (int i=0; i<256; i++)
+		data[i] = i;
+	ASSERT_EQ(256, ::write(fds[1], data, 256));
+	::close(fds[1]);
+
+	BufferedFile file(File::create(fds[0], File::ReadAccess), 64);
+	EXPECT_FALSE(file.canSeek());
+	EXPECT_EQ(-1, file.length());
+	EXPECT_EQ(0, file.tell());
+
+	// Data which is still buffered can be read again.
+	uint8_t header[12];
+	ASSERT_EQ(12, file.read(header, 12));
+	ASSERT_EQ(0, file.seek(0, File::SeekFromBeginning));
+	ASSERT_EQ(12, file.read(header, 12));
+	EXPECT_EQ(0, memcmp(header, data, 12));
+
+	// Seeking ahead skips data.
+	uint8_t value;
+	ASSERT_EQ(150, file.seek(150, File::SeekFromBeginning));
+	ASSERT_EQ(1, file.read(&value, 1));
+	EXPECT_EQ(150, value);
+	EXPECT_EQ(151, file.tell());
+
+	// Data which has been discarded cannot be returned to.
+	EXPECT_EQ(-1, file.seek(10, File::SeekFromBeginning));
+	EXPECT_EQ(-1, file.seek(0, File::SeekFromEnd));
+	ASSERT_EQ(160, file.seek(160, File::SeekFromBeginning));
+	ASSERT_EQ(1, file.read(&value, 1));
+	EXPECT_EQ(160, value);
+
+	uint8_t rest[256];
+	EXPECT_EQ(95, file.read(rest, sizeof (rest)));
+	EXPECT_EQ(0, memcmp(rest, data + 161, 95));
+}
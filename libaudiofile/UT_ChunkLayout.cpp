@@ -0,0 +1,117 @@
+/*
+	Audio File Library
+
+	This library is free software; you can redistribute it and/or
+	modify it under the terms of the GNU Lesser General Public
+	License as published by the Free Software Foundation; either
+	version 2.1 of the License, or (at your option) any later version.
+
+	This library is distributed in the hope that it will be useful,
+	but WITHOUT ANY WARRANTY; without even the implied warranty of
+	MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+	Lesser General Public License for more details.
+
+	You should have received a copy of the GNU Lesser General Public
+	License along with this library; if not, write to the
+	Free Software Foundation, Inc., 51 Franklin Street, Fifth Floor,
+	Boston, MA  02110-1301  USA
+*/
+
+
+#include "config.h"
+
+#include <gtest/gtest.h>
+#include <vector>
+
+#include "ChunkLayout.h"
+
+static std::vector<ChunkLayout::Extent> chunks(AFfileoffset offset,
+	AFfileoffset length)
+{
+	ChunkLayout::Extent extent = { offset, length, false };
+	return std::vector<ChunkLayout::Extent>(1, extent);
+}
+
+TEST(ChunkLayout, SameLength)
+{
+	ChunkLayout layout;
+	AFfileoffset fileLength = 1000;
+	std::vector<ChunkLayout::Extent> old = chunks(100, 40);
+	EXPECT_EQ(100, layout.place(&old, 40, &fileLength));
+	EXPECT_EQ(1000, fileLength);
+	ASSERT_EQ(1u, old.size());
+	EXPECT_EQ(100, old[0].offset);
+	EXPECT_EQ(40, old[0].length);
+	EXPECT_TRUE(layout.takeChanged().empty());
+}
+
+TEST(ChunkLayout, ShrinkLeavesFreeChunk)
+{
+	ChunkLayout layout;
+	AFfileoffset fileLength = 1000;
+	std::vector<ChunkLayout::Extent> old = chunks(100, 40);
+	EXPECT_EQ(100, layout.place(&old, 24, &fileLength));
+	std::vector<ChunkLayout::Extent> changed = layout.takeChanged();
+	ASSERT_EQ(1u, changed.size());
+	EXPECT_EQ(124, changed[0].offset);
+	EXPECT_EQ(16, changed[0].length);
+	EXPECT_TRUE(layout.takeChanged().empty());
+}
+
+TEST(ChunkLayout, GrowIntoAdjoiningFreeChunk)
+{
+	ChunkLayout layout;
+	layout.addFree(140, 64);
+	AFfileoffset fileLength = 1000;
+	std::vector<ChunkLayout::Extent> old = chunks(100, 40);
+	EXPECT_EQ(100, layout.place(&old, 80, &fileLength));
+	EXPECT_EQ(1000, fileLength);
+	std::vector<ChunkLayout::Extent> changed = layout.takeChanged();
+	ASSERT_EQ(1u, changed.size());
+	EXPECT_EQ(180, changed[0].offset);
+	EXPECT_EQ(24, changed[0].length);
+}
+
+// A remainder too small for a free chunk header cannot be left behind.
+TEST(ChunkLayout, MoveToEnd)
+{
+	ChunkLayout layout;
+	AFfileoffset fileLength = 1001;
+	std::vector<ChunkLayout::Extent> old = chunks(100, 40);
+	EXPECT_EQ(1002, layout.place(&old, 36, &fileLength));
+	EXPECT_EQ(1038, fileLength);
+	ASSERT_EQ(1u, layout.freeExtents().size());
+	std::vector<ChunkLayout::Extent> changed = layout.takeChanged();
+	ASSERT_EQ(1u, changed.size());
+	EXPECT_EQ(100, changed[0].offset);
+	EXPECT_EQ(40, changed[0].length);
+}
+
+TEST(ChunkLayout, GrowAtEndOfFile)
+{
+	ChunkLayout layout;
+	AFfileoffset fileLength = 140;
+	std::vector<ChunkLayout::Extent> old = chunks(100, 40);
+	EXPECT_EQ(100, layout.place(&old, 60, &fileLength));
+	EXPECT_EQ(160, fileLength);
+	EXPECT_TRUE(layout.freeExtents().empty());
+}
+
+// Chunks placed one after another share the free space.
+TEST(ChunkLayout, SeveralChunks)
+{
+	ChunkLayout layout;
+	layout.addFree(200, 100);
+	AFfileoffset fileLength = 1000;
+	std::vector<ChunkLayout::Extent> first = chunks(100, 40);
+	std::vector<ChunkLayout::Extent> second = chunks(140, 60);
+	EXPECT_EQ(200, layout.place(&first, 48, &fileLength));
+	EXPECT_EQ(100, layout.place(&second, 80, &fileLength));
+	std::vector<ChunkLayout::Extent> changed = layout.takeChanged();
+	ASSERT_EQ(2u, changed.size());
+	EXPECT_EQ(180, changed[0].offset);
+	EXPECT_EQ(20, changed[0].length);
+	EXPECT_EQ(248, changed[1].offset);
+	EXPECT_EQ(52, changed[1].length);
+	EXPECT_EQ(1000, fileLength);
+}
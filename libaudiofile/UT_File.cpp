@@ -0,0 +1,215 @@
+/*
+	Audio File Library
+
+	This library is free software; you can redistribute it and/or
+	modify it under the terms of the GNU Lesser General Public
+	License as published by the Free Software Foundation; either
+	version 2.1 of the License, or (at your option) any later version.
+
+	This library is distributed in the hope that it will be useful,
+	but WITHOUT ANY WARRANTY; without even the implied warranty of
+	MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+	Lesser General Public License for more details.
+
+	You should have received a copy of the GNU Lesser General Public
+	License along with this library; if not, write to the
+	Free Software Foundation, Inc., 51 Franklin Street, Fifth Floor,
+	Boston, MA  02110-1301  USA
+*/
+
+#include "config.h"
+
+#include <gtest/gtest.h>
+#include <fcntl.h>
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <vector>
+
+#include "BufferedFile.h"
+#include "File.h"
+
+static int createTemporaryFile(int flags)
+{
+	char path[] = "/tmp/UT_File-XXXXXX";
+	int fd = ::mkstemp(path);
+	if (fd == -1)
+		return -1;
+	::close(fd);
+	fd = ::open(path, O_RDWR | flags);
+	::unlink(path);
+	return fd;
+}
+
+TEST(File, TracksOffset)
+{
+	int fd = createTemporaryFile(0);
+	ASSERT_NE(-1, fd);
+
+	File *file = File::create(fd, File::WriteAccess);
+	uint8_t data[100];
+	for (int i=0; i<100; i++)
+		data[i] = i;
+	ASSERT_EQ(100, file->write(data, 100));
+	EXPECT_EQ(100, file->tell());
+	EXPECT_EQ(100, file->length());
+
+	EXPECT_EQ(10, file->seek(10, File::SeekFromBeginning));
+	EXPECT_EQ(15, file->seek(5, File::SeekFromCurrent));
+	EXPECT_EQ(90, file->seek(-10, File::SeekFromEnd));
+	EXPECT_EQ(-1, file->seek(-1, File::SeekFromBeginning));
+	EXPECT_EQ(90, file->tell());
+
+	uint8_t value;
+	ASSERT_EQ(1, file->read(&value, 1));
+	EXPECT_EQ(90, value);
+	EXPECT_EQ(91, file->tell());
+
+	// Writing past the end extends the file.
+	ASSERT_EQ(120, file->seek(120, File::SeekFromBeginning));
+	ASSERT_EQ(1, file->write(&value, 1));
+	EXPECT_EQ(121, file->length());
+	ASSERT_EQ(0, file->seek(0, File::SeekFromBeginning));
+	ASSERT_EQ(1, file->read(&value, 1));
+	EXPECT_EQ(0, value);
+
+	delete file;
+}
+
+TEST(File, StartsAtDescriptorOffset)
+{
+	int fd = createTemporaryFile(0);
+	ASSERT_NE(-1, fd);
+
+	const char data[] = "0123456789";
+	ASSERT_EQ(10, ::write(fd, data, 10));
+	ASSERT_EQ(4, ::lseek(fd, 4, SEEK_SET));
+
+	File *file = File::create(fd, File::ReadAccess);
+	EXPECT_EQ(4, file->tell());
+	char c;
+	ASSERT_EQ(1, file->read(&c, 1));
+	EXPECT_EQ('4', c);
+	delete file;
+}
+
+TEST(File, Append)
+{
+	int fd = createTemporaryFile(O_APPEND);
+	ASSERT_NE(-1, fd);
+
+	File *file = File::create(fd, File::WriteAccess);
+	ASSERT_EQ(4, file->write("abcd", 4));
+	ASSERT_EQ(0, file->seek(0, File::SeekFromBeginning));
+	ASSERT_EQ(2, file->write("ef", 2));
+	EXPECT_EQ(6, file->tell());
+	EXPECT_EQ(6, file->length());
+	delete file;
+}
+
+TEST(File, Pipe)
+{
+	int fds[2];
+	ASSERT_EQ(0, ::pipe(fds));
+
+	File *reader = File::create(fds[0], File::ReadAccess);
+	File *writer = File::create(fds[1], File::WriteAccess);
+	EXPECT_FALSE(reader->canSeek());
+	EXPECT_FALSE(writer->canSeek());
+	EXPECT_EQ(-1, writer->length());
+
+	ASSERT_EQ(3, writer->write("xyz", 3));
+	char data[3];
+	ASSERT_EQ(3, reader->read(data, 3));
+	EXPECT_EQ(0, memcmp(data, "xyz", 3));
+
+	delete writer;
+	delete reader;
+}
+
+TEST(File, MemoryRead)
+{
+	const char data[] = "0123456789";
+	File *file = File::createMemory(data, 10, File::ReadAccess);
+	ASSERT_TRUE(file);
+	EXPECT_TRUE(file->canSeek());
+	EXPECT_EQ(10, file->length());
+
+	// Data is lent in place.
+	const void *borrowed;
+	ASSERT_EQ(4, file->borrow(6, 100, &borrowed));
+	EXPECT_EQ(data + 6, borrowed);
+
+	char buffer[10];
+	EXPECT_EQ(3, file->seek(3, File::SeekFromBeginning));
+	ASSERT_EQ(7, file->read(buffer, 10));
+	EXPECT_EQ(0, memcmp(buffer, "3456789", 7));
+	EXPECT_EQ(0, file->read(buffer, 10));
+	ASSERT_EQ(2, file->readAt(buffer, 2, 1));
+	EXPECT_EQ(0, memcmp(buffer, "12", 2));
+
+	EXPECT_EQ(-1, file->write("x", 1));
+	size_t size;
+	EXPECT_TRUE(file->releaseContents(&size) == NULL);
+	delete file;
+}
+
+TEST(File, MemoryWrite)
+{
+	File *file = File::createMemory("abc", 3, File::ReadWriteAccess);
+	ASSERT_TRUE(file);
+	EXPECT_EQ(0, file->tell());
+	EXPECT_EQ(3, file->length());
+
+	// The buffer grows, and writing past the end fills the gap with zeros.
+	ASSERT_EQ(1, file->seek(1, File::SeekFromBeginning));
+	ASSERT_EQ(2, file->write("xy", 2));
+	ASSERT_EQ(100000, file->seek(100000, File::SeekFromBeginning));
+	std::vector<uint8_t> data(200000, 7);
+	ASSERT_EQ(200000, file->write(&data[0], data.size()));
+	EXPECT_EQ(300000, file->length());
+
+	size_t size;
+	uint8_t *contents = static_cast<uint8_t *>(file->releaseContents(&size));
+	ASSERT_TRUE(contents);
+	ASSERT_EQ(300000u, size);
+	EXPECT_EQ(0, memcmp(contents, "axy", 3));
+	for (size_t i=3; i<100000; i++)
+		ASSERT_EQ(0, contents[i]) << i;
+	for (size_t i=100000; i<300000; i++)
+		ASSERT_EQ(7, contents[i]) << i;
+	free(contents);
+
+	EXPECT_EQ(0, file->length());
+	delete file;
+}
+
+TEST(File, ViewLendsOnlyUnchangingData)
+{
+	const char data[] = "0123456789";
+	File *file = File::createMemory(data, 10, File::ReadAccess);
+	ASSERT_TRUE(file);
+	EXPECT_TRUE(file->canLend());
+	File *view = File::createView(file);
+	const void *borrowed;
+	ASSERT_EQ(4, view->borrow(6, 4, &borrowed));
+	EXPECT_EQ(data + 6, borrowed);
+	delete view;
+
+	// A buffered file lends its read buffer, which a view must not share.
+	BufferedFile *buffered = new BufferedFile(file, 4);
+	EXPECT_FALSE(buffered->canLend());
+	view = File::createView(buffered);
+	EXPECT_EQ(-1, view->borrow(0, 4, &borrowed));
+	char buffer[4];
+	ASSERT_EQ(4, view->readAt(buffer, 4, 2));
+	EXPECT_EQ(0, memcmp(buffer, "2345", 4));
+	delete view;
+	delete buffered;
+
+	file = File::createMemory(data, 10, File::ReadWriteAccess);
+	ASSERT_TRUE(file);
+	EXPECT_FALSE(file->canLend());
+	delete file;
+}
@@ -0,0 +1,183 @@
+/*
+	Audio File Library
+
+	This library is free software; you can redistribute it and/or
+	modify it under the terms of the GNU Lesser General Public
+	License as published by the Free Software Foundation; either
+	version 2.1 of the License, or (at your option) any later version.
+
+	This library is distributed in the hope that it will be useful,
+	but WITHOUT ANY WARRANTY; without even the implied warranty of
+	MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+	Lesser General Public License for more details.
+
+	You should have received a copy of the GNU Lesser General Public
+	License along with this library; if not, write to the
+	Free Software Foundation, Inc., 51 Franklin Street, Fifth Floor,
+	Boston, MA  02110-1301  USA
+*/
+
+
+#include "config.h"
+
+#include <gtest/gtest.h>
+#include <algorithm>
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <vector>
+
+#include "Compiler.h"
+#include "HeaderFile.h"
+
+static int createTemporaryFile()
+{
+	char path[] = "/tmp/UT_HeaderFile-XXXXXX";
+	int fd = ::mkstemp(path);
+	if (fd != -1)
+		::unlink(path);
+	return fd;
+}
+
+// Forwards to another file and counts the calls to write().
+class CountingFile : public File
+{
+public:
+	CountingFile(File *file) :
+		File(file->accessMode()),
+		m_file(file),
+		m_writeCount(0)
+	{
+	}
+	virtual ~CountingFile() { delete m_file; }
+
+	virtual int close() OVERRIDE { return m_file->close(); }
+	virtual ssize_t read(void *data, size_t nbytes) OVERRIDE
+	{
+		return m_file->read(data, nbytes);
+	}
+	virtual ssize_t write(const void *data, size_t nbytes) OVERRIDE
+	{
+		m_writeCount++;
+		return m_file->write(data, nbytes);
+	}
+	virtual off_t length() OVERRIDE { return m_file->length(); }
+	virtual off_t seek(off_t offset, SeekOrigin origin) OVERRIDE
+	{
+		return m_file->seek(offset, origin);
+	}
+	virtual off_t tell() OVERRIDE { return m_file->tell(); }
+
+	int writeCount() const { return m_writeCount; }
+
+private:
+	File *m_file;
+	int m_writeCount;
+};
+
+/*
+	Apply a pseudo-random mix of reads, writes and seeks to a header
+	file and to an in-memory model, checking that they agree.
+*/
+TEST(HeaderFile, RandomAccess)
+{
+	int fd = createTemporaryFile();
+	ASSERT_NE(-1, fd);
+
+	File *file = File::create(fd, File::WriteAccess);
+	HeaderFile *header = new HeaderFile(file);
+	std::vector<uint8_t> model;
+	off_t position = 0;
+
+	srand(1);
+	for (int i=0; i<2000; i++)
+	{
+		int operation = rand() % 8;
+		size_t size = rand() % 24;
+		if (operation < 5)
+		{
+			std::vector<uint8_t> data(size);
+			for (size_t j=0; j<size; j++)
+				data[j] = rand();
+			ASSERT_EQ(static_cast<ssize_t>(size),
+				header->write(size ? &data[0] : NULL, size));
+			if (position + size > model.size())
+				model.resize(position + size);
+			if (size)
+				memcpy(&model[position], &data[0], size);
+			position += size;
+		}
+		else if (operation == 5)
+		{
+			std::vector<uint8_t> data(size + 1);
+			ssize_t expected = 0;
+			if (position < static_cast<off_t>(model.size()))
+				expected = std::min<off_t>(size, model.size() - position);
+			ASSERT_EQ(expected, header->read(&data[0], size));
+			if (expected)
+				EXPECT_EQ(0, memcmp(&model[position], &data[0], expected));
+			position += expected;
+		}
+		else
+		{
+			off_t offset = rand() % (model.size() + 16);
+			ASSERT_EQ(offset, header->seek(offset, File::SeekFromBeginning));
+			position = offset;
+		}
+		ASSERT_EQ(position, header->tell());
+		ASSERT_EQ(static_cast<off_t>(model.size()), header->length());
+	}
+
+	ASSERT_EQ(0, header->commit());
+	EXPECT_EQ(position, file->tell());
+
+	// The underlying file must match the model once committed.
+	std::vector<uint8_t> contents(model.size());
+	ASSERT_EQ(static_cast<ssize_t>(model.size()),
+		::pread(fd, contents.empty() ? NULL : &contents[0], contents.size(), 0));
+	EXPECT_TRUE(contents == model);
+
+	delete header;
+	delete file;
+}
+
+TEST(HeaderFile, OneWritePerRegion)
+{
+	int fd = createTemporaryFile();
+	ASSERT_NE(-1, fd);
+
+	CountingFile file(File::create(fd, File::WriteAccess));
+	HeaderFile header(&file);
+
+	// A header built from many small fields and patched afterward.
+	for (uint32_t i=0; i<32; i++)
+		ASSERT_EQ(4, header.write(&i, 4));
+	uint32_t size = 0x12345678;
+	ASSERT_EQ(4, header.seek(4, File::SeekFromBeginning));
+	ASSERT_EQ(4, header.write(&size, 4));
+
+	// A second region, written in reverse order.
+	for (int i=7; i>=0; i--)
+	{
+		uint8_t value = i;
+		ASSERT_EQ(200 + i, header.seek(200 + i, File::SeekFromBeginning));
+		ASSERT_EQ(1, header.write(&value, 1));
+	}
+	ASSERT_EQ(128, header.seek(128, File::SeekFromBeginning));
+
+	EXPECT_EQ(0, file.writeCount());
+	ASSERT_EQ(0, header.commit());
+	EXPECT_EQ(2, file.writeCount());
+	EXPECT_EQ(128, file.tell());
+
+	uint8_t contents[208];
+	ASSERT_EQ(208, ::pread(fd, contents, sizeof (contents), 0));
+	uint32_t value;
+	memcpy(&value, contents + 4, 4);
+	EXPECT_EQ(size, value);
+	memcpy(&value, contents + 124, 4);
+	EXPECT_EQ(31u, value);
+	for (int i=0; i<8; i++)
+		EXPECT_EQ(i, contents[200 + i]);
+}
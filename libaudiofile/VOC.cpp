@@ -86,15 +86,10 @@ VOCFile::VOCFile() :
 	setFormatByteOrder(AF_BYTEORDER_LITTLEENDIAN);
 }
 
-bool VOCFile::recognize(File *f)
+bool VOCFile::recognize(const uint8_t *header, size_t length)
 {
-	f->seek(0, File::SeekFromBeginning);
-	char buffer[kVOCMagicLength];
-	if (f->read(buffer, kVOCMagicLength) != kVOCMagicLength)
-		return false;
-	if (memcmp(buffer, kVOCMagic, kVOCMagicLength) != 0)
-		return false;
-	return true;
+	return length >= static_cast<size_t>(kVOCMagicLength) &&
+		memcmp(header, kVOCMagic, kVOCMagicLength) == 0;
 }
 
 AFfilesetup VOCFile::completeSetup(AFfilesetup setup)
@@ -32,7 +32,7 @@ class VOCFile : public _AFfilehandle
 public:
 	VOCFile();
 
-	static bool recognize(File *);
+	static bool recognize(const uint8_t *header, size_t length);
 	static AFfilesetup completeSetup(AFfilesetup);
 
 	status readInit(AFfilesetup) OVERRIDE;
@@ -112,6 +112,12 @@ const InstParamInfo _af_wave_inst_params[_AF_WAVE_NUM_INSTPARAMS] =
 	{ AF_INST_NUMDBS_GAIN, AU_PVTYPE_LONG, "Gain in dB", {0} }
 };
 
+/*
+	Chunk lengths and the frame count are left unspecified in a file
+	written in streaming mode.
+*/
+static const uint32_t kLengthUnspecified = 0xffffffff;
+
 static const _AFfilesetup waveDefaultFileSetup =
 {
 	_AF_VALID_FILESETUP,	/* valid */
@@ -153,9 +159,17 @@ WAVEFile::WAVEFile()
 	setFormatByteOrder(AF_BYTEORDER_LITTLEENDIAN);
 
 	m_factOffset = 0;
+	m_peakOffset = 0;
+	m_peakSize = 0;
 	m_miscellaneousOffset = 0;
 	m_markOffset = 0;
 	m_dataSizeOffset = 0;
+	m_ds64Offset = 0;
+
+	m_isRF64 = false;
+	m_riffSize64 = 0;
+	m_dataSize64 = 0;
+	m_sampleCount64 = 0;
 
 	m_msadpcmNumCoefficients = 0;
 }
@@ -164,10 +178,37 @@ status WAVEFile::parseFrameCount(const Tag &id, uint32_t size)
 {
 	Track *track = getTrack();
 
+	m_factOffset = m_fh->tell() - 8;
+
 	uint32_t totalFrames;
 	readU32(&totalFrames);
 
-	track->totalfframes = totalFrames;
+	if (totalFrames == kLengthUnspecified)
+		track->totalfframes = m_isRF64 ? m_sampleCount64 : -1;
+	else
+		track->totalfframes = totalFrames;
+
+	return AF_SUCCEED;
+}
+
+/*
+	Parse the ds64 chunk, which holds the sizes which do not fit in
+	32 bits in an RF64 or BW64 file.  The table of sizes of other
+	chunks is not used since only the data chunk is expected to be
+	that large.
+*/
+status WAVEFile::parseDataSize64(const Tag &id, uint32_t size)
+{
+	if (size < 28)
+	{
+		_af_error(AF_BAD_HEADER, "ds64 chunk is too short");
+		return AF_FAIL;
+	}
+
+	if (!readU64(&m_riffSize64) ||
+		!readU64(&m_dataSize64) ||
+		!readU64(&m_sampleCount64))
+		return AF_FAIL;
 
 	return AF_SUCCEED;
 }
@@ -444,13 +485,23 @@ status WAVEFile::parseFormat(const Tag &id, uint32_t size)
 	return AF_SUCCEED;
 }
 
-status WAVEFile::parseData(const Tag &id, uint32_t size)
+status WAVEFile::parseData(const Tag &id, AFfileoffset size)
 {
 	Track *track = getTrack();
 
 	track->fpos_first_frame = m_fh->tell();
 	track->data_size = size;
 
+	/*
+		The sound data in a streamed file extends to the end of
+		the file, which is unknown for a pipe.
+	*/
+	if (!m_isRF64 && size == kLengthUnspecified)
+	{
+		off_t length = m_fh->length();
+		track->data_size = length != -1 ? length - track->fpos_first_frame : -1;
+	}
+
 	return AF_SUCCEED;
 }
 
@@ -482,6 +533,8 @@ status WAVEFile::parseCues(const Tag &id, uint32_t size)
 {
 	Track *track = getTrack();
 
+	m_cueChunks.push_back(ChunkLayout::chunk(m_fh->tell() - 8, size));
+
 	uint32_t markerCount;
 	readU32(&markerCount);
 	track->markerCount = markerCount;
@@ -639,6 +692,8 @@ status WAVEFile::parseINFOSubChunk(const Tag &id, uint32_t size)
 
 status WAVEFile::parseList(const Tag &id, uint32_t size)
 {
+	ChunkLayout::Extent extent = ChunkLayout::chunk(m_fh->tell() - 8, size);
+
 	Tag typeID;
 	readTag(&typeID);
 	size-=4;
@@ -646,11 +701,13 @@ status WAVEFile::parseList(const Tag &id, uint32_t size)
 	if (typeID == "adtl")
 	{
 		/* Handle adtl sub-chunks. */
+		m_cueChunks.push_back(extent);
 		return parseADTLSubChunk(typeID, size);
 	}
 	else if (typeID == "INFO")
 	{
 		/* Handle INFO sub-chunks. */
+		m_infoChunks.push_back(extent);
 		return parseINFOSubChunk(typeID, size);
 	}
 	else
@@ -681,25 +738,20 @@ status WAVEFile::parseInstrument(const Tag &id, uint32_t size)
 	return AF_SUCCEED;
 }
 
-bool WAVEFile::recognize(File *fh)
+bool WAVEFile::recognize(const uint8_t *header, size_t length)
 {
-	uint8_t buffer[8];
-
-	fh->seek(0, File::SeekFromBeginning);
-
-	if (fh->read(buffer, 8) != 8 || memcmp(buffer, "RIFF", 4) != 0)
-		return false;
-	if (fh->read(buffer, 4) != 4 || memcmp(buffer, "WAVE", 4) != 0)
-		return false;
-
-	return true;
+	return length >= 12 &&
+		(memcmp(header, "RIFF", 4) == 0 ||
+		memcmp(header, "RF64", 4) == 0 ||
+		memcmp(header, "BW64", 4) == 0) &&
+		memcmp(header + 8, "WAVE", 4) == 0;
 }
 
 status WAVEFile::readInit(AFfilesetup setup)
 {
 	Tag type, formtype;
 	uint32_t size;
-	uint32_t index = 0;
+	uint64_t index = 0;
 
 	bool hasFormat = false;
 	bool hasData = false;
@@ -713,21 +765,55 @@ status WAVEFile::readInit(AFfilesetup setup)
 	readU32(&size);
 	readTag(&formtype);
 
-	assert(type == "RIFF");
+	assert(type == "RIFF" || type == "RF64" || type == "BW64");
 	assert(formtype == "WAVE");
 
+	/*
+		An RF64 or BW64 file begins with a ds64 chunk giving the
+		sizes which are too large for their 32-bit fields.
+	*/
+	uint64_t riffSize = size;
+	if (type != "RIFF")
+	{
+		Tag chunkid;
+		uint32_t chunksize = 0;
+		if (!readTag(&chunkid) || !readU32(&chunksize) ||
+			chunkid != "ds64")
+		{
+			_af_error(AF_BAD_HEADER, "missing ds64 chunk in RF64 file");
+			return AF_FAIL;
+		}
+		if (parseDataSize64(chunkid, chunksize) == AF_FAIL)
+			return AF_FAIL;
+		m_isRF64 = true;
+		m_ds64Offset = 12;
+		if (size == kLengthUnspecified)
+			riffSize = m_riffSize64;
+
+		m_fh->seek(12 + 8 + chunksize + (chunksize % 2),
+			File::SeekFromBeginning);
+		index += 8 + chunksize + (chunksize % 2);
+	}
+
 	/* Include the offset of the form type. */
 	index += 4;
 
-	while (index < size)
+	bool dataExtendsToEnd = false;
+
+	while (index < riffSize && !dataExtendsToEnd)
 	{
 		Tag chunkid;
 		uint32_t chunksize = 0;
+		uint64_t chunkLength;
 		status result;
 
 		readTag(&chunkid);
 		readU32(&chunksize);
 
+		chunkLength = chunksize;
+		if (m_isRF64 && chunkid == "data" && chunksize == kLengthUnspecified)
+			chunkLength = m_dataSize64;
+
 		if (chunkid == "fmt ")
 		{
 			result = parseFormat(chunkid, chunksize);
@@ -745,51 +831,69 @@ status WAVEFile::readInit(AFfilesetup setup)
 				return AF_FAIL;
 			}
 
-			result = parseData(chunkid, chunksize);
+			result = parseData(chunkid, chunkLength);
 			if (result == AF_FAIL)
 				return AF_FAIL;
 
 			hasData = true;
-		}
-		else if (chunkid == "inst")
-		{
-			result = parseInstrument(chunkid, chunksize);
-			if (result == AF_FAIL)
-				return AF_FAIL;
+			dataExtendsToEnd = chunkLength == kLengthUnspecified;
 		}
 		else if (chunkid == "fact")
 		{
-			hasFrameCount = true;
 			result = parseFrameCount(chunkid, chunksize);
 			if (result == AF_FAIL)
 				return AF_FAIL;
+			hasFrameCount = track->totalfframes != -1;
 		}
-		else if (chunkid == "cue ")
+		else if (chunkid == "PEAK")
 		{
-			result = parseCues(chunkid, chunksize);
-			if (result == AF_FAIL)
-				return AF_FAIL;
+			m_peakOffset = index + 8;
+			m_peakSize = chunksize;
+			parsePeakChunk(chunksize);
 		}
-		else if (chunkid == "LIST" || chunkid == "list")
+		else if (chunkid == "JUNK" && chunksize == 28 && index == 4)
 		{
-			result = parseList(chunkid, chunksize);
-			if (result == AF_FAIL)
-				return AF_FAIL;
+			// Room reserved for a ds64 chunk; see writeDataSize64().
+			m_ds64Offset = 12;
 		}
-		else if (chunkid == "INST")
+		else if (chunkid == "JUNK" ||
+			chunkid == "junk" ||
+			chunkid == "PAD " ||
+			chunkid == "FLLR")
 		{
-			result = parseInstrument(chunkid, chunksize);
-			if (result == AF_FAIL)
-				return AF_FAIL;
+			// Space which metadata edited in place may take over.
+			m_chunkLayout.addFree(index + 8, 8 + chunkLength + (chunkLength % 2));
 		}
-		else if (chunkid == "plst")
+		else if (chunkid == "inst" ||
+			chunkid == "INST" ||
+			chunkid == "cue " ||
+			chunkid == "LIST" ||
+			chunkid == "list" ||
+			chunkid == "plst")
 		{
-			result = parsePlayList(chunkid, chunksize);
-			if (result == AF_FAIL)
-				return AF_FAIL;
+			/*
+				Metadata is parsed when it is first asked for;
+				see parseDeferredChunk().
+			*/
+			deferChunk(chunkid, m_fh->tell(), chunksize);
 		}
 
-		index += chunksize + 8;
+		/*
+			For a header-only read, stop once the frame count is
+			known; compressed data needs the fact chunk for that.
+		*/
+		if (m_headerOnly && hasFormat && hasData &&
+			(hasFrameCount || !track->f.isCompressed()))
+			break;
+
+		/*
+			A file which cannot seek is read in a single pass,
+			so nothing after the start of the data is parsed.
+		*/
+		if (!m_seekok && hasData)
+			break;
+
+		index += chunkLength + 8;
 
 		/* All chunks must be aligned on an even number of bytes */
 		if ((index % 2) != 0)
@@ -804,6 +908,15 @@ status WAVEFile::readInit(AFfilesetup setup)
 		return AF_FAIL;
 	}
 
+	// Peaks are ignored unless there is one for each channel.
+	if (track->peaks.size() != static_cast<size_t>(track->f.channelCount))
+		track->peaks.clear();
+
+	// A PEAK chunk of another size cannot be rewritten in place.
+	if (m_peakOffset != 0 &&
+		m_peakSize != peakChunkSize(track->f.channelCount))
+		m_peakOffset = 0;
+
 	/*
 		At this point we know that the file has a format chunk and a
 		data chunk, so we can assume that track->f and track->data_size
@@ -815,6 +928,13 @@ status WAVEFile::readInit(AFfilesetup setup)
 		{
 			track->computeTotalFileFrames();
 		}
+		else if (!m_seekok)
+		{
+			_af_error(AF_BAD_HEADER,
+				"frame count chunk must precede the data chunk "
+				"when reading from a non-seekable file");
+			return AF_FAIL;
+		}
 		else
 		{
 			_af_error(AF_BAD_HEADER, "Frame count required but not found");
@@ -825,6 +945,19 @@ status WAVEFile::readInit(AFfilesetup setup)
 	return AF_SUCCEED;
 }
 
+status WAVEFile::parseDeferredChunk(const Tag &chunkid, AFfileoffset size)
+{
+	if (chunkid == "inst" || chunkid == "INST")
+		return parseInstrument(chunkid, size);
+	else if (chunkid == "cue ")
+		return parseCues(chunkid, size);
+	else if (chunkid == "LIST" || chunkid == "list")
+		return parseList(chunkid, size);
+	else if (chunkid == "plst")
+		return parsePlayList(chunkid, size);
+	return AF_SUCCEED;
+}
+
 AFfilesetup WAVEFile::completeSetup(AFfilesetup setup)
 {
 	if (setup->trackSet && setup->trackCount != 1)
@@ -1219,12 +1352,25 @@ status WAVEFile::writeFrameCount()
 	m_fh->write("fact", 4);
 	writeU32(&factSize);
 
-	totalFrameCount = track->totalfframes;
+	totalFrameCount = m_seekok ? track->totalfframes : kLengthUnspecified;
+	// The ds64 chunk holds a frame count which does not fit here.
+	if (track->totalfframes >= kLengthUnspecified)
+		totalFrameCount = kLengthUnspecified;
 	writeU32(&totalFrameCount);
 
 	return AF_SUCCEED;
 }
 
+status WAVEFile::writePeaks()
+{
+	if (m_peakOffset == 0)
+		m_peakOffset = m_fh->tell();
+	else
+		m_fh->seek(m_peakOffset, File::SeekFromBeginning);
+
+	return writePeakChunk(Tag("JUNK"));
+}
+
 status WAVEFile::writeData()
 {
 	Track *track = getTrack();
@@ -1232,7 +1378,7 @@ status WAVEFile::writeData()
 	m_fh->write("data", 4);
 	m_dataSizeOffset = m_fh->tell();
 
-	uint32_t chunkSize = track->data_size;
+	uint32_t chunkSize = m_seekok ? track->data_size : kLengthUnspecified;
 
 	writeU32(&chunkSize);
 	track->fpos_first_frame = m_fh->tell();
@@ -1240,43 +1386,184 @@ status WAVEFile::writeData()
 	return AF_SUCCEED;
 }
 
+/*
+	Write the ds64 chunk of an RF64 file.  Until the file needs it,
+	its place is held by a JUNK chunk of the same size, which
+	readers skip.
+*/
+status WAVEFile::writeDataSize64()
+{
+	if (m_ds64Offset == 0)
+		m_ds64Offset = m_fh->tell();
+	else
+		m_fh->seek(m_ds64Offset, File::SeekFromBeginning);
+
+	Tag chunkID(m_isRF64 ? "ds64" : "JUNK");
+	uint32_t chunkSize = 28;
+	uint32_t tableLength = 0;
+
+	if (!writeTag(&chunkID) ||
+		!writeU32(&chunkSize) ||
+		!writeU64(&m_riffSize64) ||
+		!writeU64(&m_dataSize64) ||
+		!writeU64(&m_sampleCount64) ||
+		!writeU32(&tableLength))
+		return AF_FAIL;
+
+	return AF_SUCCEED;
+}
+
 status WAVEFile::update()
+{
+	// A streamed file's header is written only once.
+	if (!m_seekok)
+		return AF_SUCCEED;
+
+	if (getTrack()->fpos_first_frame != 0 && writeSizes() == AF_FAIL)
+		return AF_FAIL;
+
+	if (m_peakOffset != 0 && writePeaks() == AF_FAIL)
+		return AF_FAIL;
+
+	if (m_metadataChanged)
+	{
+		/*
+			Write the actual data that was set after initializing
+			the miscellaneous IDs.	The size of the data will be
+			unchanged.
+		*/
+		writeMiscellaneous();
+
+		// Write the new positions; the size of the data will be unchanged.
+		writeCues();
+	}
+
+	return AF_SUCCEED;
+}
+
+/*
+	Write the chunk sizes and the frame count, which change as the
+	file grows.
+*/
+status WAVEFile::writeSizes()
 {
 	Track *track = getTrack();
+	AFfileoffset riffSize = m_fh->length() - 8;
+
+	/*
+		Once the file outgrows the 32-bit sizes of RIFF, it
+		becomes an RF64 file: the JUNK chunk reserved at the
+		start of the file is replaced with a ds64 chunk which
+		holds the actual sizes.
+	*/
+	if (riffSize >= kLengthUnspecified ||
+		track->data_size >= kLengthUnspecified)
+	{
+		/*
+			A file opened with "a" or "r+" which has no
+			reserved chunk cannot hold sizes this large.
+		*/
+		if (m_ds64Offset == 0)
+		{
+			_af_error(AF_BAD_WRITE,
+				"WAVE file without a ds64 chunk cannot exceed 4 GB");
+			return AF_FAIL;
+		}
+		m_isRF64 = true;
+	}
 
-	if (track->fpos_first_frame != 0)
+	if (m_isRF64)
 	{
-		uint32_t dataLength, fileLength;
+		m_riffSize64 = riffSize;
+		m_dataSize64 = track->data_size;
+		m_sampleCount64 = track->totalfframes;
+		writeDataSize64();
+	}
 
-		// Update the frame count chunk if present.
+	// Update the frame count chunk if present.
+	if (m_factOffset != 0)
 		writeFrameCount();
 
-		// Update the length of the data chunk.
-		m_fh->seek(m_dataSizeOffset, File::SeekFromBeginning);
-		dataLength = (uint32_t) track->data_size;
-		writeU32(&dataLength);
+	// Update the length of the data chunk.
+	m_fh->seek(m_dataSizeOffset, File::SeekFromBeginning);
+	uint32_t dataLength = m_isRF64 ? kLengthUnspecified :
+		static_cast<uint32_t>(track->data_size);
+	writeU32(&dataLength);
 
-		// Update the length of the RIFF chunk.
-		fileLength = (uint32_t) m_fh->length();
-		fileLength -= 8;
+	// Update the form type and the length of the RIFF chunk.
+	m_fh->seek(0, File::SeekFromBeginning);
+	m_fh->write(m_isRF64 ? "RF64" : "RIFF", 4);
+	uint32_t riffLength = m_isRF64 ? kLengthUnspecified :
+		static_cast<uint32_t>(riffSize);
+	writeU32(&riffLength);
+
+	return AF_SUCCEED;
+}
 
-		m_fh->seek(4, File::SeekFromBeginning);
-		writeU32(&fileLength);
+/*
+	Rewrite the chunks holding the metadata which has changed in a
+	file opened with "m".  A chunk stays where it is if it still
+	fits there and otherwise moves to free space or to the end of
+	the file, leaving a JUNK chunk in its place.
+*/
+status WAVEFile::updateMetadata()
+{
+	AFfileoffset originalLength = m_fh->length();
+	AFfileoffset length = originalLength;
+
+	if ((m_metadataChanged & kMiscellaneousMetadata) && !m_infoChunks.empty())
+	{
+		uint32_t size = miscellaneousSize();
+		m_miscellaneousOffset = m_chunkLayout.place(&m_infoChunks, size, &length);
+		writeMiscellaneous();
 	}
 
-	/*
-		Write the actual data that was set after initializing
-		the miscellaneous IDs.	The size of the data will be
-		unchanged.
-	*/
-	writeMiscellaneous();
+	if ((m_metadataChanged & kMarkerMetadata) && !m_cueChunks.empty())
+	{
+		Track *track = getTrack();
+		uint32_t size = 12 + track->markerCount * 24 + 8 + labelListSize();
+		m_markOffset = m_chunkLayout.place(&m_cueChunks, size, &length);
+		writeCues();
+	}
 
-	// Write the new positions; the size of the data will be unchanged.
-	writeCues();
+	std::vector<ChunkLayout::Extent> freeChunks = m_chunkLayout.takeChanged();
+	for (size_t i=0; i<freeChunks.size(); i++)
+	{
+		m_fh->seek(freeChunks[i].offset, File::SeekFromBeginning);
+		writeFreeChunk(freeChunks[i].length);
+	}
+
+	if (length > originalLength)
+	{
+		// Chunks begin at even offsets.
+		if (originalLength % 2)
+		{
+			uint8_t zero = 0;
+			m_fh->seek(originalLength, File::SeekFromBeginning);
+			writeU8(&zero);
+		}
+
+		if (writeSizes() == AF_FAIL)
+			return AF_FAIL;
+	}
 
 	return AF_SUCCEED;
 }
 
+/*
+	Write a JUNK chunk of the given total length, whose contents
+	are left as they are.
+*/
+status WAVEFile::writeFreeChunk(AFfileoffset length)
+{
+	assert(length >= ChunkLayout::kMinimumFreeLength);
+	Tag junk("JUNK");
+	uint32_t chunkSize = length - 8;
+	if (!writeTag(&junk) || !writeU32(&chunkSize))
+		return AF_FAIL;
+	return AF_SUCCEED;
+}
+
 /* Convert an Audio File Library miscellaneous type to a WAVE type. */
 static bool misc_type_to_wave (int misctype, Tag *miscid)
 {
@@ -1298,35 +1585,44 @@ static bool misc_type_to_wave (int misctype, Tag *miscid)
 	return true;
 }
 
-status WAVEFile::writeMiscellaneous()
+/*
+	Return the length of the LIST chunk which holds the miscellaneous
+	data, including its header.
+*/
+uint32_t WAVEFile::miscellaneousSize()
 {
-	if (m_miscellaneousCount != 0)
+	/* Start at 12 to account for 'LIST', size, and 'INFO'. */
+	uint32_t miscellaneousBytes = 12;
+
+	/* Then calculate the size of the whole INFO chunk. */
+	for (int i=0; i<m_miscellaneousCount; i++)
 	{
-		uint32_t	miscellaneousBytes;
-		uint32_t 	chunkSize;
+		Tag miscid;
 
-		/* Start at 12 to account for 'LIST', size, and 'INFO'. */
-		miscellaneousBytes = 12;
+		// Skip miscellaneous data of an unsupported type.
+		if (!misc_type_to_wave(m_miscellaneous[i].type, &miscid))
+			continue;
 
-		/* Then calculate the size of the whole INFO chunk. */
-		for (int i=0; i<m_miscellaneousCount; i++)
-		{
-			Tag miscid;
+		// Account for miscellaneous type and size.
+		miscellaneousBytes += 8;
+		miscellaneousBytes += m_miscellaneous[i].size;
 
-			// Skip miscellaneous data of an unsupported type.
-			if (!misc_type_to_wave(m_miscellaneous[i].type, &miscid))
-				continue;
+		// Add a pad byte if necessary.
+		if (m_miscellaneous[i].size % 2 != 0)
+			miscellaneousBytes++;
 
-			// Account for miscellaneous type and size.
-			miscellaneousBytes += 8;
-			miscellaneousBytes += m_miscellaneous[i].size;
+		assert(miscellaneousBytes % 2 == 0);
+	}
 
-			// Add a pad byte if necessary.
-			if (m_miscellaneous[i].size % 2 != 0)
-				miscellaneousBytes++;
+	return miscellaneousBytes;
+}
 
-			assert(miscellaneousBytes % 2 == 0);
-		}
+status WAVEFile::writeMiscellaneous()
+{
+	if (m_miscellaneousCount != 0)
+	{
+		uint32_t	miscellaneousBytes = miscellaneousSize();
+		uint32_t 	chunkSize;
 
 		if (m_miscellaneousOffset == 0)
 			m_miscellaneousOffset = m_fh->tell();
@@ -1382,7 +1678,7 @@ status WAVEFile::writeMiscellaneous()
 				// Pad if necessary.
 				if ((size % 2) != 0)
 					size++;
-				m_fh->seek(size, File::SeekFromCurrent);
+				reserveSpace(size);
 			}
 		}
 	}
@@ -1442,24 +1738,7 @@ status WAVEFile::writeCues()
 	}
 
 	// Now write the cue names and comments within a master list chunk.
-	uint32_t listChunkSize = 4;
-	for (int i=0; i<track->markerCount; i++)
-	{
-		const char *name = track->markers[i].name;
-		const char *comment = track->markers[i].comment;
-
-		/*
-			Each 'labl' or 'note' chunk consists of 4 bytes for the chunk ID,
-			4 bytes for the chunk data size, 4 bytes for the cue point ID,
-			and then the length of the label as a null-terminated string.
-
-			In all, this is 12 bytes plus the length of the string, its null
-			termination byte, and a trailing pad byte if the length of the
-			chunk is otherwise odd.
-		*/
-		listChunkSize += 12 + zStringLength(name);
-		listChunkSize += 12 + zStringLength(comment);
-	}
+	uint32_t listChunkSize = labelListSize();
 
 	Tag list("LIST");
 	writeTag(&list);
@@ -1491,6 +1770,36 @@ status WAVEFile::writeCues()
 	return AF_SUCCEED;
 }
 
+/*
+	Return the size of the data of the LIST chunk which holds the
+	names and comments of the markers.
+*/
+uint32_t WAVEFile::labelListSize()
+{
+	Track *track = getTrack();
+
+	uint32_t listChunkSize = 4;
+	for (int i=0; i<track->markerCount; i++)
+	{
+		const char *name = track->markers[i].name;
+		const char *comment = track->markers[i].comment;
+
+		/*
+			Each 'labl' or 'note' chunk consists of 4 bytes for the chunk ID,
+			4 bytes for the chunk data size, 4 bytes for the cue point ID,
+			and then the length of the label as a null-terminated string.
+
+			In all, this is 12 bytes plus the length of the string, its null
+			termination byte, and a trailing pad byte if the length of the
+			chunk is otherwise odd.
+		*/
+		listChunkSize += 12 + zStringLength(name);
+		listChunkSize += 12 + zStringLength(comment);
+	}
+
+	return listChunkSize;
+}
+
 bool WAVEFile::writeZString(const char *s)
 {
 	ssize_t lengthPlusNull = strlen(s) + 1;
@@ -1518,22 +1827,55 @@ status WAVEFile::writeInit(AFfilesetup setup)
 
 	initCompressionParams();
 
-	uint32_t zero = 0;
+	uint32_t riffSize = m_seekok ? 0 : kLengthUnspecified;
 
 	m_fh->seek(0, File::SeekFromBeginning);
 	m_fh->write("RIFF", 4);
-	m_fh->write(&zero, 4);
+	writeU32(&riffSize);
 	m_fh->write("WAVE", 4);
 
+	// Reserve room for a ds64 chunk in case the file grows past 4 GB.
+	if (m_seekok)
+		writeDataSize64();
+
 	writeMiscellaneous();
 	writeCues();
+
+	// Leave room for the metadata to grow if it is edited in place.
+	if (m_miscellaneousCount != 0 || getTrack()->markerCount != 0)
+	{
+		writeFreeChunk(ChunkLayout::kMetadataSlack);
+		reserveSpace(ChunkLayout::kMetadataSlack - 8);
+	}
+
 	writeFormat();
 	writeFrameCount();
+	// The peaks are known only after the audio data has been written.
+	if (getTrack()->computesPeaks && m_seekok)
+		writePeaks();
 	writeData();
 
 	return AF_SUCCEED;
 }
 
+status WAVEFile::updateInit()
+{
+	// The size of the data chunk precedes the sound data.
+	m_dataSizeOffset = getTrack()->fpos_first_frame - 4;
+
+	// Keep the peaks of a PEAK chunk up to date.
+	Track *track = getTrack();
+	if (m_peakOffset != 0 && !track->peaks.empty())
+		track->computesPeaks = true;
+	return AF_SUCCEED;
+}
+
+status WAVEFile::editInit()
+{
+	// The chunk sizes are rewritten if metadata moves to the end.
+	return updateInit();
+}
+
 bool WAVEFile::readUUID(UUID *u)
 {
 	return m_fh->read(u->data, 16) == 16;
@@ -30,9 +30,11 @@
 #ifndef WAVE_H
 #define WAVE_H
 
+#include "ChunkLayout.h"
 #include "Compiler.h"
 #include "FileHandle.h"
 #include <stdint.h>
+#include <vector>
 
 #define _AF_WAVE_NUM_INSTPARAMS 7
 extern const InstParamInfo _af_wave_inst_params[_AF_WAVE_NUM_INSTPARAMS];
@@ -44,23 +46,45 @@ struct UUID;
 class WAVEFile : public _AFfilehandle
 {
 public:
-	static bool recognize(File *fh);
+	static bool recognize(const uint8_t *header, size_t length);
 	static AFfilesetup completeSetup(AFfilesetup);
 
 	WAVEFile();
 
 	status readInit(AFfilesetup) OVERRIDE;
 	status writeInit(AFfilesetup) OVERRIDE;
+	status updateInit() OVERRIDE;
+	status editInit() OVERRIDE;
 
 	status update() OVERRIDE;
+	status updateMetadata() OVERRIDE;
+	bool supportsStreaming() OVERRIDE { return true; }
 
 	bool isInstrumentParameterValid(AUpvlist, int) OVERRIDE;
 
+protected:
+	status parseDeferredChunk(const Tag &, AFfileoffset) OVERRIDE;
+
 private:
 	AFfileoffset m_factOffset;	// start of fact (frame count) chunk
+	AFfileoffset m_peakOffset;	// start of PEAK chunk
+	uint32_t m_peakSize;	// size of PEAK chunk read from the file
 	AFfileoffset m_miscellaneousOffset;
 	AFfileoffset m_markOffset;
 	AFfileoffset m_dataSizeOffset;
+	// start of ds64 chunk, or of the JUNK chunk reserving room for it
+	AFfileoffset m_ds64Offset;
+
+	// 64-bit sizes from the ds64 chunk of an RF64 or BW64 file
+	bool m_isRF64;
+	uint64_t m_riffSize64;
+	uint64_t m_dataSize64;
+	uint64_t m_sampleCount64;
+
+	// Free space and the chunks holding metadata, for editing in place.
+	ChunkLayout m_chunkLayout;
+	std::vector<ChunkLayout::Extent> m_cueChunks;
+	std::vector<ChunkLayout::Extent> m_infoChunks;
 
 	/*
 		The index into the coefficient array is of type
@@ -72,7 +96,8 @@ private:
 
 	status parseFrameCount(const Tag &type, uint32_t size);
 	status parseFormat(const Tag &type, uint32_t size);
-	status parseData(const Tag &type, uint32_t size);
+	status parseDataSize64(const Tag &type, uint32_t size);
+	status parseData(const Tag &type, AFfileoffset size);
 	status parsePlayList(const Tag &type, uint32_t size);
 	status parseCues(const Tag &type, uint32_t size);
 	status parseADTLSubChunk(const Tag &type, uint32_t size);
@@ -82,9 +107,15 @@ private:
 
 	status writeFormat();
 	status writeFrameCount();
+	status writePeaks();
 	status writeMiscellaneous();
 	status writeCues();
+	status writeSizes();
+	status writeFreeChunk(AFfileoffset length);
+	uint32_t miscellaneousSize();
+	uint32_t labelListSize();
 	status writeData();
+	status writeDataSize64();
 
 	bool readUUID(UUID *g);
 	bool writeUUID(const UUID *g);
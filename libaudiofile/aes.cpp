@@ -66,6 +66,8 @@ int afGetAESChannelData (AFfilehandle file, int trackid, unsigned char buf[24])
 	if (!_af_filehandle_ok(file))
 		return -1;
 
+	file->loadMetadata();
+
 	Track *track = file->getTrack(trackid);
 	if (!track)
 		return -1;
@@ -88,16 +90,19 @@ void afSetAESChannelData (AFfilehandle file, int trackid, unsigned char buf[24])
 	if (!_af_filehandle_ok(file))
 		return;
 
+	file->loadMetadata();
+
 	Track *track = file->getTrack(trackid);
 	if (!track)
 		return;
 
-	if (!file->checkCanWrite())
+	if (!file->checkCanWriteMetadata())
 		return;
 
 	if (track->hasAESData)
 	{
 		memcpy(track->aesData, buf, 24);
+		file->m_metadataChanged |= _AFfilehandle::kAESMetadata;
 	}
 	else
 	{
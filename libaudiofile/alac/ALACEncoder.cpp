@@ -1177,6 +1177,32 @@ int32_t ALACEncoder::Finish()
 #pragma mark -
 #endif
 
+/*
+	SaveState()
+	- used to encode a partial packet and then encode the same packet
+	  again once it is complete
+*/
+void ALACEncoder::SaveState()
+{
+	memcpy( mSavedLastMixRes, mLastMixRes, sizeof(mLastMixRes) );
+	memcpy( mSavedCoefsU, mCoefsU, sizeof(mCoefsU) );
+	memcpy( mSavedCoefsV, mCoefsV, sizeof(mCoefsV) );
+	mSavedTotalBytesGenerated = mTotalBytesGenerated;
+	mSavedMaxFrameBytes = mMaxFrameBytes;
+}
+
+/*
+	RestoreState()
+*/
+void ALACEncoder::RestoreState()
+{
+	memcpy( mLastMixRes, mSavedLastMixRes, sizeof(mLastMixRes) );
+	memcpy( mCoefsU, mSavedCoefsU, sizeof(mCoefsU) );
+	memcpy( mCoefsV, mSavedCoefsV, sizeof(mCoefsV) );
+	mTotalBytesGenerated = mSavedTotalBytesGenerated;
+	mMaxFrameBytes = mSavedMaxFrameBytes;
+}
+
 /*
 	GetConfig()
 */
@@ -52,6 +52,10 @@ class ALACEncoder
 
         virtual int32_t	InitializeEncoder(AudioFormatDescription theOutputFormat);
 
+		// save and restore the state carried from one packet to the next
+		void				SaveState();
+		void				RestoreState();
+
     protected:
 		virtual void		GetSourceFormat( const AudioFormatDescription * source, AudioFormatDescription * output );
 		
@@ -82,6 +86,12 @@ class ALACEncoder
 		int16_t					mCoefsV[kALACMaxChannels][kALACMaxSearches][kALACMaxCoefs];
 
 		// encoding statistics
+		int16_t					mSavedLastMixRes[kALACMaxChannels];
+		int16_t					mSavedCoefsU[kALACMaxChannels][kALACMaxSearches][kALACMaxCoefs];
+		int16_t					mSavedCoefsV[kALACMaxChannels][kALACMaxSearches][kALACMaxCoefs];
+		uint32_t					mSavedTotalBytesGenerated;
+		uint32_t					mSavedMaxFrameBytes;
+
 		uint32_t					mTotalBytesGenerated;
 		uint32_t					mAvgBitRate;
 		uint32_t					mMaxFrameBytes;
@@ -49,6 +49,7 @@ typedef struct _AFvirtualfile AFvirtualfile;
 
 typedef struct _AFfilesetup *AFfilesetup;
 typedef struct _AFfilehandle *AFfilehandle;
+typedef struct _AFoverview *AFoverview;
 typedef void (*AFerrfunc)(long, const char *);
 
 // Define AFframecount and AFfileoffset as 64-bit signed integers.
@@ -209,6 +210,34 @@ enum
 	AF_COMPRESSION_ALAC = 540
 };
 
+/* hints for memory-mapped input -- see afInitMemoryMap() */
+enum
+{
+	AF_MMAP_NORMAL = 0,
+	AF_MMAP_SEQUENTIAL = 1,	/* expect sequential access */
+	AF_MMAP_RANDOM = 2,	/* expect random access */
+	AF_MMAP_WILLNEED = 4,	/* prefetch the whole file */
+	AF_MMAP_HUGEPAGES = 8	/* back the mapping with huge pages */
+};
+
+/* policies for writing files -- see afInitWritePolicy() */
+enum
+{
+	AF_WRITE_NORMAL = 0,
+	AF_WRITE_PREALLOCATE = 1,	/* reserve space for the frame count */
+	AF_WRITE_DIRECT = 2,	/* write sound data past the page cache */
+	AF_WRITE_SYNC_ON_CLOSE = 4,	/* wait for storage in afCloseFile() */
+	AF_WRITE_SYNC_ALWAYS = 8	/* wait for storage in afSyncFile() */
+};
+
+/* hints for reading files -- see afSetAccessHint() */
+enum
+{
+	AF_ACCESS_NORMAL = 0,
+	AF_ACCESS_SEQUENTIAL = 1,	/* read once from start to end */
+	AF_ACCESS_RANDOM = 2	/* read at scattered positions */
+};
+
 /* tokens for afQuery() -- see the man page for instructions */
 /* level 1 selectors */
 enum
@@ -419,6 +448,22 @@ enum
 };
 
 
+/* essential header fields of an audio file -- see afProbeFile(3) */
+typedef struct _AFfileinfo
+{
+	int fileFormat;			/* AF_FILE_... */
+	int channelCount;
+	double sampleRate;
+	int sampleFormat;		/* AF_SAMPFMT_... */
+	int sampleWidth;		/* in bits */
+	int byteOrder;			/* AF_BYTEORDER_... */
+	int compressionType;		/* AF_COMPRESSION_... */
+	AFframecount frameCount;	/* -1 if unknown */
+	AFfileoffset dataOffset;	/* offset of the first sample frame */
+	AFfileoffset dataBytes;		/* size of the audio data */
+	double duration;		/* in seconds, -1 if unknown */
+} AFfileinfo;
+
 /* global routines */
 AFAPI AFerrfunc afSetErrorHandler (AFerrfunc efunc);
 
@@ -441,15 +486,39 @@ AFAPI AFfilehandle afOpenVirtualFile (AFvirtualfile *vfile, const char *mode,
 AFAPI AFfilehandle afOpenFD (int fd, const char *mode, AFfilesetup setup);
 AFAPI AFfilehandle afOpenNamedFD (int fd, const char *mode, AFfilesetup setup,
 	const char *filename);
+AFAPI AFfilehandle afOpenMemory (const void *data, size_t size,
+	const char *mode, AFfilesetup setup);
+
+/* header-only probing */
+AFAPI int afProbeFile (const char *filename, AFfileinfo *info);
+AFAPI int afProbeFD (int fd, AFfileinfo *info);
+AFAPI int afProbeFiles (const char * const *filenames, int count,
+	AFfileinfo *infos);
 
 AFAPI void afSaveFilePosition (AFfilehandle file);
 AFAPI void afRestoreFilePosition (AFfilehandle file);
 AFAPI int afSyncFile (AFfilehandle file);
 AFAPI int afCloseFile (AFfilehandle file);
+AFAPI int afCloseMemoryFile (AFfilehandle file, void **data, size_t *size);
 
 AFAPI void afInitFileFormat (AFfilesetup, int format);
 AFAPI int afGetFileFormat (AFfilehandle, int *version);
 
+/* memory-mapped input */
+AFAPI void afInitMemoryMap (AFfilesetup, int enable, int hints);
+
+/* file I/O buffering */
+AFAPI void afInitBufferSize (AFfilesetup, int bufferSize);
+AFAPI void afInitWriteBehind (AFfilesetup, int enable);
+AFAPI void afInitWritePolicy (AFfilesetup, int policy);
+
+/* streaming output */
+AFAPI void afInitStreaming (AFfilesetup, int enable);
+
+/* seek index for compressed input -- see afInitSeekIndex(3) */
+AFAPI void afInitSeekIndex (AFfilesetup, int enable, const char *path,
+	AFframecount interval);
+
 /* track */
 AFAPI void afInitTrackIDs (AFfilesetup, const int *trackids, int trackCount);
 AFAPI int afGetTrackIDs (AFfilehandle, int *trackids);
@@ -457,8 +526,26 @@ AFAPI int afGetTrackIDs (AFfilehandle, int *trackids);
 /* track data: reading, writng, seeking, sizing frames */
 AFAPI int afReadFrames (AFfilehandle, int track, void *buffer, int frameCount);
 AFAPI int afWriteFrames (AFfilehandle, int track, const void *buffer, int frameCount);
+
+/* positional, thread-safe read -- see afReadFramesAt(3) */
+AFAPI int afReadFramesAt (AFfilehandle, int track, AFframecount frame,
+	void *buffer, int frameCount);
+
+/* track data: encoded packets, copied without decoding -- see afReadPackets(3) */
+AFAPI int afReadPackets (AFfilehandle, int track, void *buffer, int bufferSize,
+	int packetCount, int *packetSizes, AFframecount *frameCount);
+AFAPI int afWritePackets (AFfilehandle, int track, const void *buffer,
+	int packetCount, const int *packetSizes, AFframecount frameCount);
+AFAPI int afGetCodecData (AFfilehandle, int track, void *buffer, int bufferSize);
+AFAPI int afSetCodecData (AFfilehandle, int track, const void *buffer, int bufferSize);
+
+/* copy the stored audio data of a track to another file -- see afRemuxTrack(3) */
+AFAPI AFframecount afRemuxTrack (AFfilehandle infile, AFfilehandle outfile,
+	int track);
+
 AFAPI AFframecount afSeekFrame (AFfilehandle, int track, AFframecount frameoffset);
 AFAPI AFframecount afTellFrame (AFfilehandle, int track);
+AFAPI int afSetAccessHint (AFfilehandle, int hint, AFframecount prefetchFrames);
 AFAPI AFfileoffset afGetTrackBytes (AFfilehandle, int track);
 AFAPI float afGetFrameSize (AFfilehandle, int track, int expand3to4);
 AFAPI float afGetVirtualFrameSize (AFfilehandle, int track, int expand3to4);
@@ -470,6 +557,20 @@ AFAPI void afInitAESChannelDataTo (AFfilesetup, int track, int willBeData);
 AFAPI int afGetAESChannelData (AFfilehandle, int track, unsigned char buf[24]);
 AFAPI void afSetAESChannelData (AFfilehandle, int track, unsigned char buf[24]);
 
+/* track data: peak amplitude of each channel -- see afGetPeaks(3) */
+AFAPI void afInitPeaks (AFfilesetup, int track, int enable);
+AFAPI int afGetPeaks (AFfilehandle, int track, double *peaks,
+	AFframecount *positions);
+
+/* track data: overview of the audio data -- see afNewOverview(3) */
+AFAPI AFoverview afNewOverview (AFfilehandle, int track,
+	const char *cachePath);
+AFAPI void afFreeOverview (AFoverview);
+AFAPI int afGetOverviewChannels (AFoverview);
+AFAPI AFframecount afGetOverviewFrameCount (AFoverview);
+AFAPI int afReadOverview (AFoverview, AFframecount start, AFframecount end,
+	int bucketCount, float *minima, float *maxima, float *rms);
+
 /* track data: byte order */
 AFAPI void afInitByteOrder (AFfilesetup, int track, int byteOrder);
 AFAPI int afGetByteOrder (AFfilehandle, int track);
@@ -27,7 +27,9 @@
 
 #include "config.h"
 
+#include <algorithm>
 #include <assert.h>
+#include <string.h>
 
 #include "FileHandle.h"
 #include "Setup.h"
@@ -75,6 +77,71 @@ void afInitCompression (AFfilesetup setup, int trackid, int compression)
 	track->f.compressionType = compression;
 }
 
+/*
+	Find the codec data, such as the magic cookie of ALAC, which
+	describes how a track's audio data is encoded.
+*/
+static bool getCodecData (Track *track, void **data, long *size)
+{
+	AUpvlist pv = track->f.compressionParams;
+	return pv != AU_NULL_PVLIST &&
+		_af_pv_getlong(pv, _AF_CODEC_DATA_SIZE, size) &&
+		_af_pv_getptr(pv, _AF_CODEC_DATA, data);
+}
+
+int afGetCodecData (AFfilehandle file, int trackid, void *data, int size)
+{
+	if (!_af_filehandle_ok(file))
+		return -1;
+
+	Track *track = file->getTrack(trackid);
+	if (!track)
+		return -1;
+
+	void *codecData;
+	long codecDataSize;
+	if (!getCodecData(track, &codecData, &codecDataSize))
+		return 0;
+
+	if (data && size > 0)
+		memcpy(data, codecData, std::min<long>(size, codecDataSize));
+
+	return codecDataSize;
+}
+
+int afSetCodecData (AFfilehandle file, int trackid, const void *data, int size)
+{
+	if (!_af_filehandle_ok(file))
+		return -1;
+
+	if (!file->checkCanWrite())
+		return -1;
+
+	Track *track = file->getTrack(trackid);
+	if (!track)
+		return -1;
+
+	void *codecData;
+	long codecDataSize;
+	if (!getCodecData(track, &codecData, &codecDataSize))
+	{
+		_af_error(AF_BAD_CODEC_CONFIG,
+			"compression type of track does not use codec data");
+		return -1;
+	}
+
+	if (!data || size != codecDataSize)
+	{
+		_af_error(AF_BAD_CODEC_CONFIG,
+			"codec data must be %ld bytes long", codecDataSize);
+		return -1;
+	}
+
+	memcpy(codecData, data, size);
+
+	return 0;
+}
+
 #if 0
 int afGetCompressionParams (AFfilehandle file, int trackid,
 	int *compression, AUpvlist pvlist, int numitems)
@@ -25,12 +25,17 @@
 
 #include "config.h"
 
+#include <algorithm>
 #include <assert.h>
+#include <math.h>
+#include <stdint.h>
 #include <stdlib.h>
 #include <string.h>
 
 #include "File.h"
 #include "FileHandle.h"
+#include "PacketTable.h"
+#include "ReaderPool.h"
 #include "Setup.h"
 #include "Track.h"
 #include "afinternal.h"
@@ -50,13 +55,24 @@ int afWriteFrames (AFfilehandle file, int trackid, const void *samples,
 	if (!_af_filehandle_ok(file))
 		return -1;
 
-	if (!file->checkCanWrite())
+	if (!file->checkCanWrite() ||
+		file->switchAccess(_AF_WRITE_ACCESS) == AF_FAIL)
 		return -1;
 
 	Track *track = file->getTrack(trackid);
 	if (!track)
 		return -1;
 
+	/*
+		Peaks measured while writing cannot tell when a peak is
+		lowered.  The virtual frames are compared since a sync may
+		leave a block codec's next frame at the start of the partial
+		block it has written, which is written again with the same
+		frames.
+	*/
+	if (track->computesPeaks && track->nextvframe < track->totalvframes)
+		track->discardPeaks();
+
 	if (track->ms->isDirty() && track->ms->setup(file, track) == AF_FAIL)
 		return -1;
 
@@ -117,13 +133,19 @@ int afWriteFrames (AFfilehandle file, int trackid, const void *samples,
 	}
 
 	track->nextvframe += vframe;
-	track->totalvframes += vframe;
+	// Frames may overwrite existing ones in a file opened with "r+".
+	if (track->nextvframe > track->totalvframes)
+		track->totalvframes = track->nextvframe;
 
 	return vframe;
 }
 
-int afReadFrames (AFfilehandle file, int trackid, void *samples,
-	int nvframeswanted)
+/*
+	Read frames from track's current position through its module
+	state. fh is the file from which the track's file module reads.
+*/
+static int readFrames (AFfilehandle file, File *fh, Track *track,
+	void *samples, int nvframeswanted)
 {
 	SharedPtr<Module> firstmod;
 	SharedPtr<Chunk> userc;
@@ -131,22 +153,9 @@ int afReadFrames (AFfilehandle file, int trackid, void *samples,
 	int		bytes_per_vframe;
 	AFframecount	vframe;
 
-	if (!_af_filehandle_ok(file))
-		return -1;
-
-	if (!file->checkCanRead())
-		return -1;
-
-	Track *track = file->getTrack(trackid);
-	if (!track)
-		return -1;
-
-	if (track->ms->isDirty() && track->ms->setup(file, track) == AF_FAIL)
-		return -1;
-
 	if (!track->ms->fileModuleHandlesSeeking() &&
 		file->m_seekok &&
-		file->m_fh->seek(track->fpos_next_frame, File::SeekFromBeginning) !=
+		fh->seek(track->fpos_next_frame, File::SeekFromBeginning) !=
 			track->fpos_next_frame)
 	{
 		_af_error(AF_BAD_LSEEK, "unable to position read pointer at next frame");
@@ -184,27 +193,14 @@ int afReadFrames (AFfilehandle file, int trackid, void *samples,
 	{
 		bool	eof = false;
 
-		if (track->frames2ignore != 0)
-		{
-			userc->frameCount = track->frames2ignore;
-			userc->allocate(track->frames2ignore * bytes_per_vframe);
-			if (!userc->buffer)
-				return 0;
-
-			firstmod->runPull();
-
-			/* Have we hit EOF? */
-			if (static_cast<ssize_t>(userc->frameCount) < track->frames2ignore)
-				eof = true;
-
-			track->frames2ignore = 0;
-
-			userc->deallocate();
-		}
+		/*
+			Frames to be skipped after seeking within a packet
+			are discarded by the module chain.
+		*/
+		assert(track->frames2ignore == 0);
 
 		/*
-			Now start reading useful frames, until EOF or
-			premature EOF.
+			Read frames until EOF or premature EOF.
 		*/
 
 		while (track->filemodhappy && !eof && vframe < nvframes2read)
@@ -234,3 +230,559 @@ int afReadFrames (AFfilehandle file, int trackid, void *samples,
 
 	return vframe;
 }
+
+int afReadFrames (AFfilehandle file, int trackid, void *samples,
+	int nvframeswanted)
+{
+	if (!_af_filehandle_ok(file))
+		return -1;
+
+	if (!file->checkCanRead() ||
+		file->switchAccess(_AF_READ_ACCESS) == AF_FAIL)
+		return -1;
+
+	Track *track = file->getTrack(trackid);
+	if (!track)
+		return -1;
+
+	if (track->ms->isDirty() && track->ms->setup(file, track) == AF_FAIL)
+		return -1;
+
+	int result = readFrames(file, file->m_fh, track, samples, nvframeswanted);
+	if (result > 0)
+		file->adviseAccess(track, false);
+	return result;
+}
+
+int afReadFramesAt (AFfilehandle file, int trackid, AFframecount frame,
+	void *samples, int nvframeswanted)
+{
+	if (!_af_filehandle_ok(file))
+		return -1;
+
+	if (!file->checkCanRead())
+		return -1;
+
+	Track *track = file->getTrack(trackid);
+	if (!track)
+		return -1;
+
+	if (frame < 0)
+	{
+		_af_error(AF_BAD_FRAME, "invalid frame %jd", static_cast<intmax_t>(frame));
+		return -1;
+	}
+
+	if (!track->readerPool)
+	{
+		_af_error(AF_BAD_NOT_IMPLEMENTED,
+			"positional reads are not supported for this file");
+		return -1;
+	}
+
+	if (track->totalfframes != -1 &&
+		llrint(frame * track->f.sampleRate / track->v.sampleRate) >=
+			track->totalfframes)
+		return 0;
+
+	TrackReader *reader = track->readerPool->acquire(file, track);
+	if (!reader)
+		return -1;
+
+	int result = -1;
+	if (reader->seek(file, frame) == AF_SUCCEED)
+		result = readFrames(file, reader->file(), reader->track(),
+			samples, nvframeswanted);
+
+	track->readerPool->release(reader);
+
+	return result;
+}
+
+/*
+	Find the number of frames in each packet of a track's audio data
+	and the number of bytes in each packet, which is 0 if the size
+	of each packet is given by the track's packet table.
+*/
+static bool getPacketSize (Track *track, AFframecount *framesPerPacket,
+	AFfileoffset *bytesPerPacket)
+{
+	if (track->f.isUncompressed())
+	{
+		*framesPerPacket = 1;
+		*bytesPerPacket = track->f.bytesPerFrame(false);
+		return true;
+	}
+
+	if (track->f.compressionType == AF_COMPRESSION_G711_ULAW ||
+		track->f.compressionType == AF_COMPRESSION_G711_ALAW)
+	{
+		*framesPerPacket = 1;
+		*bytesPerPacket = track->f.channelCount;
+		return true;
+	}
+
+	if (track->f.framesPerPacket > 0 &&
+		(track->f.bytesPerPacket > 0 || track->m_packetTable))
+	{
+		*framesPerPacket = track->f.framesPerPacket;
+		*bytesPerPacket = track->m_packetTable ? 0 : track->f.bytesPerPacket;
+		return true;
+	}
+
+	_af_error(AF_BAD_NOT_IMPLEMENTED,
+		"packets of this track's compression type cannot be accessed");
+	return false;
+}
+
+int afReadPackets (AFfilehandle file, int trackid, void *buffer,
+	int bufferSize, int packetCount, int *packetSizes,
+	AFframecount *frameCount)
+{
+	if (!_af_filehandle_ok(file))
+		return -1;
+
+	if (!file->checkCanRead() ||
+		file->switchAccess(_AF_READ_ACCESS) == AF_FAIL)
+		return -1;
+
+	Track *track = file->getTrack(trackid);
+	if (!track)
+		return -1;
+
+	if (packetCount < 0 || bufferSize < 0)
+	{
+		_af_error(AF_BAD_READ, "invalid packet count %d or buffer size %d",
+			packetCount, bufferSize);
+		return -1;
+	}
+
+	AFframecount framesPerPacket;
+	AFfileoffset bytesPerPacket;
+	if (!getPacketSize(track, &framesPerPacket, &bytesPerPacket))
+		return -1;
+
+	const PacketTable *packetTable =
+		bytesPerPacket ? NULL : track->m_packetTable.get();
+
+	// Reading starts with the packet holding the track's next frame.
+	AFframecount frame = llrint(track->nextvframe * track->f.sampleRate /
+		track->v.sampleRate);
+	AFframecount packet = frame / framesPerPacket;
+
+	AFframecount packetsLeft = -1;
+	if (track->totalfframes != -1 && frame >= track->totalfframes)
+		packetsLeft = 0;
+	else if (packetTable)
+		packetsLeft = packetTable->numPackets() - packet;
+	else if (track->totalfframes != -1)
+		packetsLeft = (track->totalfframes + framesPerPacket - 1) /
+			framesPerPacket - packet;
+	if (packetsLeft != -1 && packetCount > packetsLeft)
+		packetCount = std::max<AFframecount>(packetsLeft, 0);
+
+	// Read as many whole packets as fit in the buffer.
+	size_t bytesToRead = 0;
+	int packetsToRead = 0;
+	while (packetsToRead < packetCount)
+	{
+		size_t size = packetTable ?
+			packetTable->bytesPerPacket(packet + packetsToRead) :
+			bytesPerPacket;
+		if (bytesToRead + size > static_cast<size_t>(bufferSize))
+		{
+			if (packetsToRead == 0)
+			{
+				_af_error(AF_BAD_READ,
+					"buffer of %d bytes cannot hold packet of %zu bytes",
+					bufferSize, size);
+				return -1;
+			}
+			break;
+		}
+		if (packetSizes)
+			packetSizes[packetsToRead] = size;
+		bytesToRead += size;
+		packetsToRead++;
+	}
+
+	if (packetsToRead == 0)
+	{
+		if (frameCount)
+			*frameCount = 0;
+		return 0;
+	}
+
+	AFfileoffset offset = track->fpos_first_frame + (packetTable ?
+		packetTable->startOfPacket(packet) : packet * bytesPerPacket);
+	if (file->m_fh->seek(offset, File::SeekFromBeginning) != offset)
+	{
+		_af_error(AF_BAD_LSEEK, "unable to position read pointer at packet %jd",
+			static_cast<intmax_t>(packet));
+		return -1;
+	}
+
+	ssize_t bytesRead = file->m_fh->read(buffer, bytesToRead);
+	if (bytesRead < 0)
+	{
+		_af_error(AF_BAD_READ, "unable to read packets");
+		return -1;
+	}
+
+	// Only whole packets count; a file of unknown length may end early.
+	int packetsRead = packetsToRead;
+	if (static_cast<size_t>(bytesRead) < bytesToRead)
+	{
+		packetsRead = 0;
+		size_t bytes = 0;
+		while (packetsRead < packetsToRead)
+		{
+			size_t size = packetTable ?
+				packetTable->bytesPerPacket(packet + packetsRead) :
+				bytesPerPacket;
+			if (bytes + size > static_cast<size_t>(bytesRead))
+				break;
+			bytes += size;
+			packetsRead++;
+		}
+
+		if (track->totalfframes != -1)
+			_af_error(AF_BAD_READ,
+				"file missing data -- read %d packets, should be %d",
+				packetsRead, packetsToRead);
+	}
+
+	AFframecount endFrame = (packet + packetsRead) * framesPerPacket;
+	if (track->totalfframes != -1 && endFrame > track->totalfframes)
+		endFrame = track->totalfframes;
+	if (frameCount)
+		*frameCount = endFrame - packet * framesPerPacket;
+
+	// Frames read next start after these packets.
+	track->nextvframe = llrint(endFrame * track->v.sampleRate /
+		track->f.sampleRate);
+	track->ms->setDirty();
+
+	return packetsRead;
+}
+
+/*
+	Packets must follow whole packets: frames which are still
+	buffered by the track's modules or a partial packet already
+	written would be overwritten.
+*/
+static bool canAppendPackets (Track *track, AFframecount framesPerPacket)
+{
+	const PacketTable *packetTable = track->m_packetTable.get();
+	AFframecount frame = llrint(track->nextvframe * track->f.sampleRate /
+		track->v.sampleRate);
+	if (frame != track->nextfframe ||
+		track->nextfframe % framesPerPacket != 0 ||
+		(packetTable && packetTable->numValidFrames() != track->nextfframe))
+	{
+		_af_error(AF_BAD_NOT_IMPLEMENTED,
+			"packets can be written only after whole packets");
+		return false;
+	}
+	return true;
+}
+
+/*
+	Combine the peaks of frames written at the track's next frame
+	with those of the frames before them.
+*/
+static void addPeaks (Track *track, const std::vector<Peak> &peaks)
+{
+	for (size_t i=0; i<peaks.size(); i++)
+	{
+		if (peaks[i].value > track->peaks[i].value)
+		{
+			track->peaks[i].value = peaks[i].value;
+			track->peaks[i].position = track->nextfframe + peaks[i].position;
+		}
+	}
+}
+
+// Account for encoded data written at the track's next frame.
+static void advanceWrittenFrames (Track *track, AFfileoffset bytes,
+	AFframecount frames)
+{
+	track->fpos_next_frame += bytes;
+	AFfileoffset dataEnd = track->fpos_next_frame - track->fpos_first_frame;
+	if (dataEnd > track->data_size)
+		track->data_size = dataEnd;
+
+	track->nextfframe += frames;
+	if (track->nextfframe > track->totalfframes)
+		track->totalfframes = track->nextfframe;
+	track->nextvframe = llrint(track->nextfframe * track->v.sampleRate /
+		track->f.sampleRate);
+	if (track->nextvframe > track->totalvframes)
+		track->totalvframes = track->nextvframe;
+}
+
+int afWritePackets (AFfilehandle file, int trackid, const void *buffer,
+	int packetCount, const int *packetSizes, AFframecount frameCount)
+{
+	if (!_af_filehandle_ok(file))
+		return -1;
+
+	if (!file->checkCanWrite() ||
+		file->switchAccess(_AF_WRITE_ACCESS) == AF_FAIL)
+		return -1;
+
+	Track *track = file->getTrack(trackid);
+	if (!track)
+		return -1;
+
+	AFframecount framesPerPacket;
+	AFfileoffset bytesPerPacket;
+	if (!getPacketSize(track, &framesPerPacket, &bytesPerPacket))
+		return -1;
+
+	if (track->ms->isDirty() && track->ms->setup(file, track) == AF_FAIL)
+		return -1;
+
+	// Only the last packet written may hold fewer frames than the others.
+	if (packetCount < 0 || frameCount < 0 ||
+		frameCount > packetCount * framesPerPacket ||
+		(packetCount > 0 && frameCount <= (packetCount - 1) * framesPerPacket))
+	{
+		_af_error(AF_BAD_FRAMECNT,
+			"%jd frames cannot be held in %d packets of %jd frames",
+			static_cast<intmax_t>(frameCount), packetCount,
+			static_cast<intmax_t>(framesPerPacket));
+		return -1;
+	}
+
+	PacketTable *packetTable = bytesPerPacket ? NULL : track->m_packetTable.get();
+	if (!canAppendPackets(track, framesPerPacket))
+		return -1;
+
+	size_t bytesToWrite = 0;
+	for (int i=0; i<packetCount; i++)
+	{
+		AFfileoffset size = packetSizes ? packetSizes[i] : bytesPerPacket;
+		if (size <= 0 || (bytesPerPacket && size != bytesPerPacket))
+		{
+			_af_error(AF_BAD_CODEC_CONFIG,
+				"invalid size %jd of packet %d", static_cast<intmax_t>(size), i);
+			return -1;
+		}
+		bytesToWrite += size;
+	}
+
+	if (file->m_seekok &&
+		file->m_fh->seek(track->fpos_next_frame, File::SeekFromBeginning) !=
+			track->fpos_next_frame)
+	{
+		_af_error(AF_BAD_LSEEK, "unable to position write pointer at next frame");
+		return -1;
+	}
+
+	ssize_t bytesWritten = file->m_fh->write(buffer, bytesToWrite);
+	if (bytesWritten != static_cast<ssize_t>(bytesToWrite))
+	{
+		_af_error(AF_BAD_WRITE, "unable to write packets");
+		return -1;
+	}
+
+	if (packetTable)
+	{
+		for (int i=0; i<packetCount; i++)
+			packetTable->append(packetSizes[i]);
+		packetTable->setNumValidFrames(packetTable->numValidFrames() +
+			frameCount);
+	}
+
+	// The samples of encoded packets are not measured.
+	if (frameCount > 0 && track->computesPeaks)
+		track->discardPeaks();
+
+	advanceWrittenFrames(track, bytesWritten, frameCount);
+
+	return packetCount;
+}
+
+/*
+	Compare a parameter which tells a codec how packets are encoded,
+	such as the type of IMA ADPCM, the coefficients of MS ADPCM or
+	the magic cookie of ALAC.  A parameter is alike when neither
+	track has it.
+*/
+static bool haveIdenticalLongParameter (AUpvlist p, AUpvlist q, int param,
+	long *value)
+{
+	long x = 0, y = 0;
+	bool hasX = p != AU_NULL_PVLIST && _af_pv_getlong(p, param, &x);
+	bool hasY = q != AU_NULL_PVLIST && _af_pv_getlong(q, param, &y);
+	*value = x;
+	return hasX == hasY && x == y;
+}
+
+static bool haveIdenticalDataParameter (AUpvlist p, AUpvlist q, int param,
+	size_t size)
+{
+	void *x = NULL, *y = NULL;
+	bool hasX = p != AU_NULL_PVLIST && _af_pv_getptr(p, param, &x);
+	bool hasY = q != AU_NULL_PVLIST && _af_pv_getptr(q, param, &y);
+	if (hasX != hasY)
+		return false;
+	return !hasX || size == 0 || (x && y && memcmp(x, y, size) == 0);
+}
+
+static bool haveIdenticalCodecParameters (const Track *a, const Track *b)
+{
+	AUpvlist p = a->f.compressionParams, q = b->f.compressionParams;
+	long value;
+
+	if (!haveIdenticalLongParameter(p, q, _AF_IMA_ADPCM_TYPE, &value))
+		return false;
+
+	if (!haveIdenticalLongParameter(p, q, _AF_MS_ADPCM_NUM_COEFFICIENTS,
+			&value) ||
+		!haveIdenticalDataParameter(p, q, _AF_MS_ADPCM_COEFFICIENTS,
+			value * 2 * sizeof (int16_t)))
+		return false;
+
+	return haveIdenticalLongParameter(p, q, _AF_CODEC_DATA_SIZE, &value) &&
+		haveIdenticalDataParameter(p, q, _AF_CODEC_DATA, value);
+}
+
+/*
+	The audio data of two tracks is stored identically when they have
+	the same sample rate, number of channels and fixed-size packets,
+	and their samples are encoded alike with the same codec
+	parameters.
+*/
+static bool haveIdenticalData (const Track *a, const Track *b)
+{
+	const AudioFormat &f = a->f, &g = b->f;
+	if (f.sampleRate != g.sampleRate ||
+		f.channelCount != g.channelCount ||
+		f.compressionType != g.compressionType)
+		return false;
+
+	if (f.isUncompressed())
+		return f.sampleFormat == g.sampleFormat &&
+			f.sampleWidth == g.sampleWidth &&
+			(f.bytesPerSample(false) == 1 || f.byteOrder == g.byteOrder);
+
+	return !a->m_packetTable && !b->m_packetTable &&
+		f.framesPerPacket == g.framesPerPacket &&
+		f.bytesPerPacket == g.bytesPerPacket &&
+		haveIdenticalCodecParameters(a, b);
+}
+
+AFframecount afRemuxTrack (AFfilehandle infile, AFfilehandle outfile,
+	int trackid)
+{
+	if (!_af_filehandle_ok(infile) || !_af_filehandle_ok(outfile))
+		return -1;
+
+	if (!infile->checkCanRead() ||
+		infile->switchAccess(_AF_READ_ACCESS) == AF_FAIL ||
+		!outfile->checkCanWrite() ||
+		outfile->switchAccess(_AF_WRITE_ACCESS) == AF_FAIL)
+		return -1;
+
+	Track *inTrack = infile->getTrack(trackid);
+	Track *outTrack = outfile->getTrack(trackid);
+	if (!inTrack || !outTrack)
+		return -1;
+
+	if (!haveIdenticalData(inTrack, outTrack))
+	{
+		_af_error(AF_BAD_NOT_IMPLEMENTED,
+			"audio data of the tracks is not stored identically");
+		return -1;
+	}
+
+	if (inTrack->totalfframes == -1)
+	{
+		_af_error(AF_BAD_NOT_IMPLEMENTED,
+			"audio data of unknown length cannot be remuxed");
+		return -1;
+	}
+
+	AFframecount framesPerPacket;
+	AFfileoffset bytesPerPacket;
+	if (!getPacketSize(inTrack, &framesPerPacket, &bytesPerPacket))
+		return -1;
+
+	if (outTrack->ms->isDirty() &&
+		outTrack->ms->setup(outfile, outTrack) == AF_FAIL)
+		return -1;
+
+	if (!canAppendPackets(outTrack, framesPerPacket))
+		return -1;
+
+	// Copy whole packets from the one holding the next frame onward.
+	AFframecount frame = llrint(inTrack->nextvframe * inTrack->f.sampleRate /
+		inTrack->v.sampleRate);
+	AFframecount packet = frame / framesPerPacket;
+	AFframecount packetCount = 0;
+	if (frame < inTrack->totalfframes)
+		packetCount = (inTrack->totalfframes + framesPerPacket - 1) /
+			framesPerPacket - packet;
+	AFframecount frameCount = packetCount > 0 ?
+		inTrack->totalfframes - packet * framesPerPacket : 0;
+
+	AFfileoffset bytesToCopy = packetCount * bytesPerPacket;
+	AFfileoffset offset = inTrack->fpos_first_frame + packet * bytesPerPacket;
+
+	if (outfile->m_seekok &&
+		outfile->m_fh->seek(outTrack->fpos_next_frame, File::SeekFromBeginning) !=
+			outTrack->fpos_next_frame)
+	{
+		_af_error(AF_BAD_LSEEK, "unable to position write pointer at next frame");
+		return -1;
+	}
+
+	/*
+		The data is copied by the operating system where possible,
+		which on some file systems shares it between the files
+		rather than duplicating it.
+	*/
+	AFfileoffset bytesCopied = 0;
+	while (bytesCopied < bytesToCopy)
+	{
+		size_t n = std::min<AFfileoffset>(bytesToCopy - bytesCopied, 1 << 30);
+		ssize_t result = outfile->m_fh->copyFrom(infile->m_fh,
+			offset + bytesCopied, n);
+		if (result <= 0)
+			break;
+		bytesCopied += result;
+	}
+
+	if (bytesCopied < bytesToCopy)
+	{
+		_af_error(AF_BAD_WRITE,
+			"unable to copy audio data -- copied %jd of %jd bytes",
+			static_cast<intmax_t>(bytesCopied),
+			static_cast<intmax_t>(bytesToCopy));
+		return -1;
+	}
+
+	/*
+		The stored peaks of a whole track carry over to the frames
+		copied from it to the end of the output track; otherwise the
+		peaks are no longer known.
+	*/
+	if (frameCount > 0 && outTrack->computesPeaks)
+	{
+		if (packet == 0 && inTrack->peaks.size() == outTrack->peaks.size() &&
+			outTrack->nextfframe == outTrack->totalfframes)
+			addPeaks(outTrack, inTrack->peaks);
+		else
+			outTrack->discardPeaks();
+	}
+
+	advanceWrittenFrames(outTrack, bytesCopied, frameCount);
+
+	inTrack->nextvframe = llrint(inTrack->totalfframes *
+		inTrack->v.sampleRate / inTrack->f.sampleRate);
+	inTrack->ms->setDirty();
+
+	return frameCount;
+}
@@ -103,7 +103,8 @@ AFframecount afSeekFrame (AFfilehandle file, int trackid, AFframecount frame)
 	if (!_af_filehandle_ok(file))
 		return -1;
 
-	if (!file->checkCanRead())
+	if (!file->checkCanRead() ||
+		file->switchAccess(_AF_READ_ACCESS) == AF_FAIL)
 		return -1;
 
 	Track *track = file->getTrack(trackid);
@@ -139,6 +140,8 @@ AFframecount afSeekFrame (AFfilehandle file, int trackid, AFframecount frame)
 	if (track->ms->setup(file, track) == AF_FAIL)
 		return -1;
 
+	file->adviseAccess(track, true);
+
 	return track->nextvframe;
 }
 
@@ -147,6 +150,32 @@ AFfileoffset afTellFrame (AFfilehandle file, int trackid)
 	return afSeekFrame(file, trackid, -1);
 }
 
+int afSetAccessHint (AFfilehandle file, int hint, AFframecount prefetchFrames)
+{
+	if (!_af_filehandle_ok(file))
+		return -1;
+
+	if (!file->checkCanRead())
+		return -1;
+
+	if (hint != AF_ACCESS_NORMAL && hint != AF_ACCESS_SEQUENTIAL &&
+		hint != AF_ACCESS_RANDOM)
+	{
+		_af_error(AF_BAD_ACCMODE, "invalid access hint %d", hint);
+		return -1;
+	}
+
+	if (prefetchFrames < 0)
+	{
+		_af_error(AF_BAD_FRAMECNT, "invalid number of frames to prefetch %jd",
+			static_cast<intmax_t>(prefetchFrames));
+		return -1;
+	}
+
+	file->setAccessHint(hint, prefetchFrames);
+	return 0;
+}
+
 int afSetVirtualByteOrder (AFfilehandle file, int trackid, int byteorder)
 {
 	if (!_af_filehandle_ok(file))
@@ -26,6 +26,7 @@
 #include "File.h"
 #include "FileModule.h"
 #include "PacketTable.h"
+#include "SeekIndex.h"
 #include "SimpleModule.h"
 #include "Track.h"
 #include "afinternal.h"
@@ -50,6 +51,9 @@ enum
 	kALACFormatFlag_32BitSourceData = 4
 };
 
+// Bytes the ALAC bit reader may access beyond the end of a packet.
+static const size_t kBitReaderSlack = 8;
+
 class ALAC : public FileModule
 {
 public:
@@ -77,15 +81,27 @@ private:
 	AFframecount m_framesToIgnore;
 	AFfileoffset m_savedPositionNextFrame;
 	AFframecount m_savedNextFrame;
+	/*
+		State of the packet table and size of the audio data before
+		the partial packet written by the last sync, or -1 if that
+		packet has since been replaced.
+	*/
+	AFfileoffset m_savedDataSize;
+	size_t m_savedPacketCount;
+	AFframecount m_savedValidFrames;
 
 	SharedPtr<Buffer> m_codecData;
 	ALACDecoder *m_decoder;
 	ALACEncoder *m_encoder;
 	int m_currentPacket;
+	// Offset of the current packet from the start of the audio data.
+	AFfileoffset m_currentOffset;
 
 	ALAC(Mode mode, Track *track, File *fh, bool canSeek, Buffer *codecData);
 	void initDecoder();
 	void initEncoder();
+	void discardSyncedPacket();
+	AFfileoffset startOfPacket(int packet) const;
 
 	AudioFormatDescription outputFormat() const;
 };
@@ -94,10 +110,14 @@ ALAC::ALAC(Mode mode, Track *track, File *fh, bool canSeek, Buffer *codecData) :
 	FileModule(mode, track, fh, canSeek),
 	m_savedPositionNextFrame(-1),
 	m_savedNextFrame(-1),
+	m_savedDataSize(-1),
+	m_savedPacketCount(0),
+	m_savedValidFrames(0),
 	m_codecData(codecData),
 	m_decoder(NULL),
 	m_encoder(NULL),
-	m_currentPacket(0)
+	m_currentPacket(0),
+	m_currentOffset(0)
 {
 	if (mode == Decompress)
 		initDecoder();
@@ -237,14 +257,29 @@ void ALAC::runPull()
 	ssize_t bytesPerPacket = packetTable->bytesPerPacket(m_currentPacket);
 	assert(bytesPerPacket <= bufferSize());
 
-	if (read(m_inChunk->buffer, bytesPerPacket) < bytesPerPacket)
+	if (m_track->seekIndex)
+		m_track->seekIndex->add(m_currentPacket * m_track->f.framesPerPacket,
+			m_currentOffset, m_currentPacket);
+
+	/*
+		The bit reader may look a few bytes past the end of the
+		packet, so only decode in place when that much of the
+		mapping follows it.
+	*/
+	const void *packet = NULL;
+	if (borrow(&packet, bytesPerPacket, kBitReaderSlack) < 0)
 	{
-		reportReadError(0, m_track->f.framesPerPacket);
-		return;
+		packet = m_inChunk->buffer;
+		if (read(m_inChunk->buffer, bytesPerPacket) < bytesPerPacket)
+		{
+			reportReadError(0, m_track->f.framesPerPacket);
+			return;
+		}
 	}
 
 	BitBuffer bitBuffer;
-	BitBufferInit(&bitBuffer, static_cast<uint8_t *>(m_inChunk->buffer),
+	BitBufferInit(&bitBuffer,
+		const_cast<uint8_t *>(static_cast<const uint8_t *>(packet)),
 		bytesPerPacket);
 
 	uint32_t numFrames;
@@ -253,6 +288,7 @@ void ALAC::runPull()
 	m_outChunk->frameCount = numFrames;
 
 	m_currentPacket++;
+	m_currentOffset += bytesPerPacket;
 }
 
 void ALAC::reset1()
@@ -265,11 +301,31 @@ void ALAC::reset1()
 
 void ALAC::reset2()
 {
-	m_track->fpos_next_frame = m_track->fpos_first_frame +
-		m_track->m_packetTable->startOfPacket(m_currentPacket);
+	m_currentOffset = startOfPacket(m_currentPacket);
+	m_track->fpos_next_frame = m_track->fpos_first_frame + m_currentOffset;
 	m_track->frames2ignore += m_framesToIgnore;
 }
 
+/*
+	Finding the start of a packet means adding up the sizes of the
+	packets before it.  With a seek index only the packets after the
+	last restart point before it need be added.
+*/
+AFfileoffset ALAC::startOfPacket(int packet) const
+{
+	SharedPtr<PacketTable> packetTable = m_track->m_packetTable;
+	const SeekIndex::Entry *entry = m_track->seekIndex ?
+		m_track->seekIndex->find(static_cast<AFframecount>(packet) *
+			m_track->f.framesPerPacket) : NULL;
+	if (!entry || entry->packet > packet)
+		return packetTable->startOfPacket(packet);
+
+	AFfileoffset offset = entry->offset;
+	for (int64_t i=entry->packet; i<packet; i++)
+		offset += packetTable->bytesPerPacket(i);
+	return offset;
+}
+
 int ALAC::bufferSize() const
 {
 	return m_track->f.framesPerPacket * m_track->f.channelCount *
@@ -278,6 +334,8 @@ int ALAC::bufferSize() const
 
 void ALAC::runPush()
 {
+	discardSyncedPacket();
+
 	AudioFormatDescription inputFormat;
 	inputFormat.mSampleRate = m_track->f.sampleRate;
 	inputFormat.mFormatID = kALACFormatLinearPCM;
@@ -320,8 +378,13 @@ void ALAC::runPush()
 
 void ALAC::sync1()
 {
+	discardSyncedPacket();
+
 	m_savedPositionNextFrame = m_track->fpos_next_frame;
 	m_savedNextFrame = m_track->nextfframe;
+	m_savedPacketCount = m_track->m_packetTable->numPackets();
+	m_savedValidFrames = m_track->m_packetTable->numValidFrames();
+	m_encoder->SaveState();
 }
 
 void ALAC::sync2()
@@ -329,9 +392,29 @@ void ALAC::sync2()
 	assert(!canSeek() || (tell() == m_track->fpos_next_frame));
 
 	m_track->fpos_after_data = tell();
+	m_savedDataSize = m_track->data_size -
+		(m_track->fpos_next_frame - m_savedPositionNextFrame);
 
 	m_track->fpos_next_frame = m_savedPositionNextFrame;
 	m_track->nextfframe = m_savedNextFrame;
+	m_encoder->RestoreState();
+}
+
+/*
+	The partial packet written by a sync stays in the packet table
+	and in the size of the audio data so that the header written by
+	the sync covers it.  Remove it once it is about to be encoded
+	again.
+*/
+void ALAC::discardSyncedPacket()
+{
+	if (m_savedDataSize == -1)
+		return;
+
+	m_track->data_size = m_savedDataSize;
+	m_track->m_packetTable->truncate(m_savedPacketCount);
+	m_track->m_packetTable->setNumValidFrames(m_savedValidFrames);
+	m_savedDataSize = -1;
 }
 
 bool _af_alac_format_ok (AudioFormat *f)
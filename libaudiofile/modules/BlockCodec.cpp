@@ -31,7 +31,8 @@ BlockCodec::BlockCodec(Mode mode, Track *track, File *fh, bool canSeek) :
 	m_framesPerPacket(-1),
 	m_framesToIgnore(-1),
 	m_savedPositionNextFrame(-1),
-	m_savedNextFrame(-1)
+	m_savedNextFrame(-1),
+	m_savedDataSize(-1)
 {
 	m_framesPerPacket = track->f.framesPerPacket;
 	m_bytesPerPacket = track->f.bytesPerPacket;
@@ -45,14 +46,20 @@ void BlockCodec::runPull()
 	assert(framesToRead % m_framesPerPacket == 0);
 	int blockCount = framesToRead / m_framesPerPacket;
 
-	// Read the compressed data.
-	ssize_t bytesRead = read(m_inChunk->buffer, m_bytesPerPacket * blockCount);
+	// Read the compressed data, decoding in place if the file is mapped.
+	const void *compressed = NULL;
+	ssize_t bytesRead = borrow(&compressed, m_bytesPerPacket * blockCount);
+	if (bytesRead < 0)
+	{
+		compressed = m_inChunk->buffer;
+		bytesRead = read(m_inChunk->buffer, m_bytesPerPacket * blockCount);
+	}
 	int blocksRead = bytesRead >= 0 ? bytesRead / m_bytesPerPacket : 0;
 
 	// Decompress into m_outChunk.
 	for (int i=0; i<blocksRead; i++)
 	{
-		decodeBlock(static_cast<const uint8_t *>(m_inChunk->buffer) + i * m_bytesPerPacket,
+		decodeBlock(static_cast<const uint8_t *>(compressed) + i * m_bytesPerPacket,
 			static_cast<int16_t *>(m_outChunk->buffer) + i * m_framesPerPacket * m_track->f.channelCount);
 
 		framesRead += m_framesPerPacket;
@@ -62,7 +69,7 @@ void BlockCodec::runPull()
 
 	assert(tell() == m_track->fpos_next_frame);
 
-	if (framesRead < framesToRead)
+	if (framesRead < framesToRead && m_track->totalfframes != -1)
 		reportReadError(framesRead, framesToRead);
 
 	m_outChunk->frameCount = framesRead;
@@ -91,6 +98,8 @@ void BlockCodec::runPush()
 	AFframecount framesToWrite = m_inChunk->frameCount;
 	int channelCount = m_inChunk->f.channelCount;
 
+	discardSyncedBlock();
+
 	int blockCount = (framesToWrite + m_framesPerPacket - 1) / m_framesPerPacket;
 	for (int i=0; i<blockCount; i++)
 	{
@@ -113,14 +122,34 @@ void BlockCodec::runPush()
 
 void BlockCodec::sync1()
 {
+	discardSyncedBlock();
+
 	m_savedPositionNextFrame = m_track->fpos_next_frame;
 	m_savedNextFrame = m_track->nextfframe;
+	saveEncoderState();
 }
 
 void BlockCodec::sync2()
 {
 	assert(tell() == m_track->fpos_next_frame);
 	m_track->fpos_after_data = tell();
+	m_savedDataSize = m_track->data_size -
+		(m_track->fpos_next_frame - m_savedPositionNextFrame);
 	m_track->fpos_next_frame = m_savedPositionNextFrame;
 	m_track->nextfframe = m_savedNextFrame;
+	restoreEncoderState();
+}
+
+/*
+	The partial block written by a sync is counted in the size of
+	the audio data so that the header written by the sync covers
+	it.  Stop counting it once it is about to be overwritten.
+*/
+void BlockCodec::discardSyncedBlock()
+{
+	if (m_savedDataSize != -1)
+	{
+		m_track->data_size = m_savedDataSize;
+		m_savedDataSize = -1;
+	}
 }
@@ -41,11 +41,28 @@ protected:
 	AFframecount m_framesToIgnore;
 	AFfileoffset m_savedPositionNextFrame;
 	AFframecount m_savedNextFrame;
+	/*
+		Size of the audio data before the partial block written by
+		the last sync, or -1 if that block has since been replaced.
+	*/
+	AFfileoffset m_savedDataSize;
 
 	BlockCodec(Mode, Track *, File *, bool canSeek);
 
 	virtual int decodeBlock(const uint8_t *encoded, int16_t *decoded) = 0;
 	virtual int encodeBlock(const int16_t *decoded, uint8_t *encoded) = 0;
+
+	/*
+		An encoder which carries state from one block to the next
+		saves it before a sync encodes a partial block and restores
+		it afterward, so that the block is encoded from the same
+		state again once it is complete.
+	*/
+	virtual void saveEncoderState() { }
+	virtual void restoreEncoderState() { }
+
+private:
+	void discardSyncedBlock();
 };
 
 #endif
@@ -24,6 +24,7 @@
 #include "Compiler.h"
 #include "FileModule.h"
 #include "Features.h"
+#include "SeekIndex.h"
 #include "Track.h"
 #include "byteorder.h"
 
@@ -31,6 +32,7 @@
 
 #include <FLAC/stream_decoder.h>
 #include <FLAC/stream_encoder.h>
+#include <algorithm>
 #include <assert.h>
 #include <string.h>
 #include <vector>
@@ -59,7 +61,17 @@ private:
 	std::vector<int32_t *> m_buffer;
 	int m_bufferedFrames, m_bufferedOffset;
 
+	// Frames to be discarded from the start of the next decoded frames.
+	AFframecount m_framesToSkip;
+	// Whether a frame was decoded by the last call to the decoder.
+	bool m_frameDecoded;
+	// The first and last frames + 1 of the last decoded FLAC frame.
+	AFframecount m_decodedStart, m_decodedEnd;
+
 	void convertAndInterleave(int offset, int frameCount);
+	bool decodeFrame();
+	void recordRestartPoint();
+	bool seekToRestartPoint();
 
 	static FLAC__StreamDecoderReadStatus readCallback(const FLAC__StreamDecoder *, FLAC__byte buffer[], size_t *bytes, void *clientData)
 	{
@@ -106,7 +118,8 @@ private:
 	static FLAC__bool eofCallback(const FLAC__StreamDecoder *, void *clientData)
 	{
 		FLACDecoder *flac = static_cast<FLACDecoder *>(clientData);
-		return flac->tell() == flac->length();
+		off_t length = flac->length();
+		return length >= 0 && flac->tell() == length;
 	}
 
 	static FLAC__StreamDecoderWriteStatus writeCallback(const FLAC__StreamDecoder *, const FLAC__Frame *frame, const FLAC__int32 * const buffer[], void *clientData)
@@ -127,12 +140,19 @@ private:
 
 	void didDecodeFrame(const FLAC__Frame *frame, const FLAC__int32 * const buffer[])
 	{
+		int skip = std::min<AFframecount>(m_framesToSkip, frame->header.blocksize);
+		m_framesToSkip -= skip;
+
 		m_bufferedFrames = frame->header.blocksize;
-		m_bufferedOffset = 0;
+		m_bufferedOffset = skip;
 		for (unsigned c=0; c<frame->header.channels; c++)
 			memcpy(m_buffer[c], buffer[c], frame->header.blocksize * sizeof (int32_t));
 
-		m_track->nextfframe += frame->header.blocksize;
+		m_frameDecoded = true;
+		m_decodedStart = frame->header.number.sample_number;
+		m_decodedEnd = m_decodedStart + frame->header.blocksize;
+
+		m_track->nextfframe += frame->header.blocksize - skip;
 	}
 };
 
@@ -146,7 +166,11 @@ FLACDecoder::FLACDecoder(Track *track, File *file, bool canSeek) :
 	FileModule(Decompress, track, file, canSeek),
 	m_decoder(NULL),
 	m_bufferedFrames(0),
-	m_bufferedOffset(0)
+	m_bufferedOffset(0),
+	m_framesToSkip(0),
+	m_frameDecoded(false),
+	m_decodedStart(0),
+	m_decodedEnd(0)
 {
 	m_decoder = FLAC__stream_decoder_new();
 
@@ -250,25 +274,110 @@ void FLACDecoder::runPull()
 
 		if (framesToRead > 0)
 		{
-			if (!FLAC__stream_decoder_process_single(m_decoder))
+			if (!decodeFrame())
 				break;
 			if (FLAC__stream_decoder_get_state(m_decoder) >= FLAC__STREAM_DECODER_END_OF_STREAM)
 				break;
+			recordRestartPoint();
 		}
 	}
 }
 
+bool FLACDecoder::decodeFrame()
+{
+	m_frameDecoded = false;
+	return FLAC__stream_decoder_process_single(m_decoder);
+}
+
+/*
+	Record the end of the FLAC frame just decoded, where the next one
+	begins, as a restart point of the track's seek index.
+*/
+void FLACDecoder::recordRestartPoint()
+{
+	FLAC__uint64 position;
+	if (m_track->seekIndex && m_frameDecoded &&
+		FLAC__stream_decoder_get_decode_position(m_decoder, &position))
+		m_track->seekIndex->add(m_decodedEnd, position, 0);
+}
+
+/*
+	Seek by decoding from the last restart point of the seek index at
+	or before the track's next frame, which reads only a few FLAC
+	frames rather than bisecting a file without a seek table.
+	Returns false, with the decoder still able to seek on its own, if
+	there is no usable restart point.
+*/
+bool FLACDecoder::seekToRestartPoint()
+{
+	if (!m_track->seekIndex)
+		return false;
+
+	AFframecount frame = m_track->nextfframe;
+	const SeekIndex::Entry *entry = m_track->seekIndex->find(frame);
+	if (!entry || (m_track->totalfframes != -1 &&
+		entry->frame >= m_track->totalfframes))
+		return false;
+
+	// The stream's metadata must be read before any frame is decoded.
+	if (FLAC__stream_decoder_get_state(m_decoder) ==
+		FLAC__STREAM_DECODER_SEARCH_FOR_METADATA &&
+		(seek(0) != 0 ||
+		!FLAC__stream_decoder_process_until_end_of_metadata(m_decoder)))
+		return false;
+
+	if (seek(entry->offset) != entry->offset ||
+		!FLAC__stream_decoder_flush(m_decoder))
+		return false;
+
+	m_framesToSkip = frame - entry->frame;
+	m_bufferedFrames = m_bufferedOffset = 0;
+
+	// The first FLAC frame decoded must begin at the restart point.
+	if (!decodeFrame() || !m_frameDecoded || m_decodedStart != entry->frame)
+	{
+		m_framesToSkip = 0;
+		m_bufferedFrames = m_bufferedOffset = 0;
+		m_track->nextfframe = frame;
+		FLAC__stream_decoder_flush(m_decoder);
+		return false;
+	}
+
+	return true;
+}
+
 void FLACDecoder::reset1()
 {
 }
 
 void FLACDecoder::reset2()
 {
+	if (!canSeek())
+	{
+		/*
+			A non-seekable file can only be decoded from the
+			start, and its metadata is still in the file's buffer.
+		*/
+		if (m_track->nextfframe != 0 || seek(0) != 0 ||
+			!FLAC__stream_decoder_process_until_end_of_metadata(m_decoder))
+		{
+			_af_error(AF_BAD_CODEC_CONFIG, "could not seek to frame %jd",
+				static_cast<intmax_t>(m_track->nextfframe));
+		}
+		return;
+	}
+
+	if (seekToRestartPoint())
+		return;
+
+	m_frameDecoded = false;
 	if (!FLAC__stream_decoder_seek_absolute(m_decoder, m_track->nextfframe))
 	{
 		_af_error(AF_BAD_CODEC_CONFIG, "could not seek to frame %jd",
 			static_cast<intmax_t>(m_track->nextfframe));
+		return;
 	}
+	recordRestartPoint();
 }
 
 class FLACEncoder : public FileModule
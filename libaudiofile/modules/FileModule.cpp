@@ -47,13 +47,38 @@ ssize_t FileModule::read(void *data, size_t nbytes)
 	return bytesRead;
 }
 
+ssize_t FileModule::borrow(const void **data, size_t nbytes, size_t padding)
+{
+	off_t offset = m_fh->tell();
+	if (offset < 0)
+		return -1;
+	ssize_t bytesBorrowed = m_fh->borrow(offset, nbytes + padding, data);
+	if (bytesBorrowed < 0)
+		return -1;
+	if (padding)
+	{
+		if (static_cast<size_t>(bytesBorrowed) < nbytes + padding)
+			return -1;
+		bytesBorrowed = nbytes;
+	}
+	if (bytesBorrowed > 0)
+	{
+		m_fh->seek(offset + bytesBorrowed, File::SeekFromBeginning);
+		m_track->fpos_next_frame += bytesBorrowed;
+	}
+	return bytesBorrowed;
+}
+
 ssize_t FileModule::write(const void *data, size_t nbytes)
 {
 	ssize_t bytesWritten = m_fh->write(data, nbytes);
 	if (bytesWritten > 0)
 	{
 		m_track->fpos_next_frame += bytesWritten;
-		m_track->data_size += bytesWritten;
+		// Data written over existing data leaves its size unchanged.
+		AFfileoffset dataEnd = m_track->fpos_next_frame - m_track->fpos_first_frame;
+		if (dataEnd > m_track->data_size)
+			m_track->data_size = dataEnd;
 	}
 	return bytesWritten;
 }
@@ -116,6 +141,15 @@ void FileModule::reportWriteError(AFframecount framesWritten,
 	m_track->filemodhappy = false;
 }
 
+status FileModule::flush()
+{
+	if (m_fh->flush() == 0)
+		return AF_SUCCEED;
+
+	reportWriteError(-1, 0);
+	return AF_FAIL;
+}
+
 int FileModule::bufferSize() const
 {
 	if (mode() == Compress)
@@ -30,6 +30,9 @@ public:
 
 	virtual int bufferSize() const;
 
+	// Write out any data which the file is holding back.
+	status flush();
+
 protected:
 	enum Mode { Compress, Decompress };
 	FileModule(Mode, Track *, File *fh, bool canSeek);
@@ -38,6 +41,13 @@ protected:
 	bool canSeek() const { return m_canSeek; }
 
 	ssize_t read(void *data, size_t nbytes);
+	/*
+		Like read(), but lends the bytes in place when the underlying
+		file supports it. Returns -1 if it does not, or if fewer than
+		padding readable bytes follow the requested range, in which
+		case the caller should fall back to read().
+	*/
+	ssize_t borrow(const void **data, size_t nbytes, size_t padding = 0);
 	ssize_t write(const void *data, size_t nbytes);
 	off_t seek(off_t offset);
 	off_t tell();
@@ -147,7 +147,8 @@ void G711::runPush()
 		reportWriteError(framesWritten, framesToWrite);
 
 	m_track->nextfframe += framesWritten;
-	m_track->totalfframes = m_track->nextfframe;
+	if (m_track->nextfframe > m_track->totalfframes)
+		m_track->totalfframes = m_track->nextfframe;
 
 	assert(!canSeek() || (tell() == m_track->fpos_next_frame));
 }
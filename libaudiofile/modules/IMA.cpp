@@ -26,6 +26,7 @@
 #include "config.h"
 #include "IMA.h"
 
+#include <algorithm>
 #include <assert.h>
 
 #include <audiofile.h>
@@ -71,6 +72,7 @@ public:
 private:
 	int m_imaType;
 	adpcmState *m_adpcmState;
+	adpcmState *m_savedAdpcmState;
 
 	IMA(Mode, Track *, File *fh, bool canSeek);
 
@@ -81,6 +83,9 @@ private:
 	int encodeBlock(const int16_t *input, uint8_t *output) OVERRIDE;
 	int encodeBlockWAVE(const int16_t *input, uint8_t *output);
 	int encodeBlockQT(const int16_t *input, uint8_t *output);
+
+	void saveEncoderState() OVERRIDE;
+	void restoreEncoderState() OVERRIDE;
 };
 
 IMA::IMA(Mode mode, Track *track, File *fh, bool canSeek) :
@@ -97,11 +102,25 @@ IMA::IMA(Mode mode, Track *track, File *fh, bool canSeek) :
 		m_imaType = l;
 
 	m_adpcmState = new adpcmState[track->f.channelCount];
+	m_savedAdpcmState = new adpcmState[track->f.channelCount];
 }
 
 IMA::~IMA()
 {
 	delete [] m_adpcmState;
+	delete [] m_savedAdpcmState;
+}
+
+void IMA::saveEncoderState()
+{
+	std::copy(m_adpcmState, m_adpcmState + m_track->f.channelCount,
+		m_savedAdpcmState);
+}
+
+void IMA::restoreEncoderState()
+{
+	std::copy(m_savedAdpcmState, m_savedAdpcmState + m_track->f.channelCount,
+		m_adpcmState);
 }
 
 int IMA::decodeBlock(const uint8_t *encoded, int16_t *decoded)
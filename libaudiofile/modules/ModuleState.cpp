@@ -41,7 +41,8 @@
 #include <stdio.h>
 
 ModuleState::ModuleState() :
-	m_isDirty(true)
+	m_isDirty(true),
+	m_generation(0)
 {
 }
 
@@ -49,7 +50,7 @@ ModuleState::~ModuleState()
 {
 }
 
-status ModuleState::initFileModule(AFfilehandle file, Track *track)
+status ModuleState::initFileModule(AFfilehandle file, Track *track, File *fh)
 {
 	const CompressionUnit *unit = _af_compression_unit_from_id(track->f.compressionType);
 	if (!unit)
@@ -59,8 +60,18 @@ status ModuleState::initFileModule(AFfilehandle file, Track *track)
 	if (!unit->fmtok(&track->f))
 		return AF_FAIL;
 
-	if (file->m_seekok &&
-		file->m_fh->seek(track->fpos_first_frame, File::SeekFromBeginning) !=
+	if (!fh)
+		fh = file->m_fh;
+
+	/*
+		A non-seekable file is positioned only if it tracks its
+		offset; a buffered pipe can then skip forward to the sound
+		data or return to it within its buffer.
+	*/
+	bool positionFile = file->m_seekok ||
+		(fh->tell() >= 0 && fh->tell() != track->fpos_first_frame);
+	if (positionFile &&
+		fh->seek(track->fpos_first_frame, File::SeekFromBeginning) !=
 			track->fpos_first_frame)
 	{
 		_af_error(AF_BAD_LSEEK, "unable to position file handle at beginning of sound data");
@@ -69,10 +80,10 @@ status ModuleState::initFileModule(AFfilehandle file, Track *track)
 
 	AFframecount chunkFrames;
 	if (file->m_access == _AF_READ_ACCESS)
-		m_fileModule = unit->initdecompress(track, file->m_fh, file->m_seekok,
+		m_fileModule = unit->initdecompress(track, fh, file->m_seekok,
 			file->m_fileFormat == AF_FILE_RAWDATA, &chunkFrames);
 	else
-		m_fileModule = unit->initcompress(track, file->m_fh, file->m_seekok,
+		m_fileModule = unit->initcompress(track, fh, file->m_seekok,
 			file->m_fileFormat == AF_FILE_RAWDATA, &chunkFrames);
 
 	if (unit->needsRebuffer)
@@ -93,9 +104,9 @@ status ModuleState::initFileModule(AFfilehandle file, Track *track)
 	return AF_SUCCEED;
 }
 
-status ModuleState::init(AFfilehandle file, Track *track)
+status ModuleState::init(AFfilehandle file, Track *track, File *fh)
 {
-	if (initFileModule(file, track) == AF_FAIL)
+	if (initFileModule(file, track, fh) == AF_FAIL)
 		return AF_FAIL;
 
 	return AF_SUCCEED;
@@ -190,6 +201,22 @@ status ModuleState::setup(AFfilehandle file, Track *track)
 		if (reset(file, track) == AF_FAIL)
 			return AF_FAIL;
 	}
+	else if (file->m_inPlace)
+	{
+		/*
+			Writing to an existing file starts at the track's
+			position rather than at the start of the sound data.
+		*/
+		track->nextfframe = fframepos;
+		track->nextvframe = (AFframecount) (fframepos * track->v.sampleRate / track->f.sampleRate);
+		track->totalvframes = llrint(track->totalfframes *
+			(track->v.sampleRate / track->f.sampleRate));
+
+		m_isDirty = false;
+
+		if (reset(file, track) == AF_FAIL)
+			return AF_FAIL;
+	}
 	else
 	{
 		track->nextvframe = track->totalvframes =
@@ -224,6 +251,19 @@ status ModuleState::reset(AFfilehandle file, Track *track)
 		(*i)->reset2();
 	if (!track->filemodhappy)
 		return AF_FAIL;
+
+	/*
+		Frames decoded before the new position within a packet are
+		dropped by the rebuffer module as they leave the file module,
+		before they are converted.
+	*/
+	if (track->frames2ignore != 0 && file->m_access == _AF_READ_ACCESS)
+	{
+		assert(m_fileRebufferModule);
+		m_fileRebufferModule->discard(track->frames2ignore);
+		track->frames2ignore = 0;
+	}
+
 	return AF_SUCCEED;
 }
 
@@ -238,7 +278,14 @@ status ModuleState::sync(AFfilehandle file, Track *track)
 	for (std::vector<SharedPtr<Module> >::iterator i=m_modules.begin();
 			i != m_modules.end(); ++i)
 		(*i)->sync2();
-	return AF_SUCCEED;
+	if (!track->filemodhappy)
+		return AF_FAIL;
+
+	/*
+		Write out the data held back by buffering so that an error
+		writing it is reported as an error writing this track.
+	*/
+	return m_fileModule->flush();
 }
 
 static const PCMInfo * const intmappings[6] =
@@ -414,6 +461,11 @@ status ModuleState::arrange(AFfilehandle file, Track *track)
 			addModule(new Clip(outfc, out.pcm));
 	}
 
+	// Keep the peaks of the samples written.
+	if (!isReading && track->computesPeaks)
+		addModule(new MeasurePeaks(outfc, out.pcm, &track->peaks,
+			track->nextvframe));
+
 	// Make data unsigned if necessary.
 	if (out.isUnsigned())
 		addModule(new ConvertSign(outfc, true));
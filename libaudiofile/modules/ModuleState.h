@@ -27,8 +27,10 @@
 #include "afinternal.h"
 #include <vector>
 
+class File;
 class FileModule;
 class Module;
+class RebufferModule;
 
 class ModuleState : public Shared<ModuleState>
 {
@@ -37,8 +39,14 @@ public:
 	virtual ~ModuleState();
 
 	bool isDirty() const { return m_isDirty; }
-	void setDirty() { m_isDirty = true; }
-	status init(AFfilehandle file, Track *track);
+	void setDirty() { m_isDirty = true; m_generation++; }
+	// Incremented whenever the module chain has to be rebuilt.
+	unsigned generation() const { return m_generation; }
+	/*
+		If fh is not NULL, the file module reads from it rather than
+		from the file handle's own file.
+	*/
+	status init(AFfilehandle file, Track *track, File *fh = NULL);
 	status setup(AFfilehandle file, Track *track);
 	status reset(AFfilehandle file, Track *track);
 	status sync(AFfilehandle file, Track *track);
@@ -57,11 +65,12 @@ private:
 	std::vector<SharedPtr<Module> > m_modules;
 	std::vector<SharedPtr<Chunk> > m_chunks;
 	bool m_isDirty;
+	unsigned m_generation;
 
 	SharedPtr<FileModule> m_fileModule;
-	SharedPtr<Module> m_fileRebufferModule;
+	SharedPtr<RebufferModule> m_fileRebufferModule;
 
-	status initFileModule(AFfilehandle file, Track *track);
+	status initFileModule(AFfilehandle file, Track *track, File *fh);
 
 	status arrange(AFfilehandle file, Track *track);
 
@@ -111,7 +111,8 @@ void PCM::runPush()
 		reportWriteError(n, frames2write);
 
 	m_track->nextfframe += n;
-	m_track->totalfframes = m_track->nextfframe;
+	if (m_track->nextfframe > m_track->totalfframes)
+		m_track->totalfframes = m_track->nextfframe;
 	assert(!canSeek() || (tell() == m_track->fpos_next_frame));
 }
 
@@ -37,7 +37,8 @@ RebufferModule::RebufferModule(Direction direction, int bytesPerFrame,
 	m_buffer(NULL),
 	m_offset(-1),
 	m_savedBuffer(NULL),
-	m_savedOffset(-1)
+	m_savedOffset(-1),
+	m_framesToDiscard(0)
 {
 	if (m_direction == FixedToVariable)
 		initFixedToVariable();
@@ -82,6 +83,80 @@ void RebufferModule::maxPush()
 		m_outChunk->frameCount = m_numFrames;
 }
 
+void RebufferModule::discard(int frameCount)
+{
+	assert(m_direction == FixedToVariable);
+	assert(frameCount >= 0);
+	m_framesToDiscard += frameCount;
+}
+
+/*
+	Drop the frames to be discarded, from the buffer and then from
+	chunks pulled from the source, keeping the rest of the last chunk
+	pulled in the buffer.
+*/
+void RebufferModule::discardPending()
+{
+	const char *inBuffer = static_cast<const char *>(m_inChunk->buffer);
+
+	while (m_framesToDiscard > 0)
+	{
+		if (m_offset < m_numFrames)
+		{
+			int n = std::min(m_framesToDiscard, m_numFrames - m_offset);
+			m_offset += n;
+			m_framesToDiscard -= n;
+			continue;
+		}
+
+		if (m_eof)
+		{
+			m_framesToDiscard = 0;
+			break;
+		}
+
+		pull(m_numFrames);
+
+		int framesReceived = m_inChunk->frameCount;
+		if (framesReceived != m_numFrames)
+			m_eof = true;
+
+		int n = std::min(m_framesToDiscard, framesReceived);
+		int framesKept = framesReceived - n;
+		m_framesToDiscard -= n;
+		m_offset = m_numFrames - framesKept;
+		memcpy(m_buffer + m_offset * m_bytesPerFrame,
+			inBuffer + n * m_bytesPerFrame,
+			framesKept * m_bytesPerFrame);
+	}
+
+	assert(m_offset > 0 && m_offset <= m_numFrames);
+}
+
+/*
+	Pull frames from the source into buffer rather than into the
+	input chunk's own buffer.
+*/
+void RebufferModule::pullInto(void *buffer, int frameCount)
+{
+	void *chunkBuffer = m_inChunk->buffer;
+	m_inChunk->buffer = buffer;
+	pull(frameCount);
+	m_inChunk->buffer = chunkBuffer;
+}
+
+/*
+	Push frames to the sink from buffer rather than from the output
+	chunk's own buffer.
+*/
+void RebufferModule::pushFrom(const void *buffer, int frameCount)
+{
+	void *chunkBuffer = m_outChunk->buffer;
+	m_outChunk->buffer = const_cast<void *>(buffer);
+	push(frameCount);
+	m_outChunk->buffer = chunkBuffer;
+}
+
 void RebufferModule::runPull()
 {
 	int framesToPull = m_outChunk->frameCount;
@@ -96,6 +171,9 @@ void RebufferModule::runPull()
 	*/
 	assert(!m_sentShortChunk);
 
+	if (m_framesToDiscard > 0)
+		discardPending();
+
 	if (m_offset < m_numFrames)
 	{
 		int buffered = m_numFrames - m_offset;
@@ -111,14 +189,39 @@ void RebufferModule::runPull()
 	while (!m_eof && framesToPull > 0)
 	{
 		int framesRequested;
+		bool wholeChunks;
 		if (m_multipleOf)
+		{
 			// Round framesToPull up to nearest multiple of m_numFrames.
 			framesRequested = ((framesToPull - 1) / m_numFrames + 1) * m_numFrames;
+			wholeChunks = framesRequested == framesToPull;
+		}
 		else
+		{
 			framesRequested = m_numFrames;
+			wholeChunks = framesToPull >= m_numFrames;
+		}
 
 		assert(framesRequested > 0);
 
+		/*
+			Frames which fill whole chunks are pulled straight
+			into the output; only a partial chunk needs to be
+			pulled into the input chunk and copied.
+		*/
+		if (wholeChunks)
+		{
+			pullInto(outBuffer, framesRequested);
+
+			int framesReceived = m_inChunk->frameCount;
+			if (framesReceived != framesRequested)
+				m_eof = true;
+
+			outBuffer += framesReceived * m_bytesPerFrame;
+			framesToPull -= framesReceived;
+			continue;
+		}
+
 		pull(framesRequested);
 
 		int framesReceived = m_inChunk->frameCount;
@@ -171,6 +274,7 @@ void RebufferModule::runPull()
 void RebufferModule::reset1()
 {
 	m_offset = m_numFrames;
+	m_framesToDiscard = 0;
 	m_eof = false;
 	m_sentShortChunk = false;
 	assert(m_offset > 0 && m_offset <= m_numFrames);
@@ -189,7 +293,11 @@ void RebufferModule::runPush()
 
 	assert(m_offset >= 0 && m_offset < m_numFrames);
 
-	// Check that we will be able to push even one block.
+	/*
+		Check that we will be able to push even one block.  Blocks
+		which do not begin with buffered frames are pushed straight
+		from the input.
+	*/
 	if (m_offset + framesToPush >= m_numFrames)
 	{
 		if (m_offset > 0)
@@ -201,11 +309,16 @@ void RebufferModule::runPush()
 			int n = ((m_offset + framesToPush) / m_numFrames) * m_numFrames;
 
 			assert(n > m_offset);
-			memcpy(outBuffer + m_offset * m_bytesPerFrame,
-				inBuffer,
-				(n - m_offset) * m_bytesPerFrame);
+			if (m_offset == 0)
+				pushFrom(inBuffer, n);
+			else
+			{
+				memcpy(outBuffer + m_offset * m_bytesPerFrame,
+					inBuffer,
+					(n - m_offset) * m_bytesPerFrame);
 
-			push(n);
+				push(n);
+			}
 
 			inBuffer += (n - m_offset) * m_bytesPerFrame;
 			framesToPush -= n - m_offset;
@@ -217,11 +330,16 @@ void RebufferModule::runPush()
 			while (m_offset + framesToPush >= m_numFrames)
 			{
 				int n = m_numFrames - m_offset;
-				memcpy(outBuffer + m_offset * m_bytesPerFrame,
-					inBuffer,
-					n * m_bytesPerFrame);
+				if (m_offset == 0)
+					pushFrom(inBuffer, m_numFrames);
+				else
+				{
+					memcpy(outBuffer + m_offset * m_bytesPerFrame,
+						inBuffer,
+						n * m_bytesPerFrame);
 
-				push(m_numFrames);
+					push(m_numFrames);
+				}
 
 				inBuffer += n * m_bytesPerFrame;
 				framesToPush -= n;
@@ -260,7 +378,15 @@ void RebufferModule::sync2()
 {
 	assert(m_offset >= 0 && m_offset < m_numFrames);
 
-	memcpy(m_outChunk->buffer, m_buffer, m_offset * m_bytesPerFrame);
+	/*
+		The sink may encode the rest of the block following the
+		buffered frames, so fill it with silence rather than with
+		whatever the output chunk last held.
+	*/
+	char *outBuffer = static_cast<char *>(m_outChunk->buffer);
+	memcpy(outBuffer, m_buffer, m_offset * m_bytesPerFrame);
+	memset(outBuffer + m_offset * m_bytesPerFrame, 0,
+		(m_numFrames - m_offset) * m_bytesPerFrame);
 
 	push(m_offset);
 
@@ -37,6 +37,12 @@ public:
 	RebufferModule(Direction, int bytesPerFrame, int numFrames, bool multipleOf);
 	virtual ~RebufferModule();
 
+	/*
+		Drop the next frameCount frames pulled from the source rather
+		than passing them on.
+	*/
+	void discard(int frameCount);
+
 	virtual const char *name() const OVERRIDE { return "rebuffer"; }
 
 	virtual void maxPull() OVERRIDE;
@@ -60,9 +66,13 @@ private:
 	int m_offset;
 	char *m_savedBuffer;
 	int m_savedOffset;
+	int m_framesToDiscard;
 
 	void initFixedToVariable();
 	void initVariableToFixed();
+	void discardPending();
+	void pullInto(void *buffer, int frameCount);
+	void pushFrom(const void *buffer, int frameCount);
 };
 
 #endif // REBUFFER_MODULE_H
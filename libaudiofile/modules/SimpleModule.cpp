@@ -22,10 +22,14 @@
 #include "SimpleModule.h"
 
 #include <algorithm>
+#include <math.h>
+#include <string.h>
 
 void SimpleModule::runPull()
 {
 	pull(m_outChunk->frameCount);
+	// Pass on a short read at the end of a file of unknown length.
+	m_outChunk->frameCount = m_inChunk->frameCount;
 	run(*m_inChunk, *m_outChunk);
 }
 
@@ -172,3 +176,124 @@ void ApplyChannelMatrix::initDefaultMatrix()
 				m_matrix[j*m_inChannels + i] = (i==j) ? 1 : 0;
 	}
 }
+
+MeasurePeaks::MeasurePeaks(FormatCode format, const PCMInfo &mapping,
+	std::vector<Peak> *peaks, AFframecount firstFrame) :
+	m_format(format),
+	m_mapping(mapping),
+	m_peaks(peaks),
+	m_frame(firstFrame)
+{
+}
+
+const char *MeasurePeaks::name() const { return "measurePeaks"; }
+
+void MeasurePeaks::runPush()
+{
+	int frameCount = m_inChunk->frameCount;
+	switch (m_format)
+	{
+		case kInt8:
+			measure<int8_t>(m_inChunk->buffer, frameCount);
+			break;
+		case kInt16:
+			measure<int16_t>(m_inChunk->buffer, frameCount);
+			break;
+		case kInt24:
+		case kInt32:
+			measure<int32_t>(m_inChunk->buffer, frameCount);
+			break;
+		case kFloat:
+			measure<float>(m_inChunk->buffer, frameCount);
+			break;
+		case kDouble:
+			measure<double>(m_inChunk->buffer, frameCount);
+			break;
+		default:
+			assert(false);
+	}
+	m_frame += frameCount;
+
+	// Push the input chunk's buffer on rather than a copy of it.
+	void *chunkBuffer = m_outChunk->buffer;
+	m_outChunk->buffer = m_inChunk->buffer;
+	push(frameCount);
+	m_outChunk->buffer = chunkBuffer;
+}
+
+template <typename T>
+void MeasurePeaks::measure(const void *inputData, int frameCount)
+{
+	const T *input = static_cast<const T *>(inputData);
+	int channelCount = m_inChunk->f.channelCount;
+
+	// The peaks are empty once they are no longer known.
+	if (frameCount == 0 || m_peaks->size() != static_cast<size_t>(channelCount))
+		return;
+
+	/*
+		The interleaved samples are scanned in order, gathering the
+		extremes of each sample position within a row of laneCount
+		samples, a whole number of frames long.  The loop over a row
+		has a fixed stride and no branches, so the compiler can
+		vectorize it.
+	*/
+	T laneMinima[kLaneCount], laneMaxima[kLaneCount];
+	std::vector<T> extremes;
+	T *minima = laneMinima, *maxima = laneMaxima;
+	int laneCount = kLaneCount / channelCount * channelCount;
+	if (laneCount == 0)
+	{
+		laneCount = channelCount;
+		extremes.resize(2 * laneCount);
+		minima = &extremes[0];
+		maxima = &extremes[laneCount];
+	}
+
+	for (int j=0; j<laneCount; j++)
+		minima[j] = maxima[j] = input[j % channelCount];
+
+	int sampleCount = frameCount * channelCount;
+	int i = 0;
+	for (; i + laneCount <= sampleCount; i += laneCount)
+	{
+		const T *row = input + i;
+		for (int j=0; j<laneCount; j++)
+		{
+			minima[j] = std::min(minima[j], row[j]);
+			maxima[j] = std::max(maxima[j], row[j]);
+		}
+	}
+	// The remaining samples are a whole number of frames.
+	for (int j=0; i + j < sampleCount; j++)
+	{
+		minima[j] = std::min(minima[j], input[i + j]);
+		maxima[j] = std::max(maxima[j], input[i + j]);
+	}
+
+	const double intercept = m_mapping.intercept;
+	const double slope = fabs(m_mapping.slope);
+
+	for (int c=0; c<channelCount; c++)
+	{
+		T minValue = minima[c], maxValue = maxima[c];
+		for (int j=c + channelCount; j<laneCount; j+=channelCount)
+		{
+			minValue = std::min(minValue, minima[j]);
+			maxValue = std::max(maxValue, maxima[j]);
+		}
+
+		// The chunk is searched for a peak only when it grows.
+		double largest = std::max(fabs(minValue - intercept),
+			fabs(maxValue - intercept));
+		Peak &peak = (*m_peaks)[c];
+		if (!(largest > peak.value * slope))
+			continue;
+
+		int f = 0;
+		while (fabs(input[f*channelCount + c] - intercept) < largest)
+			f++;
+		peak.value = largest / slope;
+		peak.position = m_frame + f;
+	}
+}
@@ -25,12 +25,14 @@
 
 #include "Compiler.h"
 #include "Module.h"
+#include "Peak.h"
 #include "byteorder.h"
 
 #include <algorithm>
 #include <cassert>
 #include <climits>
 #include <functional>
+#include <vector>
 
 class SimpleModule : public Module
 {
@@ -711,6 +713,32 @@ private:
 		void run(const void *input, void *output, int frameCount);
 };
 
+/*
+	Pass samples through unchanged, without copying them, while
+	keeping the peak of each channel up to date.  firstFrame is the
+	position in the track of the first frame passed through.
+*/
+struct MeasurePeaks : public Module
+{
+public:
+	MeasurePeaks(FormatCode format, const PCMInfo &mapping,
+		std::vector<Peak> *peaks, AFframecount firstFrame);
+	virtual const char *name() const OVERRIDE;
+	virtual void runPush() OVERRIDE;
+
+private:
+	// The number of samples whose extremes are gathered side by side.
+	static const int kLaneCount = 64;
+
+	FormatCode m_format;
+	PCMInfo m_mapping;
+	std::vector<Peak> *m_peaks;
+	AFframecount m_frame;
+
+	template <typename T>
+		void measure(const void *input, int frameCount);
+};
+
 struct Transform : public SimpleModule
 {
 public:
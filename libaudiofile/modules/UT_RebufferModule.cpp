@@ -55,7 +55,8 @@ public:
 	TestSourceModule() :
 		m_startFrame(0),
 		m_frameCount(0),
-		m_expectedRequestLength(0)
+		m_expectedRequestLength(0),
+		m_lastBuffer(NULL)
 	{
 	}
 	unsigned startFrame() const { return m_startFrame; }
@@ -67,10 +68,13 @@ public:
 	{
 		m_expectedRequestLength = expectedRequestLength;
 	}
+	// The buffer into which frames were last pulled.
+	const void *lastBuffer() const { return m_lastBuffer; }
 
 	void runPull()
 	{
 		EXPECT_EQ(m_outChunk->frameCount, m_expectedRequestLength);
+		m_lastBuffer = m_outChunk->buffer;
 		unsigned frameCount = std::min<unsigned>(m_outChunk->frameCount, m_frameCount);
 		m_outChunk->frameCount = frameCount;
 		setChunkData(*m_outChunk, m_startFrame);
@@ -82,6 +86,7 @@ private:
 	unsigned m_startFrame;
 	unsigned m_frameCount;
 	unsigned m_expectedRequestLength;
+	const void *m_lastBuffer;
 };
 
 class TestSinkModule : public Module
@@ -89,7 +94,8 @@ class TestSinkModule : public Module
 public:
 	TestSinkModule() :
 		m_startFrame(0),
-		m_expectedRequestLength(0)
+		m_expectedRequestLength(0),
+		m_lastBuffer(NULL)
 	{
 	}
 	unsigned startFrame() const { return m_startFrame; }
@@ -99,9 +105,12 @@ public:
 	{
 		m_expectedRequestLength = expectedRequestLength;
 	}
+	// The buffer from which frames were last pushed.
+	const void *lastBuffer() const { return m_lastBuffer; }
 	void runPush()
 	{
 		EXPECT_EQ(m_inChunk->frameCount, m_expectedRequestLength);
+		m_lastBuffer = m_inChunk->buffer;
 		validateChunkData(*m_inChunk, m_startFrame);
 		m_startFrame += m_inChunk->frameCount;
 	}
@@ -109,6 +118,7 @@ public:
 private:
 	unsigned m_startFrame;
 	unsigned m_expectedRequestLength;
+	const void *m_lastBuffer;
 };
 
 static AudioFormat createAudioFormat(int channels)
@@ -272,6 +282,78 @@ TEST(RebufferModule, FixedToVariable_BufferingAfterShortChunk_Multiple)
 	testBufferingAfterShortChunk(true);
 }
 
+/*
+	Discard frames, as after seeking within a chunk, and verify that
+	the rebuffer module passes on only the frames which follow them.
+*/
+static void testDiscard(bool multiple)
+{
+	const int channels = 2;
+	AudioFormat f = createAudioFormat(channels);
+
+	SharedPtr<RebufferModule> rebuffer =
+		new RebufferModule(RebufferModule::FixedToVariable, f.bytesPerFrame(),
+			10, multiple);
+
+	SharedPtr<TestSourceModule> source = new TestSourceModule();
+	rebuffer->setSource(source.get());
+
+	SharedPtr<Chunk> fixedChunk(new Chunk());
+	SharedPtr<Chunk> variableChunk(new Chunk());
+
+	const int maxFrameCount = 30;
+	fixedChunk->f = f;
+	fixedChunk->allocate(maxFrameCount * f.bytesPerFrame());
+
+	variableChunk->f = f;
+	variableChunk->allocate(maxFrameCount * f.bytesPerFrame());
+
+	rebuffer->setInChunk(fixedChunk.get());
+	rebuffer->setOutChunk(variableChunk.get());
+
+	source->setOutChunk(fixedChunk.get());
+
+	// Initialize source to contain 100 frames.
+	source->setFrameCount(100);
+	source->setExpectedRequestLength(10);
+
+	// Discard 7 frames, then request 5 frames from rebuffer module.
+	rebuffer->discard(7);
+	variableChunk->frameCount = 5;
+	rebuffer->runPull();
+	// Check that 20 frames have been pulled from source module.
+	EXPECT_EQ(20u, source->startFrame());
+	// Check that the frames following the discarded frames are produced.
+	EXPECT_EQ(5u, variableChunk->frameCount);
+	validateChunkData(*variableChunk, 7);
+
+	// Discard the 8 buffered frames and 5 more, then request 12 frames.
+	rebuffer->discard(13);
+	variableChunk->frameCount = 12;
+	rebuffer->runPull();
+	EXPECT_EQ(40u, source->startFrame());
+	EXPECT_EQ(12u, variableChunk->frameCount);
+	validateChunkData(*variableChunk, 25);
+
+	// Discard more frames than remain, then request 10 frames.
+	rebuffer->discard(70);
+	variableChunk->frameCount = 10;
+	rebuffer->runPull();
+	// Check that all frames have been pulled and none produced.
+	EXPECT_EQ(100u, source->startFrame());
+	EXPECT_EQ(0u, variableChunk->frameCount);
+}
+
+TEST(RebufferModule, FixedToVariable_Discard)
+{
+	testDiscard(false);
+}
+
+TEST(RebufferModule, FixedToVariable_Discard_Multiple)
+{
+	testDiscard(true);
+}
+
 static void testVariableToFixed(bool multiple)
 {
 	const int channels = 2;
@@ -329,6 +411,141 @@ TEST(RebufferModule, VariableToFixed_Multiple)
 	testVariableToFixed(true);
 }
 
+/*
+	Verify that whole chunks are pulled straight into the output and
+	that only a partial chunk is pulled into the input chunk.
+*/
+static void testPullWholeChunks(bool multiple)
+{
+	const int channels = 2;
+	AudioFormat f = createAudioFormat(channels);
+
+	SharedPtr<RebufferModule> rebuffer =
+		new RebufferModule(RebufferModule::FixedToVariable, f.bytesPerFrame(),
+			10, multiple);
+
+	SharedPtr<TestSourceModule> source = new TestSourceModule();
+	rebuffer->setSource(source.get());
+
+	SharedPtr<Chunk> fixedChunk(new Chunk());
+	SharedPtr<Chunk> variableChunk(new Chunk());
+
+	const int maxFrameCount = 30;
+	fixedChunk->f = f;
+	fixedChunk->allocate(maxFrameCount * f.bytesPerFrame());
+	void *fixedBuffer = fixedChunk->buffer;
+
+	variableChunk->f = f;
+	variableChunk->allocate(maxFrameCount * f.bytesPerFrame());
+	char *variableBuffer = static_cast<char *>(variableChunk->buffer);
+
+	rebuffer->setInChunk(fixedChunk.get());
+	rebuffer->setOutChunk(variableChunk.get());
+
+	source->setOutChunk(fixedChunk.get());
+
+	// Initialize source to contain 100 frames.
+	source->setFrameCount(100);
+
+	// Request 20 frames from rebuffer module.
+	variableChunk->frameCount = 20;
+	source->setExpectedRequestLength(multiple ? 20 : 10);
+	rebuffer->runPull();
+	EXPECT_EQ(20u, variableChunk->frameCount);
+	validateChunkData(*variableChunk, 0);
+	// Check that the frames have been pulled into the output.
+	EXPECT_EQ(variableBuffer + (multiple ? 0 : 10) * f.bytesPerFrame(),
+		source->lastBuffer());
+	EXPECT_EQ(fixedBuffer, fixedChunk->buffer);
+
+	// Request 5 frames from rebuffer module.
+	variableChunk->frameCount = 5;
+	source->setExpectedRequestLength(10);
+	rebuffer->runPull();
+	EXPECT_EQ(5u, variableChunk->frameCount);
+	validateChunkData(*variableChunk, 20);
+	// Check that the partial chunk has been pulled into the input chunk.
+	EXPECT_EQ(fixedBuffer, source->lastBuffer());
+}
+
+TEST(RebufferModule, FixedToVariable_WholeChunks)
+{
+	testPullWholeChunks(false);
+}
+
+TEST(RebufferModule, FixedToVariable_WholeChunks_Multiple)
+{
+	testPullWholeChunks(true);
+}
+
+/*
+	Verify that whole blocks are pushed straight from the input when
+	no frames are buffered.
+*/
+static void testPushWholeChunks(bool multiple)
+{
+	const int channels = 2;
+	AudioFormat f = createAudioFormat(channels);
+
+	SharedPtr<RebufferModule> rebuffer =
+		new RebufferModule(RebufferModule::VariableToFixed, f.bytesPerFrame(),
+			10, multiple);
+	SharedPtr<TestSinkModule> sink = new TestSinkModule();
+	rebuffer->setSink(sink.get());
+
+	SharedPtr<Chunk> variableChunk(new Chunk());
+	SharedPtr<Chunk> fixedChunk(new Chunk());
+
+	const int maxFrameCount = 40;
+	variableChunk->f = f;
+	variableChunk->allocate(maxFrameCount * f.bytesPerFrame());
+	char *variableBuffer = static_cast<char *>(variableChunk->buffer);
+
+	fixedChunk->f = f;
+	fixedChunk->allocate(maxFrameCount * f.bytesPerFrame());
+	void *fixedBuffer = fixedChunk->buffer;
+
+	rebuffer->setInChunk(variableChunk.get());
+	rebuffer->setOutChunk(fixedChunk.get());
+
+	sink->setInChunk(fixedChunk.get());
+
+	// Push 25 frames to the rebuffer module.
+	variableChunk->frameCount = 25;
+	setChunkData(*variableChunk, 0);
+	sink->setExpectedRequestLength(multiple ? 20 : 10);
+	rebuffer->runPush();
+	EXPECT_EQ(20u, sink->startFrame());
+	// Check that the frames have been pushed from the input.
+	EXPECT_EQ(variableBuffer + (multiple ? 0 : 10) * f.bytesPerFrame(),
+		sink->lastBuffer());
+	EXPECT_EQ(fixedBuffer, fixedChunk->buffer);
+
+	// Push 15 frames, completing the buffered block.
+	variableChunk->frameCount = 15;
+	setChunkData(*variableChunk, 25);
+	sink->setExpectedRequestLength(multiple ? 20 : 10);
+	rebuffer->runPush();
+	EXPECT_EQ(40u, sink->startFrame());
+	/*
+		Check that the last block has been pushed from the output
+		chunk (multiple) or from the input (single).
+	*/
+	EXPECT_EQ(multiple ? fixedBuffer :
+			static_cast<void *>(variableBuffer + 5 * f.bytesPerFrame()),
+		sink->lastBuffer());
+}
+
+TEST(RebufferModule, VariableToFixed_WholeChunks)
+{
+	testPushWholeChunks(false);
+}
+
+TEST(RebufferModule, VariableToFixed_WholeChunks_Multiple)
+{
+	testPushWholeChunks(true);
+}
+
 int main(int argc, char **argv)
 {
 	::testing::InitGoogleTest(&argc, argv);
@@ -24,16 +24,21 @@
 #include <assert.h>
 #include <string.h>
 
+#include <algorithm>
+
+#include <fcntl.h>
 #ifdef HAVE_UNISTD_H
 #include <unistd.h>
 #endif
 
 #include <audiofile.h>
 
+#include "BufferedFile.h"
 #include "File.h"
 #include "FileHandle.h"
 #include "Instrument.h"
 #include "Marker.h"
+#include "ReaderPool.h"
 #include "Setup.h"
 #include "Track.h"
 #include "afinternal.h"
@@ -42,33 +47,133 @@
 #include "units.h"
 #include "util.h"
 
-static status _afOpenFile (int access, File *f, const char *filename,
+/*
+	"r" reads a file and "w" writes a new one.  "a" appends frames to
+	an existing file, and "r+" reads an existing file and overwrites
+	or adds to its frames.  "m" reads an existing file and changes
+	its metadata.
+*/
+enum OpenMode
+{
+	kOpenRead,
+	kOpenWrite,
+	kOpenAppend,
+	kOpenUpdate,
+	kOpenEdit
+};
+
+static status _afOpenFile (OpenMode openMode, File *f, const char *filename,
 	AFfilehandle *file, AFfilesetup filesetup);
 
+static bool parseMode (const char *mode, OpenMode *openMode)
+{
+	if (!mode)
+	{
+		_af_error(AF_BAD_ACCMODE, "null access mode");
+		return false;
+	}
+
+	bool plus = strchr(mode, '+') != NULL;
+	if (mode[0] == 'r')
+		*openMode = plus ? kOpenUpdate : kOpenRead;
+	else if (mode[0] == 'w')
+		*openMode = kOpenWrite;
+	else if (mode[0] == 'a' && !plus)
+		*openMode = kOpenAppend;
+	else if (mode[0] == 'm' && !plus)
+		*openMode = kOpenEdit;
+	else
+	{
+		_af_error(AF_BAD_ACCMODE, "unrecognized access mode '%s'", mode);
+		return false;
+	}
+
+	return true;
+}
+
+static File::AccessMode fileAccessMode (OpenMode openMode)
+{
+	if (openMode == kOpenRead)
+		return File::ReadAccess;
+	if (openMode == kOpenWrite)
+		return File::WriteAccess;
+	return File::ReadWriteAccess;
+}
+
+static bool wantsMemoryMap (AFfilesetup setup)
+{
+	return setup != AF_NULL_FILESETUP && _af_filesetup_ok(setup) &&
+		setup->memoryMap;
+}
+
+static int writePolicy (AFfilesetup setup)
+{
+	if (setup == AF_NULL_FILESETUP || !_af_filesetup_ok(setup))
+		return AF_WRITE_NORMAL;
+	return setup->writePolicy;
+}
+
+/*
+	Wrap f in a BufferedFile unless the setup has disabled buffering.
+*/
+static File *bufferFile (File *f, AFfilesetup setup)
+{
+	int bufferSize = BufferedFile::kDefaultBufferSize;
+	bool writeBehind = false;
+	if (setup != AF_NULL_FILESETUP && _af_filesetup_ok(setup))
+	{
+		bufferSize = setup->bufferSize;
+		writeBehind = setup->writeBehind;
+	}
+
+	if (bufferSize <= 0)
+		return f;
+
+	return new BufferedFile(f, bufferSize, writeBehind);
+}
+
 int _af_identify (File *f, int *implemented)
 {
-	if (!f->canSeek())
+	AFfileoffset curpos = f->tell();
+
+	/*
+		Read the start of the file once and let each unit examine
+		it.  When f is a BufferedFile this also fills its buffer,
+		so that readInit() can parse the header without reading
+		these bytes again; for a pipe, the buffer is what allows
+		returning to the start of the file.
+	*/
+	if (curpos == -1 || f->seek(0, File::SeekFromBeginning) != 0)
 	{
 		_af_error(AF_BAD_LSEEK, "Cannot seek in file");
+		if (implemented != NULL)
+			*implemented = false;
 		return AF_FILE_UNKNOWN;
 	}
+	uint8_t header[_AF_RECOGNIZE_LENGTH];
+	ssize_t length = f->read(header, sizeof (header));
+	if (length < 0)
+		length = 0;
 
-	AFfileoffset curpos = f->tell();
+	if (f->seek(curpos, File::SeekFromBeginning) != curpos)
+	{
+		_af_error(AF_BAD_LSEEK, "Cannot seek in file");
+		if (implemented != NULL)
+			*implemented = false;
+		return AF_FILE_UNKNOWN;
+	}
 
 	for (int i=0; i<_AF_NUM_UNITS; i++)
 	{
 		if (_af_units[i].recognize &&
-			_af_units[i].recognize(f))
+			_af_units[i].recognize(header, length))
 		{
 			if (implemented != NULL)
 				*implemented = _af_units[i].implemented;
-			f->seek(curpos, File::SeekFromBeginning);
 			return _af_units[i].fileFormat;
 		}
 	}
 
-	f->seek(curpos, File::SeekFromBeginning);
-
 	if (implemented != NULL)
 		*implemented = false;
 
@@ -117,32 +222,19 @@ int afIdentifyNamedFD (int fd, const char *filename, int *implemented)
 
 AFfilehandle afOpenFD (int fd, const char *mode, AFfilesetup setup)
 {
-	if (!mode)
-	{
-		_af_error(AF_BAD_ACCMODE, "null access mode");
-		return AF_NULL_FILEHANDLE;
-	}
-
-	int access;
-	if (mode[0] == 'r')
-	{
-		access = _AF_READ_ACCESS;
-	}
-	else if (mode[0] == 'w')
-	{
-		access = _AF_WRITE_ACCESS;
-	}
-	else
-	{
-		_af_error(AF_BAD_ACCMODE, "unrecognized access mode '%s'", mode);
+	OpenMode openMode;
+	if (!parseMode(mode, &openMode))
 		return AF_NULL_FILEHANDLE;
-	}
 
-	File *f = File::create(fd, access == _AF_READ_ACCESS ?
-		File::ReadAccess : File::WriteAccess);
+	File *f = NULL;
+	if (openMode == kOpenRead && wantsMemoryMap(setup))
+		f = File::map(fd, setup->memoryMapHints);
+	if (!f)
+		f = bufferFile(File::create(fd, fileAccessMode(openMode),
+			writePolicy(setup)), setup);
 
 	AFfilehandle filehandle = NULL;
-	if (_afOpenFile(access, f, NULL, &filehandle, setup) != AF_SUCCEED)
+	if (_afOpenFile(openMode, f, NULL, &filehandle, setup) != AF_SUCCEED)
 	{
 		delete f;
 	}
@@ -153,28 +245,19 @@ AFfilehandle afOpenFD (int fd, const char *mode, AFfilesetup setup)
 AFfilehandle afOpenNamedFD (int fd, const char *mode, AFfilesetup setup,
 	const char *filename)
 {
-	if (!mode)
-	{
-		_af_error(AF_BAD_ACCMODE, "null access mode");
-		return AF_NULL_FILEHANDLE;
-	}
-
-	int access;
-	if (mode[0] == 'r')
-		access = _AF_READ_ACCESS;
-	else if (mode[0] == 'w')
-		access = _AF_WRITE_ACCESS;
-	else
-	{
-		_af_error(AF_BAD_ACCMODE, "unrecognized access mode '%s'", mode);
+	OpenMode openMode;
+	if (!parseMode(mode, &openMode))
 		return AF_NULL_FILEHANDLE;
-	}
 
-	File *f = File::create(fd, access == _AF_READ_ACCESS ?
-		File::ReadAccess : File::WriteAccess);
+	File *f = NULL;
+	if (openMode == kOpenRead && wantsMemoryMap(setup))
+		f = File::map(fd, setup->memoryMapHints);
+	if (!f)
+		f = bufferFile(File::create(fd, fileAccessMode(openMode),
+			writePolicy(setup)), setup);
 
 	AFfilehandle filehandle;
-	if (_afOpenFile(access, f, filename, &filehandle, setup) != AF_SUCCEED)
+	if (_afOpenFile(openMode, f, filename, &filehandle, setup) != AF_SUCCEED)
 	{
 		delete f;
 	}
@@ -184,37 +267,35 @@ AFfilehandle afOpenNamedFD (int fd, const char *mode, AFfilesetup setup,
 
 AFfilehandle afOpenFile (const char *filename, const char *mode, AFfilesetup setup)
 {
-	if (!mode)
-	{
-		_af_error(AF_BAD_ACCMODE, "null access mode");
+	OpenMode openMode;
+	if (!parseMode(mode, &openMode))
 		return AF_NULL_FILEHANDLE;
-	}
 
-	int access;
-	if (mode[0] == 'r')
-	{
-		access = _AF_READ_ACCESS;
-	}
-	else if (mode[0] == 'w')
-	{
-		access = _AF_WRITE_ACCESS;
-	}
-	else
+	File *f = NULL;
+	if (openMode == kOpenRead && wantsMemoryMap(setup))
 	{
-		_af_error(AF_BAD_ACCMODE, "unrecognized access mode '%s'", mode);
-		return AF_NULL_FILEHANDLE;
+		int fd = ::open(filename, O_RDONLY);
+		if (fd != -1)
+		{
+			f = File::map(fd, setup->memoryMapHints);
+			if (!f)
+				::close(fd);
+		}
 	}
-
-	File *f = File::open(filename,
-		access == _AF_READ_ACCESS ? File::ReadAccess : File::WriteAccess);
 	if (!f)
 	{
-		_af_error(AF_BAD_OPEN, "could not open file '%s'", filename);
-		return AF_NULL_FILEHANDLE;
+		f = File::open(filename, fileAccessMode(openMode),
+			writePolicy(setup));
+		if (!f)
+		{
+			_af_error(AF_BAD_OPEN, "could not open file '%s'", filename);
+			return AF_NULL_FILEHANDLE;
+		}
+		f = bufferFile(f, setup);
 	}
 
 	AFfilehandle filehandle;
-	if (_afOpenFile(access, f, filename, &filehandle, setup) != AF_SUCCEED)
+	if (_afOpenFile(openMode, f, filename, &filehandle, setup) != AF_SUCCEED)
 	{
 		delete f;
 	}
@@ -231,37 +312,85 @@ AFfilehandle afOpenVirtualFile (AFvirtualfile *vf, const char *mode,
 		return AF_NULL_FILEHANDLE;
 	}
 
-	if (!mode)
+	OpenMode openMode;
+	if (!parseMode(mode, &openMode))
+		return AF_NULL_FILEHANDLE;
+
+	File *f = File::create(vf, fileAccessMode(openMode));
+	if (!f)
 	{
-		_af_error(AF_BAD_ACCMODE, "null access mode");
+		_af_error(AF_BAD_OPEN, "could not open virtual file");
 		return AF_NULL_FILEHANDLE;
 	}
 
-	int access;
-	if (mode[0] == 'r')
+	AFfilehandle filehandle;
+	if (_afOpenFile(openMode, f, NULL, &filehandle, setup) != AF_SUCCEED)
 	{
-		access = _AF_READ_ACCESS;
+		delete f;
 	}
-	else if (mode[0] == 'w')
-	{
-		access = _AF_WRITE_ACCESS;
+
+	return filehandle;
+}
+
+/*
+	Reserve storage for the sound data of a new file whose frame
+	count was given in its setup, so that the data can be stored
+	contiguously.  Sound data whose size cannot be known from its
+	frame count, and files on which storage cannot be reserved, are
+	written without.
+*/
+static void preallocateData (AFfilehandle file, AFfilesetup setup)
+{
+	AFfileoffset dataEnd = 0;
+	for (int i=0; i<file->m_trackCount && i<setup->trackCount; i++)
+	{
+		const TrackSetup &trackSetup = setup->tracks[i];
+		const Track &track = file->m_tracks[i];
+		if (!trackSetup.frameCountSet || trackSetup.frameCount <= 0)
+			continue;
+
+		AFfileoffset dataSize;
+		if (track.f.isUncompressed())
+			dataSize = trackSetup.frameCount * track.f.bytesPerFrame();
+		else if (track.f.framesPerPacket > 0 && track.f.bytesPerPacket > 0)
+			dataSize = (trackSetup.frameCount + track.f.framesPerPacket - 1) /
+				track.f.framesPerPacket * track.f.bytesPerPacket;
+		else
+			continue;
+
+		dataEnd = std::max(dataEnd, track.fpos_first_frame + dataSize);
 	}
-	else
+
+	if (dataEnd > 0)
+		file->m_fh->preallocate(0, dataEnd);
+}
+
+AFfilehandle afOpenMemory (const void *data, size_t size, const char *mode,
+	AFfilesetup setup)
+{
+	OpenMode openMode;
+	if (!parseMode(mode, &openMode))
+		return AF_NULL_FILEHANDLE;
+
+	if (!data && size > 0)
 	{
-		_af_error(AF_BAD_ACCMODE, "unrecognized access mode '%s'", mode);
+		_af_error(AF_BAD_OPEN, "null memory buffer");
 		return AF_NULL_FILEHANDLE;
 	}
 
-	File *f = File::create(vf,
-		access == _AF_READ_ACCESS ? File::ReadAccess : File::WriteAccess);
+	// A new file starts empty whatever memory is given.
+	if (openMode == kOpenWrite)
+		size = 0;
+
+	File *f = File::createMemory(data, size, fileAccessMode(openMode));
 	if (!f)
 	{
-		_af_error(AF_BAD_OPEN, "could not open virtual file");
+		_af_error(AF_BAD_MALLOC, "could not allocate memory file");
 		return AF_NULL_FILEHANDLE;
 	}
 
 	AFfilehandle filehandle;
-	if (_afOpenFile(access, f, NULL, &filehandle, setup) != AF_SUCCEED)
+	if (_afOpenFile(openMode, f, NULL, &filehandle, setup) != AF_SUCCEED)
 	{
 		delete f;
 	}
@@ -269,9 +398,96 @@ AFfilehandle afOpenVirtualFile (AFvirtualfile *vf, const char *mode,
 	return filehandle;
 }
 
-static status _afOpenFile (int access, File *f, const char *filename,
+/*
+	Check that an existing file whose header has been read can have
+	frames written to it in place, and prepare it for writing.
+*/
+static status initInPlace (AFfilehandle file, OpenMode openMode)
+{
+	if (!file->m_seekok)
+	{
+		_af_error(AF_BAD_ACCMODE,
+			"a file which cannot seek cannot be opened for appending or updating");
+		return AF_FAIL;
+	}
+
+	for (int i=0; i<file->m_trackCount; i++)
+	{
+		Track *track = &file->m_tracks[i];
+
+		// Only data without state between frames can be written in place.
+		int compression = track->f.compressionType;
+		if (compression != AF_COMPRESSION_NONE &&
+			compression != AF_COMPRESSION_G711_ULAW &&
+			compression != AF_COMPRESSION_G711_ALAW)
+		{
+			_af_error(AF_BAD_NOT_IMPLEMENTED,
+				"compressed audio data cannot be appended to or updated");
+			return AF_FAIL;
+		}
+
+		if (track->totalfframes == -1 || track->data_size == -1)
+		{
+			_af_error(AF_BAD_HEADER, "length of sound data is unknown");
+			return AF_FAIL;
+		}
+
+		// Allow for a pad byte after sound data of odd length.
+		AFfileoffset dataEnd = track->fpos_first_frame + track->data_size;
+		AFfileoffset length = file->m_fh->length();
+		if (length != dataEnd && length != dataEnd + (track->data_size % 2))
+		{
+			_af_error(AF_BAD_NOT_IMPLEMENTED,
+				"sound data must be at the end of a file which is "
+				"opened for appending or updating");
+			return AF_FAIL;
+		}
+
+		if (openMode == kOpenAppend)
+			track->nextfframe = track->nextvframe = track->totalfframes;
+	}
+
+	if (file->updateInit() == AF_FAIL)
+		return AF_FAIL;
+
+	file->m_inPlace = true;
+	file->m_readWrite = openMode == kOpenUpdate;
+	file->m_metadataChanged = 0;
+	if (openMode == kOpenAppend)
+		file->m_access = _AF_WRITE_ACCESS;
+
+	return AF_SUCCEED;
+}
+
+/*
+	Prepare an existing file whose header has been read for having
+	its metadata changed in place.
+*/
+static status initEdit (AFfilehandle file)
+{
+	if (!file->m_seekok)
+	{
+		_af_error(AF_BAD_ACCMODE,
+			"a file which cannot seek cannot have its metadata edited");
+		return AF_FAIL;
+	}
+
+	file->loadMetadata();
+	if (file->editInit() == AF_FAIL)
+		return AF_FAIL;
+
+	file->m_editMetadata = true;
+	file->m_metadataChanged = 0;
+
+	return AF_SUCCEED;
+}
+
+static status _afOpenFile (OpenMode openMode, File *f, const char *filename,
 	AFfilehandle *file, AFfilesetup filesetup)
 {
+	// An existing file is first opened for reading.
+	int access = openMode == kOpenWrite ? _AF_WRITE_ACCESS : _AF_READ_ACCESS;
+
 	int	fileFormat = AF_FILE_UNKNOWN;
 	int	implemented = true;
 
@@ -282,6 +498,8 @@ static status _afOpenFile (int access, File *f, const char *filename,
 
 	AFfilehandle	filehandle = AF_NULL_FILEHANDLE;
 	AFfilesetup	completesetup = AF_NULL_FILESETUP;
+	// The setup carrying access options, kept when filesetup is ignored.
+	AFfilesetup	accesssetup = AF_NULL_FILESETUP;
 
 	*file = AF_NULL_FILEHANDLE;
 
@@ -290,12 +508,19 @@ static status _afOpenFile (int access, File *f, const char *filename,
 		if (!_af_filesetup_ok(filesetup))
 			return AF_FAIL;
 
+		accesssetup = filesetup;
+
 		fileFormat = filesetup->fileFormat;
 		if (access == _AF_READ_ACCESS && fileFormat != AF_FILE_RAWDATA)
 		{
-			_af_error(AF_BAD_FILESETUP,
-				"warning: opening file for read access: "
-				"ignoring file setup with non-raw file format");
+			/*
+				A setup which only carries access options
+				such as memory mapping is expected here.
+			*/
+			if (_af_setup_describes_format(filesetup))
+				_af_error(AF_BAD_FILESETUP,
+					"warning: opening file for read access: "
+					"ignoring file setup with non-raw file format");
 			filesetup = AF_NULL_FILESETUP;
 			fileFormat = _af_identify(f, &implemented);
 		}
@@ -344,7 +569,26 @@ static status _afOpenFile (int access, File *f, const char *filename,
 
 	filehandle->m_fh = f;
 	filehandle->m_access = access;
+	if (accesssetup != AF_NULL_FILESETUP)
+		filehandle->m_writePolicy = accesssetup->writePolicy;
 	filehandle->m_seekok = f->canSeek();
+	/*
+		A file written in streaming mode is never repositioned,
+		just like a file which cannot seek.
+	*/
+	if (access == _AF_WRITE_ACCESS && filesetup->streaming)
+		filehandle->m_seekok = false;
+	if (access == _AF_WRITE_ACCESS && !filehandle->m_seekok &&
+		!filehandle->supportsStreaming())
+	{
+		_af_error(AF_BAD_FILEFMT,
+			"%s files cannot be written in streaming mode or to a "
+			"non-seekable file", formatName);
+		delete filehandle;
+		if (completesetup)
+			afFreeFileSetup(completesetup);
+		return AF_FAIL;
+	}
 	if (filename != NULL)
 		filehandle->m_fileName = strdup(filename);
 	else
@@ -353,7 +597,12 @@ static status _afOpenFile (int access, File *f, const char *filename,
 
 	status result = access == _AF_READ_ACCESS ?
 		filehandle->readInit(completesetup) :
-		filehandle->writeInit(completesetup);
+		filehandle->commitWriteInit(completesetup);
+	if (result == AF_SUCCEED &&
+		(openMode == kOpenAppend || openMode == kOpenUpdate))
+		result = initInPlace(filehandle, openMode);
+	if (result == AF_SUCCEED && openMode == kOpenEdit)
+		result = initEdit(filehandle);
 
 	if (result != AF_SUCCEED)
 	{
@@ -364,9 +613,22 @@ static status _afOpenFile (int access, File *f, const char *filename,
 		return AF_FAIL;
 	}
 
+	if (openMode == kOpenWrite && completesetup &&
+		(filehandle->m_writePolicy & AF_WRITE_PREALLOCATE))
+		preallocateData(filehandle, completesetup);
+
 	if (completesetup)
 		afFreeFileSetup(completesetup);
 
+	/*
+		A seek index is kept only for a file which is only read,
+		since its restart points move when frames are written.
+	*/
+	if (openMode == kOpenRead && accesssetup != AF_NULL_FILESETUP &&
+		accesssetup->seekIndex)
+		filehandle->initSeekIndexes(accesssetup->seekIndexPath,
+			accesssetup->seekIndexInterval);
+
 	/*
 		Initialize virtual format.
 	*/
@@ -398,6 +660,14 @@ static status _afOpenFile (int access, File *f, const char *filename,
 			delete filehandle;
 			return AF_FAIL;
 		}
+
+		/*
+			afReadFramesAt() needs a file which supports positional
+			reads; a zero-length read tells whether this one does.
+		*/
+		if (openMode == kOpenRead && filehandle->m_seekok &&
+			f->readAt(NULL, 0, 0) == 0)
+			track->readerPool = new ReaderPool();
 	}
 
 	*file = filehandle;
@@ -408,7 +678,12 @@ static status _afOpenFile (int access, File *f, const char *filename,
 int afSyncFile (AFfilehandle handle)
 {
 	if (!_af_filehandle_ok(handle))
-		return -1;
+		return AF_FAIL;
+
+	// A file opened with "r+" has its header updated even after reading.
+	if (handle->m_readWrite &&
+		handle->switchAccess(_AF_WRITE_ACCESS) == AF_FAIL)
+		return AF_FAIL;
 
 	if (handle->m_access == _AF_WRITE_ACCESS)
 	{
@@ -418,19 +693,59 @@ int afSyncFile (AFfilehandle handle)
 			Track *track = &handle->m_tracks[trackno];
 
 			if (track->ms->isDirty() && track->ms->setup(handle, track) == AF_FAIL)
-				return -1;
+				return AF_FAIL;
+
+			/*
+				A partial block is written at the next frame, but
+				a previous sync may have left the file positioned
+				in the header.
+			*/
+			if (!track->ms->fileModuleHandlesSeeking() &&
+				handle->m_seekok &&
+				handle->m_fh->seek(track->fpos_next_frame, File::SeekFromBeginning) !=
+					track->fpos_next_frame)
+			{
+				_af_error(AF_BAD_LSEEK, "unable to position write pointer at next frame");
+				return AF_FAIL;
+			}
 
 			if (track->ms->sync(handle, track) != AF_SUCCEED)
-				return -1;
+				return AF_FAIL;
 		}
 
 		/* Update file headers. */
-		if (handle->update() != AF_SUCCEED)
+		if (handle->commitUpdate() != AF_SUCCEED)
+			return AF_FAIL;
+		handle->m_metadataChanged = 0;
+
+		/*
+			Hand the buffered data to the operating system and,
+			if the write policy asks for it, wait for it to reach
+			storage.
+		*/
+		int result = (handle->m_writePolicy & AF_WRITE_SYNC_ALWAYS) ?
+			handle->m_fh->sync() : handle->m_fh->flush();
+		if (result != 0)
+		{
+			_af_error(AF_BAD_WRITE, "could not write buffered data");
 			return AF_FAIL;
+		}
 	}
 	else if (handle->m_access == _AF_READ_ACCESS)
 	{
-		/* Do nothing. */
+		// Only a file opened with "m" is written while it is read.
+		if (handle->m_editMetadata && handle->m_metadataChanged)
+		{
+			if (handle->commitUpdate() != AF_SUCCEED)
+				return AF_FAIL;
+			handle->m_metadataChanged = 0;
+
+			if (handle->m_fh->flush() != 0)
+			{
+				_af_error(AF_BAD_WRITE, "could not write buffered data");
+				return AF_FAIL;
+			}
+		}
 	}
 	else
 	{
@@ -442,21 +757,75 @@ int afSyncFile (AFfilehandle handle)
 	return AF_SUCCEED;
 }
 
-int afCloseFile (AFfilehandle file)
+/*
+	Sync and close file.  If contents is not NULL, the contents of a
+	file held in memory are handed to the caller in *contents and
+	*size before the file is closed.
+*/
+static int closeFile (AFfilehandle file, void **contents, size_t *size)
 {
 	int	err;
 
 	if (!_af_filehandle_ok(file))
 		return -1;
 
-	afSyncFile(file);
+	// The file is closed even if its data could not be written.
+	int result = 0;
+	if (afSyncFile(file) != AF_SUCCEED)
+		result = -1;
+
+	/*
+		Data written since the last afSyncFile() has not yet
+		reached storage unless it was synchronized there.
+	*/
+	if (file->m_access == _AF_WRITE_ACCESS &&
+		(file->m_writePolicy & AF_WRITE_SYNC_ON_CLOSE) &&
+		!(file->m_writePolicy & AF_WRITE_SYNC_ALWAYS) &&
+		file->m_fh->sync() != 0)
+	{
+		_af_error(AF_BAD_WRITE, "could not synchronize file with storage");
+		result = -1;
+	}
+
+	file->saveSeekIndexes();
+
+	if (contents != NULL)
+	{
+		*size = 0;
+		*contents = file->m_fh->releaseContents(size);
+		if (*contents == NULL)
+		{
+			_af_error(AF_BAD_ACCMODE,
+				"file does not hold written data in memory");
+			result = -1;
+		}
+	}
 
 	err = file->m_fh->close();
 	if (err < 0)
+	{
 		_af_error(AF_BAD_CLOSE, "close returned %d", err);
+		result = -1;
+	}
 
 	delete file->m_fh;
 	delete file;
 
-	return 0;
+	return result;
+}
+
+int afCloseFile (AFfilehandle file)
+{
+	return closeFile(file, NULL, NULL);
+}
+
+int afCloseMemoryFile (AFfilehandle file, void **data, size_t *size)
+{
+	if (!data || !size)
+	{
+		_af_error(AF_BAD_CLOSE, "null pointer for memory file contents");
+		return -1;
+	}
+
+	return closeFile(file, data, size);
 }
@@ -0,0 +1,179 @@
+/*
+	Audio File Library
+
+	This library is free software; you can redistribute it and/or
+	modify it under the terms of the GNU Lesser General Public
+	License as published by the Free Software Foundation; either
+	version 2.1 of the License, or (at your option) any later version.
+
+	This library is distributed in the hope that it will be useful,
+	but WITHOUT ANY WARRANTY; without even the implied warranty of
+	MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+	Lesser General Public License for more details.
+
+	You should have received a copy of the GNU Lesser General Public
+	License along with this library; if not, write to the
+	Free Software Foundation, Inc., 51 Franklin Street, Fifth Floor,
+	Boston, MA  02110-1301  USA
+*/
+
+/*
+	probe.cpp
+
+	This file contains routines which read the essential header fields
+	of an audio file without opening a file handle for it.
+*/
+
+#include "config.h"
+
+#include <string.h>
+#ifdef HAVE_UNISTD_H
+#include <unistd.h>
+#endif
+
+#include <audiofile.h>
+
+#include "BufferedFile.h"
+#include "File.h"
+#include "FileHandle.h"
+#include "Track.h"
+#include "afinternal.h"
+#include "units.h"
+
+/*
+	Headers are small and usually contiguous, so a single page of
+	read-ahead is enough to identify and parse most files.
+*/
+static const size_t kProbeBufferSize = 4096;
+
+static void clearFileInfo (AFfileinfo *info)
+{
+	memset(info, 0, sizeof (AFfileinfo));
+	info->fileFormat = AF_FILE_UNKNOWN;
+	info->frameCount = -1;
+	info->duration = -1;
+}
+
+/*
+	Parse the header of f without building a module chain or reading
+	any metadata which is not needed to describe the audio data.
+*/
+static status probe (File *f, const char *filename, AFfileinfo *info)
+{
+	int implemented = true;
+	int fileFormat = _af_identify(f, &implemented);
+
+	if (fileFormat == AF_FILE_UNKNOWN)
+	{
+		if (filename != NULL)
+			_af_error(AF_BAD_NOT_IMPLEMENTED,
+				"'%s': unrecognized audio file format",
+				filename);
+		else
+			_af_error(AF_BAD_NOT_IMPLEMENTED,
+				"unrecognized audio file format");
+		return AF_FAIL;
+	}
+
+	if (!implemented)
+	{
+		_af_error(AF_BAD_NOT_IMPLEMENTED,
+			"%s format not currently supported",
+			_af_units[fileFormat].name);
+		return AF_FAIL;
+	}
+
+	AFfilehandle handle = _AFfilehandle::create(fileFormat);
+	if (!handle)
+		return AF_FAIL;
+
+	handle->m_fh = f;
+	handle->m_access = _AF_READ_ACCESS;
+	handle->m_seekok = f->canSeek();
+	handle->m_fileFormat = fileFormat;
+	handle->m_headerOnly = true;
+
+	status result = handle->readInit(AF_NULL_FILESETUP);
+
+	Track *track = NULL;
+	if (result == AF_SUCCEED && handle->m_trackCount > 0)
+		track = &handle->m_tracks[0];
+
+	if (track)
+	{
+		info->fileFormat = fileFormat;
+		info->channelCount = track->f.channelCount;
+		info->sampleRate = track->f.sampleRate;
+		info->sampleFormat = track->f.sampleFormat;
+		info->sampleWidth = track->f.sampleWidth;
+		info->byteOrder = track->f.byteOrder;
+		info->compressionType = track->f.compressionType;
+		info->frameCount = track->totalfframes;
+		info->dataOffset = track->fpos_first_frame;
+		info->dataBytes = track->data_size;
+		if (track->totalfframes >= 0 && track->f.sampleRate > 0)
+			info->duration = track->totalfframes / track->f.sampleRate;
+	}
+	else
+		result = AF_FAIL;
+
+	delete handle;
+
+	return result;
+}
+
+int afProbeFile (const char *filename, AFfileinfo *info)
+{
+	clearFileInfo(info);
+
+	File *f = File::open(filename, File::ReadAccess);
+	if (!f)
+	{
+		_af_error(AF_BAD_OPEN, "could not open file '%s'", filename);
+		return -1;
+	}
+	f = new BufferedFile(f, kProbeBufferSize);
+
+	status result = probe(f, filename, info);
+
+	delete f;
+
+	return result == AF_SUCCEED ? 0 : -1;
+}
+
+int afProbeFD (int fd, AFfileinfo *info)
+{
+	clearFileInfo(info);
+
+	/*
+		Duplicate the file descriptor since otherwise the
+		original file descriptor would get closed when we close
+		the virtual file below.
+	*/
+	fd = dup(fd);
+
+	File *f = File::create(fd, File::ReadAccess);
+	if (!f)
+	{
+		_af_error(AF_BAD_OPEN, "could not open file descriptor");
+		return -1;
+	}
+	f = new BufferedFile(f, kProbeBufferSize);
+
+	status result = probe(f, NULL, info);
+
+	delete f;
+
+	return result == AF_SUCCEED ? 0 : -1;
+}
+
+int afProbeFiles (const char * const *filenames, int count, AFfileinfo *infos)
+{
+	int probed = 0;
+
+	for (int i=0; i<count; i++)
+		if (afProbeFile(filenames[i], &infos[i]) == 0)
+			probed++;
+
+	return probed;
+}
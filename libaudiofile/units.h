@@ -31,6 +31,8 @@
 #include "audiofile.h"
 #include "afinternal.h"
 
+#include <stdint.h>
+
 struct AudioFormat;
 class FileModule;
 
@@ -43,7 +45,8 @@ struct Unit
 	bool implemented;	/* if implemented */
 
 	AFfilesetup (*completesetup) (AFfilesetup setup);
-	bool (*recognize) (File *fh);
+	/* examines the first bytes of a file, see _AF_RECOGNIZE_LENGTH */
+	bool (*recognize) (const uint8_t *header, size_t length);
 
 	int defaultSampleFormat;
 	int defaultSampleWidth;
@@ -83,7 +86,16 @@ struct CompressionUnit
 #define _AF_NUM_UNITS 17
 #define _AF_NUM_COMPRESSION 7
 
+/*
+	The number of bytes at the beginning of a file which are passed
+	to each unit's recognize function.  This must be large enough
+	for the longest magic number.
+*/
+#define _AF_RECOGNIZE_LENGTH 32
+
 extern const Unit _af_units[_AF_NUM_UNITS];
 extern const CompressionUnit _af_compression[_AF_NUM_COMPRESSION];
 
+int _af_identify (File *f, int *implemented);
+
 #endif /* UNIT_H */
@@ -128,6 +128,20 @@ bool printfileinfo (const char *filename)
 		afGetFrameCount(file, AF_DEFAULT_TRACK) /
 		afGetRate(file, AF_DEFAULT_TRACK));
 
+	int channels = afGetChannels(file, AF_DEFAULT_TRACK);
+	double *peaks = malloc(channels * sizeof (double));
+	AFframecount *positions = malloc(channels * sizeof (AFframecount));
+	if (peaks && positions &&
+		afGetPeaks(file, AF_DEFAULT_TRACK, peaks, positions) == channels)
+	{
+		for (int i=0; i<channels; i++)
+			printf("%-15s%f in channel %d at frame %jd\n",
+				i == 0 ? "Peak" : "", peaks[i], i + 1,
+				(intmax_t) positions[i]);
+	}
+	free(peaks);
+	free(positions);
+
 	char *copyright = copyrightstring(file);
 	if (copyright)
 	{
@@ -44,6 +44,7 @@ void printversion (void);
 void printusage (void);
 void usageerror (void);
 bool copyaudiodata (AFfilehandle infile, AFfilehandle outfile, int trackid);
+bool canremux (AFfilehandle infile, AFfilehandle outfile, int trackid);
 
 int main (int argc, char **argv)
 {
@@ -227,6 +228,23 @@ int main (int argc, char **argv)
 		outSampleWidth);
 	afInitChannels(outFileSetup, AF_DEFAULT_TRACK, outChannelCount);
 	afInitRate(outFileSetup, AF_DEFAULT_TRACK, sampleRate);
+	// Keep the peaks of an input file which stores them.
+	afInitPeaks(outFileSetup, AF_DEFAULT_TRACK,
+		afGetPeaks(inFile, AF_DEFAULT_TRACK, NULL, NULL) > 0);
+
+	/*
+		CAF files can store samples in either byte order, so when the
+		sample data could otherwise be copied unchanged (see canremux),
+		keep the byte order of the input file.
+	*/
+	if (outFileFormat == AF_FILE_CAF &&
+		afGetCompression(inFile, AF_DEFAULT_TRACK) == AF_COMPRESSION_NONE &&
+		outCompression == AF_COMPRESSION_NONE &&
+		outChannelCount == channelCount &&
+		outSampleFormat == sampleFormat &&
+		outSampleWidth == sampleWidth)
+		afInitByteOrder(outFileSetup, AF_DEFAULT_TRACK,
+			afGetByteOrder(inFile, AF_DEFAULT_TRACK));
 
 	AFfilehandle outFile = afOpenFile(outFileName, "w", outFileSetup);
 	if (!outFile)
@@ -245,7 +263,12 @@ int main (int argc, char **argv)
 	afSetVirtualSampleFormat(outFile, AF_DEFAULT_TRACK, sampleFormat,
 		sampleWidth);
 
-	bool success = copyaudiodata(inFile, outFile, AF_DEFAULT_TRACK);
+	bool success;
+	if (canremux(inFile, outFile, AF_DEFAULT_TRACK))
+		success = afRemuxTrack(inFile, outFile, AF_DEFAULT_TRACK) ==
+			afGetFrameCount(inFile, AF_DEFAULT_TRACK);
+	else
+		success = copyaudiodata(inFile, outFile, AF_DEFAULT_TRACK);
 
 	afCloseFile(inFile);
 	afCloseFile(outFile);
@@ -364,3 +387,27 @@ bool copyaudiodata (AFfilehandle infile, AFfilehandle outfile, int trackid)
 
 	return success;
 }
+
+/*
+	Determine whether the sample data of one file can be copied
+	unchanged into another.
+*/
+bool canremux (AFfilehandle infile, AFfilehandle outfile, int trackid)
+{
+	if (afGetCompression(infile, trackid) != AF_COMPRESSION_NONE ||
+		afGetCompression(outfile, trackid) != AF_COMPRESSION_NONE)
+		return false;
+
+	if (afGetChannels(infile, trackid) != afGetChannels(outfile, trackid) ||
+		afGetRate(infile, trackid) != afGetRate(outfile, trackid))
+		return false;
+
+	int inSampleFormat, inSampleWidth, outSampleFormat, outSampleWidth;
+	afGetSampleFormat(infile, trackid, &inSampleFormat, &inSampleWidth);
+	afGetSampleFormat(outfile, trackid, &outSampleFormat, &outSampleWidth);
+	if (inSampleFormat != outSampleFormat || inSampleWidth != outSampleWidth)
+		return false;
+
+	return inSampleWidth <= 8 ||
+		afGetByteOrder(infile, trackid) == afGetByteOrder(outfile, trackid);
+}
@@ -0,0 +1,185 @@
+/*
+	Audio File Library
+
+	This program is free software; you can redistribute it and/or modify
+	it under the terms of the GNU General Public License as published by
+	the Free Software Foundation; either version 2 of the License, or
+	(at your option) any later version.
+
+	This program is distributed in the hope that it will be useful,
+	but WITHOUT ANY WARRANTY; without even the implied warranty of
+	MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+	GNU General Public License for more details.
+
+	You should have received a copy of the GNU General Public License along
+	with this program; if not, write to the Free Software Foundation, Inc.,
+	51 Franklin Street, Fifth Floor, Boston, MA  02110-1301  USA
+*/
+
+/*
+	This program tests that files read with access hints are read
+	correctly, both in order and after seeking.
+*/
+
+#include <algorithm>
+#include <audiofile.h>
+#include <gtest/gtest.h>
+#include <stdint.h>
+#include <unistd.h>
+#include <string>
+#include <vector>
+
+#include "TestUtilities.h"
+
+static const int kChannelCount = 2;
+static const int kFrameCount = 1000000;
+
+class AccessHintTest : public testing::Test
+{
+protected:
+	virtual void SetUp()
+	{
+		generateStereoFrames(m_frames, kFrameCount);
+		ASSERT_TRUE(createTemporaryFile("AccessHint", &m_path));
+	}
+	virtual void TearDown()
+	{
+		ASSERT_EQ(0, ::unlink(m_path.c_str()));
+	}
+
+	void writeFile(int fileFormat, int compression)
+	{
+		AFfilesetup setup = afNewFileSetup();
+		afInitFileFormat(setup, fileFormat);
+		afInitChannels(setup, AF_DEFAULT_TRACK, kChannelCount);
+		afInitSampleFormat(setup, AF_DEFAULT_TRACK, AF_SAMPFMT_TWOSCOMP, 16);
+		afInitCompression(setup, AF_DEFAULT_TRACK, compression);
+		AFfilehandle file = afOpenFile(m_path.c_str(), "w", setup);
+		afFreeFileSetup(setup);
+		ASSERT_TRUE(file);
+		ASSERT_EQ(kFrameCount, afWriteFrames(file, AF_DEFAULT_TRACK,
+			&m_frames[0], kFrameCount));
+		ASSERT_EQ(0, afCloseFile(file));
+	}
+
+	AFfilehandle openFile(bool memoryMap)
+	{
+		AFfilesetup setup = afNewFileSetup();
+		afInitMemoryMap(setup, memoryMap, AF_MMAP_NORMAL);
+		AFfilehandle file = afOpenFile(m_path.c_str(), "r", setup);
+		afFreeFileSetup(setup);
+		return file;
+	}
+
+	// Read the whole file in pieces of varying size.
+	void readInOrder(int hint, AFframecount prefetchFrames, bool memoryMap)
+	{
+		AFfilehandle file = openFile(memoryMap);
+		ASSERT_TRUE(file);
+		ASSERT_EQ(0, afSetAccessHint(file, hint, prefetchFrames));
+
+		std::vector<int16_t> data(kFrameCount * kChannelCount);
+		int framesRead = 0;
+		for (int i=0; framesRead < kFrameCount; i++)
+		{
+			int frameCount = std::min(1000 + (i * 997) % 9000,
+				kFrameCount - framesRead);
+			ASSERT_EQ(frameCount, afReadFrames(file, AF_DEFAULT_TRACK,
+				&data[framesRead * kChannelCount], frameCount));
+			framesRead += frameCount;
+		}
+		EXPECT_TRUE(data == m_frames);
+		ASSERT_EQ(0, afCloseFile(file));
+	}
+
+	// Read pieces of the file at scattered positions.
+	void readScattered(int hint, AFframecount prefetchFrames, bool memoryMap)
+	{
+		AFfilehandle file = openFile(memoryMap);
+		ASSERT_TRUE(file);
+		ASSERT_EQ(0, afSetAccessHint(file, hint, prefetchFrames));
+
+		static const int kReadFrames = 4096;
+		std::vector<int16_t> data(kReadFrames * kChannelCount);
+		for (int i=0; i<50; i++)
+		{
+			AFframecount frame = (static_cast<AFframecount>(i) * 7919 * 1013) %
+				(kFrameCount - kReadFrames);
+			ASSERT_EQ(frame, afSeekFrame(file, AF_DEFAULT_TRACK, frame));
+			ASSERT_EQ(kReadFrames, afReadFrames(file, AF_DEFAULT_TRACK,
+				&data[0], kReadFrames));
+			EXPECT_TRUE(std::equal(data.begin(), data.end(),
+				m_frames.begin() + frame * kChannelCount)) << "frame " << frame;
+		}
+		ASSERT_EQ(0, afCloseFile(file));
+	}
+
+	std::string m_path;
+	std::vector<int16_t> m_frames;
+};
+
+TEST_F(AccessHintTest, Sequential)
+{
+	writeFile(AF_FILE_WAVE, AF_COMPRESSION_NONE);
+	readInOrder(AF_ACCESS_SEQUENTIAL, 0, false);
+	readInOrder(AF_ACCESS_SEQUENTIAL, 100000, false);
+	readInOrder(AF_ACCESS_SEQUENTIAL, 100000, true);
+}
+
+TEST_F(AccessHintTest, Random)
+{
+	writeFile(AF_FILE_AIFFC, AF_COMPRESSION_NONE);
+	readScattered(AF_ACCESS_RANDOM, 0, false);
+	readScattered(AF_ACCESS_RANDOM, 4096, false);
+	readScattered(AF_ACCESS_RANDOM, 4096, true);
+}
+
+TEST_F(AccessHintTest, Prefetch)
+{
+	writeFile(AF_FILE_WAVE, AF_COMPRESSION_NONE);
+	readInOrder(AF_ACCESS_NORMAL, 1, false);
+	readScattered(AF_ACCESS_NORMAL, 10 * kFrameCount, false);
+}
+
+TEST_F(AccessHintTest, Compressed)
+{
+	writeFile(AF_FILE_CAF, AF_COMPRESSION_ALAC);
+	readInOrder(AF_ACCESS_SEQUENTIAL, 50000, false);
+	readScattered(AF_ACCESS_RANDOM, 8192, false);
+
+	writeFile(AF_FILE_WAVE, AF_COMPRESSION_IMA);
+	AFfilehandle file = openFile(false);
+	ASSERT_TRUE(file);
+	ASSERT_EQ(0, afSetAccessHint(file, AF_ACCESS_SEQUENTIAL, 50000));
+	std::vector<int16_t> data(kFrameCount * kChannelCount);
+	ASSERT_EQ(kFrameCount, afReadFrames(file, AF_DEFAULT_TRACK,
+		&data[0], kFrameCount));
+	ASSERT_EQ(0, afCloseFile(file));
+}
+
+TEST_F(AccessHintTest, Invalid)
+{
+	writeFile(AF_FILE_WAVE, AF_COMPRESSION_NONE);
+	AFfilehandle file = openFile(false);
+	ASSERT_TRUE(file);
+
+	IgnoreErrors ignoreErrors;
+	EXPECT_EQ(-1, afSetAccessHint(file, 3, 0));
+	EXPECT_EQ(-1, afSetAccessHint(file, AF_ACCESS_SEQUENTIAL, -1));
+	EXPECT_EQ(-1, afSetAccessHint(AF_NULL_FILEHANDLE, AF_ACCESS_NORMAL, 0));
+	ASSERT_EQ(0, afCloseFile(file));
+
+	AFfilesetup setup = afNewFileSetup();
+	afInitFileFormat(setup, AF_FILE_WAVE);
+	file = afOpenFile(m_path.c_str(), "w", setup);
+	afFreeFileSetup(setup);
+	ASSERT_TRUE(file);
+	EXPECT_EQ(-1, afSetAccessHint(file, AF_ACCESS_SEQUENTIAL, 0));
+	ASSERT_EQ(0, afCloseFile(file));
+}
+
+int main(int argc, char **argv)
+{
+	::testing::InitGoogleTest(&argc, argv);
+	return RUN_ALL_TESTS();
+}
@@ -29,7 +29,9 @@
 
 #include <audiofile.h>
 #include <stdio.h>
+#include <unistd.h>
 #include <gtest/gtest.h>
+#include <vector>
 
 struct ErrorListener *g_listener;
 
@@ -229,6 +231,43 @@ TEST(File, Bad)
 		AFfilesetup setup = afNewFileSetup();
 		afInitSampleFormat(setup, AF_DEFAULT_TRACK, 3992, 3932);
 		afFreeFileSetup(setup));
+
+	TEST_ERROR(AF_BAD_FILESETUP, "initializing write policy to invalid value",
+		AFfilesetup setup = afNewFileSetup();
+		afInitWritePolicy(setup, 0x100);
+		afFreeFileSetup(setup));
+}
+
+/*
+	Writes to /dev/full fail once the buffered data is written out,
+	and closing the file must report that.
+*/
+TEST(File, WriteFailure)
+{
+	if (access("/dev/full", W_OK) != 0)
+		return;
+
+	AFfilesetup setup = afNewFileSetup();
+	afInitFileFormat(setup, AF_FILE_WAVE);
+	afInitChannels(setup, AF_DEFAULT_TRACK, 2);
+	afInitSampleFormat(setup, AF_DEFAULT_TRACK, AF_SAMPFMT_TWOSCOMP, 16);
+	AFfilehandle file = afOpenFile("/dev/full", "w", setup);
+	afFreeFileSetup(setup);
+	ASSERT_TRUE(file);
+
+	std::vector<int16_t> frames(2 * 1000);
+	TEST_ERROR(AF_BAD_WRITE, "writing frames to full device",
+		for (int i=0; i<100; i++)
+			if (afWriteFrames(file, AF_DEFAULT_TRACK, &frames[0], 1000) != 1000)
+				break);
+
+	TEST_ERROR(AF_BAD_WRITE, "syncing file on full device",
+		EXPECT_EQ(-1, afSyncFile(file)));
+
+	// Closing reports both the failed write and the failed close.
+	AFerrfunc oldErrorFunction = afSetErrorHandler(NULL);
+	EXPECT_EQ(-1, afCloseFile(file));
+	afSetErrorHandler(oldErrorFunction);
 }
 
 TEST(Query, Bad)
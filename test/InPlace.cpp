@@ -0,0 +1,527 @@
+/*
+	Audio File Library
+
+	This program is free software; you can redistribute it and/or modify
+	it under the terms of the GNU General Public License as published by
+	the Free Software Foundation; either version 2 of the License, or
+	(at your option) any later version.
+
+	This program is distributed in the hope that it will be useful,
+	but WITHOUT ANY WARRANTY; without even the implied warranty of
+	MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+	GNU General Public License for more details.
+
+	You should have received a copy of the GNU General Public License along
+	with this program; if not, write to the Free Software Foundation, Inc.,
+	51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+*/
+
+/*
+	This program tests appending to existing files with mode "a",
+	overwriting their frames with mode "r+" and changing their
+	metadata with mode "m".
+*/
+
+#include <audiofile.h>
+#include <gtest/gtest.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <string.h>
+#include <unistd.h>
+#include <string>
+#include <vector>
+
+#include "TestUtilities.h"
+
+static const int kChannelCount = 2;
+
+static void generateFrames(std::vector<int16_t> &data, int frameCount,
+	int seed)
+{
+	data.resize(frameCount * kChannelCount);
+	for (size_t i=0; i<data.size(); i++)
+		data[i] = static_cast<int16_t>(i * 31 + seed * 1009);
+}
+
+static void writeFile(const std::string &path, int fileFormat,
+	int sampleFormat, int compression, const std::vector<int16_t> &frames)
+{
+	AFfilesetup setup = afNewFileSetup();
+	afInitFileFormat(setup, fileFormat);
+	afInitChannels(setup, AF_DEFAULT_TRACK, kChannelCount);
+	afInitSampleFormat(setup, AF_DEFAULT_TRACK, sampleFormat,
+		sampleFormat == AF_SAMPFMT_FLOAT ? 32 : 16);
+	afInitCompression(setup, AF_DEFAULT_TRACK, compression);
+	AFfilehandle file = afOpenFile(path.c_str(), "w", setup);
+	afFreeFileSetup(setup);
+	ASSERT_TRUE(file);
+	ASSERT_EQ(0, afSetVirtualSampleFormat(file, AF_DEFAULT_TRACK,
+		AF_SAMPFMT_TWOSCOMP, 16));
+	int frameCount = frames.size() / kChannelCount;
+	ASSERT_EQ(frameCount,
+		afWriteFrames(file, AF_DEFAULT_TRACK, &frames[0], frameCount));
+	ASSERT_EQ(0, afCloseFile(file));
+}
+
+static void readFile(const std::string &path, std::vector<int16_t> &frames)
+{
+	AFfilehandle file = afOpenFile(path.c_str(), "r", AF_NULL_FILESETUP);
+	ASSERT_TRUE(file);
+	ASSERT_EQ(0, afSetVirtualSampleFormat(file, AF_DEFAULT_TRACK,
+		AF_SAMPFMT_TWOSCOMP, 16));
+	AFframecount frameCount = afGetFrameCount(file, AF_DEFAULT_TRACK);
+	frames.resize(frameCount * kChannelCount);
+	if (frameCount)
+		ASSERT_EQ(frameCount,
+			afReadFrames(file, AF_DEFAULT_TRACK, &frames[0], frameCount));
+	ASSERT_EQ(0, afCloseFile(file));
+}
+
+static void testAppend(int fileFormat, int sampleFormat, int compression)
+{
+	std::string testFileName, referenceFileName;
+	ASSERT_TRUE(createTemporaryFile("InPlace", &testFileName));
+	ASSERT_TRUE(createTemporaryFile("InPlace", &referenceFileName));
+
+	std::vector<int16_t> first, second;
+	generateFrames(first, 1001, 1);
+	generateFrames(second, 777, 2);
+	writeFile(testFileName, fileFormat, sampleFormat, compression, first);
+
+	AFfilehandle file = afOpenFile(testFileName.c_str(), "a", AF_NULL_FILESETUP);
+	ASSERT_TRUE(file);
+	EXPECT_EQ(1001, afGetFrameCount(file, AF_DEFAULT_TRACK));
+	ASSERT_EQ(0, afSetVirtualSampleFormat(file, AF_DEFAULT_TRACK,
+		AF_SAMPFMT_TWOSCOMP, 16));
+	ASSERT_EQ(777, afWriteFrames(file, AF_DEFAULT_TRACK, &second[0], 777));
+	EXPECT_EQ(1778, afGetFrameCount(file, AF_DEFAULT_TRACK));
+	ASSERT_EQ(0, afCloseFile(file));
+
+	// The result reads the same as a file written in one go.
+	std::vector<int16_t> all(first);
+	all.insert(all.end(), second.begin(), second.end());
+	writeFile(referenceFileName, fileFormat, sampleFormat, compression, all);
+
+	std::vector<int16_t> data, referenceData;
+	readFile(testFileName, data);
+	readFile(referenceFileName, referenceData);
+	ASSERT_EQ(referenceData.size(), data.size());
+	EXPECT_TRUE(data == referenceData);
+	if (sampleFormat == AF_SAMPFMT_TWOSCOMP && compression == AF_COMPRESSION_NONE)
+		EXPECT_TRUE(data == all);
+
+	ASSERT_EQ(0, ::unlink(testFileName.c_str()));
+	ASSERT_EQ(0, ::unlink(referenceFileName.c_str()));
+}
+
+TEST(InPlace, AppendWAVE)
+{
+	testAppend(AF_FILE_WAVE, AF_SAMPFMT_TWOSCOMP, AF_COMPRESSION_NONE);
+}
+
+TEST(InPlace, AppendWAVE_Float)
+{
+	testAppend(AF_FILE_WAVE, AF_SAMPFMT_FLOAT, AF_COMPRESSION_NONE);
+}
+
+TEST(InPlace, AppendWAVE_ULaw)
+{
+	testAppend(AF_FILE_WAVE, AF_SAMPFMT_TWOSCOMP, AF_COMPRESSION_G711_ULAW);
+}
+
+TEST(InPlace, AppendAIFF)
+{
+	testAppend(AF_FILE_AIFF, AF_SAMPFMT_TWOSCOMP, AF_COMPRESSION_NONE);
+}
+
+TEST(InPlace, AppendAIFFC_ALaw)
+{
+	testAppend(AF_FILE_AIFFC, AF_SAMPFMT_TWOSCOMP, AF_COMPRESSION_G711_ALAW);
+}
+
+TEST(InPlace, AppendCAF)
+{
+	testAppend(AF_FILE_CAF, AF_SAMPFMT_TWOSCOMP, AF_COMPRESSION_NONE);
+}
+
+// Markers written with the file survive appending.
+TEST(InPlace, AppendKeepsMarkers)
+{
+	std::string testFileName;
+	ASSERT_TRUE(createTemporaryFile("InPlace", &testFileName));
+
+	std::vector<int16_t> frames;
+	generateFrames(frames, 500, 3);
+
+	AFfilesetup setup = afNewFileSetup();
+	afInitFileFormat(setup, AF_FILE_WAVE);
+	afInitChannels(setup, AF_DEFAULT_TRACK, kChannelCount);
+	afInitSampleFormat(setup, AF_DEFAULT_TRACK, AF_SAMPFMT_TWOSCOMP, 16);
+	int markerID = 1;
+	afInitMarkIDs(setup, AF_DEFAULT_TRACK, &markerID, 1);
+	AFfilehandle file = afOpenFile(testFileName.c_str(), "w", setup);
+	afFreeFileSetup(setup);
+	ASSERT_TRUE(file);
+	afSetMarkPosition(file, AF_DEFAULT_TRACK, markerID, 123);
+	ASSERT_EQ(500, afWriteFrames(file, AF_DEFAULT_TRACK, &frames[0], 500));
+	ASSERT_EQ(0, afCloseFile(file));
+
+	file = afOpenFile(testFileName.c_str(), "a", AF_NULL_FILESETUP);
+	ASSERT_TRUE(file);
+	ASSERT_EQ(500, afWriteFrames(file, AF_DEFAULT_TRACK, &frames[0], 500));
+	{
+		// Metadata cannot be changed while appending.
+		IgnoreErrors ignoreErrors;
+		afSetMarkPosition(file, AF_DEFAULT_TRACK, markerID, 700);
+		EXPECT_EQ(-1, afWriteMisc(file, 1, "x", 1));
+	}
+	ASSERT_EQ(0, afCloseFile(file));
+
+	file = afOpenFile(testFileName.c_str(), "r", AF_NULL_FILESETUP);
+	ASSERT_TRUE(file);
+	EXPECT_EQ(1000, afGetFrameCount(file, AF_DEFAULT_TRACK));
+	ASSERT_EQ(1, afGetMarkIDs(file, AF_DEFAULT_TRACK, NULL));
+	EXPECT_EQ(123, afGetMarkPosition(file, AF_DEFAULT_TRACK, markerID));
+	ASSERT_EQ(0, afCloseFile(file));
+
+	ASSERT_EQ(0, ::unlink(testFileName.c_str()));
+}
+
+static void testReadWrite(int fileFormat)
+{
+	std::string testFileName;
+	ASSERT_TRUE(createTemporaryFile("InPlace", &testFileName));
+
+	std::vector<int16_t> frames, patch;
+	generateFrames(frames, 2000, 4);
+	generateFrames(patch, 300, 5);
+	writeFile(testFileName, fileFormat, AF_SAMPFMT_TWOSCOMP,
+		AF_COMPRESSION_NONE, frames);
+
+	AFfilehandle file = afOpenFile(testFileName.c_str(), "r+", AF_NULL_FILESETUP);
+	ASSERT_TRUE(file);
+	EXPECT_EQ(2000, afGetFrameCount(file, AF_DEFAULT_TRACK));
+
+	// Reading starts at the beginning of the sound data.
+	std::vector<int16_t> data(100 * kChannelCount);
+	ASSERT_EQ(100, afReadFrames(file, AF_DEFAULT_TRACK, &data[0], 100));
+	EXPECT_TRUE(std::equal(data.begin(), data.end(), frames.begin()));
+
+	// Overwrite frames in the middle and read those which follow.
+	ASSERT_EQ(600, afSeekFrame(file, AF_DEFAULT_TRACK, 600));
+	ASSERT_EQ(300, afWriteFrames(file, AF_DEFAULT_TRACK, &patch[0], 300));
+	EXPECT_EQ(900, afTellFrame(file, AF_DEFAULT_TRACK));
+	ASSERT_EQ(100, afReadFrames(file, AF_DEFAULT_TRACK, &data[0], 100));
+	EXPECT_TRUE(std::equal(data.begin(), data.end(),
+		frames.begin() + 900 * kChannelCount));
+	EXPECT_EQ(2000, afGetFrameCount(file, AF_DEFAULT_TRACK));
+	std::copy(patch.begin(), patch.end(), frames.begin() + 600 * kChannelCount);
+
+	// Writing past the end extends the file.
+	ASSERT_EQ(1900, afSeekFrame(file, AF_DEFAULT_TRACK, 1900));
+	ASSERT_EQ(300, afWriteFrames(file, AF_DEFAULT_TRACK, &patch[0], 300));
+	EXPECT_EQ(2200, afGetFrameCount(file, AF_DEFAULT_TRACK));
+	frames.resize(1900 * kChannelCount);
+	frames.insert(frames.end(), patch.begin(), patch.end());
+
+	// The whole file can be read back through the same handle.
+	ASSERT_EQ(0, afSeekFrame(file, AF_DEFAULT_TRACK, 0));
+	data.resize(frames.size());
+	ASSERT_EQ(2200, afReadFrames(file, AF_DEFAULT_TRACK, &data[0], 2200));
+	EXPECT_TRUE(data == frames);
+	ASSERT_EQ(0, afCloseFile(file));
+
+	readFile(testFileName, data);
+	ASSERT_EQ(frames.size(), data.size());
+	EXPECT_TRUE(data == frames);
+
+	ASSERT_EQ(0, ::unlink(testFileName.c_str()));
+}
+
+TEST(InPlace, ReadWriteWAVE)
+{
+	testReadWrite(AF_FILE_WAVE);
+}
+
+TEST(InPlace, ReadWriteAIFFC)
+{
+	testReadWrite(AF_FILE_AIFFC);
+}
+
+TEST(InPlace, ReadWriteCAF)
+{
+	testReadWrite(AF_FILE_CAF);
+}
+
+TEST(InPlace, EditWAVE)
+{
+	std::string testFileName;
+	ASSERT_TRUE(createTemporaryFile("InPlace", &testFileName));
+
+	std::vector<int16_t> frames;
+	generateFrames(frames, 1000, 7);
+
+	AFfilesetup setup = afNewFileSetup();
+	afInitFileFormat(setup, AF_FILE_WAVE);
+	afInitChannels(setup, AF_DEFAULT_TRACK, kChannelCount);
+	afInitSampleFormat(setup, AF_DEFAULT_TRACK, AF_SAMPFMT_TWOSCOMP, 16);
+	const int markerIDs[] = { 1, 2 };
+	afInitMarkIDs(setup, AF_DEFAULT_TRACK, markerIDs, 2);
+	afInitMarkName(setup, AF_DEFAULT_TRACK, 1, "start");
+	afInitMarkName(setup, AF_DEFAULT_TRACK, 2, "end");
+	int miscID = 1;
+	afInitMiscIDs(setup, &miscID, 1);
+	afInitMiscType(setup, miscID, AF_MISC_ICMT);
+	afInitMiscSize(setup, miscID, 8);
+	AFfilehandle file = afOpenFile(testFileName.c_str(), "w", setup);
+	afFreeFileSetup(setup);
+	ASSERT_TRUE(file);
+	ASSERT_EQ(8, afWriteMisc(file, miscID, "comment", 8));
+	afSetMarkPosition(file, AF_DEFAULT_TRACK, 1, 10);
+	afSetMarkPosition(file, AF_DEFAULT_TRACK, 2, 990);
+	ASSERT_EQ(1000, afWriteFrames(file, AF_DEFAULT_TRACK, &frames[0], 1000));
+	ASSERT_EQ(0, afCloseFile(file));
+	off_t size = fileSize(testFileName);
+
+	file = afOpenFile(testFileName.c_str(), "m", AF_NULL_FILESETUP);
+	ASSERT_TRUE(file);
+	EXPECT_EQ(10, afGetMarkPosition(file, AF_DEFAULT_TRACK, 1));
+	afSetMarkPosition(file, AF_DEFAULT_TRACK, 1, 123);
+	ASSERT_EQ(0, afSeekMisc(file, miscID, 0));
+	ASSERT_EQ(8, afWriteMisc(file, miscID, "changed", 8));
+
+	// Frames can be read but not written.
+	std::vector<int16_t> data(frames.size());
+	ASSERT_EQ(1000, afReadFrames(file, AF_DEFAULT_TRACK, &data[0], 1000));
+	EXPECT_TRUE(data == frames);
+	{
+		IgnoreErrors ignoreErrors;
+		EXPECT_EQ(-1, afWriteFrames(file, AF_DEFAULT_TRACK, &frames[0], 1));
+	}
+	ASSERT_EQ(0, afCloseFile(file));
+
+	// The chunks were rewritten where they were.
+	EXPECT_EQ(size, fileSize(testFileName));
+
+	file = afOpenFile(testFileName.c_str(), "r", AF_NULL_FILESETUP);
+	ASSERT_TRUE(file);
+	EXPECT_EQ(123, afGetMarkPosition(file, AF_DEFAULT_TRACK, 1));
+	EXPECT_EQ(990, afGetMarkPosition(file, AF_DEFAULT_TRACK, 2));
+	EXPECT_STREQ("start", afGetMarkName(file, AF_DEFAULT_TRACK, 1));
+	char misc[8];
+	ASSERT_EQ(8, afReadMisc(file, miscID, misc, 8));
+	EXPECT_STREQ("changed", misc);
+	ASSERT_EQ(0, afCloseFile(file));
+
+	readFile(testFileName, data);
+	EXPECT_TRUE(data == frames);
+
+	ASSERT_EQ(0, ::unlink(testFileName.c_str()));
+}
+
+TEST(InPlace, EditAIFF)
+{
+	std::string testFileName;
+	ASSERT_TRUE(createTemporaryFile("InPlace", &testFileName));
+
+	std::vector<int16_t> frames;
+	generateFrames(frames, 1000, 8);
+	writeFile(testFileName, AF_FILE_AIFF, AF_SAMPFMT_TWOSCOMP,
+		AF_COMPRESSION_NONE, frames);
+	off_t size = fileSize(testFileName);
+
+	AFfilehandle file = afOpenFile(testFileName.c_str(), "m", AF_NULL_FILESETUP);
+	ASSERT_TRUE(file);
+	afSetMarkPosition(file, AF_DEFAULT_TRACK, 1, 100);
+	afSetMarkPosition(file, AF_DEFAULT_TRACK, 2, 900);
+	afSetInstParamLong(file, AF_DEFAULT_INST, AF_INST_MIDI_BASENOTE, 48);
+	afSetLoopMode(file, AF_DEFAULT_INST, 1, AF_LOOP_MODE_FORW);
+	afSetLoopStart(file, AF_DEFAULT_INST, 1, 1);
+	afSetLoopEnd(file, AF_DEFAULT_INST, 1, 2);
+	// Syncing writes the changes made so far.
+	ASSERT_EQ(0, afSyncFile(file));
+	afSetMarkPosition(file, AF_DEFAULT_TRACK, 2, 800);
+	ASSERT_EQ(0, afCloseFile(file));
+
+	EXPECT_EQ(size, fileSize(testFileName));
+
+	file = afOpenFile(testFileName.c_str(), "r", AF_NULL_FILESETUP);
+	ASSERT_TRUE(file);
+	EXPECT_EQ(100, afGetMarkPosition(file, AF_DEFAULT_TRACK, 1));
+	EXPECT_EQ(800, afGetMarkPosition(file, AF_DEFAULT_TRACK, 2));
+	EXPECT_EQ(48, afGetInstParamLong(file, AF_DEFAULT_INST, AF_INST_MIDI_BASENOTE));
+	EXPECT_EQ(AF_LOOP_MODE_FORW, afGetLoopMode(file, AF_DEFAULT_INST, 1));
+	EXPECT_EQ(100, afGetLoopStartFrame(file, AF_DEFAULT_INST, 1));
+	EXPECT_EQ(800, afGetLoopEndFrame(file, AF_DEFAULT_INST, 1));
+	ASSERT_EQ(0, afCloseFile(file));
+
+	std::vector<int16_t> data;
+	readFile(testFileName, data);
+	EXPECT_TRUE(data == frames);
+
+	ASSERT_EQ(0, ::unlink(testFileName.c_str()));
+}
+
+static void appendU32(std::vector<uint8_t> &bytes, uint32_t value)
+{
+	for (int i=0; i<4; i++)
+		bytes.push_back((value >> (8 * i)) & 0xff);
+}
+
+static void appendChunk(std::vector<uint8_t> &bytes, const char *id,
+	const std::vector<uint8_t> &data)
+{
+	bytes.insert(bytes.end(), id, id + 4);
+	appendU32(bytes, data.size());
+	bytes.insert(bytes.end(), data.begin(), data.end());
+}
+
+/*
+	Write a WAVE file with a cue chunk but no names for its cue
+	points, optionally followed by a JUNK chunk, as other programs
+	do.  Rewriting the cue chunk adds the names, so it grows.
+*/
+static void writeCueFile(const std::string &path, uint32_t junkSize)
+{
+	std::vector<uint8_t> format;
+	appendU32(format, 1 | (1 << 16));	// PCM, mono
+	appendU32(format, 8000);
+	appendU32(format, 16000);
+	appendU32(format, 2 | (16 << 16));	// block align, bits per sample
+
+	std::vector<uint8_t> cue;
+	appendU32(cue, 1);
+	appendU32(cue, 7);	// cue point ID
+	appendU32(cue, 0);
+	cue.insert(cue.end(), "data", "data" + 4);
+	appendU32(cue, 0);
+	appendU32(cue, 0);
+	appendU32(cue, 5);	// position
+
+	std::vector<uint8_t> data;
+	for (int i=0; i<20; i++)
+		data.push_back(i);
+
+	std::vector<uint8_t> bytes;
+	appendChunk(bytes, "fmt ", format);
+	appendChunk(bytes, "cue ", cue);
+	if (junkSize)
+		appendChunk(bytes, "JUNK", std::vector<uint8_t>(junkSize));
+	appendChunk(bytes, "data", data);
+
+	std::vector<uint8_t> riff;
+	riff.insert(riff.end(), "WAVE", "WAVE" + 4);
+	riff.insert(riff.end(), bytes.begin(), bytes.end());
+	bytes.clear();
+	appendChunk(bytes, "RIFF", riff);
+
+	FILE *fp = fopen(path.c_str(), "wb");
+	ASSERT_TRUE(fp);
+	ASSERT_EQ(1u, fwrite(&bytes[0], bytes.size(), 1, fp));
+	ASSERT_EQ(0, fclose(fp));
+}
+
+static void testEditGrowingChunk(uint32_t junkSize, bool moves)
+{
+	std::string testFileName;
+	ASSERT_TRUE(createTemporaryFile("InPlace", &testFileName));
+	writeCueFile(testFileName, junkSize);
+	off_t size = fileSize(testFileName);
+
+	AFfilehandle file = afOpenFile(testFileName.c_str(), "m", AF_NULL_FILESETUP);
+	ASSERT_TRUE(file);
+	EXPECT_EQ(5, afGetMarkPosition(file, AF_DEFAULT_TRACK, 7));
+	afSetMarkPosition(file, AF_DEFAULT_TRACK, 7, 6);
+	ASSERT_EQ(0, afCloseFile(file));
+
+	// The new cue chunk and its names take 76 bytes instead of 36.
+	EXPECT_EQ(moves ? size + 76 : size, fileSize(testFileName));
+
+	file = afOpenFile(testFileName.c_str(), "r", AF_NULL_FILESETUP);
+	ASSERT_TRUE(file);
+	EXPECT_EQ(6, afGetMarkPosition(file, AF_DEFAULT_TRACK, 7));
+	ASSERT_EQ(10, afGetFrameCount(file, AF_DEFAULT_TRACK));
+	int16_t frames[10];
+	ASSERT_EQ(10, afReadFrames(file, AF_DEFAULT_TRACK, frames, 10));
+	const uint8_t *bytes = reinterpret_cast<const uint8_t *>(frames);
+	for (int i=0; i<20; i++)
+		EXPECT_EQ(i, bytes[i]);
+	ASSERT_EQ(0, afCloseFile(file));
+
+	// A JUNK chunk is left where the cue chunk was if it moved.
+	FILE *fp = fopen(testFileName.c_str(), "rb");
+	ASSERT_TRUE(fp);
+	char id[4];
+	ASSERT_EQ(0, fseek(fp, 36, SEEK_SET));
+	ASSERT_EQ(1u, fread(id, 4, 1, fp));
+	EXPECT_EQ(0, memcmp(id, moves ? "JUNK" : "cue ", 4));
+	ASSERT_EQ(0, fclose(fp));
+
+	ASSERT_EQ(0, ::unlink(testFileName.c_str()));
+}
+
+TEST(InPlace, EditMovesGrowingChunk)
+{
+	testEditGrowingChunk(0, true);
+}
+
+TEST(InPlace, EditGrowsIntoFreeSpace)
+{
+	testEditGrowingChunk(64, false);
+}
+
+TEST(InPlace, Unsupported)
+{
+	IgnoreErrors ignoreErrors;
+
+	std::string testFileName;
+	ASSERT_TRUE(createTemporaryFile("InPlace", &testFileName));
+	std::vector<int16_t> frames;
+	generateFrames(frames, 1000, 6);
+
+	// Compressed data with state between frames.
+	writeFile(testFileName, AF_FILE_WAVE, AF_SAMPFMT_TWOSCOMP,
+		AF_COMPRESSION_IMA, frames);
+	EXPECT_FALSE(afOpenFile(testFileName.c_str(), "a", AF_NULL_FILESETUP));
+	EXPECT_FALSE(afOpenFile(testFileName.c_str(), "r+", AF_NULL_FILESETUP));
+
+	// A format which cannot be updated.
+	writeFile(testFileName, AF_FILE_NEXTSND, AF_SAMPFMT_TWOSCOMP,
+		AF_COMPRESSION_NONE, frames);
+	EXPECT_FALSE(afOpenFile(testFileName.c_str(), "a", AF_NULL_FILESETUP));
+
+	// Sound data followed by another chunk.
+	writeFile(testFileName, AF_FILE_WAVE, AF_SAMPFMT_TWOSCOMP,
+		AF_COMPRESSION_NONE, frames);
+	FILE *fp = fopen(testFileName.c_str(), "ab");
+	ASSERT_TRUE(fp);
+	const char junk[8] = { 'J', 'U', 'N', 'K', 0, 0, 0, 0 };
+	ASSERT_EQ(1u, fwrite(junk, sizeof (junk), 1, fp));
+	ASSERT_EQ(0, fclose(fp));
+	EXPECT_FALSE(afOpenFile(testFileName.c_str(), "a", AF_NULL_FILESETUP));
+
+	// A file opened for appending cannot be read.
+	writeFile(testFileName, AF_FILE_WAVE, AF_SAMPFMT_TWOSCOMP,
+		AF_COMPRESSION_NONE, frames);
+	AFfilehandle file = afOpenFile(testFileName.c_str(), "a", AF_NULL_FILESETUP);
+	ASSERT_TRUE(file);
+	int16_t frame[kChannelCount];
+	EXPECT_EQ(-1, afReadFrames(file, AF_DEFAULT_TRACK, frame, 1));
+	EXPECT_EQ(-1, afSeekFrame(file, AF_DEFAULT_TRACK, 0));
+	ASSERT_EQ(0, afCloseFile(file));
+
+	EXPECT_FALSE(afOpenFile(testFileName.c_str(), "a+", AF_NULL_FILESETUP));
+
+	// A format whose metadata cannot be edited.
+	writeFile(testFileName, AF_FILE_CAF, AF_SAMPFMT_TWOSCOMP,
+		AF_COMPRESSION_NONE, frames);
+	EXPECT_FALSE(afOpenFile(testFileName.c_str(), "m", AF_NULL_FILESETUP));
+
+	ASSERT_EQ(0, ::unlink(testFileName.c_str()));
+}
+
+int main(int argc, char **argv)
+{
+	::testing::InitGoogleTest(&argc, argv);
+	return RUN_ALL_TESTS();
+}
@@ -121,6 +121,66 @@ TEST(Marker, WAVE)
 	testMarkers(AF_FILE_WAVE, true);
 }
 
+/*
+	Markers are parsed when first requested; doing so in the middle of
+	reading sample data must not disturb the read position.
+*/
+static void testMarkersWhileReading(int fileFormat)
+{
+	std::string testFileName;
+	ASSERT_TRUE(createTemporaryFile("Marker", &testFileName));
+
+	AFfilesetup setup = afNewFileSetup();
+	afInitFileFormat(setup, fileFormat);
+	afInitChannels(setup, AF_DEFAULT_TRACK, 1);
+	afInitSampleFormat(setup, AF_DEFAULT_TRACK, AF_SAMPFMT_TWOSCOMP, 16);
+	const int markerIDs[] = { 1, 2 };
+	afInitMarkIDs(setup, AF_DEFAULT_TRACK, markerIDs, 2);
+
+	AFfilehandle file = afOpenFile(testFileName.c_str(), "w", setup);
+	ASSERT_TRUE(file) << "Could not open test file for writing";
+	afFreeFileSetup(setup);
+
+	const int frameCount = 1000;
+	int16_t frames[frameCount];
+	for (int i=0; i<frameCount; i++)
+		frames[i] = i;
+	EXPECT_EQ(afWriteFrames(file, AF_DEFAULT_TRACK, frames, frameCount),
+		frameCount);
+	afSetMarkPosition(file, AF_DEFAULT_TRACK, 1, 100);
+	afSetMarkPosition(file, AF_DEFAULT_TRACK, 2, 900);
+	ASSERT_EQ(afCloseFile(file), 0);
+
+	file = afOpenFile(testFileName.c_str(), "r", NULL);
+	ASSERT_TRUE(file) << "Could not open test file for reading";
+
+	int16_t readFrames[frameCount];
+	ASSERT_EQ(afReadFrames(file, AF_DEFAULT_TRACK, readFrames, 500), 500);
+
+	ASSERT_EQ(afGetMarkIDs(file, AF_DEFAULT_TRACK, NULL), 2);
+	EXPECT_EQ(afGetMarkPosition(file, AF_DEFAULT_TRACK, 1), 100);
+	EXPECT_EQ(afGetMarkPosition(file, AF_DEFAULT_TRACK, 2), 900);
+
+	ASSERT_EQ(afReadFrames(file, AF_DEFAULT_TRACK, readFrames + 500, 500),
+		500);
+	for (int i=0; i<frameCount; i++)
+		EXPECT_EQ(frames[i], readFrames[i]);
+
+	ASSERT_EQ(afCloseFile(file), 0);
+
+	ASSERT_EQ(::unlink(testFileName.c_str()), 0);
+}
+
+TEST(Marker, AIFFWhileReading)
+{
+	testMarkersWhileReading(AF_FILE_AIFF);
+}
+
+TEST(Marker, WAVEWhileReading)
+{
+	testMarkersWhileReading(AF_FILE_WAVE);
+}
+
 static void testUnsupported(int fileFormat)
 {
 	std::string testFileName;
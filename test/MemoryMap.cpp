@@ -0,0 +1,157 @@
+/*
+	Audio File Library
+
+	This program is free software; you can redistribute it and/or modify
+	it under the terms of the GNU General Public License as published by
+	the Free Software Foundation; either version 2 of the License, or
+	(at your option) any later version.
+
+	This program is distributed in the hope that it will be useful,
+	but WITHOUT ANY WARRANTY; without even the implied warranty of
+	MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+	GNU General Public License for more details.
+
+	You should have received a copy of the GNU General Public License along
+	with this program; if not, write to the Free Software Foundation, Inc.,
+	51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+*/
+
+#include <audiofile.h>
+#include <gtest/gtest.h>
+
+#include <fcntl.h>
+#include <stdint.h>
+#include <stdlib.h>
+#include <unistd.h>
+#include <vector>
+
+#include "TestUtilities.h"
+
+static const int kChannelCount = 2;
+static const int kFrameCount = 20011;
+
+static void writeTestFile(const std::string &path, int fileFormat,
+	int compression, std::vector<int16_t> &data)
+{
+	data.resize(kFrameCount * kChannelCount);
+	for (size_t i=0; i<data.size(); i++)
+		data[i] = static_cast<int16_t>((i * 37) ^ (i >> 3));
+
+	AFfilesetup setup = afNewFileSetup();
+	afInitFileFormat(setup, fileFormat);
+	afInitChannels(setup, AF_DEFAULT_TRACK, kChannelCount);
+	afInitSampleFormat(setup, AF_DEFAULT_TRACK, AF_SAMPFMT_TWOSCOMP, 16);
+	afInitCompression(setup, AF_DEFAULT_TRACK, compression);
+	AFfilehandle file = afOpenFile(path.c_str(), "w", setup);
+	ASSERT_TRUE(file);
+	afFreeFileSetup(setup);
+
+	ASSERT_EQ(kFrameCount,
+		afWriteFrames(file, AF_DEFAULT_TRACK, &data[0], kFrameCount));
+	ASSERT_EQ(0, afCloseFile(file));
+}
+
+static void readFrames(AFfilehandle file, std::vector<int16_t> &data)
+{
+	AFframecount frameCount = afGetFrameCount(file, AF_DEFAULT_TRACK);
+	data.resize(frameCount * kChannelCount);
+	AFframecount framesRead = 0;
+	while (framesRead < frameCount)
+	{
+		AFframecount n = afReadFrames(file, AF_DEFAULT_TRACK,
+			&data[framesRead * kChannelCount], 997);
+		ASSERT_GT(n, 0);
+		framesRead += n;
+	}
+}
+
+static void testMemoryMap(int fileFormat, int compression)
+{
+	std::string testFileName;
+	ASSERT_TRUE(createTemporaryFile("MemoryMap", &testFileName));
+
+	std::vector<int16_t> written;
+	writeTestFile(testFileName, fileFormat, compression, written);
+
+	AFfilehandle file = afOpenFile(testFileName.c_str(), "r", AF_NULL_FILESETUP);
+	ASSERT_TRUE(file);
+	std::vector<int16_t> expected;
+	readFrames(file, expected);
+	ASSERT_EQ(0, afCloseFile(file));
+
+	if (compression == AF_COMPRESSION_NONE)
+		EXPECT_TRUE(expected == written);
+
+	AFfilesetup setup = afNewFileSetup();
+	afInitMemoryMap(setup, 1, AF_MMAP_SEQUENTIAL | AF_MMAP_WILLNEED);
+	file = afOpenFile(testFileName.c_str(), "r", setup);
+	ASSERT_TRUE(file);
+	EXPECT_EQ(fileFormat, afGetFileFormat(file, NULL));
+	std::vector<int16_t> mapped;
+	readFrames(file, mapped);
+	EXPECT_TRUE(mapped == expected);
+
+	// Seeking backwards must work on a mapped file.
+	const AFframecount kSeekFrame = 4321;
+	ASSERT_EQ(kSeekFrame, afSeekFrame(file, AF_DEFAULT_TRACK, kSeekFrame));
+	int16_t frame[kChannelCount];
+	ASSERT_EQ(1, afReadFrames(file, AF_DEFAULT_TRACK, frame, 1));
+	for (int c=0; c<kChannelCount; c++)
+		EXPECT_EQ(expected[kSeekFrame * kChannelCount + c], frame[c]);
+	ASSERT_EQ(0, afCloseFile(file));
+
+	// afOpenFD accepts the same option.
+	int fd = ::open(testFileName.c_str(), O_RDONLY);
+	ASSERT_GE(fd, 0);
+	file = afOpenFD(fd, "r", setup);
+	ASSERT_TRUE(file);
+	readFrames(file, mapped);
+	EXPECT_TRUE(mapped == expected);
+	ASSERT_EQ(0, afCloseFile(file));
+
+	afFreeFileSetup(setup);
+
+	ASSERT_EQ(0, ::unlink(testFileName.c_str()));
+}
+
+TEST(MemoryMap, PCM)
+{
+	testMemoryMap(AF_FILE_WAVE, AF_COMPRESSION_NONE);
+}
+
+TEST(MemoryMap, IMA)
+{
+	testMemoryMap(AF_FILE_WAVE, AF_COMPRESSION_IMA);
+}
+
+TEST(MemoryMap, MSADPCM)
+{
+	testMemoryMap(AF_FILE_WAVE, AF_COMPRESSION_MS_ADPCM);
+}
+
+TEST(MemoryMap, ALAC)
+{
+	testMemoryMap(AF_FILE_CAF, AF_COMPRESSION_ALAC);
+}
+
+TEST(MemoryMap, EmptyFileFallsBack)
+{
+	IgnoreErrors ignoreErrors;
+
+	std::string testFileName;
+	ASSERT_TRUE(createTemporaryFile("MemoryMap", &testFileName));
+
+	AFfilesetup setup = afNewFileSetup();
+	afInitMemoryMap(setup, 1, AF_MMAP_NORMAL);
+	AFfilehandle file = afOpenFile(testFileName.c_str(), "r", setup);
+	EXPECT_FALSE(file);
+	afFreeFileSetup(setup);
+
+	ASSERT_EQ(0, ::unlink(testFileName.c_str()));
+}
+
+int main(int argc, char **argv)
+{
+	::testing::InitGoogleTest(&argc, argv);
+	return RUN_ALL_TESTS();
+}
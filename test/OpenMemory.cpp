@@ -0,0 +1,241 @@
+/*
+	Audio File Library
+
+	This program is free software; you can redistribute it and/or modify
+	it under the terms of the GNU General Public License as published by
+	the Free Software Foundation; either version 2 of the License, or
+	(at your option) any later version.
+
+	This program is distributed in the hope that it will be useful,
+	but WITHOUT ANY WARRANTY; without even the implied warranty of
+	MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+	GNU General Public License for more details.
+
+	You should have received a copy of the GNU General Public License along
+	with this program; if not, write to the Free Software Foundation, Inc.,
+	51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+*/
+
+/*
+	This program tests that files written to memory are the same as
+	files written to disk, and that files are read from memory.
+*/
+
+#include <audiofile.h>
+#include <gtest/gtest.h>
+
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <unistd.h>
+#include <string>
+#include <vector>
+
+#include "TestUtilities.h"
+
+static const int kChannelCount = 2;
+static const int kFrameCount = 20011;
+
+static void generateFrames(std::vector<int16_t> &data)
+{
+	data.resize(kFrameCount * kChannelCount);
+	for (size_t i=0; i<data.size(); i++)
+		data[i] = static_cast<int16_t>((i * 37) ^ (i >> 3));
+}
+
+static AFfilesetup createSetup(int fileFormat, int compression)
+{
+	AFfilesetup setup = afNewFileSetup();
+	afInitFileFormat(setup, fileFormat);
+	afInitChannels(setup, AF_DEFAULT_TRACK, kChannelCount);
+	afInitSampleFormat(setup, AF_DEFAULT_TRACK, AF_SAMPFMT_TWOSCOMP, 16);
+	afInitCompression(setup, AF_DEFAULT_TRACK, compression);
+	return setup;
+}
+
+static void writeToMemory(int fileFormat, int compression,
+	const std::vector<int16_t> &frames, std::vector<uint8_t> &contents)
+{
+	AFfilesetup setup = createSetup(fileFormat, compression);
+	AFfilehandle file = afOpenMemory(NULL, 0, "w", setup);
+	afFreeFileSetup(setup);
+	ASSERT_TRUE(file);
+	ASSERT_EQ(kFrameCount, afWriteFrames(file, AF_DEFAULT_TRACK,
+		&frames[0], kFrameCount));
+
+	void *data;
+	size_t size;
+	ASSERT_EQ(0, afCloseMemoryFile(file, &data, &size));
+	ASSERT_TRUE(data);
+	const uint8_t *bytes = static_cast<const uint8_t *>(data);
+	contents.assign(bytes, bytes + size);
+	free(data);
+}
+
+static void writeToDisk(const std::string &path, int fileFormat,
+	int compression, const std::vector<int16_t> &frames,
+	std::vector<uint8_t> &contents)
+{
+	AFfilesetup setup = createSetup(fileFormat, compression);
+	AFfilehandle file = afOpenFile(path.c_str(), "w", setup);
+	afFreeFileSetup(setup);
+	ASSERT_TRUE(file);
+	ASSERT_EQ(kFrameCount, afWriteFrames(file, AF_DEFAULT_TRACK,
+		&frames[0], kFrameCount));
+	ASSERT_EQ(0, afCloseFile(file));
+
+	FILE *f = fopen(path.c_str(), "rb");
+	ASSERT_TRUE(f);
+	contents.clear();
+	uint8_t buffer[4096];
+	size_t n;
+	while ((n = fread(buffer, 1, sizeof (buffer), f)) > 0)
+		contents.insert(contents.end(), buffer, buffer + n);
+	fclose(f);
+}
+
+static void readFrames(AFfilehandle file, std::vector<int16_t> &data)
+{
+	AFframecount frameCount = afGetFrameCount(file, AF_DEFAULT_TRACK);
+	data.resize(frameCount * kChannelCount);
+	AFframecount framesRead = 0;
+	while (framesRead < frameCount)
+	{
+		AFframecount n = afReadFrames(file, AF_DEFAULT_TRACK,
+			&data[framesRead * kChannelCount], 997);
+		ASSERT_GT(n, 0);
+		framesRead += n;
+	}
+}
+
+static void testOpenMemory(int fileFormat, int compression)
+{
+	std::string path;
+	ASSERT_TRUE(createTemporaryFile("OpenMemory", &path));
+
+	std::vector<int16_t> frames;
+	generateFrames(frames);
+
+	std::vector<uint8_t> contents, diskContents;
+	writeToMemory(fileFormat, compression, frames, contents);
+	writeToDisk(path, fileFormat, compression, frames, diskContents);
+	EXPECT_TRUE(contents == diskContents);
+
+	AFfilehandle file = afOpenFile(path.c_str(), "r", AF_NULL_FILESETUP);
+	ASSERT_TRUE(file);
+	std::vector<int16_t> expected;
+	readFrames(file, expected);
+	ASSERT_EQ(0, afCloseFile(file));
+
+	file = afOpenMemory(&contents[0], contents.size(), "r", AF_NULL_FILESETUP);
+	ASSERT_TRUE(file);
+	EXPECT_EQ(fileFormat, afGetFileFormat(file, NULL));
+	EXPECT_EQ(kFrameCount, afGetFrameCount(file, AF_DEFAULT_TRACK));
+	std::vector<int16_t> data;
+	readFrames(file, data);
+	EXPECT_TRUE(data == expected);
+
+	// Frames read after seeking and from several positions at once.
+	AFframecount frame = kFrameCount / 3;
+	ASSERT_EQ(frame, afSeekFrame(file, AF_DEFAULT_TRACK, frame));
+	std::vector<int16_t> buffer(1000 * kChannelCount);
+	ASSERT_EQ(1000, afReadFrames(file, AF_DEFAULT_TRACK, &buffer[0], 1000));
+	EXPECT_TRUE(std::equal(buffer.begin(), buffer.end(),
+		expected.begin() + frame * kChannelCount));
+	ASSERT_EQ(1000, afReadFramesAt(file, AF_DEFAULT_TRACK, 2 * frame,
+		&buffer[0], 1000));
+	EXPECT_TRUE(std::equal(buffer.begin(), buffer.end(),
+		expected.begin() + 2 * frame * kChannelCount));
+	ASSERT_EQ(0, afCloseFile(file));
+
+	ASSERT_EQ(0, ::unlink(path.c_str()));
+}
+
+TEST(OpenMemory, WAVE_PCM)
+{
+	testOpenMemory(AF_FILE_WAVE, AF_COMPRESSION_NONE);
+}
+
+TEST(OpenMemory, AIFFC_PCM)
+{
+	testOpenMemory(AF_FILE_AIFFC, AF_COMPRESSION_NONE);
+}
+
+TEST(OpenMemory, WAVE_IMA)
+{
+	testOpenMemory(AF_FILE_WAVE, AF_COMPRESSION_IMA);
+}
+
+TEST(OpenMemory, WAVE_MSADPCM)
+{
+	testOpenMemory(AF_FILE_WAVE, AF_COMPRESSION_MS_ADPCM);
+}
+
+TEST(OpenMemory, CAF_ALAC)
+{
+	testOpenMemory(AF_FILE_CAF, AF_COMPRESSION_ALAC);
+}
+
+// The memory of a file opened for appending is copied and grows.
+TEST(OpenMemory, Append)
+{
+	std::vector<int16_t> frames;
+	generateFrames(frames);
+	std::vector<uint8_t> contents;
+	writeToMemory(AF_FILE_WAVE, AF_COMPRESSION_NONE, frames, contents);
+	std::vector<uint8_t> original = contents;
+
+	AFfilehandle file = afOpenMemory(&contents[0], contents.size(), "a",
+		AF_NULL_FILESETUP);
+	ASSERT_TRUE(file);
+	ASSERT_EQ(kFrameCount, afWriteFrames(file, AF_DEFAULT_TRACK,
+		&frames[0], kFrameCount));
+	void *data;
+	size_t size;
+	ASSERT_EQ(0, afCloseMemoryFile(file, &data, &size));
+	EXPECT_TRUE(contents == original);
+
+	file = afOpenMemory(data, size, "r", AF_NULL_FILESETUP);
+	ASSERT_TRUE(file);
+	EXPECT_EQ(2 * kFrameCount, afGetFrameCount(file, AF_DEFAULT_TRACK));
+	std::vector<int16_t> readBack;
+	readFrames(file, readBack);
+	ASSERT_EQ(0, afCloseFile(file));
+	free(data);
+
+	ASSERT_EQ(2u * frames.size(), readBack.size());
+	EXPECT_TRUE(std::equal(frames.begin(), frames.end(), readBack.begin()));
+	EXPECT_TRUE(std::equal(frames.begin(), frames.end(),
+		readBack.begin() + frames.size()));
+}
+
+TEST(OpenMemory, Invalid)
+{
+	IgnoreErrors ignoreErrors;
+
+	EXPECT_FALSE(afOpenMemory(NULL, 100, "r", AF_NULL_FILESETUP));
+
+	const uint8_t garbage[64] = { 0 };
+	EXPECT_FALSE(afOpenMemory(garbage, sizeof (garbage), "r",
+		AF_NULL_FILESETUP));
+	EXPECT_FALSE(afOpenMemory(NULL, 0, "r", AF_NULL_FILESETUP));
+
+	// The contents of a file which is only read cannot be taken.
+	std::vector<int16_t> frames;
+	generateFrames(frames);
+	std::vector<uint8_t> contents;
+	writeToMemory(AF_FILE_WAVE, AF_COMPRESSION_NONE, frames, contents);
+	AFfilehandle file = afOpenMemory(&contents[0], contents.size(), "r",
+		AF_NULL_FILESETUP);
+	ASSERT_TRUE(file);
+	void *data;
+	size_t size;
+	EXPECT_EQ(-1, afCloseMemoryFile(file, &data, &size));
+	EXPECT_TRUE(data == NULL);
+}
+
+int main(int argc, char **argv)
+{
+	::testing::InitGoogleTest(&argc, argv);
+	return RUN_ALL_TESTS();
+}
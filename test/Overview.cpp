@@ -0,0 +1,285 @@
+/*
+	Audio File Library
+
+	This program is free software; you can redistribute it and/or modify
+	it under the terms of the GNU General Public License as published by
+	the Free Software Foundation; either version 2 of the License, or
+	(at your option) any later version.
+
+	This program is distributed in the hope that it will be useful,
+	but WITHOUT ANY WARRANTY; without even the implied warranty of
+	MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+	GNU General Public License for more details.
+
+	You should have received a copy of the GNU General Public License along
+	with this program; if not, write to the Free Software Foundation, Inc.,
+	51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+*/
+
+/*
+	This program tests that overviews of a track agree with its audio
+	data and are saved to and loaded from cache files.
+*/
+
+#include <algorithm>
+#include <audiofile.h>
+#include <gtest/gtest.h>
+#include <math.h>
+#include <stdint.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#include <string>
+#include <vector>
+
+#include "TestUtilities.h"
+
+static const int kChannelCount = 2;
+static const int kFrameCount = 100000;
+
+static void generateFrames(std::vector<int16_t> &data, int seed)
+{
+	data.resize(kFrameCount * kChannelCount);
+	for (int i=0; i<kFrameCount; i++)
+	{
+		data[kChannelCount*i] = (i * 37 * seed) % 20000 - 10000;
+		data[kChannelCount*i + 1] = (i * 91 + seed) % 60000 - 30000;
+	}
+}
+
+static void writeFile(const std::string &path, const std::vector<int16_t> &data)
+{
+	AFfilesetup setup = afNewFileSetup();
+	afInitFileFormat(setup, AF_FILE_WAVE);
+	afInitChannels(setup, AF_DEFAULT_TRACK, kChannelCount);
+	afInitSampleFormat(setup, AF_DEFAULT_TRACK, AF_SAMPFMT_TWOSCOMP, 16);
+	AFfilehandle file = afOpenFile(path.c_str(), "w", setup);
+	afFreeFileSetup(setup);
+	ASSERT_TRUE(file);
+	ASSERT_EQ(afWriteFrames(file, AF_DEFAULT_TRACK, &data[0], kFrameCount),
+		kFrameCount);
+	ASSERT_EQ(afCloseFile(file), 0);
+}
+
+static AFoverview newOverview(const std::string &path,
+	const char *cachePath)
+{
+	AFfilehandle file = afOpenFile(path.c_str(), "r", AF_NULL_FILESETUP);
+	if (!file)
+		return NULL;
+	AFoverview overview = afNewOverview(file, AF_DEFAULT_TRACK, cachePath);
+	afCloseFile(file);
+	return overview;
+}
+
+// Check the parts of [start, end), each of which must span whole buckets.
+static void expectOverview(AFoverview overview,
+	const std::vector<int16_t> &data, AFframecount start, AFframecount end,
+	int bucketCount)
+{
+	std::vector<float> minima(bucketCount * kChannelCount);
+	std::vector<float> maxima(bucketCount * kChannelCount);
+	std::vector<float> rms(bucketCount * kChannelCount);
+	ASSERT_EQ(afReadOverview(overview, start, end, bucketCount,
+		&minima[0], &maxima[0], &rms[0]), bucketCount);
+
+	for (int i=0; i<bucketCount; i++)
+	{
+		AFframecount first = start + (end - start) * i / bucketCount;
+		AFframecount last = start + (end - start) * (i + 1) / bucketCount;
+		for (int c=0; c<kChannelCount; c++)
+		{
+			int minimum = 32767, maximum = -32768;
+			double sum = 0;
+			for (AFframecount frame=first; frame<last; frame++)
+			{
+				int sample = data[frame * kChannelCount + c];
+				minimum = std::min(minimum, sample);
+				maximum = std::max(maximum, sample);
+				sum += static_cast<double>(sample) * sample;
+			}
+			int index = i * kChannelCount + c;
+			EXPECT_EQ(minima[index], minimum / 32768.0f);
+			EXPECT_EQ(maxima[index], maximum / 32768.0f);
+			EXPECT_NEAR(rms[index], sqrt(sum / (last - first)) / 32768, 1e-6);
+		}
+	}
+}
+
+static ino_t fileID(const std::string &path)
+{
+	struct stat st;
+	if (::stat(path.c_str(), &st) != 0)
+		return 0;
+	return st.st_ino;
+}
+
+TEST(Overview, Levels)
+{
+	std::string path;
+	ASSERT_TRUE(createTemporaryFile("Overview", &path));
+	std::vector<int16_t> data;
+	generateFrames(data, 1);
+	writeFile(path, data);
+
+	AFoverview overview = newOverview(path, NULL);
+	ASSERT_TRUE(overview);
+	EXPECT_EQ(afGetOverviewChannels(overview), kChannelCount);
+	EXPECT_EQ(afGetOverviewFrameCount(overview), kFrameCount);
+
+	// The whole track, which ends with a partial bucket.
+	expectOverview(overview, data, 0, kFrameCount, 1);
+	// Parts of one, 16 and 256 base buckets.
+	expectOverview(overview, data, 256 * 10, 256 * 10 + 4096 * 8, 128);
+	expectOverview(overview, data, 4096 * 3, 4096 * 19, 16);
+	expectOverview(overview, data, 0, 65536, 1);
+
+	// Parts after the end of the track hold zeros.
+	float minima[2 * kChannelCount], maxima[2 * kChannelCount];
+	ASSERT_EQ(afReadOverview(overview, kFrameCount, kFrameCount + 1000, 2,
+		minima, maxima, NULL), 2);
+	for (int i=0; i<2 * kChannelCount; i++)
+	{
+		EXPECT_EQ(minima[i], 0);
+		EXPECT_EQ(maxima[i], 0);
+	}
+
+	afFreeOverview(overview);
+	ASSERT_EQ(::unlink(path.c_str()), 0);
+}
+
+TEST(Overview, RestoresTrack)
+{
+	std::string path;
+	ASSERT_TRUE(createTemporaryFile("Overview", &path));
+	std::vector<int16_t> data;
+	generateFrames(data, 1);
+	writeFile(path, data);
+
+	const int kFrame = 5000;
+	AFfilehandle file = afOpenFile(path.c_str(), "r", AF_NULL_FILESETUP);
+	ASSERT_TRUE(file);
+	afSetVirtualSampleFormat(file, AF_DEFAULT_TRACK, AF_SAMPFMT_TWOSCOMP, 32);
+	ASSERT_EQ(afSeekFrame(file, AF_DEFAULT_TRACK, kFrame), kFrame);
+
+	AFoverview overview = afNewOverview(file, AF_DEFAULT_TRACK, NULL);
+	ASSERT_TRUE(overview);
+	afFreeOverview(overview);
+
+	EXPECT_EQ(afTellFrame(file, AF_DEFAULT_TRACK), kFrame);
+	int sampleFormat, sampleWidth;
+	afGetVirtualSampleFormat(file, AF_DEFAULT_TRACK, &sampleFormat,
+		&sampleWidth);
+	EXPECT_EQ(sampleFormat, AF_SAMPFMT_TWOSCOMP);
+	EXPECT_EQ(sampleWidth, 32);
+
+	int32_t frames[100 * kChannelCount];
+	ASSERT_EQ(afReadFrames(file, AF_DEFAULT_TRACK, frames, 100), 100);
+	for (int i=0; i<100 * kChannelCount; i++)
+		EXPECT_EQ(frames[i], data[kFrame * kChannelCount + i] << 16);
+
+	ASSERT_EQ(afCloseFile(file), 0);
+	ASSERT_EQ(::unlink(path.c_str()), 0);
+}
+
+TEST(Overview, Cache)
+{
+	std::string path, cachePath;
+	ASSERT_TRUE(createTemporaryFile("Overview", &path));
+	ASSERT_TRUE(createTemporaryFile("Overview", &cachePath));
+	std::vector<int16_t> data;
+	generateFrames(data, 1);
+	writeFile(path, data);
+
+	AFoverview overview = newOverview(path, cachePath.c_str());
+	ASSERT_TRUE(overview);
+	afFreeOverview(overview);
+	ino_t cacheID = fileID(cachePath);
+	ASSERT_NE(cacheID, 0u);
+
+	// A matching cache file is loaded rather than replaced.
+	overview = newOverview(path, cachePath.c_str());
+	ASSERT_TRUE(overview);
+	EXPECT_EQ(fileID(cachePath), cacheID);
+	EXPECT_EQ(afGetOverviewFrameCount(overview), kFrameCount);
+	expectOverview(overview, data, 0, kFrameCount, 1);
+	expectOverview(overview, data, 4096, 4096 * 17, 256);
+	afFreeOverview(overview);
+
+	// Rewriting the file with other audio data makes the cache stale.
+	generateFrames(data, 3);
+	writeFile(path, data);
+	overview = newOverview(path, cachePath.c_str());
+	ASSERT_TRUE(overview);
+	EXPECT_NE(fileID(cachePath), cacheID);
+	expectOverview(overview, data, 0, kFrameCount, 1);
+	expectOverview(overview, data, 4096, 4096 * 17, 256);
+	afFreeOverview(overview);
+
+	ASSERT_EQ(::unlink(path.c_str()), 0);
+	ASSERT_EQ(::unlink(cachePath.c_str()), 0);
+}
+
+TEST(Overview, CorruptCache)
+{
+	std::string path, cachePath;
+	ASSERT_TRUE(createTemporaryFile("Overview", &path));
+	ASSERT_TRUE(createTemporaryFile("Overview", &cachePath));
+	std::vector<int16_t> data;
+	generateFrames(data, 1);
+	writeFile(path, data);
+
+	// The empty file created for the cache is not a valid cache file.
+	AFoverview overview = newOverview(path, cachePath.c_str());
+	ASSERT_TRUE(overview);
+	expectOverview(overview, data, 0, kFrameCount, 1);
+	afFreeOverview(overview);
+
+	ASSERT_EQ(::truncate(cachePath.c_str(), 100), 0);
+	overview = newOverview(path, cachePath.c_str());
+	ASSERT_TRUE(overview);
+	expectOverview(overview, data, 0, kFrameCount, 1);
+	afFreeOverview(overview);
+
+	ASSERT_EQ(::unlink(path.c_str()), 0);
+	ASSERT_EQ(::unlink(cachePath.c_str()), 0);
+}
+
+TEST(Overview, Errors)
+{
+	IgnoreErrors ignoreErrors;
+
+	std::string path;
+	ASSERT_TRUE(createTemporaryFile("Overview", &path));
+	std::vector<int16_t> data;
+	generateFrames(data, 1);
+	writeFile(path, data);
+
+	AFoverview overview = newOverview(path, NULL);
+	ASSERT_TRUE(overview);
+	float minima[kChannelCount];
+	EXPECT_EQ(afReadOverview(overview, -1, 100, 1, minima, NULL, NULL), -1);
+	EXPECT_EQ(afReadOverview(overview, 100, 99, 1, minima, NULL, NULL), -1);
+	EXPECT_EQ(afReadOverview(overview, 0, 100, 0, minima, NULL, NULL), -1);
+	afFreeOverview(overview);
+
+	EXPECT_EQ(afGetOverviewChannels(NULL), -1);
+	EXPECT_EQ(afGetOverviewFrameCount(NULL), -1);
+	EXPECT_EQ(afReadOverview(NULL, 0, 100, 1, minima, NULL, NULL), -1);
+
+	// Files open for writing cannot be read.
+	AFfilesetup setup = afNewFileSetup();
+	afInitFileFormat(setup, AF_FILE_WAVE);
+	AFfilehandle file = afOpenFile(path.c_str(), "w", setup);
+	afFreeFileSetup(setup);
+	ASSERT_TRUE(file);
+	EXPECT_FALSE(afNewOverview(file, AF_DEFAULT_TRACK, NULL));
+	ASSERT_EQ(afCloseFile(file), 0);
+
+	ASSERT_EQ(::unlink(path.c_str()), 0);
+}
+
+int main(int argc, char **argv)
+{
+	::testing::InitGoogleTest(&argc, argv);
+	return RUN_ALL_TESTS();
+}
@@ -0,0 +1,304 @@
+/*
+	Audio File Library
+
+	This program is free software; you can redistribute it and/or modify
+	it under the terms of the GNU General Public License as published by
+	the Free Software Foundation; either version 2 of the License, or
+	(at your option) any later version.
+
+	This program is distributed in the hope that it will be useful,
+	but WITHOUT ANY WARRANTY; without even the implied warranty of
+	MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+	GNU General Public License for more details.
+
+	You should have received a copy of the GNU General Public License along
+	with this program; if not, write to the Free Software Foundation, Inc.,
+	51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+*/
+
+/*
+	This program tests copying encoded packets from one audio file
+	to another with afReadPackets and afWritePackets.
+*/
+
+#include <algorithm>
+#include <audiofile.h>
+#include <gtest/gtest.h>
+#include <stdint.h>
+#include <unistd.h>
+#include <string>
+#include <vector>
+
+#include "TestUtilities.h"
+
+static const int kChannelCount = 2;
+static const int kFrameCount = 10240;
+static const int kBufferSize = 65536;
+
+static void generateFrames(std::vector<int16_t> &data, int frameCount)
+{
+	data.resize(frameCount * kChannelCount);
+	for (size_t i=0; i<data.size(); i++)
+		data[i] = static_cast<int16_t>(((i / kChannelCount) * 97) % 20011 -
+			10000 + (i % kChannelCount) * 500);
+}
+
+static AFfilesetup createSetup(int fileFormat, int compression)
+{
+	AFfilesetup setup = afNewFileSetup();
+	afInitFileFormat(setup, fileFormat);
+	afInitChannels(setup, AF_DEFAULT_TRACK, kChannelCount);
+	afInitSampleFormat(setup, AF_DEFAULT_TRACK, AF_SAMPFMT_TWOSCOMP, 16);
+	afInitCompression(setup, AF_DEFAULT_TRACK, compression);
+	return setup;
+}
+
+static void writeFile(const std::string &path, int fileFormat,
+	int compression, int frameCount)
+{
+	std::vector<int16_t> frames;
+	generateFrames(frames, frameCount);
+
+	AFfilesetup setup = createSetup(fileFormat, compression);
+	AFfilehandle file = afOpenFile(path.c_str(), "w", setup);
+	afFreeFileSetup(setup);
+	ASSERT_TRUE(file);
+	ASSERT_EQ(afWriteFrames(file, AF_DEFAULT_TRACK, &frames[0], frameCount),
+		frameCount);
+	ASSERT_EQ(afCloseFile(file), 0);
+}
+
+static void readFile(const std::string &path, std::vector<int16_t> &data)
+{
+	AFfilehandle file = afOpenFile(path.c_str(), "r", AF_NULL_FILESETUP);
+	ASSERT_TRUE(file);
+	AFframecount frameCount = afGetFrameCount(file, AF_DEFAULT_TRACK);
+	data.resize(frameCount * kChannelCount);
+	if (frameCount)
+		ASSERT_EQ(afReadFrames(file, AF_DEFAULT_TRACK, &data[0], frameCount),
+			frameCount);
+	ASSERT_EQ(afCloseFile(file), 0);
+}
+
+/*
+	Copy the packets of one file into a new file, a few at a time,
+	along with its codec data.
+*/
+static void copyPackets(const std::string &inputPath,
+	const std::string &outputPath, int fileFormat, int compression)
+{
+	AFfilehandle inFile = afOpenFile(inputPath.c_str(), "r", AF_NULL_FILESETUP);
+	ASSERT_TRUE(inFile);
+	ASSERT_EQ(afGetCompression(inFile, AF_DEFAULT_TRACK), compression);
+
+	AFfilesetup setup = createSetup(fileFormat, compression);
+	AFfilehandle outFile = afOpenFile(outputPath.c_str(), "w", setup);
+	afFreeFileSetup(setup);
+	ASSERT_TRUE(outFile);
+
+	int codecDataSize = afGetCodecData(inFile, AF_DEFAULT_TRACK, NULL, 0);
+	ASSERT_EQ(afGetCodecData(outFile, AF_DEFAULT_TRACK, NULL, 0),
+		codecDataSize);
+	if (codecDataSize > 0)
+	{
+		std::vector<uint8_t> codecData(codecDataSize);
+		ASSERT_EQ(afGetCodecData(inFile, AF_DEFAULT_TRACK, &codecData[0],
+			codecDataSize), codecDataSize);
+		ASSERT_EQ(afSetCodecData(outFile, AF_DEFAULT_TRACK, &codecData[0],
+			codecDataSize), 0);
+	}
+
+	std::vector<uint8_t> buffer(kBufferSize);
+	const int kMaximumPacketCount = 7;
+	int packetSizes[kMaximumPacketCount];
+	AFframecount framesCopied = 0;
+	while (true)
+	{
+		AFframecount frameCount;
+		int packetCount = afReadPackets(inFile, AF_DEFAULT_TRACK,
+			&buffer[0], buffer.size(), kMaximumPacketCount, packetSizes,
+			&frameCount);
+		ASSERT_GE(packetCount, 0);
+		if (packetCount == 0)
+			break;
+		ASSERT_EQ(afWritePackets(outFile, AF_DEFAULT_TRACK, &buffer[0],
+			packetCount, packetSizes, frameCount), packetCount);
+		framesCopied += frameCount;
+	}
+
+	EXPECT_EQ(framesCopied, afGetFrameCount(inFile, AF_DEFAULT_TRACK));
+	EXPECT_EQ(afGetTrackBytes(outFile, AF_DEFAULT_TRACK),
+		afGetTrackBytes(inFile, AF_DEFAULT_TRACK));
+
+	ASSERT_EQ(afCloseFile(outFile), 0);
+	ASSERT_EQ(afCloseFile(inFile), 0);
+}
+
+/*
+	A file whose packets are copied into another file decodes to the
+	same frames as the original.
+*/
+static void testCopyPackets(int inputFormat, int outputFormat,
+	int compression)
+{
+	std::string inputPath, outputPath;
+	ASSERT_TRUE(createTemporaryFile("Packets", &inputPath));
+	ASSERT_TRUE(createTemporaryFile("Packets", &outputPath));
+
+	writeFile(inputPath, inputFormat, compression, kFrameCount);
+	copyPackets(inputPath, outputPath, outputFormat, compression);
+
+	std::vector<int16_t> inputData, outputData;
+	readFile(inputPath, inputData);
+	readFile(outputPath, outputData);
+	EXPECT_EQ(inputData.size(), kFrameCount * kChannelCount);
+	EXPECT_TRUE(inputData == outputData);
+
+	ASSERT_EQ(::unlink(inputPath.c_str()), 0);
+	ASSERT_EQ(::unlink(outputPath.c_str()), 0);
+}
+
+TEST(Packets, AIFFC_IMA_To_CAF)
+{
+	testCopyPackets(AF_FILE_AIFFC, AF_FILE_CAF, AF_COMPRESSION_IMA);
+}
+
+TEST(Packets, WAVE_ULaw_To_NeXT)
+{
+	testCopyPackets(AF_FILE_WAVE, AF_FILE_NEXTSND, AF_COMPRESSION_G711_ULAW);
+}
+
+TEST(Packets, NeXT_ALaw_To_WAVE)
+{
+	testCopyPackets(AF_FILE_NEXTSND, AF_FILE_WAVE, AF_COMPRESSION_G711_ALAW);
+}
+
+TEST(Packets, WAVE_MSADPCM)
+{
+	testCopyPackets(AF_FILE_WAVE, AF_FILE_WAVE, AF_COMPRESSION_MS_ADPCM);
+}
+
+TEST(Packets, CAF_ALAC)
+{
+	testCopyPackets(AF_FILE_CAF, AF_FILE_CAF, AF_COMPRESSION_ALAC);
+}
+
+/*
+	Frames read after packets start with the first frame of the
+	next packet.
+*/
+TEST(Packets, ReadFramesAfterPackets)
+{
+	std::string path;
+	ASSERT_TRUE(createTemporaryFile("Packets", &path));
+	writeFile(path, AF_FILE_CAF, AF_COMPRESSION_ALAC, kFrameCount);
+
+	std::vector<int16_t> data;
+	readFile(path, data);
+
+	AFfilehandle file = afOpenFile(path.c_str(), "r", AF_NULL_FILESETUP);
+	ASSERT_TRUE(file);
+
+	const int kFramesToSkip = 100;
+	std::vector<int16_t> frames(kFramesToSkip * kChannelCount);
+	ASSERT_EQ(afReadFrames(file, AF_DEFAULT_TRACK, &frames[0], kFramesToSkip),
+		kFramesToSkip);
+
+	// The packet holding the next frame is read from its start.
+	std::vector<uint8_t> buffer(kBufferSize);
+	int packetSize;
+	AFframecount packetFrames;
+	ASSERT_EQ(afReadPackets(file, AF_DEFAULT_TRACK, &buffer[0], buffer.size(),
+		1, &packetSize, &packetFrames), 1);
+	EXPECT_GT(packetSize, 0);
+	EXPECT_GT(packetFrames, kFramesToSkip);
+	EXPECT_EQ(afTellFrame(file, AF_DEFAULT_TRACK), packetFrames);
+
+	const int kFramesToRead = 1000;
+	frames.resize(kFramesToRead * kChannelCount);
+	ASSERT_EQ(afReadFrames(file, AF_DEFAULT_TRACK, &frames[0], kFramesToRead),
+		kFramesToRead);
+	EXPECT_TRUE(std::equal(frames.begin(), frames.end(),
+		data.begin() + packetFrames * kChannelCount));
+
+	ASSERT_EQ(afCloseFile(file), 0);
+	ASSERT_EQ(::unlink(path.c_str()), 0);
+}
+
+TEST(Packets, Errors)
+{
+	IgnoreErrors ignoreErrors;
+
+	std::string path, outputPath;
+	ASSERT_TRUE(createTemporaryFile("Packets", &path));
+	ASSERT_TRUE(createTemporaryFile("Packets", &outputPath));
+	writeFile(path, AF_FILE_AIFFC, AF_COMPRESSION_IMA, kFrameCount);
+
+	AFfilehandle file = afOpenFile(path.c_str(), "r", AF_NULL_FILESETUP);
+	ASSERT_TRUE(file);
+
+	// A buffer which cannot hold a single packet.
+	uint8_t buffer[512];
+	int packetSizes[16];
+	AFframecount frameCount;
+	EXPECT_EQ(afReadPackets(file, AF_DEFAULT_TRACK, buffer, 10, 1,
+		packetSizes, &frameCount), -1);
+
+	// IMA packets have no codec data.
+	EXPECT_EQ(afGetCodecData(file, AF_DEFAULT_TRACK, NULL, 0), 0);
+
+	// Packets cannot be written to a file opened for reading.
+	ASSERT_EQ(afReadPackets(file, AF_DEFAULT_TRACK, buffer, sizeof (buffer),
+		2, packetSizes, &frameCount), 2);
+	EXPECT_EQ(frameCount, 128);
+	EXPECT_EQ(afWritePackets(file, AF_DEFAULT_TRACK, buffer, 2, packetSizes,
+		frameCount), -1);
+	ASSERT_EQ(afCloseFile(file), 0);
+
+	AFfilesetup setup = createSetup(AF_FILE_CAF, AF_COMPRESSION_IMA);
+	file = afOpenFile(outputPath.c_str(), "w", setup);
+	afFreeFileSetup(setup);
+	ASSERT_TRUE(file);
+
+	EXPECT_EQ(afSetCodecData(file, AF_DEFAULT_TRACK, buffer, 24), -1);
+
+	// Each packet must have the track's packet size.
+	int wrongSizes[2] = { packetSizes[0], packetSizes[1] - 1 };
+	EXPECT_EQ(afWritePackets(file, AF_DEFAULT_TRACK, buffer, 2, wrongSizes,
+		frameCount), -1);
+
+	// Only the last packet may be partial.
+	EXPECT_EQ(afWritePackets(file, AF_DEFAULT_TRACK, buffer, 2, packetSizes,
+		64), -1);
+	EXPECT_EQ(afWritePackets(file, AF_DEFAULT_TRACK, buffer, 2, packetSizes,
+		129), -1);
+	EXPECT_EQ(afWritePackets(file, AF_DEFAULT_TRACK, buffer, 2, packetSizes,
+		100), 2);
+
+	// A partial packet ends the packets which can be written.
+	EXPECT_EQ(afWritePackets(file, AF_DEFAULT_TRACK, buffer, 1, packetSizes,
+		64), -1);
+	ASSERT_EQ(afCloseFile(file), 0);
+
+	// Packets cannot follow frames still held by the encoder.
+	setup = createSetup(AF_FILE_CAF, AF_COMPRESSION_ALAC);
+	file = afOpenFile(outputPath.c_str(), "w", setup);
+	afFreeFileSetup(setup);
+	ASSERT_TRUE(file);
+	std::vector<int16_t> frames;
+	generateFrames(frames, 100);
+	ASSERT_EQ(afWriteFrames(file, AF_DEFAULT_TRACK, &frames[0], 100), 100);
+	int packetSize = 100;
+	EXPECT_EQ(afWritePackets(file, AF_DEFAULT_TRACK, buffer, 1, &packetSize,
+		100), -1);
+	ASSERT_EQ(afCloseFile(file), 0);
+
+	ASSERT_EQ(::unlink(path.c_str()), 0);
+	ASSERT_EQ(::unlink(outputPath.c_str()), 0);
+}
+
+int main(int argc, char **argv)
+{
+	::testing::InitGoogleTest(&argc, argv);
+	return RUN_ALL_TESTS();
+}
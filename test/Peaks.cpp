@@ -0,0 +1,572 @@
+/*
+	Audio File Library
+
+	This program is free software; you can redistribute it and/or modify
+	it under the terms of the GNU General Public License as published by
+	the Free Software Foundation; either version 2 of the License, or
+	(at your option) any later version.
+
+	This program is distributed in the hope that it will be useful,
+	but WITHOUT ANY WARRANTY; without even the implied warranty of
+	MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+	GNU General Public License for more details.
+
+	You should have received a copy of the GNU General Public License along
+	with this program; if not, write to the Free Software Foundation, Inc.,
+	51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+*/
+
+/*
+	This program tests that the peaks of each channel are computed
+	as frames are written and are read back from the file.
+*/
+
+#include <algorithm>
+#include <audiofile.h>
+#include <gtest/gtest.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <unistd.h>
+#include <string>
+#include <vector>
+
+#include "TestUtilities.h"
+
+static const int kChannelCount = 2;
+static const int kFrameCount = 100000;
+
+/*
+	The first channel reaches its peak at two frames, of which the
+	first counts, and the second channel reaches full scale.
+*/
+static const int kPeakFrame0 = 70001;
+static const int kPeakFrame1 = 1234;
+static const int16_t kPeak0 = 20000;
+
+static void generateFrames(std::vector<int16_t> &data)
+{
+	data.resize(kFrameCount * kChannelCount);
+	for (int i=0; i<kFrameCount; i++)
+	{
+		data[kChannelCount*i] = (i * 37) % 1000 - 500;
+		data[kChannelCount*i + 1] = (i * 91) % 2000 - 1000;
+	}
+	data[kChannelCount*kPeakFrame0] = -kPeak0;
+	data[kChannelCount*(kPeakFrame0 + 5000)] = kPeak0;
+	data[kChannelCount*kPeakFrame1 + 1] = -32768;
+}
+
+static AFfilesetup createSetup(int fileFormat, int compression)
+{
+	AFfilesetup setup = afNewFileSetup();
+	afInitFileFormat(setup, fileFormat);
+	afInitChannels(setup, AF_DEFAULT_TRACK, kChannelCount);
+	afInitSampleFormat(setup, AF_DEFAULT_TRACK, AF_SAMPFMT_TWOSCOMP, 16);
+	afInitCompression(setup, AF_DEFAULT_TRACK, compression);
+	afInitPeaks(setup, AF_DEFAULT_TRACK, true);
+	return setup;
+}
+
+static void expectPeaks(AFfilehandle file, double peak0, AFframecount frame0,
+	double peak1, AFframecount frame1)
+{
+	double peaks[kChannelCount];
+	AFframecount positions[kChannelCount];
+	ASSERT_EQ(afGetPeaks(file, AF_DEFAULT_TRACK, peaks, positions),
+		kChannelCount);
+	EXPECT_NEAR(peaks[0], peak0, 1e-6);
+	EXPECT_EQ(positions[0], frame0);
+	EXPECT_NEAR(peaks[1], peak1, 1e-6);
+	EXPECT_EQ(positions[1], frame1);
+}
+
+static void testPeaks(int fileFormat, int compression = AF_COMPRESSION_NONE)
+{
+	std::string testFileName;
+	ASSERT_TRUE(createTemporaryFile("Peaks", &testFileName));
+
+	std::vector<int16_t> frames;
+	generateFrames(frames);
+
+	AFfilesetup setup = createSetup(fileFormat, compression);
+	AFfilehandle file = afOpenFile(testFileName.c_str(), "w", setup);
+	afFreeFileSetup(setup);
+	ASSERT_TRUE(file);
+	ASSERT_EQ(afWriteFrames(file, AF_DEFAULT_TRACK, &frames[0], kFrameCount),
+		kFrameCount);
+	// The peaks are known while the file is being written.
+	expectPeaks(file, kPeak0 / 32768.0, kPeakFrame0, 1, kPeakFrame1);
+	ASSERT_EQ(afCloseFile(file), 0);
+
+	file = afOpenFile(testFileName.c_str(), "r", AF_NULL_FILESETUP);
+	ASSERT_TRUE(file);
+	expectPeaks(file, kPeak0 / 32768.0, kPeakFrame0, 1, kPeakFrame1);
+	ASSERT_EQ(afCloseFile(file), 0);
+
+	ASSERT_EQ(::unlink(testFileName.c_str()), 0);
+}
+
+TEST(Peaks, WAVE)
+{
+	testPeaks(AF_FILE_WAVE);
+}
+
+TEST(Peaks, AIFF)
+{
+	testPeaks(AF_FILE_AIFF);
+}
+
+TEST(Peaks, AIFFC)
+{
+	testPeaks(AF_FILE_AIFFC);
+}
+
+TEST(Peaks, CAF)
+{
+	testPeaks(AF_FILE_CAF);
+}
+
+// The peaks are those of the samples before they are encoded.
+TEST(Peaks, CAF_ALAC)
+{
+	testPeaks(AF_FILE_CAF, AF_COMPRESSION_ALAC);
+}
+
+TEST(Peaks, WAVE_IMA)
+{
+	testPeaks(AF_FILE_WAVE, AF_COMPRESSION_IMA);
+}
+
+/*
+	A sync writes the partial block of a block codec, which is then
+	written again with the frames which follow; the peaks are kept.
+*/
+static void testSync(int compression)
+{
+	std::string testFileName;
+	ASSERT_TRUE(createTemporaryFile("Peaks", &testFileName));
+
+	std::vector<int16_t> frames;
+	generateFrames(frames);
+
+	AFfilesetup setup = createSetup(AF_FILE_WAVE, compression);
+	AFfilehandle file = afOpenFile(testFileName.c_str(), "w", setup);
+	afFreeFileSetup(setup);
+	ASSERT_TRUE(file);
+	const int firstFrames = 1001;
+	ASSERT_EQ(afWriteFrames(file, AF_DEFAULT_TRACK, &frames[0], firstFrames),
+		firstFrames);
+	ASSERT_EQ(afSyncFile(file), 0);
+	ASSERT_EQ(afWriteFrames(file, AF_DEFAULT_TRACK,
+		&frames[firstFrames * kChannelCount], kFrameCount - firstFrames),
+		kFrameCount - firstFrames);
+	expectPeaks(file, kPeak0 / 32768.0, kPeakFrame0, 1, kPeakFrame1);
+	ASSERT_EQ(afCloseFile(file), 0);
+
+	file = afOpenFile(testFileName.c_str(), "r", AF_NULL_FILESETUP);
+	ASSERT_TRUE(file);
+	expectPeaks(file, kPeak0 / 32768.0, kPeakFrame0, 1, kPeakFrame1);
+	ASSERT_EQ(afCloseFile(file), 0);
+
+	ASSERT_EQ(::unlink(testFileName.c_str()), 0);
+}
+
+TEST(Peaks, SyncIMA)
+{
+	testSync(AF_COMPRESSION_IMA);
+}
+
+TEST(Peaks, SyncMSADPCM)
+{
+	testSync(AF_COMPRESSION_MS_ADPCM);
+}
+
+TEST(Peaks, Float)
+{
+	std::string testFileName;
+	ASSERT_TRUE(createTemporaryFile("Peaks", &testFileName));
+
+	AFfilesetup setup = afNewFileSetup();
+	afInitFileFormat(setup, AF_FILE_CAF);
+	afInitChannels(setup, AF_DEFAULT_TRACK, kChannelCount);
+	afInitSampleFormat(setup, AF_DEFAULT_TRACK, AF_SAMPFMT_FLOAT, 32);
+	afInitPeaks(setup, AF_DEFAULT_TRACK, true);
+	AFfilehandle file = afOpenFile(testFileName.c_str(), "w", setup);
+	afFreeFileSetup(setup);
+	ASSERT_TRUE(file);
+	const float frames[] = { 0.25f, -0.125f, -0.5f, 0.0f, 0.5f, 0.75f };
+	ASSERT_EQ(afWriteFrames(file, AF_DEFAULT_TRACK, frames, 3), 3);
+	ASSERT_EQ(afCloseFile(file), 0);
+
+	file = afOpenFile(testFileName.c_str(), "r", AF_NULL_FILESETUP);
+	ASSERT_TRUE(file);
+	expectPeaks(file, 0.5, 1, 0.75, 2);
+	ASSERT_EQ(afCloseFile(file), 0);
+
+	ASSERT_EQ(::unlink(testFileName.c_str()), 0);
+}
+
+// Frames are measured whatever their number of channels.
+static void testChannels(int channelCount)
+{
+	std::string testFileName;
+	ASSERT_TRUE(createTemporaryFile("Peaks", &testFileName));
+
+	const int frameCount = 1001;
+	std::vector<int16_t> frames(frameCount * channelCount);
+	std::vector<AFframecount> peakFrames(channelCount);
+	for (int c=0; c<channelCount; c++)
+	{
+		for (int i=0; i<frameCount; i++)
+			frames[i*channelCount + c] = (i * 7 + c) % 200 - 100;
+		// The first channel peaks in the last frame.
+		peakFrames[c] = c == 0 ? frameCount - 1 : (c * 37) % frameCount;
+		frames[peakFrames[c] * channelCount + c] = -(1000 + c);
+	}
+
+	AFfilesetup setup = afNewFileSetup();
+	afInitFileFormat(setup, AF_FILE_CAF);
+	afInitChannels(setup, AF_DEFAULT_TRACK, channelCount);
+	afInitSampleFormat(setup, AF_DEFAULT_TRACK, AF_SAMPFMT_TWOSCOMP, 16);
+	afInitPeaks(setup, AF_DEFAULT_TRACK, true);
+	AFfilehandle file = afOpenFile(testFileName.c_str(), "w", setup);
+	afFreeFileSetup(setup);
+	ASSERT_TRUE(file);
+	ASSERT_EQ(afWriteFrames(file, AF_DEFAULT_TRACK, &frames[0], frameCount),
+		frameCount);
+	ASSERT_EQ(afCloseFile(file), 0);
+
+	file = afOpenFile(testFileName.c_str(), "r", AF_NULL_FILESETUP);
+	ASSERT_TRUE(file);
+	std::vector<double> peaks(channelCount);
+	std::vector<AFframecount> positions(channelCount);
+	ASSERT_EQ(afGetPeaks(file, AF_DEFAULT_TRACK, &peaks[0], &positions[0]),
+		channelCount);
+	for (int c=0; c<channelCount; c++)
+	{
+		EXPECT_NEAR(peaks[c], (1000 + c) / 32768.0, 1e-6) << c;
+		EXPECT_EQ(positions[c], peakFrames[c]) << c;
+	}
+	ASSERT_EQ(afCloseFile(file), 0);
+
+	ASSERT_EQ(::unlink(testFileName.c_str()), 0);
+}
+
+TEST(Peaks, ThreeChannels)
+{
+	testChannels(3);
+}
+
+TEST(Peaks, ManyChannels)
+{
+	testChannels(100);
+}
+
+/*
+	Samples converted from the virtual format are measured as they
+	are stored: here as unsigned 8-bit samples.
+*/
+TEST(Peaks, VirtualFormat)
+{
+	std::string testFileName;
+	ASSERT_TRUE(createTemporaryFile("Peaks", &testFileName));
+
+	AFfilesetup setup = afNewFileSetup();
+	afInitFileFormat(setup, AF_FILE_WAVE);
+	afInitChannels(setup, AF_DEFAULT_TRACK, kChannelCount);
+	afInitSampleFormat(setup, AF_DEFAULT_TRACK, AF_SAMPFMT_UNSIGNED, 8);
+	afInitPeaks(setup, AF_DEFAULT_TRACK, true);
+	AFfilehandle file = afOpenFile(testFileName.c_str(), "w", setup);
+	afFreeFileSetup(setup);
+	ASSERT_TRUE(file);
+	afSetVirtualSampleFormat(file, AF_DEFAULT_TRACK, AF_SAMPFMT_TWOSCOMP, 16);
+	const int16_t frames[] = { 256, -512, -16384, 0, 32767, 1024 };
+	ASSERT_EQ(afWriteFrames(file, AF_DEFAULT_TRACK, frames, 3), 3);
+	ASSERT_EQ(afCloseFile(file), 0);
+
+	file = afOpenFile(testFileName.c_str(), "r", AF_NULL_FILESETUP);
+	ASSERT_TRUE(file);
+	expectPeaks(file, 127 / 128.0, 2, 4 / 128.0, 2);
+	ASSERT_EQ(afCloseFile(file), 0);
+
+	ASSERT_EQ(::unlink(testFileName.c_str()), 0);
+}
+
+TEST(Peaks, NotStored)
+{
+	std::string testFileName;
+	ASSERT_TRUE(createTemporaryFile("Peaks", &testFileName));
+
+	std::vector<int16_t> frames;
+	generateFrames(frames);
+
+	AFfilesetup setup = createSetup(AF_FILE_WAVE, AF_COMPRESSION_NONE);
+	afInitPeaks(setup, AF_DEFAULT_TRACK, false);
+	AFfilehandle file = afOpenFile(testFileName.c_str(), "w", setup);
+	afFreeFileSetup(setup);
+	ASSERT_TRUE(file);
+	ASSERT_EQ(afWriteFrames(file, AF_DEFAULT_TRACK, &frames[0], kFrameCount),
+		kFrameCount);
+	EXPECT_EQ(afGetPeaks(file, AF_DEFAULT_TRACK, NULL, NULL), 0);
+	ASSERT_EQ(afCloseFile(file), 0);
+
+	file = afOpenFile(testFileName.c_str(), "r", AF_NULL_FILESETUP);
+	ASSERT_TRUE(file);
+	EXPECT_EQ(afGetPeaks(file, AF_DEFAULT_TRACK, NULL, NULL), 0);
+	ASSERT_EQ(afCloseFile(file), 0);
+
+	ASSERT_EQ(::unlink(testFileName.c_str()), 0);
+}
+
+// Frames appended to a file which stores peaks update them.
+static void testAppend(int fileFormat)
+{
+	std::string testFileName;
+	ASSERT_TRUE(createTemporaryFile("Peaks", &testFileName));
+
+	std::vector<int16_t> frames;
+	generateFrames(frames);
+
+	AFfilesetup setup = createSetup(fileFormat, AF_COMPRESSION_NONE);
+	AFfilehandle file = afOpenFile(testFileName.c_str(), "w", setup);
+	afFreeFileSetup(setup);
+	ASSERT_TRUE(file);
+	ASSERT_EQ(afWriteFrames(file, AF_DEFAULT_TRACK, &frames[0], kFrameCount),
+		kFrameCount);
+	ASSERT_EQ(afCloseFile(file), 0);
+
+	file = afOpenFile(testFileName.c_str(), "a", AF_NULL_FILESETUP);
+	ASSERT_TRUE(file);
+	const int16_t moreFrames[] = { 100, -100, -30000, 200 };
+	ASSERT_EQ(afWriteFrames(file, AF_DEFAULT_TRACK, moreFrames, 2), 2);
+	ASSERT_EQ(afCloseFile(file), 0);
+
+	file = afOpenFile(testFileName.c_str(), "r", AF_NULL_FILESETUP);
+	ASSERT_TRUE(file);
+	EXPECT_EQ(afGetFrameCount(file, AF_DEFAULT_TRACK), kFrameCount + 2);
+	expectPeaks(file, 30000 / 32768.0, kFrameCount + 1, 1, kPeakFrame1);
+	ASSERT_EQ(afCloseFile(file), 0);
+
+	ASSERT_EQ(::unlink(testFileName.c_str()), 0);
+}
+
+TEST(Peaks, AppendWAVE)
+{
+	testAppend(AF_FILE_WAVE);
+}
+
+TEST(Peaks, AppendAIFF)
+{
+	testAppend(AF_FILE_AIFF);
+}
+
+TEST(Peaks, AppendCAF)
+{
+	testAppend(AF_FILE_CAF);
+}
+
+/*
+	Frames written at the end of a file opened with "r+" update its
+	stored peaks, but overwriting frames may lower a peak, so the
+	peaks are no longer stored.
+*/
+static void testUpdate(int fileFormat)
+{
+	std::string testFileName;
+	ASSERT_TRUE(createTemporaryFile("Peaks", &testFileName));
+
+	std::vector<int16_t> frames;
+	generateFrames(frames);
+
+	AFfilesetup setup = createSetup(fileFormat, AF_COMPRESSION_NONE);
+	AFfilehandle file = afOpenFile(testFileName.c_str(), "w", setup);
+	afFreeFileSetup(setup);
+	ASSERT_TRUE(file);
+	ASSERT_EQ(afWriteFrames(file, AF_DEFAULT_TRACK, &frames[0], kFrameCount),
+		kFrameCount);
+	ASSERT_EQ(afCloseFile(file), 0);
+
+	file = afOpenFile(testFileName.c_str(), "r+", AF_NULL_FILESETUP);
+	ASSERT_TRUE(file);
+	ASSERT_EQ(afSeekFrame(file, AF_DEFAULT_TRACK, kFrameCount), kFrameCount);
+	const int16_t moreFrames[] = { 100, -100, -30000, 200 };
+	ASSERT_EQ(afWriteFrames(file, AF_DEFAULT_TRACK, moreFrames, 2), 2);
+	expectPeaks(file, 30000 / 32768.0, kFrameCount + 1, 1, kPeakFrame1);
+	ASSERT_EQ(afCloseFile(file), 0);
+
+	file = afOpenFile(testFileName.c_str(), "r", AF_NULL_FILESETUP);
+	ASSERT_TRUE(file);
+	expectPeaks(file, 30000 / 32768.0, kFrameCount + 1, 1, kPeakFrame1);
+	ASSERT_EQ(afCloseFile(file), 0);
+
+	// Silence the loudest frame.
+	file = afOpenFile(testFileName.c_str(), "r+", AF_NULL_FILESETUP);
+	ASSERT_TRUE(file);
+	ASSERT_EQ(afSeekFrame(file, AF_DEFAULT_TRACK, kFrameCount + 1),
+		kFrameCount + 1);
+	const int16_t quietFrames[] = { 1, -1 };
+	ASSERT_EQ(afWriteFrames(file, AF_DEFAULT_TRACK, quietFrames, 1), 1);
+	EXPECT_EQ(afGetPeaks(file, AF_DEFAULT_TRACK, NULL, NULL), 0);
+	ASSERT_EQ(afCloseFile(file), 0);
+
+	file = afOpenFile(testFileName.c_str(), "r", AF_NULL_FILESETUP);
+	ASSERT_TRUE(file);
+	EXPECT_EQ(afGetFrameCount(file, AF_DEFAULT_TRACK), kFrameCount + 2);
+	EXPECT_EQ(afGetPeaks(file, AF_DEFAULT_TRACK, NULL, NULL), 0);
+	ASSERT_EQ(afCloseFile(file), 0);
+
+	ASSERT_EQ(::unlink(testFileName.c_str()), 0);
+}
+
+TEST(Peaks, UpdateWAVE)
+{
+	testUpdate(AF_FILE_WAVE);
+}
+
+TEST(Peaks, UpdateAIFF)
+{
+	testUpdate(AF_FILE_AIFF);
+}
+
+TEST(Peaks, UpdateCAF)
+{
+	testUpdate(AF_FILE_CAF);
+}
+
+/*
+	A PEAK chunk which does not have one peak for each channel is left
+	as it is when frames are appended, since a chunk of another size
+	would overwrite the chunks which follow it.
+*/
+TEST(Peaks, AppendMismatchedChunk)
+{
+	std::string testFileName;
+	ASSERT_TRUE(createTemporaryFile("Peaks", &testFileName));
+
+	const uint8_t data[] =
+	{
+		'R', 'I', 'F', 'F',
+		84, 0, 0, 0,
+		'W', 'A', 'V', 'E',
+		'f', 'm', 't', ' ',
+		16, 0, 0, 0,
+		1, 0, // PCM
+		2, 0, // 2 channels
+		0x44, 0xac, 0, 0, // 44100 Hz
+		0x10, 0xb1, 0x02, 0, // 176400 bytes per second
+		4, 0, // block align
+		16, 0, // 16 bits per sample
+		'P', 'E', 'A', 'K',
+		32, 0, 0, 0, // three peaks
+		1, 0, 0, 0, // version
+		0, 0, 0, 0, // time stamp
+		0, 0, 0x80, 0x3f, 0xff, 0xff, 0, 0,
+		0, 0, 0x80, 0x3f, 0xff, 0xff, 0, 0,
+		0, 0, 0x80, 0x3f, 0xff, 0xff, 0, 0,
+		'd', 'a', 't', 'a',
+		8, 0, 0, 0,
+		1, 0, 2, 0, 3, 0, 4, 0
+	};
+	FILE *fp = fopen(testFileName.c_str(), "wb");
+	ASSERT_TRUE(fp);
+	ASSERT_EQ(fwrite(data, 1, sizeof (data), fp), sizeof (data));
+	ASSERT_EQ(fclose(fp), 0);
+
+	AFfilehandle file = afOpenFile(testFileName.c_str(), "a", AF_NULL_FILESETUP);
+	ASSERT_TRUE(file);
+	EXPECT_EQ(afGetPeaks(file, AF_DEFAULT_TRACK, NULL, NULL), 0);
+	const int16_t moreFrames[] = { 5, 6, 7, 8 };
+	ASSERT_EQ(afWriteFrames(file, AF_DEFAULT_TRACK, moreFrames, 2), 2);
+	ASSERT_EQ(afCloseFile(file), 0);
+
+	file = afOpenFile(testFileName.c_str(), "r", AF_NULL_FILESETUP);
+	ASSERT_TRUE(file);
+	ASSERT_EQ(afGetFrameCount(file, AF_DEFAULT_TRACK), 4);
+	int16_t frames[8];
+	ASSERT_EQ(afReadFrames(file, AF_DEFAULT_TRACK, frames, 4), 4);
+	for (int i=0; i<8; i++)
+		EXPECT_EQ(frames[i], i + 1);
+	ASSERT_EQ(afCloseFile(file), 0);
+
+	ASSERT_EQ(::unlink(testFileName.c_str()), 0);
+}
+
+// Remuxing a whole track keeps its stored peaks.
+TEST(Peaks, Remux)
+{
+	std::string inputFileName, outputFileName;
+	ASSERT_TRUE(createTemporaryFile("Peaks", &inputFileName));
+	ASSERT_TRUE(createTemporaryFile("Peaks", &outputFileName));
+
+	std::vector<int16_t> frames;
+	generateFrames(frames);
+
+	AFfilesetup setup = createSetup(AF_FILE_WAVE, AF_COMPRESSION_NONE);
+	AFfilehandle file = afOpenFile(inputFileName.c_str(), "w", setup);
+	afFreeFileSetup(setup);
+	ASSERT_TRUE(file);
+	ASSERT_EQ(afWriteFrames(file, AF_DEFAULT_TRACK, &frames[0], kFrameCount),
+		kFrameCount);
+	ASSERT_EQ(afCloseFile(file), 0);
+
+	AFfilehandle inFile = afOpenFile(inputFileName.c_str(), "r",
+		AF_NULL_FILESETUP);
+	ASSERT_TRUE(inFile);
+	setup = createSetup(AF_FILE_CAF, AF_COMPRESSION_NONE);
+	afInitByteOrder(setup, AF_DEFAULT_TRACK, AF_BYTEORDER_LITTLEENDIAN);
+	AFfilehandle outFile = afOpenFile(outputFileName.c_str(), "w", setup);
+	afFreeFileSetup(setup);
+	ASSERT_TRUE(outFile);
+	const int16_t leadingFrames[] = { 1000, -1000, 3000, 2000 };
+	ASSERT_EQ(afWriteFrames(outFile, AF_DEFAULT_TRACK, leadingFrames, 2), 2);
+	ASSERT_EQ(afRemuxTrack(inFile, outFile, AF_DEFAULT_TRACK), kFrameCount);
+	ASSERT_EQ(afCloseFile(outFile), 0);
+	ASSERT_EQ(afCloseFile(inFile), 0);
+
+	file = afOpenFile(outputFileName.c_str(), "r", AF_NULL_FILESETUP);
+	ASSERT_TRUE(file);
+	expectPeaks(file, kPeak0 / 32768.0, kPeakFrame0 + 2, 1, kPeakFrame1 + 2);
+	ASSERT_EQ(afCloseFile(file), 0);
+
+	ASSERT_EQ(::unlink(inputFileName.c_str()), 0);
+	ASSERT_EQ(::unlink(outputFileName.c_str()), 0);
+}
+
+// The peaks of packets written without being decoded are not known.
+TEST(Peaks, Packets)
+{
+	std::string testFileName;
+	ASSERT_TRUE(createTemporaryFile("Peaks", &testFileName));
+
+	std::vector<int16_t> frames;
+	generateFrames(frames);
+
+	AFfilesetup setup = createSetup(AF_FILE_WAVE, AF_COMPRESSION_NONE);
+	AFfilehandle file = afOpenFile(testFileName.c_str(), "w", setup);
+	afFreeFileSetup(setup);
+	ASSERT_TRUE(file);
+	ASSERT_EQ(afWriteFrames(file, AF_DEFAULT_TRACK, &frames[0], 100), 100);
+	EXPECT_EQ(afGetPeaks(file, AF_DEFAULT_TRACK, NULL, NULL), kChannelCount);
+	ASSERT_EQ(afWritePackets(file, AF_DEFAULT_TRACK, &frames[200], 100, NULL,
+		100), 100);
+	EXPECT_EQ(afGetPeaks(file, AF_DEFAULT_TRACK, NULL, NULL), 0);
+	ASSERT_EQ(afWriteFrames(file, AF_DEFAULT_TRACK, &frames[400], 100), 100);
+	ASSERT_EQ(afCloseFile(file), 0);
+
+	file = afOpenFile(testFileName.c_str(), "r", AF_NULL_FILESETUP);
+	ASSERT_TRUE(file);
+	EXPECT_EQ(afGetFrameCount(file, AF_DEFAULT_TRACK), 300);
+	EXPECT_EQ(afGetPeaks(file, AF_DEFAULT_TRACK, NULL, NULL), 0);
+	std::vector<int16_t> data(300 * kChannelCount);
+	ASSERT_EQ(afReadFrames(file, AF_DEFAULT_TRACK, &data[0], 300), 300);
+	EXPECT_TRUE(std::equal(data.begin(), data.end(), frames.begin()));
+	ASSERT_EQ(afCloseFile(file), 0);
+
+	ASSERT_EQ(::unlink(testFileName.c_str()), 0);
+}
+
+int main(int argc, char **argv)
+{
+	::testing::InitGoogleTest(&argc, argv);
+	return RUN_ALL_TESTS();
+}
@@ -27,12 +27,16 @@
 	THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
 */
 
+#include <fcntl.h>
 #include <stdlib.h>
 #include <unistd.h>
+#include <vector>
 
 #include <gtest/gtest.h>
 #include <audiofile.h>
 
+#include "TestUtilities.h"
+
 TEST(Pipe, Pipe)
 {
 	const int kFrameCount = 500;
@@ -78,6 +82,167 @@ TEST(Pipe, Pipe)
 	afFreeFileSetup(setup);
 }
 
+static const int kChannelCount = 2;
+static const int kFrameCount = 500;
+
+static void writeTestFile(const std::string &path, int fileFormat,
+	int compression, const std::vector<int16_t> &data,
+	AFframecount frameCountHint = -1)
+{
+	AFfilesetup setup = afNewFileSetup();
+	afInitFileFormat(setup, fileFormat);
+	afInitChannels(setup, AF_DEFAULT_TRACK, kChannelCount);
+	afInitSampleFormat(setup, AF_DEFAULT_TRACK, AF_SAMPFMT_TWOSCOMP, 16);
+	afInitCompression(setup, AF_DEFAULT_TRACK, compression);
+	if (frameCountHint >= 0)
+		afInitFrameCount(setup, AF_DEFAULT_TRACK, frameCountHint);
+	AFfilehandle file = afOpenFile(path.c_str(), "w", setup);
+	ASSERT_TRUE(file);
+	afFreeFileSetup(setup);
+	ASSERT_EQ(kFrameCount,
+		afWriteFrames(file, AF_DEFAULT_TRACK, &data[0], kFrameCount));
+	ASSERT_EQ(0, afCloseFile(file));
+}
+
+/*
+	Copy the contents of the file at path into a pipe and return the
+	pipe's read end.  The test files are smaller than a pipe's
+	capacity, so the write does not block.
+*/
+static int openFileAsPipe(const std::string &path)
+{
+	std::vector<char> contents(65536);
+	int fd = ::open(path.c_str(), O_RDONLY);
+	if (fd < 0)
+		return -1;
+	ssize_t length = ::read(fd, &contents[0], contents.size());
+	::close(fd);
+	if (length <= 0 || length == static_cast<ssize_t>(contents.size()))
+		return -1;
+
+	int pipefd[2];
+	if (::pipe(pipefd) < 0)
+		return -1;
+	ssize_t written = ::write(pipefd[1], &contents[0], length);
+	::close(pipefd[1]);
+	if (written != length)
+	{
+		::close(pipefd[0]);
+		return -1;
+	}
+	return pipefd[0];
+}
+
+static void testReadFromPipe(int fileFormat, int compression)
+{
+	std::vector<int16_t> data(kFrameCount * kChannelCount);
+	for (size_t i=0; i<data.size(); i++)
+		data[i] = static_cast<int16_t>(i * 37 - 5000);
+
+	std::string testFileName;
+	ASSERT_TRUE(createTemporaryFile("Pipe", &testFileName));
+	writeTestFile(testFileName, fileFormat, compression, data);
+
+	AFfilehandle file = afOpenFile(testFileName.c_str(), "r", AF_NULL_FILESETUP);
+	ASSERT_TRUE(file);
+	std::vector<int16_t> expected(data.size());
+	ASSERT_EQ(kFrameCount,
+		afReadFrames(file, AF_DEFAULT_TRACK, &expected[0], kFrameCount));
+	ASSERT_EQ(0, afCloseFile(file));
+
+	int fd = openFileAsPipe(testFileName);
+	ASSERT_GE(fd, 0);
+	file = afOpenFD(fd, "r", AF_NULL_FILESETUP);
+	ASSERT_TRUE(file);
+	EXPECT_EQ(fileFormat, afGetFileFormat(file, NULL));
+	EXPECT_EQ(compression, afGetCompression(file, AF_DEFAULT_TRACK));
+
+	// Read more frames than the file contains.
+	std::vector<int16_t> readData(data.size() + 100 * kChannelCount);
+	ASSERT_EQ(kFrameCount,
+		afReadFrames(file, AF_DEFAULT_TRACK, &readData[0], kFrameCount + 100));
+	readData.resize(expected.size());
+	EXPECT_TRUE(readData == expected) << "Data read does not match data written";
+	ASSERT_EQ(0, afCloseFile(file));
+
+	ASSERT_EQ(0, ::unlink(testFileName.c_str()));
+}
+
+TEST(Pipe, WAVE)
+{
+	testReadFromPipe(AF_FILE_WAVE, AF_COMPRESSION_NONE);
+}
+
+TEST(Pipe, WAVE_IMA)
+{
+	testReadFromPipe(AF_FILE_WAVE, AF_COMPRESSION_IMA);
+}
+
+TEST(Pipe, AIFF)
+{
+	testReadFromPipe(AF_FILE_AIFF, AF_COMPRESSION_NONE);
+}
+
+TEST(Pipe, AIFFC)
+{
+	testReadFromPipe(AF_FILE_AIFFC, AF_COMPRESSION_NONE);
+}
+
+TEST(Pipe, CAF)
+{
+	testReadFromPipe(AF_FILE_CAF, AF_COMPRESSION_NONE);
+}
+
+TEST(Pipe, NeXT)
+{
+	testReadFromPipe(AF_FILE_NEXTSND, AF_COMPRESSION_NONE);
+}
+
+TEST(Pipe, PacketTableAfterData)
+{
+	IgnoreErrors ignoreErrors;
+
+	std::vector<int16_t> data(kFrameCount * kChannelCount, 0);
+	std::string testFileName;
+	ASSERT_TRUE(createTemporaryFile("Pipe", &testFileName));
+	/*
+		With an expected frame count of zero no space is reserved
+		for the packet table, so it follows the audio data.
+	*/
+	writeTestFile(testFileName, AF_FILE_CAF, AF_COMPRESSION_ALAC, data, 0);
+
+	int fd = openFileAsPipe(testFileName);
+	ASSERT_GE(fd, 0);
+	EXPECT_FALSE(afOpenFD(fd, "r", AF_NULL_FILESETUP));
+	::close(fd);
+
+	ASSERT_EQ(0, ::unlink(testFileName.c_str()));
+}
+
+TEST(Pipe, PacketTableBeforeData)
+{
+	std::vector<int16_t> data(kFrameCount * kChannelCount);
+	for (size_t i=0; i<data.size(); i++)
+		data[i] = static_cast<int16_t>(i * 37 - 5000);
+
+	std::string testFileName;
+	ASSERT_TRUE(createTemporaryFile("Pipe", &testFileName));
+	writeTestFile(testFileName, AF_FILE_CAF, AF_COMPRESSION_ALAC, data);
+
+	// The packet table is written ahead of the audio data by default.
+	int fd = openFileAsPipe(testFileName);
+	ASSERT_GE(fd, 0);
+	AFfilehandle file = afOpenFD(fd, "r", AF_NULL_FILESETUP);
+	ASSERT_TRUE(file);
+	std::vector<int16_t> readData(data.size());
+	ASSERT_EQ(kFrameCount,
+		afReadFrames(file, AF_DEFAULT_TRACK, &readData[0], kFrameCount));
+	EXPECT_TRUE(readData == data) << "Data read does not match data written";
+	ASSERT_EQ(0, afCloseFile(file));
+
+	ASSERT_EQ(0, ::unlink(testFileName.c_str()));
+}
+
 int main(int argc, char **argv)
 {
 	::testing::InitGoogleTest(&argc, argv);
@@ -0,0 +1,195 @@
+/*
+	Audio File Library
+
+	This program is free software; you can redistribute it and/or modify
+	it under the terms of the GNU General Public License as published by
+	the Free Software Foundation; either version 2 of the License, or
+	(at your option) any later version.
+
+	This program is distributed in the hope that it will be useful,
+	but WITHOUT ANY WARRANTY; without even the implied warranty of
+	MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+	GNU General Public License for more details.
+
+	You should have received a copy of the GNU General Public License along
+	with this program; if not, write to the Free Software Foundation, Inc.,
+	51 Franklin Street, Fifth Floor, Boston, MA  02110-1301  USA
+*/
+
+#include <audiofile.h>
+#include <gtest/gtest.h>
+
+#include <fcntl.h>
+#include <stdint.h>
+#include <unistd.h>
+#include <vector>
+
+#include "TestUtilities.h"
+
+static const int kChannelCount = 2;
+static const int kFrameCount = 10007;
+static const double kSampleRate = 22050;
+
+static bool supportsMarkers(int fileFormat)
+{
+	return fileFormat == AF_FILE_WAVE ||
+		fileFormat == AF_FILE_AIFF ||
+		fileFormat == AF_FILE_AIFFC;
+}
+
+static void writeTestFile(const std::string &path, int fileFormat,
+	int compression)
+{
+	std::vector<int16_t> data(kFrameCount * kChannelCount);
+	for (size_t i=0; i<data.size(); i++)
+		data[i] = static_cast<int16_t>(i * 31);
+
+	AFfilesetup setup = afNewFileSetup();
+	afInitFileFormat(setup, fileFormat);
+	afInitChannels(setup, AF_DEFAULT_TRACK, kChannelCount);
+	afInitRate(setup, AF_DEFAULT_TRACK, kSampleRate);
+	afInitSampleFormat(setup, AF_DEFAULT_TRACK, AF_SAMPFMT_TWOSCOMP, 16);
+	afInitCompression(setup, AF_DEFAULT_TRACK, compression);
+	if (supportsMarkers(fileFormat))
+	{
+		int markerIDs[] = { 1, 2 };
+		afInitMarkIDs(setup, AF_DEFAULT_TRACK, markerIDs, 2);
+	}
+	AFfilehandle file = afOpenFile(path.c_str(), "w", setup);
+	ASSERT_TRUE(file);
+	afFreeFileSetup(setup);
+	if (supportsMarkers(fileFormat))
+	{
+		afSetMarkPosition(file, AF_DEFAULT_TRACK, 1, 100);
+		afSetMarkPosition(file, AF_DEFAULT_TRACK, 2, 200);
+	}
+	ASSERT_EQ(kFrameCount,
+		afWriteFrames(file, AF_DEFAULT_TRACK, &data[0], kFrameCount));
+	ASSERT_EQ(0, afCloseFile(file));
+}
+
+static void expectMatchesFileHandle(const std::string &path,
+	const AFfileinfo &info)
+{
+	AFfilehandle file = afOpenFile(path.c_str(), "r", AF_NULL_FILESETUP);
+	ASSERT_TRUE(file);
+
+	EXPECT_EQ(afGetFileFormat(file, NULL), info.fileFormat);
+	EXPECT_EQ(afGetChannels(file, AF_DEFAULT_TRACK), info.channelCount);
+	EXPECT_EQ(afGetRate(file, AF_DEFAULT_TRACK), info.sampleRate);
+	int sampleFormat, sampleWidth;
+	afGetSampleFormat(file, AF_DEFAULT_TRACK, &sampleFormat, &sampleWidth);
+	EXPECT_EQ(sampleFormat, info.sampleFormat);
+	EXPECT_EQ(sampleWidth, info.sampleWidth);
+	EXPECT_EQ(afGetByteOrder(file, AF_DEFAULT_TRACK), info.byteOrder);
+	EXPECT_EQ(afGetCompression(file, AF_DEFAULT_TRACK), info.compressionType);
+	EXPECT_EQ(afGetFrameCount(file, AF_DEFAULT_TRACK), info.frameCount);
+	EXPECT_EQ(afGetDataOffset(file, AF_DEFAULT_TRACK), info.dataOffset);
+	EXPECT_EQ(afGetTrackBytes(file, AF_DEFAULT_TRACK), info.dataBytes);
+	EXPECT_DOUBLE_EQ(static_cast<double>(info.frameCount) / kSampleRate,
+		info.duration);
+
+	ASSERT_EQ(0, afCloseFile(file));
+}
+
+static void testProbe(int fileFormat, int compression)
+{
+	std::string testFileName;
+	ASSERT_TRUE(createTemporaryFile("Probe", &testFileName));
+	writeTestFile(testFileName, fileFormat, compression);
+
+	AFfileinfo info;
+	ASSERT_EQ(0, afProbeFile(testFileName.c_str(), &info));
+	EXPECT_EQ(fileFormat, info.fileFormat);
+	EXPECT_EQ(kChannelCount, info.channelCount);
+	EXPECT_EQ(kSampleRate, info.sampleRate);
+	EXPECT_EQ(compression, info.compressionType);
+	EXPECT_EQ(kFrameCount, info.frameCount);
+	expectMatchesFileHandle(testFileName, info);
+
+	int fd = ::open(testFileName.c_str(), O_RDONLY);
+	ASSERT_GE(fd, 0);
+	AFfileinfo fdInfo;
+	ASSERT_EQ(0, afProbeFD(fd, &fdInfo));
+	EXPECT_EQ(info.fileFormat, fdInfo.fileFormat);
+	EXPECT_EQ(info.frameCount, fdInfo.frameCount);
+	EXPECT_EQ(info.dataOffset, fdInfo.dataOffset);
+	// The file descriptor remains open.
+	EXPECT_EQ(0, ::close(fd));
+
+	ASSERT_EQ(0, ::unlink(testFileName.c_str()));
+}
+
+TEST(Probe, WAVE)
+{
+	testProbe(AF_FILE_WAVE, AF_COMPRESSION_NONE);
+}
+
+TEST(Probe, WAVE_IMA)
+{
+	testProbe(AF_FILE_WAVE, AF_COMPRESSION_IMA);
+}
+
+TEST(Probe, AIFF)
+{
+	testProbe(AF_FILE_AIFF, AF_COMPRESSION_NONE);
+}
+
+TEST(Probe, AIFFC)
+{
+	testProbe(AF_FILE_AIFFC, AF_COMPRESSION_NONE);
+}
+
+TEST(Probe, CAF_ALAC)
+{
+	testProbe(AF_FILE_CAF, AF_COMPRESSION_ALAC);
+}
+
+TEST(Probe, NeXT)
+{
+	testProbe(AF_FILE_NEXTSND, AF_COMPRESSION_NONE);
+}
+
+TEST(Probe, Batch)
+{
+	IgnoreErrors ignoreErrors;
+
+	std::string waveFileName, aiffFileName, invalidFileName;
+	ASSERT_TRUE(createTemporaryFile("Probe", &waveFileName));
+	ASSERT_TRUE(createTemporaryFile("Probe", &aiffFileName));
+	ASSERT_TRUE(createTemporaryFile("Probe", &invalidFileName));
+	writeTestFile(waveFileName, AF_FILE_WAVE, AF_COMPRESSION_NONE);
+	writeTestFile(aiffFileName, AF_FILE_AIFF, AF_COMPRESSION_NONE);
+
+	const char junk[] = "this is not an audio file";
+	int fd = ::open(invalidFileName.c_str(), O_WRONLY | O_TRUNC);
+	ASSERT_GE(fd, 0);
+	ASSERT_EQ(static_cast<ssize_t>(sizeof (junk)),
+		::write(fd, junk, sizeof (junk)));
+	::close(fd);
+
+	const char *fileNames[] =
+	{
+		waveFileName.c_str(),
+		"/nonexistent/Probe.wav",
+		invalidFileName.c_str(),
+		aiffFileName.c_str()
+	};
+	AFfileinfo infos[4];
+	EXPECT_EQ(2, afProbeFiles(fileNames, 4, infos));
+	EXPECT_EQ(AF_FILE_WAVE, infos[0].fileFormat);
+	EXPECT_EQ(AF_FILE_UNKNOWN, infos[1].fileFormat);
+	EXPECT_EQ(AF_FILE_UNKNOWN, infos[2].fileFormat);
+	EXPECT_EQ(AF_FILE_AIFF, infos[3].fileFormat);
+	EXPECT_EQ(kFrameCount, infos[3].frameCount);
+
+	ASSERT_EQ(0, ::unlink(waveFileName.c_str()));
+	ASSERT_EQ(0, ::unlink(aiffFileName.c_str()));
+	ASSERT_EQ(0, ::unlink(invalidFileName.c_str()));
+}
+
+int main(int argc, char **argv)
+{
+	::testing::InitGoogleTest(&argc, argv);
+	return RUN_ALL_TESTS();
+}
@@ -0,0 +1,394 @@
+/*
+	Audio File Library
+
+	This program is free software; you can redistribute it and/or modify
+	it under the terms of the GNU General Public License as published by
+	the Free Software Foundation; either version 2 of the License, or
+	(at your option) any later version.
+
+	This program is distributed in the hope that it will be useful,
+	but WITHOUT ANY WARRANTY; without even the implied warranty of
+	MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+	GNU General Public License for more details.
+
+	You should have received a copy of the GNU General Public License along
+	with this program; if not, write to the Free Software Foundation, Inc.,
+	51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+*/
+
+/*
+	This program tests reading and writing WAVE files in the RF64
+	format, which uses 64-bit chunk sizes stored in a ds64 chunk.
+*/
+
+#include <af_vfs.h>
+#include <algorithm>
+#include <audiofile.h>
+#include <fcntl.h>
+#include <gtest/gtest.h>
+#include <stdint.h>
+#include <string.h>
+#include <sys/types.h>
+#include <unistd.h>
+#include <string>
+#include <vector>
+
+#include "TestUtilities.h"
+
+static const int16_t kFrames[] = { 1, 1, 2, 3, 5, 8, 13, 21, 34, 55 };
+static const int kFrameCount = sizeof (kFrames) / sizeof (kFrames[0]);
+
+static const uint8_t kDataRF64[] =
+{
+	'R', 'F', '6', '4',
+	0xff, 0xff, 0xff, 0xff, // size given by ds64 chunk
+	'W', 'A', 'V', 'E',
+
+	'd', 's', '6', '4',
+	28, 0, 0, 0,
+	100, 0, 0, 0, 0, 0, 0, 0, // RIFF size
+	20, 0, 0, 0, 0, 0, 0, 0, // data size
+	10, 0, 0, 0, 0, 0, 0, 0, // sample count
+	0, 0, 0, 0, // no chunk size table
+
+	'f', 'm', 't', ' ',
+	16, 0, 0, 0,
+	1, 0, // PCM
+	1, 0, // 1 channel
+	0x44, 0xac, 0, 0, // 44100 Hz
+	0x88, 0x58, 0x01, 0, // 88200 bytes per second
+	2, 0, // block align
+	16, 0, // 16 bits per sample
+
+	'd', 'a', 't', 'a',
+	0xff, 0xff, 0xff, 0xff, // size given by ds64 chunk
+	1, 0,
+	1, 0,
+	2, 0,
+	3, 0,
+	5, 0,
+	8, 0,
+	13, 0,
+	21, 0,
+	34, 0,
+	55, 0,
+
+	'J', 'U', 'N', 'K',
+	4, 0, 0, 0,
+	0, 0, 0, 0
+};
+
+static void writeBytes(const std::string &path, const uint8_t *data,
+	size_t size)
+{
+	int fd = ::open(path.c_str(), O_RDWR | O_CREAT | O_TRUNC, 0644);
+	ASSERT_GT(fd, -1);
+	ASSERT_EQ(::write(fd, data, size), static_cast<ssize_t>(size));
+	::close(fd);
+}
+
+static void testRead(const char *formType)
+{
+	std::string testFileName;
+	ASSERT_TRUE(createTemporaryFile("RF64", &testFileName));
+
+	std::vector<uint8_t> bytes(kDataRF64, kDataRF64 + sizeof (kDataRF64));
+	memcpy(&bytes[0], formType, 4);
+	writeBytes(testFileName, &bytes[0], bytes.size());
+
+	AFfilehandle file = afOpenFile(testFileName.c_str(), "r", NULL);
+	ASSERT_TRUE(file);
+	EXPECT_EQ(afGetFileFormat(file, NULL), AF_FILE_WAVE);
+	EXPECT_EQ(afGetChannels(file, AF_DEFAULT_TRACK), 1);
+	EXPECT_EQ(afGetTrackBytes(file, AF_DEFAULT_TRACK),
+		kFrameCount * sizeof (int16_t));
+	EXPECT_EQ(afGetFrameCount(file, AF_DEFAULT_TRACK), kFrameCount);
+
+	int16_t data[kFrameCount + 1];
+	EXPECT_EQ(afReadFrames(file, AF_DEFAULT_TRACK, data, kFrameCount + 1),
+		kFrameCount);
+	for (int i=0; i<kFrameCount; i++)
+		EXPECT_EQ(data[i], kFrames[i]);
+
+	afCloseFile(file);
+	ASSERT_EQ(::unlink(testFileName.c_str()), 0);
+}
+
+TEST(RF64, ReadRF64)
+{
+	testRead("RF64");
+}
+
+TEST(RF64, ReadBW64)
+{
+	testRead("BW64");
+}
+
+TEST(RF64, MissingDataSize64)
+{
+	IgnoreErrors ignoreErrors;
+
+	std::string testFileName;
+	ASSERT_TRUE(createTemporaryFile("RF64", &testFileName));
+
+	// An RF64 file must begin with a ds64 chunk.
+	std::vector<uint8_t> bytes(kDataRF64, kDataRF64 + sizeof (kDataRF64));
+	memcpy(&bytes[12], "JUNK", 4);
+	writeBytes(testFileName, &bytes[0], bytes.size());
+
+	AFfilehandle file = afOpenFile(testFileName.c_str(), "r", NULL);
+	EXPECT_FALSE(file);
+
+	ASSERT_EQ(::unlink(testFileName.c_str()), 0);
+}
+
+TEST(RF64, ReserveDataSize64)
+{
+	std::string testFileName;
+	ASSERT_TRUE(createTemporaryFile("RF64", &testFileName));
+
+	AFfilesetup setup = afNewFileSetup();
+	afInitFileFormat(setup, AF_FILE_WAVE);
+	afInitChannels(setup, AF_DEFAULT_TRACK, 1);
+	afInitSampleFormat(setup, AF_DEFAULT_TRACK, AF_SAMPFMT_TWOSCOMP, 16);
+	AFfilehandle file = afOpenFile(testFileName.c_str(), "w", setup);
+	afFreeFileSetup(setup);
+	ASSERT_TRUE(file);
+	ASSERT_EQ(afWriteFrames(file, AF_DEFAULT_TRACK, kFrames, kFrameCount),
+		kFrameCount);
+	ASSERT_EQ(afCloseFile(file), 0);
+
+	// A small file remains a RIFF file with room reserved for a ds64 chunk.
+	int fd = ::open(testFileName.c_str(), O_RDONLY);
+	ASSERT_GT(fd, -1);
+	char header[20];
+	ASSERT_EQ(::read(fd, header, sizeof (header)), sizeof (header));
+	::close(fd);
+	EXPECT_EQ(memcmp(header, "RIFF", 4), 0);
+	EXPECT_EQ(memcmp(header + 12, "JUNK", 4), 0);
+	EXPECT_EQ(header[16], 28);
+
+	file = afOpenFile(testFileName.c_str(), "r", NULL);
+	ASSERT_TRUE(file);
+	EXPECT_EQ(afGetFrameCount(file, AF_DEFAULT_TRACK), kFrameCount);
+	int16_t data[kFrameCount];
+	EXPECT_EQ(afReadFrames(file, AF_DEFAULT_TRACK, data, kFrameCount),
+		kFrameCount);
+	for (int i=0; i<kFrameCount; i++)
+		EXPECT_EQ(data[i], kFrames[i]);
+	afCloseFile(file);
+
+	ASSERT_EQ(::unlink(testFileName.c_str()), 0);
+}
+
+/*
+	A virtual file which keeps only the first few kilobytes written
+	to it, so that a file larger than 4 GB can be written without
+	using that much memory or disk space.  The rest of the file
+	reads as zeros.
+*/
+struct SparseFile
+{
+	enum { kHeaderSize = 4096 };
+	uint8_t header[kHeaderSize];
+	AFfileoffset position;
+	AFfileoffset length;
+};
+
+static ssize_t sparseRead(AFvirtualfile *vf, void *data, size_t nbytes)
+{
+	SparseFile *f = static_cast<SparseFile *>(vf->closure);
+	if (f->position >= f->length)
+		return 0;
+	if (static_cast<AFfileoffset>(nbytes) > f->length - f->position)
+		nbytes = f->length - f->position;
+	memset(data, 0, nbytes);
+	if (f->position < SparseFile::kHeaderSize)
+	{
+		size_t n = std::min<AFfileoffset>(nbytes,
+			SparseFile::kHeaderSize - f->position);
+		memcpy(data, f->header + f->position, n);
+	}
+	f->position += nbytes;
+	return nbytes;
+}
+
+static ssize_t sparseWrite(AFvirtualfile *vf, const void *data, size_t nbytes)
+{
+	SparseFile *f = static_cast<SparseFile *>(vf->closure);
+	if (f->position < SparseFile::kHeaderSize)
+	{
+		size_t n = std::min<AFfileoffset>(nbytes,
+			SparseFile::kHeaderSize - f->position);
+		memcpy(f->header + f->position, data, n);
+	}
+	f->position += nbytes;
+	f->length = std::max(f->length, f->position);
+	return nbytes;
+}
+
+static AFfileoffset sparseLength(AFvirtualfile *vf)
+{
+	return static_cast<SparseFile *>(vf->closure)->length;
+}
+
+static AFfileoffset sparseSeek(AFvirtualfile *vf, AFfileoffset offset,
+	int isRelative)
+{
+	SparseFile *f = static_cast<SparseFile *>(vf->closure);
+	f->position = isRelative ? f->position + offset : offset;
+	return f->position;
+}
+
+static AFfileoffset sparseTell(AFvirtualfile *vf)
+{
+	return static_cast<SparseFile *>(vf->closure)->position;
+}
+
+static void sparseDestroy(AFvirtualfile *)
+{
+}
+
+static AFvirtualfile *createSparseFile(SparseFile *f)
+{
+	AFvirtualfile *vf = af_virtual_file_new();
+	vf->read = sparseRead;
+	vf->write = sparseWrite;
+	vf->length = sparseLength;
+	vf->seek = sparseSeek;
+	vf->tell = sparseTell;
+	vf->destroy = sparseDestroy;
+	vf->closure = f;
+	f->position = 0;
+	return vf;
+}
+
+static uint32_t readU32(const uint8_t *p)
+{
+	return p[0] | (p[1] << 8) | (p[2] << 16) | (static_cast<uint32_t>(p[3]) << 24);
+}
+
+static uint64_t readU64(const uint8_t *p)
+{
+	uint64_t value = 0;
+	for (int i=7; i>=0; i--)
+		value = (value << 8) | p[i];
+	return value;
+}
+
+TEST(RF64, WriteLarge)
+{
+	SparseFile sparseFile;
+	memset(sparseFile.header, 0, sizeof (sparseFile.header));
+	sparseFile.length = 0;
+
+	const int channelCount = 2;
+	const int frameSize = channelCount * sizeof (int32_t);
+	const AFframecount frameCount = 0x20000001;
+	const int bufferFrameCount = 1 << 20;
+
+	AFfilesetup setup = afNewFileSetup();
+	afInitFileFormat(setup, AF_FILE_WAVE);
+	afInitChannels(setup, AF_DEFAULT_TRACK, channelCount);
+	afInitSampleFormat(setup, AF_DEFAULT_TRACK, AF_SAMPFMT_TWOSCOMP, 32);
+	AFfilehandle file = afOpenVirtualFile(createSparseFile(&sparseFile),
+		"w", setup);
+	afFreeFileSetup(setup);
+	ASSERT_TRUE(file);
+
+	std::vector<int32_t> buffer(bufferFrameCount * channelCount);
+	AFframecount framesWritten = 0;
+	while (framesWritten < frameCount)
+	{
+		int framesToWrite = std::min<AFframecount>(bufferFrameCount,
+			frameCount - framesWritten);
+		ASSERT_EQ(afWriteFrames(file, AF_DEFAULT_TRACK, &buffer[0],
+			framesToWrite), framesToWrite);
+		framesWritten += framesToWrite;
+	}
+	AFfileoffset dataOffset = afGetDataOffset(file, AF_DEFAULT_TRACK);
+	ASSERT_EQ(afCloseFile(file), 0);
+
+	const uint64_t dataSize = frameCount * frameSize;
+	ASSERT_EQ(sparseFile.length,
+		static_cast<AFfileoffset>(dataOffset + dataSize));
+
+	const uint8_t *header = sparseFile.header;
+	EXPECT_EQ(memcmp(header, "RF64", 4), 0);
+	EXPECT_EQ(memcmp(header + 4, "\xff\xff\xff\xff", 4), 0);
+	EXPECT_EQ(memcmp(header + 12, "ds64", 4), 0);
+	EXPECT_EQ(readU64(header + 20),
+		static_cast<uint64_t>(sparseFile.length - 8));
+	EXPECT_EQ(readU64(header + 28), dataSize);
+	EXPECT_EQ(readU64(header + 36), static_cast<uint64_t>(frameCount));
+	EXPECT_EQ(memcmp(header + dataOffset - 4, "\xff\xff\xff\xff", 4), 0);
+
+	file = afOpenVirtualFile(createSparseFile(&sparseFile), "r", NULL);
+	ASSERT_TRUE(file);
+	EXPECT_EQ(afGetFileFormat(file, NULL), AF_FILE_WAVE);
+	EXPECT_EQ(afGetDataOffset(file, AF_DEFAULT_TRACK), dataOffset);
+	EXPECT_EQ(afGetTrackBytes(file, AF_DEFAULT_TRACK),
+		static_cast<AFfileoffset>(dataSize));
+	EXPECT_EQ(afGetFrameCount(file, AF_DEFAULT_TRACK), frameCount);
+	ASSERT_EQ(afCloseFile(file), 0);
+}
+
+/*
+	A file without a reserved JUNK or ds64 chunk cannot become an
+	RF64 file, so appending past 4 GB must fail rather than write
+	truncated sizes.
+*/
+TEST(RF64, AppendPastLimitWithoutDataSize64)
+{
+	IgnoreErrors ignoreErrors;
+
+	std::string testFileName;
+	ASSERT_TRUE(createTemporaryFile("RF64", &testFileName));
+
+	const uint32_t dataSize = 0xffffff00;
+	const uint8_t header[] =
+	{
+		'R', 'I', 'F', 'F',
+		0x24, 0xff, 0xff, 0xff,
+		'W', 'A', 'V', 'E',
+		'f', 'm', 't', ' ',
+		16, 0, 0, 0,
+		1, 0, // PCM
+		1, 0, // 1 channel
+		0x44, 0xac, 0, 0, // 44100 Hz
+		0x88, 0x58, 0x01, 0, // 88200 bytes per second
+		2, 0, // block align
+		16, 0, // 16 bits per sample
+		'd', 'a', 't', 'a',
+		0x00, 0xff, 0xff, 0xff
+	};
+	writeBytes(testFileName, header, sizeof (header));
+	// Extend the file sparsely so that it uses no disk space.
+	ASSERT_EQ(::truncate(testFileName.c_str(), sizeof (header) + dataSize), 0);
+
+	AFfilehandle file = afOpenFile(testFileName.c_str(), "a", NULL);
+	ASSERT_TRUE(file);
+	EXPECT_EQ(afGetFrameCount(file, AF_DEFAULT_TRACK), dataSize / 2);
+	std::vector<int16_t> frames(128);
+	EXPECT_EQ(afWriteFrames(file, AF_DEFAULT_TRACK, &frames[0], 128), 128);
+	EXPECT_EQ(afSyncFile(file), -1);
+	EXPECT_EQ(afCloseFile(file), -1);
+
+	uint8_t written[sizeof (header)];
+	int fd = ::open(testFileName.c_str(), O_RDONLY);
+	ASSERT_GT(fd, -1);
+	ASSERT_EQ(::read(fd, written, sizeof (written)),
+		static_cast<ssize_t>(sizeof (written)));
+	::close(fd);
+	EXPECT_EQ(memcmp(written, "RIFF", 4), 0);
+	EXPECT_EQ(readU32(written + 4), dataSize + 36);
+	EXPECT_EQ(readU32(written + 40), dataSize);
+
+	ASSERT_EQ(::unlink(testFileName.c_str()), 0);
+}
+
+int main(int argc, char **argv)
+{
+	::testing::InitGoogleTest(&argc, argv);
+	return RUN_ALL_TESTS();
+}
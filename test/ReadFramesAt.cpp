@@ -0,0 +1,187 @@
+/*
+	Audio File Library
+
+	This program is free software; you can redistribute it and/or modify
+	it under the terms of the GNU General Public License as published by
+	the Free Software Foundation; either version 2 of the License, or
+	(at your option) any later version.
+
+	This program is distributed in the hope that it will be useful,
+	but WITHOUT ANY WARRANTY; without even the implied warranty of
+	MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+	GNU General Public License for more details.
+
+	You should have received a copy of the GNU General Public License along
+	with this program; if not, write to the Free Software Foundation, Inc.,
+	51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+*/
+
+#include <audiofile.h>
+#include <gtest/gtest.h>
+
+#include <algorithm>
+#include <pthread.h>
+#include <stdint.h>
+#include <stdlib.h>
+#include <unistd.h>
+#include <vector>
+
+#include "TestUtilities.h"
+
+static const int kChannelCount = 2;
+static const int kFrameCount = 30011;
+static const int kThreadCount = 4;
+
+static void writeTestFile(const std::string &path, int fileFormat,
+	int compression)
+{
+	std::vector<int16_t> data(kFrameCount * kChannelCount);
+	for (size_t i=0; i<data.size(); i++)
+		data[i] = static_cast<int16_t>((i * 7919) ^ (i >> 2));
+
+	AFfilesetup setup = afNewFileSetup();
+	afInitFileFormat(setup, fileFormat);
+	afInitChannels(setup, AF_DEFAULT_TRACK, kChannelCount);
+	afInitSampleFormat(setup, AF_DEFAULT_TRACK, AF_SAMPFMT_TWOSCOMP, 16);
+	afInitCompression(setup, AF_DEFAULT_TRACK, compression);
+	AFfilehandle file = afOpenFile(path.c_str(), "w", setup);
+	ASSERT_TRUE(file);
+	afFreeFileSetup(setup);
+	ASSERT_EQ(kFrameCount,
+		afWriteFrames(file, AF_DEFAULT_TRACK, &data[0], kFrameCount));
+	ASSERT_EQ(0, afCloseFile(file));
+}
+
+struct ReaderContext
+{
+	AFfilehandle file;
+	const std::vector<int16_t> *expected;
+	unsigned seed;
+	int failures;
+};
+
+static void *readRandomRanges(void *arg)
+{
+	ReaderContext *context = static_cast<ReaderContext *>(arg);
+	const std::vector<int16_t> &expected = *context->expected;
+	AFframecount frameCount = expected.size() / kChannelCount;
+	std::vector<int16_t> buffer;
+
+	for (int i=0; i<200; i++)
+	{
+		AFframecount start = rand_r(&context->seed) % frameCount;
+		int length = 1 + rand_r(&context->seed) % 3000;
+		buffer.resize(length * kChannelCount);
+
+		int framesRead = afReadFramesAt(context->file, AF_DEFAULT_TRACK,
+			start, &buffer[0], length);
+		int framesExpected = std::min<AFframecount>(length, frameCount - start);
+		if (framesRead != framesExpected)
+		{
+			context->failures++;
+			continue;
+		}
+		for (int j=0; j<framesRead * kChannelCount; j++)
+		{
+			if (buffer[j] != expected[start * kChannelCount + j])
+			{
+				context->failures++;
+				break;
+			}
+		}
+	}
+
+	return NULL;
+}
+
+static void testReadFramesAt(int fileFormat, int compression)
+{
+	std::string testFileName;
+	ASSERT_TRUE(createTemporaryFile("ReadFramesAt", &testFileName));
+	writeTestFile(testFileName, fileFormat, compression);
+
+	AFfilehandle file = afOpenFile(testFileName.c_str(), "r", AF_NULL_FILESETUP);
+	ASSERT_TRUE(file);
+	AFframecount frameCount = afGetFrameCount(file, AF_DEFAULT_TRACK);
+	ASSERT_EQ(kFrameCount, frameCount);
+	std::vector<int16_t> expected(frameCount * kChannelCount);
+	ASSERT_EQ(frameCount, afReadFrames(file, AF_DEFAULT_TRACK, &expected[0],
+		frameCount));
+
+	ASSERT_EQ(1000, afSeekFrame(file, AF_DEFAULT_TRACK, 1000));
+
+	pthread_t threads[kThreadCount];
+	ReaderContext contexts[kThreadCount];
+	for (int i=0; i<kThreadCount; i++)
+	{
+		contexts[i].file = file;
+		contexts[i].expected = &expected;
+		contexts[i].seed = i + 1;
+		contexts[i].failures = 0;
+		ASSERT_EQ(0, pthread_create(&threads[i], NULL, readRandomRanges,
+			&contexts[i]));
+	}
+	for (int i=0; i<kThreadCount; i++)
+	{
+		pthread_join(threads[i], NULL);
+		EXPECT_EQ(0, contexts[i].failures);
+	}
+
+	// The file handle's own position is unaffected.
+	EXPECT_EQ(1000, afTellFrame(file, AF_DEFAULT_TRACK));
+	int16_t frame[kChannelCount];
+	ASSERT_EQ(1, afReadFrames(file, AF_DEFAULT_TRACK, frame, 1));
+	for (int c=0; c<kChannelCount; c++)
+		EXPECT_EQ(expected[1000 * kChannelCount + c], frame[c]);
+
+	// Reading at or past the end returns no frames.
+	EXPECT_EQ(0, afReadFramesAt(file, AF_DEFAULT_TRACK, frameCount, frame, 1));
+
+	// Changing the virtual format is reflected in later reads.
+	ASSERT_EQ(0, afSetVirtualChannels(file, AF_DEFAULT_TRACK, 1));
+	int16_t mono[2];
+	ASSERT_EQ(1, afReadFramesAt(file, AF_DEFAULT_TRACK, 10, &mono[0], 1));
+	ASSERT_EQ(10, afSeekFrame(file, AF_DEFAULT_TRACK, 10));
+	ASSERT_EQ(1, afReadFrames(file, AF_DEFAULT_TRACK, &mono[1], 1));
+	EXPECT_EQ(mono[1], mono[0]);
+
+	ASSERT_EQ(0, afCloseFile(file));
+	ASSERT_EQ(0, ::unlink(testFileName.c_str()));
+}
+
+TEST(ReadFramesAt, PCM)
+{
+	testReadFramesAt(AF_FILE_WAVE, AF_COMPRESSION_NONE);
+}
+
+TEST(ReadFramesAt, IMA)
+{
+	testReadFramesAt(AF_FILE_WAVE, AF_COMPRESSION_IMA);
+}
+
+TEST(ReadFramesAt, ALAC)
+{
+	testReadFramesAt(AF_FILE_CAF, AF_COMPRESSION_ALAC);
+}
+
+TEST(ReadFramesAt, InvalidFrame)
+{
+	IgnoreErrors ignoreErrors;
+
+	std::string testFileName;
+	ASSERT_TRUE(createTemporaryFile("ReadFramesAt", &testFileName));
+	writeTestFile(testFileName, AF_FILE_WAVE, AF_COMPRESSION_NONE);
+
+	AFfilehandle file = afOpenFile(testFileName.c_str(), "r", AF_NULL_FILESETUP);
+	ASSERT_TRUE(file);
+	int16_t frame[kChannelCount];
+	EXPECT_EQ(-1, afReadFramesAt(file, AF_DEFAULT_TRACK, -1, frame, 1));
+	ASSERT_EQ(0, afCloseFile(file));
+	ASSERT_EQ(0, ::unlink(testFileName.c_str()));
+}
+
+int main(int argc, char **argv)
+{
+	::testing::InitGoogleTest(&argc, argv);
+	return RUN_ALL_TESTS();
+}
@@ -0,0 +1,351 @@
+/*
+	Audio File Library
+
+	This program is free software; you can redistribute it and/or modify
+	it under the terms of the GNU General Public License as published by
+	the Free Software Foundation; either version 2 of the License, or
+	(at your option) any later version.
+
+	This program is distributed in the hope that it will be useful,
+	but WITHOUT ANY WARRANTY; without even the implied warranty of
+	MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+	GNU General Public License for more details.
+
+	You should have received a copy of the GNU General Public License along
+	with this program; if not, write to the Free Software Foundation, Inc.,
+	51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+*/
+
+/*
+	This program tests copying the stored audio data of a track into
+	a file of another format with afRemuxTrack.
+*/
+
+#include <algorithm>
+#include <audiofile.h>
+#include <fcntl.h>
+#include <gtest/gtest.h>
+#include <stdint.h>
+#include <unistd.h>
+#include <string>
+#include <vector>
+
+#include "TestUtilities.h"
+
+static const int kChannelCount = 2;
+static const int kFrameCount = 100000;
+
+static void generateFrames(std::vector<int32_t> &data, int frameCount)
+{
+	data.resize(frameCount * kChannelCount);
+	for (size_t i=0; i<data.size(); i++)
+		data[i] = static_cast<int32_t>(((i / kChannelCount) * 4099) % 65521 -
+			32760 + (i % kChannelCount) * 7) * 256;
+}
+
+static AFfilesetup createSetup(int fileFormat, int sampleWidth, int byteOrder)
+{
+	AFfilesetup setup = afNewFileSetup();
+	afInitFileFormat(setup, fileFormat);
+	afInitChannels(setup, AF_DEFAULT_TRACK, kChannelCount);
+	afInitSampleFormat(setup, AF_DEFAULT_TRACK, AF_SAMPFMT_TWOSCOMP,
+		sampleWidth);
+	if (byteOrder != -1)
+		afInitByteOrder(setup, AF_DEFAULT_TRACK, byteOrder);
+	return setup;
+}
+
+static AFfilehandle openOutput(const std::string &path, int fileFormat,
+	int sampleWidth, int byteOrder)
+{
+	AFfilesetup setup = createSetup(fileFormat, sampleWidth, byteOrder);
+	AFfilehandle file = afOpenFile(path.c_str(), "w", setup);
+	afFreeFileSetup(setup);
+	if (file)
+		afSetVirtualSampleFormat(file, AF_DEFAULT_TRACK, AF_SAMPFMT_TWOSCOMP, 32);
+	return file;
+}
+
+static AFfilehandle openMSADPCMOutput(const std::string &path)
+{
+	AFfilesetup setup = createSetup(AF_FILE_WAVE, 16, -1);
+	afInitCompression(setup, AF_DEFAULT_TRACK, AF_COMPRESSION_MS_ADPCM);
+	AFfilehandle file = afOpenFile(path.c_str(), "w", setup);
+	afFreeFileSetup(setup);
+	if (file)
+		afSetVirtualSampleFormat(file, AF_DEFAULT_TRACK, AF_SAMPFMT_TWOSCOMP, 32);
+	return file;
+}
+
+static void writeFile(const std::string &path, int fileFormat,
+	int sampleWidth, const std::vector<int32_t> &frames)
+{
+	AFfilehandle file = openOutput(path, fileFormat, sampleWidth, -1);
+	ASSERT_TRUE(file);
+	ASSERT_EQ(afWriteFrames(file, AF_DEFAULT_TRACK, &frames[0], kFrameCount),
+		kFrameCount);
+	ASSERT_EQ(afCloseFile(file), 0);
+}
+
+static AFfilehandle openInput(const std::string &path)
+{
+	AFfilehandle file = afOpenFile(path.c_str(), "r", AF_NULL_FILESETUP);
+	if (file)
+		afSetVirtualSampleFormat(file, AF_DEFAULT_TRACK, AF_SAMPFMT_TWOSCOMP, 32);
+	return file;
+}
+
+static void readFile(const std::string &path, std::vector<int32_t> &data)
+{
+	AFfilehandle file = openInput(path);
+	ASSERT_TRUE(file);
+	AFframecount frameCount = afGetFrameCount(file, AF_DEFAULT_TRACK);
+	data.resize(frameCount * kChannelCount);
+	if (frameCount)
+		ASSERT_EQ(afReadFrames(file, AF_DEFAULT_TRACK, &data[0], frameCount),
+			frameCount);
+	ASSERT_EQ(afCloseFile(file), 0);
+}
+
+static void testRemux(int inputFormat, int outputFormat, int sampleWidth,
+	int byteOrder)
+{
+	std::string inputPath, outputPath;
+	ASSERT_TRUE(createTemporaryFile("Remux", &inputPath));
+	ASSERT_TRUE(createTemporaryFile("Remux", &outputPath));
+
+	std::vector<int32_t> frames;
+	generateFrames(frames, kFrameCount);
+	writeFile(inputPath, inputFormat, sampleWidth, frames);
+
+	AFfilehandle inFile = openInput(inputPath);
+	ASSERT_TRUE(inFile);
+	AFfilehandle outFile = openOutput(outputPath, outputFormat, sampleWidth,
+		byteOrder);
+	ASSERT_TRUE(outFile);
+	ASSERT_EQ(afRemuxTrack(inFile, outFile, AF_DEFAULT_TRACK), kFrameCount);
+	EXPECT_EQ(afGetTrackBytes(outFile, AF_DEFAULT_TRACK),
+		afGetTrackBytes(inFile, AF_DEFAULT_TRACK));
+	ASSERT_EQ(afCloseFile(outFile), 0);
+	ASSERT_EQ(afCloseFile(inFile), 0);
+
+	std::vector<int32_t> inputData, outputData;
+	readFile(inputPath, inputData);
+	readFile(outputPath, outputData);
+	EXPECT_EQ(inputData.size(), frames.size());
+	EXPECT_TRUE(inputData == outputData);
+
+	ASSERT_EQ(::unlink(inputPath.c_str()), 0);
+	ASSERT_EQ(::unlink(outputPath.c_str()), 0);
+}
+
+TEST(Remux, WAVE_To_CAF)
+{
+	testRemux(AF_FILE_WAVE, AF_FILE_CAF, 16, AF_BYTEORDER_LITTLEENDIAN);
+}
+
+TEST(Remux, AIFF_To_AIFFC)
+{
+	testRemux(AF_FILE_AIFF, AF_FILE_AIFFC, 24, -1);
+}
+
+TEST(Remux, NeXT_To_AIFF)
+{
+	testRemux(AF_FILE_NEXTSND, AF_FILE_AIFF, 16, -1);
+}
+
+TEST(Remux, AIFF_8Bit_To_CAF)
+{
+	std::string inputPath, outputPath;
+	ASSERT_TRUE(createTemporaryFile("Remux", &inputPath));
+	ASSERT_TRUE(createTemporaryFile("Remux", &outputPath));
+
+	AFfilesetup setup = createSetup(AF_FILE_AIFF, 8, -1);
+	AFfilehandle file = afOpenFile(inputPath.c_str(), "w", setup);
+	afFreeFileSetup(setup);
+	ASSERT_TRUE(file);
+	std::vector<int8_t> frames(kFrameCount * kChannelCount);
+	for (size_t i=0; i<frames.size(); i++)
+		frames[i] = i * 7;
+	ASSERT_EQ(afWriteFrames(file, AF_DEFAULT_TRACK, &frames[0], kFrameCount),
+		kFrameCount);
+	ASSERT_EQ(afCloseFile(file), 0);
+
+	// The data of 8-bit samples does not depend on byte order.
+	AFfilehandle inFile = afOpenFile(inputPath.c_str(), "r", AF_NULL_FILESETUP);
+	ASSERT_TRUE(inFile);
+	setup = createSetup(AF_FILE_CAF, 8, AF_BYTEORDER_LITTLEENDIAN);
+	AFfilehandle outFile = afOpenFile(outputPath.c_str(), "w", setup);
+	afFreeFileSetup(setup);
+	ASSERT_TRUE(outFile);
+	ASSERT_EQ(afRemuxTrack(inFile, outFile, AF_DEFAULT_TRACK), kFrameCount);
+	ASSERT_EQ(afCloseFile(outFile), 0);
+	ASSERT_EQ(afCloseFile(inFile), 0);
+
+	outFile = afOpenFile(outputPath.c_str(), "r", AF_NULL_FILESETUP);
+	ASSERT_TRUE(outFile);
+	std::vector<int8_t> data(kFrameCount * kChannelCount);
+	ASSERT_EQ(afReadFrames(outFile, AF_DEFAULT_TRACK, &data[0], kFrameCount),
+		kFrameCount);
+	EXPECT_TRUE(data == frames);
+	ASSERT_EQ(afCloseFile(outFile), 0);
+
+	ASSERT_EQ(::unlink(inputPath.c_str()), 0);
+	ASSERT_EQ(::unlink(outputPath.c_str()), 0);
+}
+
+/*
+	Remuxing continues from the input file's position and follows
+	the frames already written to the output file.
+*/
+TEST(Remux, AfterFrames)
+{
+	std::string inputPath, outputPath;
+	ASSERT_TRUE(createTemporaryFile("Remux", &inputPath));
+	ASSERT_TRUE(createTemporaryFile("Remux", &outputPath));
+
+	std::vector<int32_t> frames;
+	generateFrames(frames, kFrameCount);
+	writeFile(inputPath, AF_FILE_WAVE, 16, frames);
+
+	const int kFramesToCopy = 1234;
+	const int kFramesToSkip = 4321;
+	std::vector<int32_t> buffer(kFramesToSkip * kChannelCount);
+
+	AFfilehandle inFile = openInput(inputPath);
+	ASSERT_TRUE(inFile);
+	AFfilehandle outFile = openOutput(outputPath, AF_FILE_CAF, 16,
+		AF_BYTEORDER_LITTLEENDIAN);
+	ASSERT_TRUE(outFile);
+	ASSERT_EQ(afReadFrames(inFile, AF_DEFAULT_TRACK, &buffer[0],
+		kFramesToCopy), kFramesToCopy);
+	ASSERT_EQ(afWriteFrames(outFile, AF_DEFAULT_TRACK, &buffer[0],
+		kFramesToCopy), kFramesToCopy);
+	ASSERT_EQ(afReadFrames(inFile, AF_DEFAULT_TRACK, &buffer[0],
+		kFramesToSkip), kFramesToSkip);
+	ASSERT_EQ(afRemuxTrack(inFile, outFile, AF_DEFAULT_TRACK),
+		kFrameCount - kFramesToCopy - kFramesToSkip);
+	EXPECT_EQ(afTellFrame(inFile, AF_DEFAULT_TRACK), kFrameCount);
+	ASSERT_EQ(afCloseFile(outFile), 0);
+	ASSERT_EQ(afCloseFile(inFile), 0);
+
+	std::vector<int32_t> inputData, data;
+	readFile(inputPath, inputData);
+	readFile(outputPath, data);
+	ASSERT_EQ(data.size(), (kFrameCount - kFramesToSkip) * kChannelCount);
+	EXPECT_TRUE(std::equal(data.begin(),
+		data.begin() + kFramesToCopy * kChannelCount,
+		inputData.begin()));
+	EXPECT_TRUE(std::equal(data.begin() + kFramesToCopy * kChannelCount,
+		data.end(),
+		inputData.begin() + (kFramesToCopy + kFramesToSkip) * kChannelCount));
+
+	ASSERT_EQ(::unlink(inputPath.c_str()), 0);
+	ASSERT_EQ(::unlink(outputPath.c_str()), 0);
+}
+
+TEST(Remux, DifferentData)
+{
+	IgnoreErrors ignoreErrors;
+
+	std::string inputPath, outputPath;
+	ASSERT_TRUE(createTemporaryFile("Remux", &inputPath));
+	ASSERT_TRUE(createTemporaryFile("Remux", &outputPath));
+
+	std::vector<int32_t> frames;
+	generateFrames(frames, kFrameCount);
+	writeFile(inputPath, AF_FILE_WAVE, 16, frames);
+
+	AFfilehandle inFile = openInput(inputPath);
+	ASSERT_TRUE(inFile);
+
+	// The byte order differs.
+	AFfilehandle outFile = openOutput(outputPath, AF_FILE_AIFF, 16, -1);
+	ASSERT_TRUE(outFile);
+	EXPECT_EQ(afRemuxTrack(inFile, outFile, AF_DEFAULT_TRACK), -1);
+	ASSERT_EQ(afCloseFile(outFile), 0);
+
+	// The sample width differs.
+	outFile = openOutput(outputPath, AF_FILE_WAVE, 24, -1);
+	ASSERT_TRUE(outFile);
+	EXPECT_EQ(afRemuxTrack(inFile, outFile, AF_DEFAULT_TRACK), -1);
+	ASSERT_EQ(afCloseFile(outFile), 0);
+
+	// The input file is not open for writing.
+	EXPECT_EQ(afRemuxTrack(inFile, inFile, AF_DEFAULT_TRACK), -1);
+
+	ASSERT_EQ(afCloseFile(inFile), 0);
+
+	ASSERT_EQ(::unlink(inputPath.c_str()), 0);
+	ASSERT_EQ(::unlink(outputPath.c_str()), 0);
+}
+
+static void writeMSADPCMFile(const std::string &path,
+	const std::vector<int32_t> &frames)
+{
+	AFfilehandle file = openMSADPCMOutput(path);
+	ASSERT_TRUE(file);
+	ASSERT_EQ(afWriteFrames(file, AF_DEFAULT_TRACK, &frames[0], kFrameCount),
+		kFrameCount);
+	ASSERT_EQ(afCloseFile(file), 0);
+}
+
+/*
+	Change the first coefficient of an MS ADPCM file, which remains
+	valid but is no longer encoded like files written by the library.
+*/
+static void changeCoefficient(const std::string &path)
+{
+	int fd = ::open(path.c_str(), O_RDWR);
+	ASSERT_GT(fd, -1);
+	uint8_t header[256];
+	ASSERT_EQ(::read(fd, header, sizeof (header)),
+		static_cast<ssize_t>(sizeof (header)));
+	uint8_t *fmt = std::search(header, header + sizeof (header),
+		"fmt ", "fmt " + 4);
+	ASSERT_NE(fmt, header + sizeof (header));
+	// The coefficients follow 22 bytes into the format chunk's data.
+	const uint8_t coefficient[2] = { 0xff, 0x00 };
+	ASSERT_EQ(::pwrite(fd, coefficient, 2, fmt - header + 8 + 22), 2);
+	::close(fd);
+}
+
+TEST(Remux, DifferentCodecParameters)
+{
+	IgnoreErrors ignoreErrors;
+
+	std::string inputPath, outputPath;
+	ASSERT_TRUE(createTemporaryFile("Remux", &inputPath));
+	ASSERT_TRUE(createTemporaryFile("Remux", &outputPath));
+
+	std::vector<int32_t> frames;
+	generateFrames(frames, kFrameCount);
+	writeMSADPCMFile(inputPath, frames);
+
+	AFfilehandle inFile = openInput(inputPath);
+	ASSERT_TRUE(inFile);
+	AFfilehandle outFile = openMSADPCMOutput(outputPath);
+	ASSERT_TRUE(outFile);
+	EXPECT_EQ(afRemuxTrack(inFile, outFile, AF_DEFAULT_TRACK), kFrameCount);
+	ASSERT_EQ(afCloseFile(outFile), 0);
+	ASSERT_EQ(afCloseFile(inFile), 0);
+
+	// The coefficients differ.
+	changeCoefficient(inputPath);
+	inFile = openInput(inputPath);
+	ASSERT_TRUE(inFile);
+	outFile = openMSADPCMOutput(outputPath);
+	ASSERT_TRUE(outFile);
+	EXPECT_EQ(afRemuxTrack(inFile, outFile, AF_DEFAULT_TRACK), -1);
+	ASSERT_EQ(afCloseFile(outFile), 0);
+	ASSERT_EQ(afCloseFile(inFile), 0);
+
+	ASSERT_EQ(::unlink(inputPath.c_str()), 0);
+	ASSERT_EQ(::unlink(outputPath.c_str()), 0);
+}
+
+int main(int argc, char **argv)
+{
+	::testing::InitGoogleTest(&argc, argv);
+	return RUN_ALL_TESTS();
+}
@@ -0,0 +1,246 @@
+/*
+	Audio File Library
+
+	This program is free software; you can redistribute it and/or modify
+	it under the terms of the GNU General Public License as published by
+	the Free Software Foundation; either version 2 of the License, or
+	(at your option) any later version.
+
+	This program is distributed in the hope that it will be useful,
+	but WITHOUT ANY WARRANTY; without even the implied warranty of
+	MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+	GNU General Public License for more details.
+
+	You should have received a copy of the GNU General Public License along
+	with this program; if not, write to the Free Software Foundation, Inc.,
+	51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+*/
+
+/*
+	This program tests that compressed files opened with a seek index
+	are read correctly after seeking, and that the seek index is saved
+	to and loaded from its file.
+*/
+
+#include <algorithm>
+#include <audiofile.h>
+#include <gtest/gtest.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#include <string>
+#include <vector>
+
+#include "TestUtilities.h"
+
+static const int kChannelCount = 2;
+static const int kFrameCount = 200000;
+static const int kReadFrames = 1000;
+
+static void generateFrames(std::vector<int16_t> &data, int seed)
+{
+	data.resize(kFrameCount * kChannelCount);
+	uint32_t state = seed;
+	for (int i=0; i<kFrameCount; i++)
+	{
+		// Noise of varying amplitude makes packets of varying size.
+		state = state * 1103515245 + 12345;
+		int amplitude = 1 << ((i / 5000) % 14);
+		int noise = static_cast<int>((state >> 16) % (2 * amplitude)) - amplitude;
+		data[kChannelCount*i] = noise;
+		data[kChannelCount*i + 1] = (i * 37) % 2000 - 1000 + noise / 2;
+	}
+}
+
+static bool isImplemented(int compression)
+{
+	return afQueryLong(AF_QUERYTYPE_COMPRESSION, AF_QUERY_IMPLEMENTED,
+		compression, 0, 0);
+}
+
+static void writeFile(const std::string &path, int fileFormat,
+	int compression, const std::vector<int16_t> &data)
+{
+	AFfilesetup setup = afNewFileSetup();
+	afInitFileFormat(setup, fileFormat);
+	afInitChannels(setup, AF_DEFAULT_TRACK, kChannelCount);
+	afInitSampleFormat(setup, AF_DEFAULT_TRACK, AF_SAMPFMT_TWOSCOMP, 16);
+	afInitCompression(setup, AF_DEFAULT_TRACK, compression);
+	AFfilehandle file = afOpenFile(path.c_str(), "w", setup);
+	afFreeFileSetup(setup);
+	ASSERT_TRUE(file);
+	ASSERT_EQ(afWriteFrames(file, AF_DEFAULT_TRACK, &data[0], kFrameCount),
+		kFrameCount);
+	ASSERT_EQ(afCloseFile(file), 0);
+}
+
+static AFfilehandle openWithIndex(const std::string &path,
+	const char *indexPath)
+{
+	AFfilesetup setup = afNewFileSetup();
+	afInitSeekIndex(setup, true, indexPath, 0);
+	AFfilehandle file = afOpenFile(path.c_str(), "r", setup);
+	afFreeFileSetup(setup);
+	return file;
+}
+
+static void readAll(AFfilehandle file, const std::vector<int16_t> &data)
+{
+	std::vector<int16_t> buffer(kFrameCount * kChannelCount);
+	ASSERT_EQ(afReadFrames(file, AF_DEFAULT_TRACK, &buffer[0], kFrameCount),
+		kFrameCount);
+	EXPECT_TRUE(buffer == data);
+}
+
+static void readAt(AFfilehandle file, const std::vector<int16_t> &data,
+	AFframecount frame)
+{
+	ASSERT_EQ(afSeekFrame(file, AF_DEFAULT_TRACK, frame), frame);
+	int frameCount = std::min<AFframecount>(kReadFrames, kFrameCount - frame);
+	int16_t buffer[kReadFrames * kChannelCount];
+	ASSERT_EQ(afReadFrames(file, AF_DEFAULT_TRACK, buffer, frameCount),
+		frameCount);
+	for (int i=0; i<frameCount * kChannelCount; i++)
+		ASSERT_EQ(buffer[i], data[frame * kChannelCount + i]) <<
+			"frame " << frame << ", sample " << i;
+}
+
+static void readAtFrames(AFfilehandle file, const std::vector<int16_t> &data)
+{
+	static const AFframecount frames[] =
+	{
+		150001, 4095, 4096, 70000, 0, 32768 * 3, 199999, 100000, 1
+	};
+	for (size_t i=0; i<sizeof (frames) / sizeof (frames[0]); i++)
+		readAt(file, data, frames[i]);
+}
+
+static ino_t fileID(const std::string &path)
+{
+	struct stat st;
+	if (::stat(path.c_str(), &st) != 0)
+		return 0;
+	return st.st_ino;
+}
+
+static void testSaved(int fileFormat, int compression)
+{
+	std::string path, indexPath;
+	ASSERT_TRUE(createTemporaryFile("SeekIndex", &path));
+	ASSERT_TRUE(createTemporaryFile("SeekIndex", &indexPath));
+	ASSERT_EQ(::unlink(indexPath.c_str()), 0);
+
+	std::vector<int16_t> data;
+	generateFrames(data, 1);
+	writeFile(path, fileFormat, compression, data);
+
+	// Reading the file in order records the seek index.
+	AFfilehandle file = openWithIndex(path, indexPath.c_str());
+	ASSERT_TRUE(file);
+	readAll(file, data);
+	ASSERT_EQ(afCloseFile(file), 0);
+	ino_t indexID = fileID(indexPath);
+	ASSERT_NE(indexID, 0u);
+
+	// The saved seek index is used and, being complete, not replaced.
+	file = openWithIndex(path, indexPath.c_str());
+	ASSERT_TRUE(file);
+	readAtFrames(file, data);
+	ASSERT_EQ(afCloseFile(file), 0);
+	EXPECT_EQ(fileID(indexPath), indexID);
+
+	// A seek index saved from other audio data is not used.
+	generateFrames(data, 2);
+	writeFile(path, fileFormat, compression, data);
+	file = openWithIndex(path, indexPath.c_str());
+	ASSERT_TRUE(file);
+	readAtFrames(file, data);
+	ASSERT_EQ(afSeekFrame(file, AF_DEFAULT_TRACK, 0), 0);
+	readAll(file, data);
+	ASSERT_EQ(afCloseFile(file), 0);
+	EXPECT_NE(fileID(indexPath), indexID);
+
+	file = openWithIndex(path, indexPath.c_str());
+	ASSERT_TRUE(file);
+	readAtFrames(file, data);
+	ASSERT_EQ(afCloseFile(file), 0);
+
+	ASSERT_EQ(::unlink(path.c_str()), 0);
+	ASSERT_EQ(::unlink(indexPath.c_str()), 0);
+}
+
+static void testInMemory(int fileFormat, int compression)
+{
+	std::string path;
+	ASSERT_TRUE(createTemporaryFile("SeekIndex", &path));
+	std::vector<int16_t> data;
+	generateFrames(data, 1);
+	writeFile(path, fileFormat, compression, data);
+
+	AFfilehandle file = openWithIndex(path, NULL);
+	ASSERT_TRUE(file);
+	readAtFrames(file, data);
+	ASSERT_EQ(afSeekFrame(file, AF_DEFAULT_TRACK, 0), 0);
+	readAll(file, data);
+	readAtFrames(file, data);
+	ASSERT_EQ(afCloseFile(file), 0);
+
+	ASSERT_EQ(::unlink(path.c_str()), 0);
+}
+
+TEST(SeekIndex, ALAC_Saved)
+{
+	testSaved(AF_FILE_CAF, AF_COMPRESSION_ALAC);
+}
+
+TEST(SeekIndex, ALAC_InMemory)
+{
+	testInMemory(AF_FILE_CAF, AF_COMPRESSION_ALAC);
+}
+
+TEST(SeekIndex, FLAC_Saved)
+{
+	if (!isImplemented(AF_COMPRESSION_FLAC))
+		return;
+	testSaved(AF_FILE_FLAC, AF_COMPRESSION_FLAC);
+}
+
+TEST(SeekIndex, FLAC_InMemory)
+{
+	if (!isImplemented(AF_COMPRESSION_FLAC))
+		return;
+	testInMemory(AF_FILE_FLAC, AF_COMPRESSION_FLAC);
+}
+
+TEST(SeekIndex, InvalidFile)
+{
+	std::string path, indexPath;
+	ASSERT_TRUE(createTemporaryFile("SeekIndex", &path));
+	ASSERT_TRUE(createTemporaryFile("SeekIndex", &indexPath));
+	std::vector<int16_t> data;
+	generateFrames(data, 1);
+	writeFile(path, AF_FILE_CAF, AF_COMPRESSION_ALAC, data);
+
+	FILE *f = fopen(indexPath.c_str(), "w");
+	ASSERT_TRUE(f);
+	for (int i=0; i<1000; i++)
+		fputc(i * 7, f);
+	ASSERT_EQ(fclose(f), 0);
+
+	AFfilehandle file = openWithIndex(path, indexPath.c_str());
+	ASSERT_TRUE(file);
+	readAtFrames(file, data);
+	ASSERT_EQ(afSeekFrame(file, AF_DEFAULT_TRACK, 0), 0);
+	readAll(file, data);
+	ASSERT_EQ(afCloseFile(file), 0);
+
+	ASSERT_EQ(::unlink(path.c_str()), 0);
+	ASSERT_EQ(::unlink(indexPath.c_str()), 0);
+}
+
+int main(int argc, char **argv)
+{
+	::testing::InitGoogleTest(&argc, argv);
+	return RUN_ALL_TESTS();
+}
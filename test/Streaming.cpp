@@ -0,0 +1,169 @@
+/*
+	Audio File Library
+
+	This program is free software; you can redistribute it and/or modify
+	it under the terms of the GNU General Public License as published by
+	the Free Software Foundation; either version 2 of the License, or
+	(at your option) any later version.
+
+	This program is distributed in the hope that it will be useful,
+	but WITHOUT ANY WARRANTY; without even the implied warranty of
+	MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+	GNU General Public License for more details.
+
+	You should have received a copy of the GNU General Public License along
+	with this program; if not, write to the Free Software Foundation, Inc.,
+	51 Franklin Street, Fifth Floor, Boston, MA  02110-1301  USA
+*/
+
+#include <audiofile.h>
+#include <gtest/gtest.h>
+
+#include <algorithm>
+#include <fcntl.h>
+#include <stdint.h>
+#include <unistd.h>
+#include <vector>
+
+#include "TestUtilities.h"
+
+static const int kChannelCount = 2;
+static const int kFrameCount = 1009;
+
+static std::vector<int16_t> makeTestData()
+{
+	std::vector<int16_t> data(kFrameCount * kChannelCount);
+	for (size_t i=0; i<data.size(); i++)
+		data[i] = static_cast<int16_t>(i * 61 - 20000);
+	return data;
+}
+
+static AFfilesetup createSetup(int fileFormat, int compression, bool streaming)
+{
+	AFfilesetup setup = afNewFileSetup();
+	afInitFileFormat(setup, fileFormat);
+	afInitChannels(setup, AF_DEFAULT_TRACK, kChannelCount);
+	afInitSampleFormat(setup, AF_DEFAULT_TRACK, AF_SAMPFMT_TWOSCOMP, 16);
+	afInitCompression(setup, AF_DEFAULT_TRACK, compression);
+	afInitStreaming(setup, streaming);
+	return setup;
+}
+
+// Write the frames in several pieces as a live encoder would.
+static void writeFrames(AFfilehandle file, const std::vector<int16_t> &data)
+{
+	for (int frame=0; frame<kFrameCount; frame+=100)
+	{
+		int count = std::min(100, kFrameCount - frame);
+		ASSERT_EQ(count, afWriteFrames(file, AF_DEFAULT_TRACK,
+			&data[frame * kChannelCount], count));
+	}
+}
+
+static void readAndCompare(AFfilehandle file, const std::vector<int16_t> &data)
+{
+	std::vector<int16_t> readData(data.size() + 100 * kChannelCount);
+	ASSERT_EQ(kFrameCount, afReadFrames(file, AF_DEFAULT_TRACK,
+		&readData[0], kFrameCount + 100));
+	readData.resize(data.size());
+	EXPECT_TRUE(readData == data) << "Data read does not match data written";
+}
+
+static void testStreamingToFile(int fileFormat)
+{
+	std::vector<int16_t> data = makeTestData();
+
+	std::string testFileName;
+	ASSERT_TRUE(createTemporaryFile("Streaming", &testFileName));
+
+	AFfilesetup setup = createSetup(fileFormat, AF_COMPRESSION_NONE, true);
+	AFfilehandle file = afOpenFile(testFileName.c_str(), "w", setup);
+	afFreeFileSetup(setup);
+	ASSERT_TRUE(file);
+
+	// The header is complete as soon as the file is opened.
+	ASSERT_EQ(0, afSyncFile(file));
+	AFfileoffset dataOffset = afGetDataOffset(file, AF_DEFAULT_TRACK);
+	EXPECT_GT(dataOffset, 0);
+	writeFrames(file, data);
+	ASSERT_EQ(0, afCloseFile(file));
+
+	EXPECT_EQ(dataOffset + kFrameCount * kChannelCount * 2,
+		fileSize(testFileName));
+
+	file = afOpenFile(testFileName.c_str(), "r", AF_NULL_FILESETUP);
+	ASSERT_TRUE(file);
+	EXPECT_EQ(fileFormat, afGetFileFormat(file, NULL));
+	EXPECT_EQ(dataOffset, afGetDataOffset(file, AF_DEFAULT_TRACK));
+	EXPECT_EQ(kFrameCount, afGetFrameCount(file, AF_DEFAULT_TRACK));
+	readAndCompare(file, data);
+	ASSERT_EQ(0, afCloseFile(file));
+
+	ASSERT_EQ(0, ::unlink(testFileName.c_str()));
+}
+
+TEST(Streaming, WAVE) { testStreamingToFile(AF_FILE_WAVE); }
+TEST(Streaming, AIFF) { testStreamingToFile(AF_FILE_AIFF); }
+TEST(Streaming, AIFFC) { testStreamingToFile(AF_FILE_AIFFC); }
+TEST(Streaming, NeXT) { testStreamingToFile(AF_FILE_NEXTSND); }
+TEST(Streaming, CAF) { testStreamingToFile(AF_FILE_CAF); }
+TEST(Streaming, IRCAM) { testStreamingToFile(AF_FILE_IRCAM); }
+
+static void testStreamingThroughPipe(int fileFormat)
+{
+	std::vector<int16_t> data = makeTestData();
+
+	int pipefd[2];
+	ASSERT_EQ(0, ::pipe(pipefd));
+
+	// A pipe is written in streaming mode without asking for it.
+	AFfilesetup setup = createSetup(fileFormat, AF_COMPRESSION_NONE, false);
+	AFfilehandle file = afOpenFD(pipefd[1], "w", setup);
+	afFreeFileSetup(setup);
+	ASSERT_TRUE(file);
+	writeFrames(file, data);
+	ASSERT_EQ(0, afCloseFile(file));
+
+	file = afOpenFD(pipefd[0], "r", AF_NULL_FILESETUP);
+	ASSERT_TRUE(file);
+	EXPECT_EQ(fileFormat, afGetFileFormat(file, NULL));
+	EXPECT_EQ(-1, afGetFrameCount(file, AF_DEFAULT_TRACK));
+	readAndCompare(file, data);
+	ASSERT_EQ(0, afCloseFile(file));
+}
+
+TEST(Streaming, WAVEPipe) { testStreamingThroughPipe(AF_FILE_WAVE); }
+TEST(Streaming, AIFFPipe) { testStreamingThroughPipe(AF_FILE_AIFF); }
+TEST(Streaming, AIFFCPipe) { testStreamingThroughPipe(AF_FILE_AIFFC); }
+TEST(Streaming, NeXTPipe) { testStreamingThroughPipe(AF_FILE_NEXTSND); }
+TEST(Streaming, CAFPipe) { testStreamingThroughPipe(AF_FILE_CAF); }
+
+static void testStreamingUnsupported(int fileFormat, int compression)
+{
+	IgnoreErrors ignoreErrors;
+
+	std::string testFileName;
+	ASSERT_TRUE(createTemporaryFile("Streaming", &testFileName));
+
+	AFfilesetup setup = createSetup(fileFormat, compression, true);
+	AFfilehandle file = afOpenFile(testFileName.c_str(), "w", setup);
+	afFreeFileSetup(setup);
+	EXPECT_FALSE(file);
+	if (file)
+		afCloseFile(file);
+
+	::unlink(testFileName.c_str());
+}
+
+TEST(Streaming, Unsupported)
+{
+	testStreamingUnsupported(AF_FILE_NIST_SPHERE, AF_COMPRESSION_NONE);
+	testStreamingUnsupported(AF_FILE_AVR, AF_COMPRESSION_NONE);
+	testStreamingUnsupported(AF_FILE_CAF, AF_COMPRESSION_ALAC);
+}
+
+int main(int argc, char **argv)
+{
+	::testing::InitGoogleTest(&argc, argv);
+	return RUN_ALL_TESTS();
+}
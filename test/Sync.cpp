@@ -0,0 +1,327 @@
+/*
+	Audio File Library
+
+	This program is free software; you can redistribute it and/or modify
+	it under the terms of the GNU General Public License as published by
+	the Free Software Foundation; either version 2 of the License, or
+	(at your option) any later version.
+
+	This program is distributed in the hope that it will be useful,
+	but WITHOUT ANY WARRANTY; without even the implied warranty of
+	MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+	GNU General Public License for more details.
+
+	You should have received a copy of the GNU General Public License along
+	with this program; if not, write to the Free Software Foundation, Inc.,
+	51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+*/
+
+/*
+	This program tests that a file being written can be read after
+	each call to afSyncFile and that syncing does not change the
+	file which is finally written.
+*/
+
+#include <af_vfs.h>
+#include <algorithm>
+#include <audiofile.h>
+#include <gtest/gtest.h>
+#include <stdint.h>
+#include <string.h>
+#include <unistd.h>
+#include <string>
+#include <vector>
+
+#include "TestUtilities.h"
+
+static const int kChannelCount = 2;
+static const int kSyncCount = 12;
+
+static int framesInRound(int round)
+{
+	return 1000 + round * 337;
+}
+
+static void generateFrames(std::vector<int16_t> &data, int frameCount)
+{
+	data.resize(frameCount * kChannelCount);
+	for (size_t i=0; i<data.size(); i++)
+		data[i] = static_cast<int16_t>(((i / kChannelCount) * 40) % 20011 +
+			(i % kChannelCount) * 1000);
+}
+
+static AFfilehandle openForWriting(const std::string &path, int fileFormat,
+	int compression, AFframecount frameCountHint)
+{
+	AFfilesetup setup = afNewFileSetup();
+	afInitFileFormat(setup, fileFormat);
+	afInitChannels(setup, AF_DEFAULT_TRACK, kChannelCount);
+	afInitSampleFormat(setup, AF_DEFAULT_TRACK, AF_SAMPFMT_TWOSCOMP, 16);
+	afInitCompression(setup, AF_DEFAULT_TRACK, compression);
+	if (frameCountHint >= 0)
+		afInitFrameCount(setup, AF_DEFAULT_TRACK, frameCountHint);
+	AFfilehandle file = afOpenFile(path.c_str(), "w", setup);
+	afFreeFileSetup(setup);
+	return file;
+}
+
+static void readAll(const std::string &path, std::vector<int16_t> &data)
+{
+	AFfilehandle file = afOpenFile(path.c_str(), "r", AF_NULL_FILESETUP);
+	ASSERT_TRUE(file);
+	AFframecount frameCount = afGetFrameCount(file, AF_DEFAULT_TRACK);
+	data.resize(frameCount * kChannelCount);
+	if (frameCount)
+		ASSERT_EQ(afReadFrames(file, AF_DEFAULT_TRACK, &data[0], frameCount),
+			frameCount);
+	ASSERT_EQ(afCloseFile(file), 0);
+}
+
+static void writeFile(const std::string &path, int fileFormat,
+	int compression, AFframecount frameCountHint,
+	const std::vector<int16_t> &frames, int frameCount)
+{
+	AFfilehandle file = openForWriting(path, fileFormat, compression,
+		frameCountHint);
+	ASSERT_TRUE(file);
+	ASSERT_EQ(afWriteFrames(file, AF_DEFAULT_TRACK, &frames[0], frameCount),
+		frameCount);
+	ASSERT_EQ(afCloseFile(file), 0);
+}
+
+/*
+	After each sync, the file being written must read back the same
+	as a file to which the same frames were written and which was
+	then closed.
+*/
+static void testSync(int fileFormat, int compression, bool lossless,
+	AFframecount frameCountHint = -1)
+{
+	std::string testFileName, referenceFileName;
+	ASSERT_TRUE(createTemporaryFile("Sync", &testFileName));
+	ASSERT_TRUE(createTemporaryFile("Sync", &referenceFileName));
+
+	int totalFrameCount = 0;
+	for (int i=0; i<kSyncCount; i++)
+		totalFrameCount += framesInRound(i);
+	std::vector<int16_t> frames;
+	generateFrames(frames, totalFrameCount);
+
+	AFfilehandle file = openForWriting(testFileName, fileFormat, compression,
+		frameCountHint);
+	ASSERT_TRUE(file);
+	int framesWritten = 0;
+	for (int i=0; i<kSyncCount; i++)
+	{
+		int frameCount = framesInRound(i);
+		ASSERT_EQ(afWriteFrames(file, AF_DEFAULT_TRACK,
+			&frames[framesWritten * kChannelCount], frameCount), frameCount);
+		framesWritten += frameCount;
+		ASSERT_EQ(afSyncFile(file), 0);
+
+		writeFile(referenceFileName, fileFormat, compression, frameCountHint,
+			frames, framesWritten);
+
+		std::vector<int16_t> data, referenceData;
+		readAll(testFileName, data);
+		readAll(referenceFileName, referenceData);
+		ASSERT_EQ(data.size(), referenceData.size()) << "after sync " << i;
+		ASSERT_TRUE(data == referenceData) << "after sync " << i;
+		if (lossless)
+		{
+			ASSERT_EQ(data.size(), framesWritten * kChannelCount);
+			ASSERT_TRUE(std::equal(data.begin(), data.end(), frames.begin()));
+		}
+	}
+	ASSERT_EQ(afCloseFile(file), 0);
+
+	// Syncing leaves nothing behind in the finished file.
+	std::vector<int16_t> data, referenceData;
+	readAll(testFileName, data);
+	readAll(referenceFileName, referenceData);
+	EXPECT_TRUE(data == referenceData);
+	EXPECT_EQ(fileSize(testFileName), fileSize(referenceFileName));
+
+	ASSERT_EQ(::unlink(testFileName.c_str()), 0);
+	ASSERT_EQ(::unlink(referenceFileName.c_str()), 0);
+}
+
+TEST(Sync, WAVE)
+{
+	testSync(AF_FILE_WAVE, AF_COMPRESSION_NONE, true);
+}
+
+TEST(Sync, WAVE_IMA)
+{
+	testSync(AF_FILE_WAVE, AF_COMPRESSION_IMA, false);
+}
+
+TEST(Sync, AIFF)
+{
+	testSync(AF_FILE_AIFF, AF_COMPRESSION_NONE, true);
+}
+
+TEST(Sync, AIFFC_IMA)
+{
+	testSync(AF_FILE_AIFFC, AF_COMPRESSION_IMA, false);
+}
+
+TEST(Sync, NeXT)
+{
+	testSync(AF_FILE_NEXTSND, AF_COMPRESSION_NONE, true);
+}
+
+TEST(Sync, CAF)
+{
+	testSync(AF_FILE_CAF, AF_COMPRESSION_NONE, true);
+}
+
+TEST(Sync, CAF_IMA)
+{
+	testSync(AF_FILE_CAF, AF_COMPRESSION_IMA, false);
+}
+
+TEST(Sync, CAF_ALAC)
+{
+	testSync(AF_FILE_CAF, AF_COMPRESSION_ALAC, true);
+}
+
+/*
+	The packet table outgrows the space reserved for it and moves
+	after the audio data.
+*/
+TEST(Sync, CAF_ALAC_PacketTableOverflow)
+{
+	testSync(AF_FILE_CAF, AF_COMPRESSION_ALAC, true, 8192);
+}
+
+/*
+	A virtual file held in memory which counts the bytes written
+	to it.
+*/
+struct CountingFile
+{
+	std::vector<uint8_t> contents;
+	AFfileoffset position;
+	AFfileoffset bytesWritten;
+};
+
+static ssize_t countingRead(AFvirtualfile *vf, void *data, size_t nbytes)
+{
+	CountingFile *f = static_cast<CountingFile *>(vf->closure);
+	AFfileoffset length = f->contents.size();
+	if (f->position >= length)
+		return 0;
+	if (static_cast<AFfileoffset>(nbytes) > length - f->position)
+		nbytes = length - f->position;
+	memcpy(data, &f->contents[f->position], nbytes);
+	f->position += nbytes;
+	return nbytes;
+}
+
+static ssize_t countingWrite(AFvirtualfile *vf, const void *data, size_t nbytes)
+{
+	CountingFile *f = static_cast<CountingFile *>(vf->closure);
+	if (f->position + nbytes > f->contents.size())
+		f->contents.resize(f->position + nbytes);
+	memcpy(&f->contents[f->position], data, nbytes);
+	f->position += nbytes;
+	f->bytesWritten += nbytes;
+	return nbytes;
+}
+
+static AFfileoffset countingLength(AFvirtualfile *vf)
+{
+	return static_cast<CountingFile *>(vf->closure)->contents.size();
+}
+
+static AFfileoffset countingSeek(AFvirtualfile *vf, AFfileoffset offset,
+	int isRelative)
+{
+	CountingFile *f = static_cast<CountingFile *>(vf->closure);
+	f->position = isRelative ? f->position + offset : offset;
+	return f->position;
+}
+
+static AFfileoffset countingTell(AFvirtualfile *vf)
+{
+	return static_cast<CountingFile *>(vf->closure)->position;
+}
+
+static void countingDestroy(AFvirtualfile *)
+{
+}
+
+static AFvirtualfile *createCountingFile(CountingFile *f)
+{
+	AFvirtualfile *vf = af_virtual_file_new();
+	vf->read = countingRead;
+	vf->write = countingWrite;
+	vf->length = countingLength;
+	vf->seek = countingSeek;
+	vf->tell = countingTell;
+	vf->destroy = countingDestroy;
+	vf->closure = f;
+	f->position = 0;
+	f->bytesWritten = 0;
+	return vf;
+}
+
+/*
+	Syncing a file which is being recorded should write only its
+	header, however much audio data it already holds.  The frames
+	written in each round fill whole packets so that no partial
+	packet is written by a sync.
+*/
+static void testSyncCost(int fileFormat, int compression)
+{
+	const int kRoundCount = 400;
+	const int kFramesPerRound = 4096;
+	const AFfileoffset kMaximumSyncBytes = 128;
+
+	CountingFile countingFile;
+	AFfilesetup setup = afNewFileSetup();
+	afInitFileFormat(setup, fileFormat);
+	afInitChannels(setup, AF_DEFAULT_TRACK, kChannelCount);
+	afInitSampleFormat(setup, AF_DEFAULT_TRACK, AF_SAMPFMT_TWOSCOMP, 16);
+	afInitCompression(setup, AF_DEFAULT_TRACK, compression);
+	afInitBufferSize(setup, 0);
+	AFfilehandle file = afOpenVirtualFile(createCountingFile(&countingFile),
+		"w", setup);
+	afFreeFileSetup(setup);
+	ASSERT_TRUE(file);
+
+	std::vector<int16_t> frames;
+	generateFrames(frames, kFramesPerRound);
+	for (int i=0; i<kRoundCount; i++)
+	{
+		ASSERT_EQ(afWriteFrames(file, AF_DEFAULT_TRACK, &frames[0],
+			kFramesPerRound), kFramesPerRound);
+		AFfileoffset bytesBeforeSync = countingFile.bytesWritten;
+		ASSERT_EQ(afSyncFile(file), 0);
+		ASSERT_LE(countingFile.bytesWritten - bytesBeforeSync,
+			kMaximumSyncBytes) << "sync " << i;
+	}
+	ASSERT_EQ(afCloseFile(file), 0);
+}
+
+TEST(Sync, CostWAVE)
+{
+	testSyncCost(AF_FILE_WAVE, AF_COMPRESSION_NONE);
+}
+
+TEST(Sync, CostAIFF)
+{
+	testSyncCost(AF_FILE_AIFF, AF_COMPRESSION_NONE);
+}
+
+TEST(Sync, CostCAF_ALAC)
+{
+	testSyncCost(AF_FILE_CAF, AF_COMPRESSION_ALAC);
+}
+
+int main(int argc, char **argv)
+{
+	::testing::InitGoogleTest(&argc, argv);
+	return RUN_ALL_TESTS();
+}
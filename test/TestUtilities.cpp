@@ -21,8 +21,10 @@
 #include "TestUtilities.h"
 
 #include <limits.h>
+#include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
+#include <sys/stat.h>
 #include <unistd.h>
 
 bool createTemporaryFile(const std::string &prefix, std::string *path)
@@ -44,3 +46,35 @@ bool createTemporaryFile(const char *prefix, char **path)
 		*path = ::strdup(pathString.c_str());
 	return result;
 }
+
+off_t fileSize(const std::string &path)
+{
+	struct stat st;
+	if (::stat(path.c_str(), &st) != 0)
+		return -1;
+	return st.st_size;
+}
+
+bool readFileContents(const std::string &path, std::vector<uint8_t> *contents)
+{
+	FILE *f = fopen(path.c_str(), "rb");
+	if (!f)
+		return false;
+	contents->clear();
+	uint8_t buffer[4096];
+	size_t n;
+	while ((n = fread(buffer, 1, sizeof (buffer), f)) > 0)
+		contents->insert(contents->end(), buffer, buffer + n);
+	fclose(f);
+	return true;
+}
+
+void generateStereoFrames(std::vector<int16_t> &data, int frameCount)
+{
+	data.resize(frameCount * 2);
+	for (int i=0; i<frameCount; i++)
+	{
+		data[2*i] = (i * 37) % 20011 - 10000;
+		data[2*i + 1] = (i * 53) % 30011 - 15000;
+	}
+}
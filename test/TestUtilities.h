@@ -25,10 +25,25 @@
 
 #ifdef __cplusplus
 
+#include <stdint.h>
+#include <sys/types.h>
 #include <string>
+#include <vector>
 
 bool createTemporaryFile(const std::string &prefix, std::string *path);
 
+// Return the size of the file at path, or -1 if it cannot be found.
+off_t fileSize(const std::string &path);
+
+// Read the whole file at path into contents.
+bool readFileContents(const std::string &path, std::vector<uint8_t> *contents);
+
+/*
+	Fill data with frameCount frames of two channels, each of which
+	repeatedly ramps through a different range of values.
+*/
+void generateStereoFrames(std::vector<int16_t> &data, int frameCount);
+
 class IgnoreErrors
 {
 public:
@@ -0,0 +1,128 @@
+/*
+	Audio File Library
+
+	This program is free software; you can redistribute it and/or modify
+	it under the terms of the GNU General Public License as published by
+	the Free Software Foundation; either version 2 of the License, or
+	(at your option) any later version.
+
+	This program is distributed in the hope that it will be useful,
+	but WITHOUT ANY WARRANTY; without even the implied warranty of
+	MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+	GNU General Public License for more details.
+
+	You should have received a copy of the GNU General Public License along
+	with this program; if not, write to the Free Software Foundation, Inc.,
+	51 Franklin Street, Fifth Floor, Boston, MA  02110-1301  USA
+*/
+
+/*
+	This program tests that files written in small pieces with their
+	buffer written from a background thread are the same as files
+	written in one piece without one.
+*/
+
+#include <algorithm>
+#include <audiofile.h>
+#include <gtest/gtest.h>
+#include <stdint.h>
+#include <unistd.h>
+#include <string>
+#include <vector>
+
+#include "TestUtilities.h"
+
+static const int kChannelCount = 2;
+static const int kFrameCount = 100000;
+
+static AFfilehandle openForWriting(const std::string &path, int fileFormat,
+	int compression, bool writeBehind)
+{
+	AFfilesetup setup = afNewFileSetup();
+	afInitFileFormat(setup, fileFormat);
+	afInitChannels(setup, AF_DEFAULT_TRACK, kChannelCount);
+	afInitSampleFormat(setup, AF_DEFAULT_TRACK, AF_SAMPFMT_TWOSCOMP, 16);
+	afInitCompression(setup, AF_DEFAULT_TRACK, compression);
+	afInitWriteBehind(setup, writeBehind);
+	AFfilehandle file = afOpenFile(path.c_str(), "w", setup);
+	afFreeFileSetup(setup);
+	return file;
+}
+
+static void testWriteBehind(int fileFormat, int compression, bool lossless)
+{
+	std::string path, referencePath;
+	ASSERT_TRUE(createTemporaryFile("WriteBehind", &path));
+	ASSERT_TRUE(createTemporaryFile("WriteBehind", &referencePath));
+
+	std::vector<int16_t> frames;
+	generateStereoFrames(frames, kFrameCount);
+
+	// Write in pieces of 64 to 512 frames, syncing along the way.
+	AFfilehandle file = openForWriting(path, fileFormat, compression, true);
+	ASSERT_TRUE(file);
+	int framesWritten = 0;
+	for (int i=0; framesWritten < kFrameCount; i++)
+	{
+		int frameCount = std::min(64 + (i * 97) % 449,
+			kFrameCount - framesWritten);
+		ASSERT_EQ(frameCount, afWriteFrames(file, AF_DEFAULT_TRACK,
+			&frames[framesWritten * kChannelCount], frameCount));
+		framesWritten += frameCount;
+		if (i % 100 == 99)
+			ASSERT_EQ(0, afSyncFile(file));
+	}
+	ASSERT_EQ(0, afCloseFile(file));
+
+	file = openForWriting(referencePath, fileFormat, compression, false);
+	ASSERT_TRUE(file);
+	ASSERT_EQ(kFrameCount, afWriteFrames(file, AF_DEFAULT_TRACK,
+		&frames[0], kFrameCount));
+	ASSERT_EQ(0, afCloseFile(file));
+
+	std::vector<uint8_t> contents, referenceContents;
+	ASSERT_TRUE(readFileContents(path, &contents));
+	ASSERT_TRUE(readFileContents(referencePath, &referenceContents));
+	EXPECT_TRUE(contents == referenceContents);
+
+	file = afOpenFile(path.c_str(), "r", AF_NULL_FILESETUP);
+	ASSERT_TRUE(file);
+	EXPECT_EQ(kFrameCount, afGetFrameCount(file, AF_DEFAULT_TRACK));
+	if (lossless)
+	{
+		std::vector<int16_t> data(kFrameCount * kChannelCount);
+		ASSERT_EQ(kFrameCount, afReadFrames(file, AF_DEFAULT_TRACK,
+			&data[0], kFrameCount));
+		EXPECT_TRUE(data == frames);
+	}
+	ASSERT_EQ(0, afCloseFile(file));
+
+	ASSERT_EQ(0, ::unlink(path.c_str()));
+	ASSERT_EQ(0, ::unlink(referencePath.c_str()));
+}
+
+TEST(WriteBehind, WAVE_PCM)
+{
+	testWriteBehind(AF_FILE_WAVE, AF_COMPRESSION_NONE, true);
+}
+
+TEST(WriteBehind, AIFC_PCM)
+{
+	testWriteBehind(AF_FILE_AIFFC, AF_COMPRESSION_NONE, true);
+}
+
+TEST(WriteBehind, WAVE_IMA)
+{
+	testWriteBehind(AF_FILE_WAVE, AF_COMPRESSION_IMA, false);
+}
+
+TEST(WriteBehind, CAF_ALAC)
+{
+	testWriteBehind(AF_FILE_CAF, AF_COMPRESSION_ALAC, true);
+}
+
+int main(int argc, char **argv)
+{
+	::testing::InitGoogleTest(&argc, argv);
+	return RUN_ALL_TESTS();
+}
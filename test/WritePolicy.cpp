@@ -0,0 +1,183 @@
+/*
+	Audio File Library
+
+	This program is free software; you can redistribute it and/or modify
+	it under the terms of the GNU General Public License as published by
+	the Free Software Foundation; either version 2 of the License, or
+	(at your option) any later version.
+
+	This program is distributed in the hope that it will be useful,
+	but WITHOUT ANY WARRANTY; without even the implied warranty of
+	MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+	GNU General Public License for more details.
+
+	You should have received a copy of the GNU General Public License along
+	with this program; if not, write to the Free Software Foundation, Inc.,
+	51 Franklin Street, Fifth Floor, Boston, MA  02110-1301  USA
+*/
+
+/*
+	This program tests that files written with preallocation, direct
+	I/O and synchronization with storage are the same as files written
+	without.
+*/
+
+#include <algorithm>
+#include <audiofile.h>
+#include <gtest/gtest.h>
+#include <fcntl.h>
+#include <stdint.h>
+#include <unistd.h>
+#include <string>
+#include <vector>
+
+#include "TestUtilities.h"
+
+static const int kChannelCount = 2;
+static const int kFrameCount = 100000;
+
+static AFfilesetup createSetup(int fileFormat, int compression,
+	AFframecount frameCount, int bufferSize, int policy)
+{
+	AFfilesetup setup = afNewFileSetup();
+	afInitFileFormat(setup, fileFormat);
+	afInitChannels(setup, AF_DEFAULT_TRACK, kChannelCount);
+	afInitSampleFormat(setup, AF_DEFAULT_TRACK, AF_SAMPFMT_TWOSCOMP, 16);
+	afInitCompression(setup, AF_DEFAULT_TRACK, compression);
+	if (frameCount >= 0)
+		afInitFrameCount(setup, AF_DEFAULT_TRACK, frameCount);
+	afInitBufferSize(setup, bufferSize);
+	afInitWritePolicy(setup, policy);
+	return setup;
+}
+
+// Write frames in pieces of 64 to 512 frames, syncing along the way.
+static void writeFrames(AFfilehandle file, const std::vector<int16_t> &frames)
+{
+	int framesWritten = 0;
+	for (int i=0; framesWritten < kFrameCount; i++)
+	{
+		int frameCount = std::min(64 + (i * 97) % 449,
+			kFrameCount - framesWritten);
+		ASSERT_EQ(frameCount, afWriteFrames(file, AF_DEFAULT_TRACK,
+			&frames[framesWritten * kChannelCount], frameCount));
+		framesWritten += frameCount;
+		if (i % 100 == 99)
+			ASSERT_EQ(0, afSyncFile(file));
+	}
+}
+
+static void testWritePolicy(int fileFormat, int compression, int policy,
+	AFframecount frameCount, int bufferSize, bool useFD)
+{
+	std::string path, referencePath;
+	ASSERT_TRUE(createTemporaryFile("WritePolicy", &path));
+	ASSERT_TRUE(createTemporaryFile("WritePolicy", &referencePath));
+
+	std::vector<int16_t> frames;
+	generateStereoFrames(frames, kFrameCount);
+
+	AFfilesetup setup = createSetup(fileFormat, compression, frameCount,
+		bufferSize, policy);
+	AFfilehandle file;
+	int fd = -1;
+	if (useFD)
+	{
+		fd = ::open(path.c_str(), O_CREAT | O_RDWR | O_TRUNC, 0666);
+		ASSERT_NE(-1, fd);
+		file = afOpenFD(fd, "w", setup);
+	}
+	else
+		file = afOpenFile(path.c_str(), "w", setup);
+	afFreeFileSetup(setup);
+	ASSERT_TRUE(file);
+	writeFrames(file, frames);
+	ASSERT_EQ(0, afCloseFile(file));
+
+	setup = createSetup(fileFormat, compression, frameCount,
+		BUFSIZ, AF_WRITE_NORMAL);
+	file = afOpenFile(referencePath.c_str(), "w", setup);
+	afFreeFileSetup(setup);
+	ASSERT_TRUE(file);
+	ASSERT_EQ(kFrameCount, afWriteFrames(file, AF_DEFAULT_TRACK,
+		&frames[0], kFrameCount));
+	ASSERT_EQ(0, afCloseFile(file));
+
+	std::vector<uint8_t> contents, referenceContents;
+	ASSERT_TRUE(readFileContents(path, &contents));
+	ASSERT_TRUE(readFileContents(referencePath, &referenceContents));
+	EXPECT_EQ(referenceContents.size(), contents.size());
+	EXPECT_TRUE(contents == referenceContents);
+
+	file = afOpenFile(path.c_str(), "r", AF_NULL_FILESETUP);
+	ASSERT_TRUE(file);
+	EXPECT_EQ(kFrameCount, afGetFrameCount(file, AF_DEFAULT_TRACK));
+	if (compression == AF_COMPRESSION_NONE)
+	{
+		std::vector<int16_t> data(kFrameCount * kChannelCount);
+		ASSERT_EQ(kFrameCount, afReadFrames(file, AF_DEFAULT_TRACK,
+			&data[0], kFrameCount));
+		EXPECT_TRUE(data == frames);
+	}
+	ASSERT_EQ(0, afCloseFile(file));
+
+	ASSERT_EQ(0, ::unlink(path.c_str()));
+	ASSERT_EQ(0, ::unlink(referencePath.c_str()));
+}
+
+TEST(WritePolicy, Preallocate)
+{
+	testWritePolicy(AF_FILE_WAVE, AF_COMPRESSION_NONE,
+		AF_WRITE_PREALLOCATE, kFrameCount, 65536, false);
+}
+
+// Storage reserved beyond the frames written does not lengthen the file.
+TEST(WritePolicy, Preallocate_Larger)
+{
+	testWritePolicy(AF_FILE_AIFFC, AF_COMPRESSION_NONE,
+		AF_WRITE_PREALLOCATE, 4 * kFrameCount, 65536, false);
+}
+
+TEST(WritePolicy, Preallocate_IMA)
+{
+	testWritePolicy(AF_FILE_WAVE, AF_COMPRESSION_IMA,
+		AF_WRITE_PREALLOCATE, kFrameCount, 65536, false);
+}
+
+TEST(WritePolicy, Direct)
+{
+	testWritePolicy(AF_FILE_WAVE, AF_COMPRESSION_NONE,
+		AF_WRITE_DIRECT, -1, 65536, false);
+}
+
+// Without buffering, most writes are neither aligned nor whole blocks.
+TEST(WritePolicy, Direct_Unbuffered)
+{
+	testWritePolicy(AF_FILE_WAVE, AF_COMPRESSION_NONE,
+		AF_WRITE_DIRECT, -1, 0, false);
+}
+
+TEST(WritePolicy, Direct_FD)
+{
+	testWritePolicy(AF_FILE_AIFFC, AF_COMPRESSION_NONE,
+		AF_WRITE_DIRECT | AF_WRITE_SYNC_ON_CLOSE, -1, 65536, true);
+}
+
+TEST(WritePolicy, Direct_ALAC)
+{
+	testWritePolicy(AF_FILE_CAF, AF_COMPRESSION_ALAC,
+		AF_WRITE_DIRECT | AF_WRITE_PREALLOCATE, kFrameCount, 65536, false);
+}
+
+TEST(WritePolicy, All)
+{
+	testWritePolicy(AF_FILE_WAVE, AF_COMPRESSION_NONE,
+		AF_WRITE_PREALLOCATE | AF_WRITE_DIRECT | AF_WRITE_SYNC_ALWAYS,
+		kFrameCount, 1 << 20, false);
+}
+
+int main(int argc, char **argv)
+{
+	::testing::InitGoogleTest(&argc, argv);
+	return RUN_ALL_TESTS();
+}